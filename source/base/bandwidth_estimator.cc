@@ -0,0 +1,163 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/bandwidth_estimator.h"
+
+#include <algorithm>
+
+namespace base {
+
+namespace {
+
+// The samples for shorter intervals are not precise enough.
+constexpr BandwidthEstimator::Clock::duration kMinSampleInterval = std::chrono::milliseconds(1);
+
+// Weight of a new sample in the smoothed round-trip time (as in TCP).
+const int kRttWeightDivider = 8;
+
+} // namespace
+
+constexpr BandwidthEstimator::Clock::duration BandwidthEstimator::kSampleWindow;
+constexpr BandwidthEstimator::Clock::duration BandwidthEstimator::kMinRttWindow;
+constexpr BandwidthEstimator::Clock::duration BandwidthEstimator::kMaxQueueDelay;
+constexpr double BandwidthEstimator::kBackoffFactor;
+constexpr double BandwidthEstimator::kMinBackoff;
+
+void BandwidthEstimator::packetSent(uint32_t id, size_t size, Clock::time_point time)
+{
+    // Nothing is in flight. The time of waiting for the data must not be counted as the time of
+    // the delivery.
+    if (packets_.empty())
+        delivered_time_ = time;
+
+    packets_.push_back({ id, size, time, delivered_, delivered_time_ });
+}
+
+void BandwidthEstimator::packetAcknowledged(uint32_t id, Clock::time_point time)
+{
+    if (packets_.empty())
+        return;
+
+    // Old confirmations and the confirmations of unknown packets are ignored.
+    if (static_cast<int32_t>(id - packets_.front().id) < 0 ||
+        static_cast<int32_t>(id - packets_.back().id) > 0)
+    {
+        return;
+    }
+
+    Packet last_packet = packets_.front();
+
+    while (!packets_.empty() && static_cast<int32_t>(id - packets_.front().id) >= 0)
+    {
+        last_packet = packets_.front();
+        delivered_ += last_packet.size;
+        packets_.pop_front();
+    }
+
+    delivered_time_ = time;
+
+    addRttSample(time, time - last_packet.sent_time);
+
+    const Clock::duration interval = time - last_packet.delivered_time;
+    if (interval < kMinSampleInterval)
+        return;
+
+    const int64_t interval_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(interval).count();
+
+    addSample(time, (delivered_ - last_packet.delivered) * 1000000 / interval_us);
+}
+
+int64_t BandwidthEstimator::bytesPerSecond() const
+{
+    if (samples_.empty())
+        return 0;
+
+    return samples_.front().bytes_per_second;
+}
+
+int64_t BandwidthEstimator::targetBytesPerSecond() const
+{
+    return static_cast<int64_t>(bytesPerSecond() * backoff_);
+}
+
+BandwidthEstimator::Clock::duration BandwidthEstimator::minRtt() const
+{
+    if (rtt_samples_.empty())
+        return Clock::duration::zero();
+
+    return rtt_samples_.front().rtt;
+}
+
+void BandwidthEstimator::reset()
+{
+    packets_.clear();
+    samples_.clear();
+    rtt_samples_.clear();
+    delivered_ = 0;
+    smoothed_rtt_ = Clock::duration::zero();
+    backoff_ = 1.0;
+}
+
+void BandwidthEstimator::addSample(Clock::time_point time, int64_t bytes_per_second)
+{
+    while (!samples_.empty() && samples_.front().time + kSampleWindow < time)
+        samples_.pop_front();
+
+    while (!samples_.empty() && samples_.back().bytes_per_second <= bytes_per_second)
+        samples_.pop_back();
+
+    samples_.push_back({ time, bytes_per_second });
+}
+
+void BandwidthEstimator::addRttSample(Clock::time_point time, Clock::duration rtt)
+{
+    while (!rtt_samples_.empty() && rtt_samples_.front().time + kMinRttWindow < time)
+        rtt_samples_.pop_front();
+
+    while (!rtt_samples_.empty() && rtt_samples_.back().rtt >= rtt)
+        rtt_samples_.pop_back();
+
+    rtt_samples_.push_back({ time, rtt });
+
+    if (smoothed_rtt_ == Clock::duration::zero())
+        smoothed_rtt_ = rtt;
+    else
+        smoothed_rtt_ += (rtt - smoothed_rtt_) / kRttWeightDivider;
+
+    const Clock::duration queue_delay = smoothed_rtt_ - minRtt();
+    const Clock::duration max_queue_delay = std::max(kMaxQueueDelay, minRtt());
+
+    if (queue_delay > max_queue_delay)
+    {
+        // The rate is reduced once per round trip: the confirmations of the packets sent before
+        // the previous reduction still show the old queue.
+        if (time - backoff_time_ >= smoothed_rtt_)
+        {
+            backoff_ = std::max(backoff_ * kBackoffFactor, kMinBackoff);
+            backoff_time_ = time;
+        }
+    }
+    else if (queue_delay < max_queue_delay / 2)
+    {
+        // Fast recovery: the queue is drained, the path can take the estimated bandwidth.
+        backoff_ = 1.0;
+    }
+}
+
+} // namespace base
@@ -0,0 +1,126 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__BANDWIDTH_ESTIMATOR_H
+#define BASE__BANDWIDTH_ESTIMATOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// Estimates the throughput of the path to the peer from the confirmations of the sent packets.
+// Each confirmation gives a sample of the delivery rate: the bytes confirmed since the confirmed
+// packet was sent divided by the time elapsed since then. When the sender has nothing to send,
+// the samples show the rate of the sender instead of the rate of the path, so the estimate is the
+// maximum of the samples of the last |kSampleWindow|.
+//
+// Each confirmation also gives a sample of the round-trip time. The difference between the
+// smoothed and the minimum round-trip time is the time that the packets wait in the queues of the
+// path. When the queue grows, the target rate is reduced by |kBackoffFactor| once per round trip.
+// When the queue is drained, the target rate returns to the estimated bandwidth at once.
+//
+// The packets are identified by the sequence numbers. A confirmation confirms the packet and all
+// previous packets.
+class BandwidthEstimator
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::duration kSampleWindow = std::chrono::seconds(5);
+    static constexpr Clock::duration kMinRttWindow = std::chrono::seconds(10);
+
+    // The queue delay above which the target rate is reduced. The delay is allowed to be as long
+    // as the minimum round-trip time on the paths with a long round trip.
+    static constexpr Clock::duration kMaxQueueDelay = std::chrono::milliseconds(50);
+
+    static constexpr double kBackoffFactor = 0.75;
+    static constexpr double kMinBackoff = 0.25;
+
+    BandwidthEstimator() = default;
+    ~BandwidthEstimator() = default;
+
+    void packetSent(uint32_t id, size_t size, Clock::time_point time = Clock::now());
+    void packetAcknowledged(uint32_t id, Clock::time_point time = Clock::now());
+
+    // Returns the estimated bandwidth in bytes per second or 0 if there are no samples.
+    int64_t bytesPerSecond() const;
+
+    // Returns the rate at which the sender can send without growing the queue of the path. 0 if
+    // the bandwidth is unknown.
+    int64_t targetBytesPerSecond() const;
+
+    Clock::duration minRtt() const;
+    Clock::duration smoothedRtt() const { return smoothed_rtt_; }
+
+    void reset();
+
+private:
+    struct Packet
+    {
+        uint32_t id;
+        size_t size;
+        Clock::time_point sent_time;
+
+        // The values of |delivered_| and |delivered_time_| when the packet was sent.
+        int64_t delivered;
+        Clock::time_point delivered_time;
+    };
+
+    struct Sample
+    {
+        Clock::time_point time;
+        int64_t bytes_per_second;
+    };
+
+    struct RttSample
+    {
+        Clock::time_point time;
+        Clock::duration rtt;
+    };
+
+    void addSample(Clock::time_point time, int64_t bytes_per_second);
+    void addRttSample(Clock::time_point time, Clock::duration rtt);
+
+    // The packets which are not confirmed yet, in the order of sending.
+    std::deque<Packet> packets_;
+
+    // Total size of the confirmed packets and the time of the last confirmation.
+    int64_t delivered_ = 0;
+    Clock::time_point delivered_time_;
+
+    // The samples of the window in decreasing order of the rate: a sample is removed when a newer
+    // sample with a higher rate is added, so the first sample is the maximum.
+    std::deque<Sample> samples_;
+
+    // The round-trip times of the window in increasing order, the first sample is the minimum.
+    std::deque<RttSample> rtt_samples_;
+    Clock::duration smoothed_rtt_ = Clock::duration::zero();
+
+    double backoff_ = 1.0;
+    Clock::time_point backoff_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(BandwidthEstimator);
+};
+
+} // namespace base
+
+#endif // BASE__BANDWIDTH_ESTIMATOR_H
@@ -0,0 +1,226 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "base/bandwidth_estimator.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace base {
+
+namespace {
+
+using Clock = BandwidthEstimator::Clock;
+
+const size_t kPacketSize = 10000;
+const int kWindow = 10;
+
+// The path delivers one packet of |kPacketSize| every 10 ms (1 MB/s) with a delay of 20 ms. The
+// sender keeps |kWindow| packets in flight. Returns the time of the last confirmation.
+Clock::time_point sendPackets(BandwidthEstimator* estimator,
+                              Clock::time_point start_time,
+                              uint32_t* next_id,
+                              int count)
+{
+    const Clock::duration packet_time = std::chrono::milliseconds(10);
+    const Clock::duration delay = std::chrono::milliseconds(20);
+
+    Clock::time_point time = start_time;
+    uint32_t first_id = *next_id;
+
+    for (int i = 0; i < kWindow; ++i)
+        estimator->packetSent((*next_id)++, kPacketSize, time);
+
+    for (int i = 0; i < count; ++i)
+    {
+        time = start_time + delay + packet_time * (i + 1);
+
+        estimator->packetAcknowledged(first_id + i, time);
+
+        if (i + kWindow < count)
+            estimator->packetSent((*next_id)++, kPacketSize, time);
+    }
+
+    return time;
+}
+
+// A path of 1 MB/s with a one-way delay of 10 ms and an unlimited queue.
+class Path
+{
+public:
+    // Returns the time of the confirmation of the packet.
+    Clock::time_point send(Clock::time_point time, size_t size)
+    {
+        const Clock::duration transfer_time = std::chrono::microseconds(size);
+
+        delivery_time_ = std::max(time, delivery_time_) + transfer_time;
+        return delivery_time_ + 2 * kDelay;
+    }
+
+private:
+    static constexpr Clock::duration kDelay = std::chrono::milliseconds(10);
+    Clock::time_point delivery_time_;
+};
+
+constexpr Clock::duration Path::kDelay;
+
+// Sends |count| packets with |interval| and confirms them at the times given by |path|. Returns
+// the time of the last confirmation.
+Clock::time_point sendToPath(BandwidthEstimator* estimator,
+                             Path* path,
+                             Clock::time_point start_time,
+                             Clock::duration interval,
+                             uint32_t* next_id,
+                             int count)
+{
+    struct Ack
+    {
+        uint32_t id;
+        Clock::time_point time;
+    };
+
+    std::deque<Ack> acks;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const Clock::time_point send_time = start_time + interval * i;
+
+        while (!acks.empty() && acks.front().time <= send_time)
+        {
+            estimator->packetAcknowledged(acks.front().id, acks.front().time);
+            acks.pop_front();
+        }
+
+        const uint32_t id = (*next_id)++;
+        estimator->packetSent(id, kPacketSize, send_time);
+        acks.push_back({ id, path->send(send_time, kPacketSize) });
+    }
+
+    for (const auto& ack : acks)
+        estimator->packetAcknowledged(ack.id, ack.time);
+
+    return acks.back().time;
+}
+
+} // namespace
+
+TEST(bandwidth_estimator, no_samples)
+{
+    BandwidthEstimator estimator;
+    EXPECT_EQ(0, estimator.bytesPerSecond());
+
+    estimator.packetSent(1, kPacketSize);
+
+    // Unknown packet.
+    estimator.packetAcknowledged(2);
+    EXPECT_EQ(0, estimator.bytesPerSecond());
+}
+
+TEST(bandwidth_estimator, busy_path)
+{
+    BandwidthEstimator estimator;
+    uint32_t next_id = 1;
+
+    sendPackets(&estimator, Clock::now(), &next_id, 100);
+
+    EXPECT_NEAR(static_cast<double>(estimator.bytesPerSecond()), 1000000.0, 10000.0);
+}
+
+TEST(bandwidth_estimator, idle_sender)
+{
+    BandwidthEstimator estimator;
+    uint32_t next_id = 1;
+
+    Clock::time_point time = sendPackets(&estimator, Clock::now(), &next_id, 100);
+    const int64_t busy_bandwidth = estimator.bytesPerSecond();
+
+    // A small packet per second. The path is idle, so the packets are confirmed quickly.
+    for (int i = 0; i < 10; ++i)
+    {
+        time += std::chrono::seconds(1);
+
+        const uint32_t id = next_id++;
+        estimator.packetSent(id, 1000, time);
+        estimator.packetAcknowledged(id, time + std::chrono::milliseconds(20));
+
+        // The samples of the idle sender do not lower the estimate until the samples of the busy
+        // path are out of the window.
+        if (i < 4)
+        {
+            EXPECT_EQ(busy_bandwidth, estimator.bytesPerSecond());
+        }
+    }
+
+    EXPECT_EQ(50000, estimator.bytesPerSecond());
+}
+
+TEST(bandwidth_estimator, old_acknowledgement)
+{
+    BandwidthEstimator estimator;
+    const Clock::time_point time = Clock::now();
+
+    estimator.packetSent(1, kPacketSize, time);
+    estimator.packetSent(2, kPacketSize, time);
+    estimator.packetAcknowledged(2, time + std::chrono::milliseconds(20));
+
+    const int64_t bandwidth = estimator.bytesPerSecond();
+    EXPECT_EQ(1000000, bandwidth);
+
+    // The packets are already confirmed.
+    estimator.packetAcknowledged(1, time + std::chrono::milliseconds(40));
+    EXPECT_EQ(bandwidth, estimator.bytesPerSecond());
+}
+
+TEST(bandwidth_estimator, round_trip_time)
+{
+    BandwidthEstimator estimator;
+    Path path;
+    uint32_t next_id = 1;
+
+    // The path is not loaded: the round trip is the transfer time and the delays.
+    sendToPath(&estimator, &path, Clock::now(), std::chrono::milliseconds(50), &next_id, 20);
+
+    EXPECT_EQ(std::chrono::milliseconds(30), estimator.minRtt());
+    EXPECT_EQ(std::chrono::milliseconds(30), estimator.smoothedRtt());
+    EXPECT_EQ(estimator.bytesPerSecond(), estimator.targetBytesPerSecond());
+}
+
+TEST(bandwidth_estimator, queue_backoff_and_recovery)
+{
+    BandwidthEstimator estimator;
+    Path path;
+    uint32_t next_id = 1;
+
+    Clock::time_point time = Clock::now();
+
+    // Twice the bandwidth of the path: the queue grows and the target rate is reduced.
+    time = sendToPath(&estimator, &path, time, std::chrono::milliseconds(5), &next_id, 100);
+
+    EXPECT_NEAR(static_cast<double>(estimator.bytesPerSecond()), 1000000.0, 10000.0);
+    EXPECT_LT(estimator.targetBytesPerSecond(), estimator.bytesPerSecond());
+    EXPECT_GT(estimator.smoothedRtt(), estimator.minRtt() + BandwidthEstimator::kMaxQueueDelay);
+
+    // Half of the bandwidth: the queue is drained and the target rate is restored.
+    sendToPath(&estimator, &path, time, std::chrono::milliseconds(20), &next_id, 100);
+
+    EXPECT_EQ(estimator.bytesPerSecond(), estimator.targetBytesPerSecond());
+}
+
+} // namespace base
@@ -0,0 +1,242 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/benchmark.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace base {
+
+namespace {
+
+// The measured function is called at least this number of times.
+const int64_t kMinIterations = 3;
+
+std::string jsonString(const std::string& value)
+{
+    std::string result = "\"";
+
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+
+        result += c;
+    }
+
+    result += '"';
+    return result;
+}
+
+bool startsWith(const char* value, const char* prefix)
+{
+    return strncmp(value, prefix, strlen(prefix)) == 0;
+}
+
+} // namespace
+
+Benchmark::Benchmark(int argc, char* argv[])
+    : output_(std::cout)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--format=json") == 0)
+        {
+            format_ = Format::JSON;
+        }
+        else if (strcmp(arg, "--format=csv") == 0)
+        {
+            format_ = Format::CSV;
+        }
+        else if (startsWith(arg, "--filter="))
+        {
+            filter_ = arg + strlen("--filter=");
+        }
+        else if (startsWith(arg, "--min-time="))
+        {
+            min_time_ns_ = atoll(arg + strlen("--min-time=")) * 1000 * 1000;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl
+                      << "Usage: " << argv[0]
+                      << " [--format=json|csv] [--filter=TEXT] [--min-time=MS]" << std::endl;
+            valid_ = false;
+        }
+    }
+}
+
+bool Benchmark::isEnabled(const std::string& suite, const std::string& name) const
+{
+    if (filter_.empty())
+        return true;
+
+    return suite.find(filter_) != std::string::npos || name.find(filter_) != std::string::npos;
+}
+
+void Benchmark::run(const std::string& suite,
+                    const std::string& name,
+                    const Params& params,
+                    int64_t bytes,
+                    const Function& function)
+{
+    run(suite, name, params, bytes, Counters(), function);
+}
+
+void Benchmark::run(const std::string& suite,
+                    const std::string& name,
+                    const Params& params,
+                    int64_t bytes,
+                    const Counters& counters,
+                    const Function& function)
+{
+    if (!isEnabled(suite, name))
+        return;
+
+    using Clock = std::chrono::steady_clock;
+
+    // Warm up the caches and the lazy initialization of the measured code.
+    function();
+
+    int64_t iterations = 0;
+    int64_t elapsed_ns = 0;
+    int64_t batch = 1;
+
+    while (elapsed_ns < min_time_ns_ || iterations < kMinIterations)
+    {
+        const Clock::time_point start_time = Clock::now();
+
+        for (int64_t i = 0; i < batch; ++i)
+            function();
+
+        elapsed_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start_time).count();
+        iterations += batch;
+
+        // Fast functions are called in batches, so that the clock is not measured.
+        if (elapsed_ns < min_time_ns_ / 10)
+            batch *= 2;
+    }
+
+    const double ns_per_call = static_cast<double>(elapsed_ns) / iterations;
+    const double gb_per_second = bytes ? bytes / ns_per_call : 0.0;
+
+    printResult(suite, name, params, iterations, ns_per_call, gb_per_second, counters);
+}
+
+void Benchmark::printHeader()
+{
+    if (header_printed_)
+        return;
+
+    header_printed_ = true;
+
+    if (format_ == Format::CSV)
+    {
+        output_ << "suite,name,params,iterations,ns_per_call,calls_per_second,gb_per_second,"
+                  "counters"
+                << std::endl;
+    }
+}
+
+void Benchmark::printResult(const std::string& suite,
+                            const std::string& name,
+                            const Params& params,
+                            int64_t iterations,
+                            double ns_per_call,
+                            double gb_per_second,
+                            const Counters& counters)
+{
+    printHeader();
+
+    const double calls_per_second = ns_per_call ? 1000000000.0 / ns_per_call : 0.0;
+
+    output_ << std::fixed << std::setprecision(3);
+
+    if (format_ == Format::CSV)
+    {
+        // The parameters and the counters are written in one column each as
+        // "key=value;key=value".
+        std::string params_string;
+
+        for (const auto& param : params)
+        {
+            if (!params_string.empty())
+                params_string += ';';
+
+            params_string += param.first + '=' + param.second;
+        }
+
+        output_ << suite << ',' << name << ',' << params_string << ',' << iterations << ','
+                << ns_per_call << ',' << calls_per_second << ',' << gb_per_second << ',';
+
+        for (size_t i = 0; i < counters.size(); ++i)
+        {
+            if (i != 0)
+                output_ << ';';
+
+            output_ << counters[i].first << '=' << counters[i].second;
+        }
+
+        output_ << std::endl;
+    }
+    else
+    {
+        output_ << "{\"suite\":" << jsonString(suite)
+                << ",\"name\":" << jsonString(name)
+                << ",\"params\":{";
+
+        for (size_t i = 0; i < params.size(); ++i)
+        {
+            if (i != 0)
+                output_ << ',';
+
+            output_ << jsonString(params[i].first) << ':' << jsonString(params[i].second);
+        }
+
+        output_ << "},\"iterations\":" << iterations
+                << ",\"ns_per_call\":" << ns_per_call
+                << ",\"calls_per_second\":" << calls_per_second
+                << ",\"gb_per_second\":" << gb_per_second;
+
+        if (!counters.empty())
+        {
+            output_ << ",\"counters\":{";
+
+            for (size_t i = 0; i < counters.size(); ++i)
+            {
+                if (i != 0)
+                    output_ << ',';
+
+                output_ << jsonString(counters[i].first) << ':' << counters[i].second;
+            }
+
+            output_ << '}';
+        }
+
+        output_ << '}' << std::endl;
+    }
+}
+
+} // namespace base
@@ -0,0 +1,109 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__BENCHMARK_H
+#define BASE__BENCHMARK_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// Runs the measured code repeatedly and prints one line per measurement in a machine-readable
+// format, so that the results can be compared between builds and releases. Each line contains
+// the time of one call, the number of calls per second (frames per second for the functions that
+// process a frame) and the throughput. A measurement can also report its own counters (for
+// example, the size of the encoded data or the image quality), which are printed with it.
+//
+// Command line options:
+//   --format=json   JSON object per line (default).
+//   --format=csv    Comma-separated values with a header line.
+//   --filter=TEXT   Run only the measurements which contain TEXT in the suite or name.
+//   --min-time=MS   Minimum time of one measurement in milliseconds (default 500).
+//
+// Usage:
+//   base::Benchmark benchmark(argc, argv);
+//
+//   benchmark.run("differ", "calcDirtyRegion", { { "pattern", "typing" } }, frame_bytes, [&]()
+//   {
+//       differ.calcDirtyRegion(prev, curr, &region);
+//   });
+class Benchmark
+{
+public:
+    using Params = std::vector<std::pair<std::string, std::string>>;
+    using Counters = std::vector<std::pair<std::string, double>>;
+    using Function = std::function<void()>;
+
+    enum class Format { JSON, CSV };
+
+    Benchmark(int argc, char* argv[]);
+    ~Benchmark() = default;
+
+    // Returns false if the command line is invalid. The usage is printed to |std::cerr|.
+    bool isValid() const { return valid_; }
+
+    // Measures |function|. |bytes| is the amount of data processed by one call and is used to
+    // calculate the throughput (0 if the throughput does not make sense).
+    void run(const std::string& suite,
+             const std::string& name,
+             const Params& params,
+             int64_t bytes,
+             const Function& function);
+
+    // Same as above, |counters| are printed together with the result of the measurement.
+    void run(const std::string& suite,
+             const std::string& name,
+             const Params& params,
+             int64_t bytes,
+             const Counters& counters,
+             const Function& function);
+
+    // Returns true if the measurement with |suite| and |name| is selected by the filter. Can be
+    // used to skip the preparation of the data for measurements that will not run.
+    bool isEnabled(const std::string& suite, const std::string& name) const;
+
+private:
+    void printHeader();
+    void printResult(const std::string& suite,
+                     const std::string& name,
+                     const Params& params,
+                     int64_t iterations,
+                     double ns_per_call,
+                     double gb_per_second,
+                     const Counters& counters);
+
+    std::ostream& output_;
+    Format format_ = Format::JSON;
+    std::string filter_;
+    int64_t min_time_ns_ = 500 * 1000 * 1000;
+    bool header_printed_ = false;
+    bool valid_ = true;
+
+    DISALLOW_COPY_AND_ASSIGN(Benchmark);
+};
+
+} // namespace base
+
+#endif // BASE__BENCHMARK_H
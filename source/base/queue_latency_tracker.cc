@@ -0,0 +1,63 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/queue_latency_tracker.h"
+
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+// Interval between writing the statistics to the log.
+constexpr std::chrono::seconds kLogInterval(60);
+
+} // namespace
+
+QueueLatencyTracker::QueueLatencyTracker(const std::string& name)
+    : name_(name),
+      last_log_time_(Clock::now())
+{
+    // Nothing
+}
+
+void QueueLatencyTracker::messageQueued()
+{
+    queued_times_.push_back(Clock::now());
+}
+
+void QueueLatencyTracker::messageProcessed()
+{
+    if (queued_times_.empty())
+        return;
+
+    const Clock::time_point now = Clock::now();
+
+    histogram_.addSample(std::chrono::duration_cast<std::chrono::microseconds>(
+        now - queued_times_.front()).count());
+    queued_times_.pop_front();
+
+    if (now - last_log_time_ < kLogInterval)
+        return;
+
+    last_log_time_ = now;
+
+    LOG(LS_INFO) << "Queue latency (us) of " << name_ << ": " << histogram_.toJson();
+}
+
+} // namespace base
@@ -0,0 +1,64 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__QUEUE_LATENCY_TRACKER_H
+#define BASE__QUEUE_LATENCY_TRACKER_H
+
+#include <chrono>
+#include <deque>
+#include <string>
+
+#include "base/rolling_histogram.h"
+
+namespace base {
+
+// Measures the time from adding a message to a FIFO queue until the message is processed (for
+// example, written to a socket) and periodically writes the statistics to the log.
+//
+// Usage:
+//   tracker.messageQueued();     // The message is added to the queue.
+//   ...
+//   tracker.messageProcessed();  // The oldest message of the queue is written.
+class QueueLatencyTracker
+{
+public:
+    explicit QueueLatencyTracker(const std::string& name);
+    ~QueueLatencyTracker() = default;
+
+    void messageQueued();
+    void messageProcessed();
+
+    // Latencies of the processed messages in microseconds.
+    const RollingHistogram& histogram() const { return histogram_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    const std::string name_;
+
+    std::deque<Clock::time_point> queued_times_;
+    RollingHistogram histogram_;
+
+    Clock::time_point last_log_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(QueueLatencyTracker);
+};
+
+} // namespace base
+
+#endif // BASE__QUEUE_LATENCY_TRACKER_H
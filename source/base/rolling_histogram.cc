@@ -0,0 +1,104 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/rolling_histogram.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace base {
+
+// static
+const size_t RollingHistogram::kDefaultCapacity;
+
+RollingHistogram::RollingHistogram(size_t capacity)
+    : capacity_(capacity)
+{
+    DCHECK_GT(capacity_, 0U);
+    samples_.reserve(capacity_);
+}
+
+void RollingHistogram::addSample(int64_t value)
+{
+    if (samples_.size() < capacity_)
+    {
+        samples_.push_back(value);
+        return;
+    }
+
+    samples_[next_] = value;
+    next_ = (next_ + 1) % capacity_;
+}
+
+void RollingHistogram::clear()
+{
+    samples_.clear();
+    next_ = 0;
+}
+
+int64_t RollingHistogram::percentile(int percent) const
+{
+    if (samples_.empty())
+        return 0;
+
+    percent = std::clamp(percent, 0, 100);
+
+    // The rank of the sample among the sorted samples, starting from 1.
+    size_t rank = (samples_.size() * percent + 99) / 100;
+    if (!rank)
+        rank = 1;
+
+    std::vector<int64_t> sorted(samples_);
+    std::nth_element(sorted.begin(), sorted.begin() + (rank - 1), sorted.end());
+
+    return sorted[rank - 1];
+}
+
+int64_t RollingHistogram::mean() const
+{
+    if (samples_.empty())
+        return 0;
+
+    int64_t sum = 0;
+
+    for (int64_t sample : samples_)
+        sum += sample;
+
+    return sum / static_cast<int64_t>(samples_.size());
+}
+
+int64_t RollingHistogram::max() const
+{
+    if (samples_.empty())
+        return 0;
+
+    return *std::max_element(samples_.begin(), samples_.end());
+}
+
+std::string RollingHistogram::toJson() const
+{
+    return "{\"count\":" + std::to_string(count()) +
+           ",\"mean\":" + std::to_string(mean()) +
+           ",\"p50\":" + std::to_string(percentile(50)) +
+           ",\"p90\":" + std::to_string(percentile(90)) +
+           ",\"p99\":" + std::to_string(percentile(99)) +
+           ",\"max\":" + std::to_string(max()) + '}';
+}
+
+} // namespace base
@@ -0,0 +1,72 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__ROLLING_HISTOGRAM_H
+#define BASE__ROLLING_HISTOGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// Keeps the last |capacity| samples and calculates the statistics for them. Used to measure the
+// latencies of the stages of the screen updates: the old samples are replaced with the new ones,
+// so the statistics show the current state of the session.
+class RollingHistogram
+{
+public:
+    static const size_t kDefaultCapacity = 512;
+
+    explicit RollingHistogram(size_t capacity = kDefaultCapacity);
+    ~RollingHistogram() = default;
+
+    void addSample(int64_t value);
+    void clear();
+
+    // Number of samples in the histogram (not more than the capacity).
+    size_t count() const { return samples_.size(); }
+    size_t capacity() const { return capacity_; }
+
+    // Returns the value below which |percent| percent of the samples are (the nearest-rank
+    // method). Returns 0 if there are no samples.
+    int64_t percentile(int percent) const;
+
+    int64_t mean() const;
+    int64_t max() const;
+
+    // Returns the statistics as a JSON object:
+    // {"count":N,"mean":N,"p50":N,"p90":N,"p99":N,"max":N}
+    std::string toJson() const;
+
+private:
+    const size_t capacity_;
+
+    std::vector<int64_t> samples_;
+
+    // Position of the oldest sample when the histogram is full.
+    size_t next_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(RollingHistogram);
+};
+
+} // namespace base
+
+#endif // BASE__ROLLING_HISTOGRAM_H
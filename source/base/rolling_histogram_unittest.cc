@@ -0,0 +1,84 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "base/rolling_histogram.h"
+
+namespace base {
+
+TEST(rolling_histogram_test, empty)
+{
+    RollingHistogram histogram(4);
+
+    EXPECT_EQ(0U, histogram.count());
+    EXPECT_EQ(0, histogram.percentile(50));
+    EXPECT_EQ(0, histogram.mean());
+    EXPECT_EQ(0, histogram.max());
+}
+
+TEST(rolling_histogram_test, percentiles)
+{
+    RollingHistogram histogram(100);
+
+    // Add the values 1..100 in reverse order.
+    for (int i = 100; i >= 1; --i)
+        histogram.addSample(i);
+
+    EXPECT_EQ(100U, histogram.count());
+    EXPECT_EQ(1, histogram.percentile(0));
+    EXPECT_EQ(50, histogram.percentile(50));
+    EXPECT_EQ(90, histogram.percentile(90));
+    EXPECT_EQ(99, histogram.percentile(99));
+    EXPECT_EQ(100, histogram.percentile(100));
+    EXPECT_EQ(50, histogram.mean());
+    EXPECT_EQ(100, histogram.max());
+}
+
+TEST(rolling_histogram_test, old_samples_replaced)
+{
+    RollingHistogram histogram(3);
+
+    histogram.addSample(1000);
+    histogram.addSample(2);
+    histogram.addSample(3);
+
+    // The oldest sample is replaced.
+    histogram.addSample(4);
+
+    EXPECT_EQ(3U, histogram.count());
+    EXPECT_EQ(4, histogram.max());
+    EXPECT_EQ(2, histogram.percentile(0));
+    EXPECT_EQ(3, histogram.mean());
+
+    histogram.clear();
+    EXPECT_EQ(0U, histogram.count());
+}
+
+TEST(rolling_histogram_test, json)
+{
+    RollingHistogram histogram(2);
+
+    histogram.addSample(10);
+    histogram.addSample(30);
+
+    EXPECT_EQ("{\"count\":2,\"mean\":20,\"p50\":10,\"p90\":30,\"p99\":30,\"max\":30}",
+              histogram.toJson());
+}
+
+} // namespace base
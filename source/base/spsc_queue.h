@@ -0,0 +1,189 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__SPSC_QUEUE_H
+#define BASE__SPSC_QUEUE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// A bounded queue for passing items from one producer thread to one consumer thread. tryPush and
+// tryPop do not take locks. push and pop wait while the queue is full or empty; the lock is used
+// only for the waiting, so a thread which does not have to wait never takes it.
+//
+// Usage:
+//   base::SpscQueue<std::unique_ptr<Item>> queue(2);
+//
+//   // Producer thread.
+//   queue.push(std::move(item));
+//
+//   // Consumer thread.
+//   std::unique_ptr<Item> item;
+//   while (queue.pop(&item))
+//       process(*item);
+template <class T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : slots_(capacity + 1)
+    {
+        // Nothing
+    }
+
+    ~SpscQueue() = default;
+
+    size_t capacity() const { return slots_.size() - 1; }
+
+    // Adds |value| to the queue. Returns false if the queue is full, |value| is not changed in
+    // this case. May be called only from the producer thread.
+    bool tryPush(T&& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next_tail = nextIndex(tail);
+
+        if (next_tail == head_.load(std::memory_order_acquire))
+            return false;
+
+        slots_[tail] = std::move(value);
+        tail_.store(next_tail, std::memory_order_seq_cst);
+
+        notify();
+        return true;
+    }
+
+    // Removes the first item of the queue to |value|. Returns false if the queue is empty. May be
+    // called only from the consumer thread.
+    bool tryPop(T* value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+
+        *value = std::move(slots_[head]);
+        head_.store(nextIndex(head), std::memory_order_seq_cst);
+
+        notify();
+        return true;
+    }
+
+    // Same as tryPush, but waits while the queue is full. Returns false if the queue is closed.
+    bool push(T&& value)
+    {
+        while (!tryPush(std::move(value)))
+        {
+            if (!waitFor([this]() { return !isFull(); }))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Same as tryPop, but waits while the queue is empty. Returns false if the queue is closed.
+    bool pop(T* value)
+    {
+        while (!tryPop(value))
+        {
+            if (!waitFor([this]() { return !isEmpty(); }))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Wakes up the waiting threads. After the call push and pop do not wait and return false if
+    // they can not be completed immediately.
+    void close()
+    {
+        std::scoped_lock lock(lock_);
+        closed_ = true;
+        condition_.notify_all();
+    }
+
+    bool isClosed() const { return closed_.load(std::memory_order_acquire); }
+
+    bool isEmpty() const
+    {
+        return head_.load(std::memory_order_seq_cst) == tail_.load(std::memory_order_seq_cst);
+    }
+
+    bool isFull() const
+    {
+        return nextIndex(tail_.load(std::memory_order_seq_cst)) ==
+            head_.load(std::memory_order_seq_cst);
+    }
+
+private:
+    size_t nextIndex(size_t index) const
+    {
+        return (index + 1 == slots_.size()) ? 0 : index + 1;
+    }
+
+    // Waits until |ready| returns true or the queue is closed. Returns false if the queue is
+    // closed.
+    template <class Predicate>
+    bool waitFor(Predicate ready)
+    {
+        std::unique_lock lock(lock_);
+
+        // The other thread checks |waiters_| after changing the indexes. Either it sees the waiter
+        // and notifies it under the lock, or the waiter sees the changed indexes.
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        condition_.wait(lock, [&]() { return closed_ || ready(); });
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+
+        return !closed_;
+    }
+
+    void notify()
+    {
+        if (waiters_.load(std::memory_order_seq_cst) == 0)
+            return;
+
+        std::scoped_lock lock(lock_);
+        condition_.notify_all();
+    }
+
+    std::vector<T> slots_;
+
+    // Index of the first item. Changed only by the consumer. The indexes are placed in different
+    // cache lines, so that the threads do not invalidate the cache line of each other.
+    alignas(64) std::atomic<size_t> head_ { 0 };
+
+    // Index of the slot after the last item. Changed only by the producer.
+    alignas(64) std::atomic<size_t> tail_ { 0 };
+
+    std::atomic_int waiters_ { 0 };
+    std::atomic_bool closed_ { false };
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+
+    DISALLOW_COPY_AND_ASSIGN(SpscQueue);
+};
+
+} // namespace base
+
+#endif // BASE__SPSC_QUEUE_H
@@ -0,0 +1,109 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "base/spsc_queue.h"
+
+#include <memory>
+#include <thread>
+
+namespace base {
+
+TEST(spsc_queue_test, try_push_pop)
+{
+    SpscQueue<int> queue(3);
+    EXPECT_EQ(3U, queue.capacity());
+    EXPECT_TRUE(queue.isEmpty());
+
+    int value = 0;
+    EXPECT_FALSE(queue.tryPop(&value));
+
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(queue.tryPush(std::move(i)));
+
+    EXPECT_TRUE(queue.isFull());
+    EXPECT_FALSE(queue.tryPush(3));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_TRUE(queue.tryPop(&value));
+        EXPECT_EQ(i, value);
+    }
+
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(spsc_queue_test, move_only_items)
+{
+    SpscQueue<std::unique_ptr<int>> queue(1);
+
+    std::unique_ptr<int> item = std::make_unique<int>(42);
+    EXPECT_TRUE(queue.tryPush(std::move(item)));
+
+    // The item is not moved if the queue is full.
+    std::unique_ptr<int> other_item = std::make_unique<int>(7);
+    EXPECT_FALSE(queue.tryPush(std::move(other_item)));
+    ASSERT_TRUE(other_item);
+
+    EXPECT_TRUE(queue.tryPop(&item));
+    ASSERT_TRUE(item);
+    EXPECT_EQ(42, *item);
+}
+
+TEST(spsc_queue_test, producer_consumer)
+{
+    const int kItemCount = 100000;
+
+    SpscQueue<int> queue(4);
+
+    std::thread producer([&]()
+    {
+        for (int i = 0; i < kItemCount; ++i)
+            EXPECT_TRUE(queue.push(std::move(i)));
+    });
+
+    for (int i = 0; i < kItemCount; ++i)
+    {
+        int value = -1;
+        ASSERT_TRUE(queue.pop(&value));
+        ASSERT_EQ(i, value);
+    }
+
+    producer.join();
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+TEST(spsc_queue_test, close_wakes_up)
+{
+    SpscQueue<int> queue(1);
+
+    std::thread consumer([&]()
+    {
+        int value;
+        EXPECT_FALSE(queue.pop(&value));
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queue.close();
+    consumer.join();
+
+    EXPECT_TRUE(queue.isClosed());
+}
+
+} // namespace base
@@ -0,0 +1,127 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/thread_pool.h"
+
+namespace base {
+
+ThreadPool::ThreadPool(int thread_count)
+{
+    if (thread_count <= 0)
+        thread_count = processorCount();
+
+    // The calling thread also executes tasks.
+    for (int i = 1; i < thread_count; ++i)
+        workers_.emplace_back(&ThreadPool::workerThread, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock(lock_);
+        terminate_ = true;
+    }
+
+    work_condition_.notify_all();
+
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void ThreadPool::parallelFor(int task_count, const Task& task)
+{
+    if (task_count <= 0)
+        return;
+
+    if (workers_.empty() || task_count == 1)
+    {
+        for (int i = 0; i < task_count; ++i)
+            task(i);
+        return;
+    }
+
+    std::unique_lock lock(lock_);
+
+    // Workers that were late for the previous job must leave it before the new job is published.
+    done_condition_.wait(lock, [this]() { return active_workers_ == 0; });
+
+    task_ = &task;
+    task_count_ = task_count;
+    next_task_ = 0;
+    ++generation_;
+
+    lock.unlock();
+    work_condition_.notify_all();
+
+    runTasks();
+
+    // Wait for the tasks that are still executed by the workers.
+    lock.lock();
+    done_condition_.wait(lock, [this]() { return active_workers_ == 0; });
+
+    task_ = nullptr;
+}
+
+// static
+int ThreadPool::processorCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    if (!count)
+        return 1;
+
+    return static_cast<int>(count);
+}
+
+void ThreadPool::workerThread()
+{
+    uint64_t generation = 0;
+
+    std::unique_lock lock(lock_);
+
+    while (true)
+    {
+        work_condition_.wait(lock, [&]() { return terminate_ || generation_ != generation; });
+
+        if (terminate_)
+            return;
+
+        generation = generation_;
+        ++active_workers_;
+
+        lock.unlock();
+        runTasks();
+        lock.lock();
+
+        if (--active_workers_ == 0)
+            done_condition_.notify_all();
+    }
+}
+
+void ThreadPool::runTasks()
+{
+    while (true)
+    {
+        int index = next_task_++;
+        if (index >= task_count_)
+            break;
+
+        (*task_)(index);
+    }
+}
+
+} // namespace base
@@ -0,0 +1,90 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef BASE__THREAD_POOL_H
+#define BASE__THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+
+// A fixed set of worker threads for splitting a CPU bound job (for example, processing of image
+// bands) into independent tasks.
+//
+// Usage:
+//   base::ThreadPool thread_pool;
+//
+//   thread_pool.parallelFor(band_count, [&](int band)
+//   {
+//       processBand(band);
+//   });
+class ThreadPool
+{
+public:
+    using Task = std::function<void(int index)>;
+
+    // Creates a pool with |thread_count| threads (including the calling thread). If
+    // |thread_count| is 0, then the number of threads is equal to the number of processors.
+    explicit ThreadPool(int thread_count = 0);
+    ~ThreadPool();
+
+    // Returns the number of threads that execute tasks (including the calling thread).
+    int threadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Calls |task| for each index in range [0, |task_count|). The calls are distributed among the
+    // pool threads and the calling thread. The method returns after all calls are completed.
+    // The method should not be called from different threads at the same time.
+    void parallelFor(int task_count, const Task& task);
+
+    // Returns the number of processors in the system.
+    static int processorCount();
+
+private:
+    void workerThread();
+    void runTasks();
+
+    std::vector<std::thread> workers_;
+
+    std::mutex lock_;
+    std::condition_variable work_condition_;
+    std::condition_variable done_condition_;
+
+    // The fields below are protected by |lock_|.
+    const Task* task_ = nullptr;
+    int task_count_ = 0;
+    uint64_t generation_ = 0;
+    int active_workers_ = 0;
+    bool terminate_ = false;
+
+    // Index of the next task to execute.
+    std::atomic_int next_task_ { 0 };
+
+    DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+} // namespace base
+
+#endif // BASE__THREAD_POOL_H
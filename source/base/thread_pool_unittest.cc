@@ -0,0 +1,58 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "base/thread_pool.h"
+
+namespace base {
+
+TEST(thread_pool_test, all_tasks_executed)
+{
+    ThreadPool thread_pool(4);
+
+    for (int task_count = 0; task_count < 64; ++task_count)
+    {
+        std::vector<std::atomic_int> calls(task_count);
+
+        thread_pool.parallelFor(task_count, [&](int index)
+        {
+            ++calls[index];
+        });
+
+        for (int i = 0; i < task_count; ++i)
+            EXPECT_EQ(1, calls[i]);
+    }
+}
+
+TEST(thread_pool_test, single_thread)
+{
+    ThreadPool thread_pool(1);
+    EXPECT_EQ(1, thread_pool.threadCount());
+
+    int sum = 0;
+
+    thread_pool.parallelFor(10, [&](int index)
+    {
+        sum += index;
+    });
+
+    EXPECT_EQ(45, sum);
+}
+
+} // namespace base
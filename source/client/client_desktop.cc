@@ -31,6 +31,14 @@
 
 namespace client {
 
+namespace {
+
+// Maximum number of video packets which the host sends without acknowledgement. Limits the
+// latency of the screen updates when the network or the client is slower than the host.
+const uint32_t kFrameWindow = 4;
+
+} // namespace
+
 ClientDesktop::ClientDesktop(const ConnectData& connect_data, Delegate* delegate, QObject* parent)
     : Client(connect_data, parent),
       delegate_(delegate)
@@ -38,10 +46,15 @@ ClientDesktop::ClientDesktop(const ConnectData& connect_data, Delegate* delegate
     // Nothing
 }
 
-ClientDesktop::~ClientDesktop() = default;
+ClientDesktop::~ClientDesktop()
+{
+    LOG(LS_INFO) << "Frame statistics (us): " << frame_statistics_.toJson();
+}
 
 void ClientDesktop::messageReceived(const QByteArray& buffer)
 {
+    received_time_ = FrameStatistics::Clock::now();
+
     incoming_message_.Clear();
 
     if (!incoming_message_.ParseFromArray(buffer.constData(), buffer.size()))
@@ -146,7 +159,13 @@ void ClientDesktop::sendConfig(const proto::desktop::Config& config)
         cursor_decoder_.reset();
 
     outgoing_message_.Clear();
-    outgoing_message_.mutable_config()->CopyFrom(config);
+
+    proto::desktop::Config* outgoing_config = outgoing_message_.mutable_config();
+    outgoing_config->CopyFrom(config);
+
+    // The client confirms each video packet, the host can use the flow control.
+    outgoing_config->set_frame_window(kFrameWindow);
+
     sendMessage(outgoing_message_);
 }
 
@@ -176,6 +195,18 @@ void ClientDesktop::sendSysInfoRequest()
     sendMessage(outgoing_message_);
 }
 
+void ClientDesktop::framePainted()
+{
+    frame_statistics_.framePainted();
+}
+
+void ClientDesktop::sendVideoAck(uint32_t frame_id)
+{
+    outgoing_message_.Clear();
+    outgoing_message_.mutable_video_ack()->set_frame_id(frame_id);
+    sendMessage(outgoing_message_);
+}
+
 void ClientDesktop::readConfigRequest(
     const proto::desktop::ConfigRequest& /* config_request */)
 {
@@ -220,6 +251,13 @@ void ClientDesktop::readVideoPacket(const proto::desktop::VideoPacket& packet)
         delegate_->resizeDesktopFrame(screen_rect);
     }
 
+    if (packet.has_source_rect())
+    {
+        QRect source_rect = codec::VideoUtil::fromVideoRect(packet.source_rect());
+        if (!source_rect.isEmpty())
+            source_rect_ = source_rect;
+    }
+
     desktop::Frame* frame = delegate_->desktopFrame();
     if (!frame)
     {
@@ -233,7 +271,16 @@ void ClientDesktop::readVideoPacket(const proto::desktop::VideoPacket& packet)
         return;
     }
 
+    if (packet.has_timings())
+    {
+        frame_statistics_.addPacket(
+            packet.timings(), received_time_, FrameStatistics::Clock::now());
+    }
+
     delegate_->drawDesktopFrame();
+
+    if (packet.frame_id())
+        sendVideoAck(packet.frame_id());
 }
 
 void ClientDesktop::readCursorShape(const proto::desktop::CursorShape& cursor_shape)
@@ -20,6 +20,7 @@
 #define CLIENT__CLIENT_DESKTOP_H
 
 #include "client/client.h"
+#include "client/frame_statistics.h"
 #include "proto/desktop_session_extensions.pb.h"
 #include "proto/system_info.pb.h"
 
@@ -65,11 +66,22 @@ public:
     void sendRemoteUpdate();
     void sendSysInfoRequest();
 
+    // Called when the desktop frame is painted. Used for the latency statistics.
+    void framePainted();
+
+    const FrameStatistics& frameStatistics() const { return frame_statistics_; }
+
+    // The position and the size of the host screen. The image may be smaller if it is scaled by
+    // the host. Empty if the host has not sent them.
+    const QRect& sourceRect() const { return source_rect_; }
+
 protected:
     // Client implementation.
     void messageReceived(const QByteArray& buffer) override;
 
 private:
+    void sendVideoAck(uint32_t frame_id);
+
     void readConfigRequest(const proto::desktop::ConfigRequest& config_request);
     void readVideoPacket(const proto::desktop::VideoPacket& packet);
     void readCursorShape(const proto::desktop::CursorShape& cursor_shape);
@@ -85,6 +97,11 @@ private:
     std::unique_ptr<codec::VideoDecoder> video_decoder_;
     std::unique_ptr<codec::CursorDecoder> cursor_decoder_;
 
+    QRect source_rect_;
+
+    FrameStatistics frame_statistics_;
+    FrameStatistics::Clock::time_point received_time_;
+
     DISALLOW_COPY_AND_ASSIGN(ClientDesktop);
 };
 
@@ -37,6 +37,14 @@ const int kDefCompressRatio = 8;
 const int kMinCompressRatio = 1;
 const int kMaxCompressRatio = 22;
 
+const int kDefTileCacheSize = 1024;
+const int kMinTileCacheSize = 16;
+const int kMaxTileCacheSize = 4096;
+
+const int kDefTopOffDelay = 1000;
+const int kMinTopOffDelay = 250;
+const int kMaxTopOffDelay = 10000;
+
 } // namespace
 
 // static
@@ -62,13 +70,16 @@ void ConfigFactory::setDefaultDesktopManageConfig(proto::desktop::Config* config
 
     static const uint32_t kDefaultFlags =
         proto::desktop::ENABLE_CLIPBOARD | proto::desktop::ENABLE_CURSOR_SHAPE |
-        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER;
+        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER |
+        proto::desktop::ENABLE_INTER_FRAME_COMPRESSION;
 
     config->set_flags(kDefaultFlags);
     config->set_video_encoding(proto::desktop::VideoEncoding::VIDEO_ENCODING_ZSTD);
     config->set_compress_ratio(kDefCompressRatio);
     config->set_scale_factor(kDefScaleFactor);
     config->set_update_interval(kDefUpdateInterval);
+    config->set_tile_cache_size(kDefTileCacheSize);
+    config->set_top_off_delay(kDefTopOffDelay);
 
     codec::VideoUtil::toVideoPixelFormat(
         desktop::PixelFormat::RGB565(), config->mutable_pixel_format());
@@ -80,13 +91,16 @@ void ConfigFactory::setDefaultDesktopViewConfig(proto::desktop::Config* config)
     DCHECK(config);
 
     static const uint32_t kDefaultFlags =
-        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER;
+        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER |
+        proto::desktop::ENABLE_INTER_FRAME_COMPRESSION;
 
     config->set_flags(kDefaultFlags);
     config->set_video_encoding(proto::desktop::VideoEncoding::VIDEO_ENCODING_ZSTD);
     config->set_compress_ratio(kDefCompressRatio);
     config->set_scale_factor(kDefScaleFactor);
     config->set_update_interval(kDefUpdateInterval);
+    config->set_tile_cache_size(kDefTileCacheSize);
+    config->set_top_off_delay(kDefTopOffDelay);
 
     codec::VideoUtil::toVideoPixelFormat(
         desktop::PixelFormat::RGB565(), config->mutable_pixel_format());
@@ -103,6 +117,12 @@ void ConfigFactory::fixupDesktopConfig(proto::desktop::Config* config)
 
     if (config->compress_ratio() < kMinCompressRatio || config->compress_ratio() > kMaxCompressRatio)
         config->set_compress_ratio(kDefCompressRatio);
+
+    if (config->tile_cache_size() < kMinTileCacheSize || config->tile_cache_size() > kMaxTileCacheSize)
+        config->set_tile_cache_size(kDefTileCacheSize);
+
+    if (config->top_off_delay() < kMinTopOffDelay || config->top_off_delay() > kMaxTopOffDelay)
+        config->set_top_off_delay(kDefTopOffDelay);
 }
 
 } // namespace client
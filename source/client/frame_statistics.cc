@@ -0,0 +1,135 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "client/frame_statistics.h"
+
+namespace client {
+
+namespace {
+
+int64_t toMicroseconds(FrameStatistics::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+} // namespace
+
+void FrameStatistics::addPacket(const proto::desktop::FrameTimings& timings,
+                                Clock::time_point received_time,
+                                Clock::time_point decoded_time)
+{
+    histograms_[STAGE_CAPTURE].addSample(timings.capture_time());
+    histograms_[STAGE_DIFF].addSample(timings.diff_time());
+    histograms_[STAGE_ENCODE_WAIT].addSample(timings.encode_wait_time());
+    histograms_[STAGE_ENCODE].addSample(timings.encode_time());
+    histograms_[STAGE_HOST].addSample(timings.host_time());
+
+    if (timings.send_timestamp())
+    {
+        const int64_t one_way_delay = toMicroseconds(received_time.time_since_epoch()) -
+            static_cast<int64_t>(timings.send_timestamp());
+
+        if (!has_min_one_way_delay_ || one_way_delay < min_one_way_delay_)
+        {
+            min_one_way_delay_ = one_way_delay;
+            has_min_one_way_delay_ = true;
+        }
+
+        histograms_[STAGE_TRANSFER].addSample(one_way_delay - min_one_way_delay_);
+    }
+
+    histograms_[STAGE_DECODE].addSample(toMicroseconds(decoded_time - received_time));
+
+    if (timings.compress_ratio())
+        compress_ratio_.addSample(timings.compress_ratio());
+
+    if (!paint_pending_)
+    {
+        paint_pending_time_ = decoded_time;
+        paint_pending_ = true;
+    }
+}
+
+void FrameStatistics::framePainted()
+{
+    if (!paint_pending_)
+        return;
+
+    histograms_[STAGE_PAINT].addSample(toMicroseconds(Clock::now() - paint_pending_time_));
+    paint_pending_ = false;
+}
+
+// static
+const char* FrameStatistics::stageName(Stage stage)
+{
+    switch (stage)
+    {
+        case STAGE_CAPTURE:
+            return "capture";
+
+        case STAGE_DIFF:
+            return "diff";
+
+        case STAGE_ENCODE_WAIT:
+            return "encode_wait";
+
+        case STAGE_ENCODE:
+            return "encode";
+
+        case STAGE_HOST:
+            return "host";
+
+        case STAGE_TRANSFER:
+            return "transfer";
+
+        case STAGE_DECODE:
+            return "decode";
+
+        case STAGE_PAINT:
+            return "paint";
+
+        default:
+            return "unknown";
+    }
+}
+
+std::string FrameStatistics::toJson() const
+{
+    std::string json = "{";
+
+    for (int i = 0; i < STAGE_COUNT; ++i)
+    {
+        const Stage stage = static_cast<Stage>(i);
+
+        if (i != 0)
+            json += ',';
+
+        json += '"';
+        json += stageName(stage);
+        json += "\":";
+        json += histogram(stage).toJson();
+    }
+
+    json += ",\"compress_ratio\":";
+    json += compress_ratio_.toJson();
+
+    json += '}';
+    return json;
+}
+
+} // namespace client
@@ -0,0 +1,93 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CLIENT__FRAME_STATISTICS_H
+#define CLIENT__FRAME_STATISTICS_H
+
+#include <chrono>
+#include <string>
+
+#include "base/rolling_histogram.h"
+#include "proto/desktop_session.pb.h"
+
+namespace client {
+
+// Collects the latencies of the stages of the screen updates in microseconds. The times of the
+// host stages are received in the video packets, the times of the client stages are measured
+// when the packet is received, decoded and painted.
+class FrameStatistics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Stage
+    {
+        STAGE_CAPTURE,     // Screen capture on the host (including the diff).
+        STAGE_DIFF,        // Search of the changed areas on the host.
+        STAGE_ENCODE_WAIT, // Waiting for the encoder on the host.
+        STAGE_ENCODE,      // Scaling and encoding on the host.
+        STAGE_HOST,        // From the start of the capture until the serialization on the host.
+        STAGE_TRANSFER,    // IPC, encryption, network and receiving above the minimum.
+        STAGE_DECODE,      // Parsing and decoding of the packet on the client.
+        STAGE_PAINT,       // From the end of the decoding until the frame is painted.
+        STAGE_COUNT
+    };
+
+    FrameStatistics() = default;
+    ~FrameStatistics() = default;
+
+    // Adds the times of the video packet. |received_time| is the time when the message with the
+    // packet is received, |decoded_time| is the time when the packet is decoded.
+    void addPacket(const proto::desktop::FrameTimings& timings,
+                   Clock::time_point received_time,
+                   Clock::time_point decoded_time);
+
+    // Called when the desktop frame is painted on the screen.
+    void framePainted();
+
+    const base::RollingHistogram& histogram(Stage stage) const { return histograms_[stage]; }
+
+    // Compression levels of the Zstd packets.
+    const base::RollingHistogram& compressRatio() const { return compress_ratio_; }
+
+    static const char* stageName(Stage stage);
+
+    // Returns the statistics of all stages as a JSON object with the stage names as keys and the
+    // statistics of the compression levels with the key "compress_ratio".
+    std::string toJson() const;
+
+private:
+    base::RollingHistogram histograms_[STAGE_COUNT];
+    base::RollingHistogram compress_ratio_;
+
+    // The clocks of the host and the client are not synchronized. The transfer time is the
+    // difference between the one-way delay of the packet and the minimum one-way delay of the
+    // session: it shows the queues in the channels and in the network.
+    int64_t min_one_way_delay_ = 0;
+    bool has_min_one_way_delay_ = false;
+
+    // The oldest decoded frame which has not been painted yet.
+    Clock::time_point paint_pending_time_;
+    bool paint_pending_ = false;
+
+    DISALLOW_COPY_AND_ASSIGN(FrameStatistics);
+};
+
+} // namespace client
+
+#endif // CLIENT__FRAME_STATISTICS_H
@@ -53,6 +53,10 @@ DesktopConfigDialog::DesktopConfigDialog(proto::SessionType session_type,
     combo_codec->addItem(QStringLiteral("VP9"), QVariant(proto::desktop::VIDEO_ENCODING_VP9));
     combo_codec->addItem(QStringLiteral("VP8"), QVariant(proto::desktop::VIDEO_ENCODING_VP8));
     combo_codec->addItem(QStringLiteral("ZSTD"), QVariant(proto::desktop::VIDEO_ENCODING_ZSTD));
+    combo_codec->addItem(QStringLiteral("ZSTD + VP9"),
+                         QVariant(proto::desktop::VIDEO_ENCODING_HYBRID));
+    combo_codec->addItem(QStringLiteral("PALETTE + ZSTD"),
+                         QVariant(proto::desktop::VIDEO_ENCODING_PALETTE));
 
     int current_codec = combo_codec->findData(QVariant(config_.video_encoding()));
     if (current_codec == -1)
@@ -90,6 +94,12 @@ DesktopConfigDialog::DesktopConfigDialog(proto::SessionType session_type,
     ui->slider_compression_ratio->setValue(config_.compress_ratio());
     onCompressionRatioChanged(config_.compress_ratio());
 
+    if (config_.flags() & proto::desktop::ENABLE_INTER_FRAME_COMPRESSION)
+        ui->checkbox_inter_frame->setChecked(true);
+
+    if (config_.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO)
+        ui->checkbox_auto_compress_ratio->setChecked(true);
+
     ui->spin_scale_factor->setValue(config_.scale_factor());
     ui->spin_update_interval->setValue(config_.update_interval());
 
@@ -139,8 +149,11 @@ DesktopConfigDialog::~DesktopConfigDialog() = default;
 
 void DesktopConfigDialog::onCodecChanged(int item_index)
 {
-    bool has_pixel_format =
-        (ui->combo_codec->itemData(item_index).toInt() == proto::desktop::VIDEO_ENCODING_ZSTD);
+    const int video_encoding = ui->combo_codec->itemData(item_index).toInt();
+
+    bool has_pixel_format = (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID ||
+                             video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE);
 
     ui->label_color_depth->setEnabled(has_pixel_format);
     ui->combo_color_depth->setEnabled(has_pixel_format);
@@ -148,6 +161,12 @@ void DesktopConfigDialog::onCodecChanged(int item_index)
     ui->slider_compression_ratio->setEnabled(has_pixel_format);
     ui->label_fast->setEnabled(has_pixel_format);
     ui->label_best->setEnabled(has_pixel_format);
+
+    // The inter-frame mode is not used with the other encoders on top of Zstd.
+    ui->checkbox_inter_frame->setEnabled(
+        video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD);
+
+    ui->checkbox_auto_compress_ratio->setEnabled(has_pixel_format);
 }
 
 void DesktopConfigDialog::onCompressionRatioChanged(int value)
@@ -164,7 +183,9 @@ void DesktopConfigDialog::onButtonBoxClicked(QAbstractButton* button)
 
         config_.set_video_encoding(video_encoding);
 
-        if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD)
+        if (video_encoding == proto::desktop::VIDEO_ENCODING_ZSTD ||
+            video_encoding == proto::desktop::VIDEO_ENCODING_HYBRID ||
+            video_encoding == proto::desktop::VIDEO_ENCODING_PALETTE)
         {
             desktop::PixelFormat pixel_format;
 
@@ -220,6 +241,15 @@ void DesktopConfigDialog::onButtonBoxClicked(QAbstractButton* button)
         if (ui->checkbox_block_remote_input->isChecked())
             flags |= proto::desktop::BLOCK_REMOTE_INPUT;
 
+        if (ui->checkbox_inter_frame->isChecked() && ui->checkbox_inter_frame->isEnabled())
+            flags |= proto::desktop::ENABLE_INTER_FRAME_COMPRESSION;
+
+        if (ui->checkbox_auto_compress_ratio->isChecked() &&
+            ui->checkbox_auto_compress_ratio->isEnabled())
+        {
+            flags |= proto::desktop::ENABLE_AUTO_COMPRESS_RATIO;
+        }
+
         config_.set_flags(flags);
 
         emit configChanged(config_);
@@ -276,6 +276,7 @@ void DesktopPanel::createAdditionalMenu(proto::SessionType session_type)
 
     additional_menu_->addSeparator();
     additional_menu_->addAction(ui.action_screenshot);
+    additional_menu_->addAction(ui.action_statistics);
 
     // Set the menu for the button on the toolbar.
     ui.action_menu->setMenu(additional_menu_);
@@ -297,6 +298,7 @@ void DesktopPanel::createAdditionalMenu(proto::SessionType session_type)
     });
 
     connect(ui.action_screenshot, &QAction::triggered, this, &DesktopPanel::takeScreenshot);
+    connect(ui.action_statistics, &QAction::triggered, this, &DesktopPanel::showStatistics);
     connect(additional_menu_, &QMenu::aboutToShow, [this]() { allow_hide_ = false; });
     connect(additional_menu_, &QMenu::aboutToHide, [this]()
     {
@@ -52,6 +52,7 @@ signals:
     void autoScrollChanged(bool enabled);
     void keyCombinationsChanged(bool enabled);
     void takeScreenshot();
+    void showStatistics();
     void startSession(proto::SessionType session_type);
     void powerControl(proto::desktop::PowerControl::Action action);
     void startRemoteUpdate();
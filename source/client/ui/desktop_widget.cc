@@ -230,6 +230,8 @@ void DesktopWidget::paintEvent(QPaintEvent* /* event */)
         QPainter painter(this);
         painter.setRenderHint(QPainter::SmoothPixmapTransform);
         painter.drawImage(rect(), frame_->constImage());
+
+        delegate_->framePainted();
     }
 }
 
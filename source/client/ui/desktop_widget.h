@@ -51,6 +51,7 @@ public:
 
         virtual void sendPointerEvent(const QPoint& pos, uint32_t mask) = 0;
         virtual void sendKeyEvent(uint32_t usb_keycode, uint32_t flags) = 0;
+        virtual void framePainted() = 0;
     };
 
     DesktopWidget(Delegate* delegate, QWidget* parent);
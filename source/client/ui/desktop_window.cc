@@ -31,12 +31,20 @@
 #include "build/version.h"
 #include "client/ui/desktop_config_dialog.h"
 #include "client/ui/desktop_panel.h"
+#include "client/ui/statistics_dialog.h"
 #include "client/ui/system_info_window.h"
 #include "common/clipboard.h"
 #include "desktop/desktop_frame_qimage.h"
 
 namespace client {
 
+namespace {
+
+// Delay in milliseconds between the last resizing of the window and sending its size to the host.
+const int kResizeDelay = 500;
+
+} // namespace
+
 DesktopWindow::DesktopWindow(const ConnectData& connect_data, QWidget* parent)
     : ClientWindow(parent)
 {
@@ -69,6 +77,7 @@ DesktopWindow::DesktopWindow(const ConnectData& connect_data, QWidget* parent)
     connect(panel_, &DesktopPanel::settingsButton, this, &DesktopWindow::changeSettings);
     connect(panel_, &DesktopPanel::switchToAutosize, this, &DesktopWindow::autosizeWindow);
     connect(panel_, &DesktopPanel::takeScreenshot, this, &DesktopWindow::takeScreenshot);
+    connect(panel_, &DesktopPanel::showStatistics, this, &DesktopWindow::showStatistics);
     connect(panel_, &DesktopPanel::scalingChanged, this, &DesktopWindow::onScalingChanged);
     connect(panel_, &DesktopPanel::screenSelected, desktopClient(), &ClientDesktop::sendScreen);
     connect(panel_, &DesktopPanel::powerControl, desktopClient(), &ClientDesktop::sendPowerControl);
@@ -224,6 +233,21 @@ void DesktopWindow::sendPointerEvent(const QPoint& pos, uint32_t mask)
 
     ClientDesktop* client = desktopClient();
 
+    // The position on the widget is mapped to the host screen. The widget has the image scaled by
+    // the host and by the client.
+    const QRect& source_rect = client->sourceRect();
+    if (source_rect.isValid() && !desktop_->size().isEmpty())
+    {
+        const QSize scaled_size = desktop_->size();
+
+        int x = static_cast<int>(int64_t(pos.x()) * source_rect.width() / scaled_size.width());
+        int y = static_cast<int>(int64_t(pos.y()) * source_rect.height() / scaled_size.height());
+
+        client->sendPointerEvent(QPoint(x, y) + source_rect.topLeft(), mask);
+        return;
+    }
+
+    // The hosts without |source_rect| scale the image only by |scale_factor|.
     int remote_scale_factor = client->connectData().desktop_config.scale_factor();
     if (remote_scale_factor)
     {
@@ -248,6 +272,11 @@ void DesktopWindow::sendKeyEvent(uint32_t usb_keycode, uint32_t flags)
     desktopClient()->sendKeyEvent(usb_keycode, flags);
 }
 
+void DesktopWindow::framePainted()
+{
+    desktopClient()->framePainted();
+}
+
 void DesktopWindow::changeSettings()
 {
     const ConnectData& connect_data = currentClient()->connectData();
@@ -320,6 +349,15 @@ void DesktopWindow::takeScreenshot()
         QMessageBox::warning(this, tr("Warning"), tr("Could not save image"), QMessageBox::Ok);
 }
 
+void DesktopWindow::showStatistics()
+{
+    StatisticsDialog* dialog = new StatisticsDialog(desktopClient(), this);
+
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+    dialog->activateWindow();
+}
+
 void DesktopWindow::onScalingChanged(bool enabled)
 {
     desktop::Frame* frame = desktopFrame();
@@ -332,6 +370,35 @@ void DesktopWindow::onScalingChanged(bool enabled)
         scaled_size.scale(size(), Qt::KeepAspectRatio);
 
     desktop_->resize(scaled_size);
+
+    // The host reduces the image to the window size, so it does not encode and send the pixels
+    // which the client can not show.
+    if (resize_timer_id_)
+        killTimer(resize_timer_id_);
+
+    resize_timer_id_ = startTimer(kResizeDelay);
+}
+
+void DesktopWindow::requestScreenSize()
+{
+    proto::desktop::Config config = currentClient()->connectData().desktop_config;
+
+    uint32_t max_width = 0;
+    uint32_t max_height = 0;
+
+    if (panel_->scaling())
+    {
+        max_width = static_cast<uint32_t>(width());
+        max_height = static_cast<uint32_t>(height());
+    }
+
+    if (config.max_width() == max_width && config.max_height() == max_height)
+        return;
+
+    config.set_max_width(max_width);
+    config.set_max_height(max_height);
+
+    onConfigChanged(config);
 }
 
 void DesktopWindow::timerEvent(QTimerEvent* event)
@@ -362,6 +429,13 @@ void DesktopWindow::timerEvent(QTimerEvent* event)
             scrollbar->setSliderPosition(pos);
         }
     }
+    else if (event->timerId() == resize_timer_id_)
+    {
+        killTimer(resize_timer_id_);
+        resize_timer_id_ = 0;
+
+        requestScreenSize();
+    }
 
     QWidget::timerEvent(event);
 }
@@ -63,6 +63,7 @@ public:
     // DesktopWidget::Delegate implementation.
     void sendPointerEvent(const QPoint& pos, uint32_t mask) override;
     void sendKeyEvent(uint32_t usb_keycode, uint32_t flags) override;
+    void framePainted() override;
 
 protected:
     // QWidget implementation.
@@ -80,10 +81,12 @@ private slots:
     void onConfigChanged(const proto::desktop::Config& config);
     void autosizeWindow();
     void takeScreenshot();
+    void showStatistics();
     void onScalingChanged(bool enabled = true);
 
 private:
     ClientDesktop* desktopClient();
+    void requestScreenSize();
 
     static QString createWindowTitle(const ConnectData& connect_data);
 
@@ -96,6 +99,9 @@ private:
     int scroll_timer_id_ = 0;
     QPoint scroll_delta_;
 
+    // The window size is sent to the host after the resizing is finished.
+    int resize_timer_id_ = 0;
+
     bool is_maximized_ = false;
 
     QPoint screen_top_left_;
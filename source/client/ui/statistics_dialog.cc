@@ -0,0 +1,140 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "client/ui/statistics_dialog.h"
+
+#include <QFile>
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QMessageBox>
+#include <QTimerEvent>
+
+#include "client/client_desktop.h"
+
+namespace client {
+
+namespace {
+
+const int kUpdateInterval = 1000; // 1 second.
+
+QString formatMilliseconds(int64_t microseconds)
+{
+    return QString::number(static_cast<double>(microseconds) / 1000.0, 'f', 2);
+}
+
+} // namespace
+
+StatisticsDialog::StatisticsDialog(ClientDesktop* client, QWidget* parent)
+    : QDialog(parent),
+      client_(client)
+{
+    ui.setupUi(this);
+
+    ui.edit_statistics->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    connect(ui.button_save, &QPushButton::released, this, &StatisticsDialog::onSave);
+    connect(ui.button_close, &QPushButton::released, this, &StatisticsDialog::close);
+
+    updateStatistics();
+    update_timer_id_ = startTimer(kUpdateInterval);
+}
+
+void StatisticsDialog::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == update_timer_id_)
+    {
+        updateStatistics();
+        return;
+    }
+
+    QDialog::timerEvent(event);
+}
+
+void StatisticsDialog::onSave()
+{
+    if (!client_)
+        return;
+
+    // The statistics are saved at the moment of pressing the button.
+    const std::string json = client_->frameStatistics().toJson();
+
+    QString file_path = QFileDialog::getSaveFileName(this,
+                                                     tr("Save File"),
+                                                     QString(),
+                                                     tr("JSON File (*.json)"));
+    if (file_path.isEmpty())
+        return;
+
+    QFile file(file_path);
+
+    if (!file.open(QFile::WriteOnly | QFile::Truncate) ||
+        file.write(json.c_str(), json.size()) != static_cast<int64_t>(json.size()))
+    {
+        QMessageBox::warning(this, tr("Warning"), tr("Could not save file"), QMessageBox::Ok);
+    }
+}
+
+void StatisticsDialog::updateStatistics()
+{
+    if (!client_)
+    {
+        ui.edit_statistics->clear();
+        return;
+    }
+
+    const FrameStatistics& statistics = client_->frameStatistics();
+
+    QString text = QString("%1 %2 %3 %4 %5 %6\n")
+        .arg(tr("Stage (ms)"), -12)
+        .arg(tr("Mean"), 9)
+        .arg(tr("P50"), 9)
+        .arg(tr("P90"), 9)
+        .arg(tr("P99"), 9)
+        .arg(tr("Max"), 9);
+
+    for (int i = 0; i < FrameStatistics::STAGE_COUNT; ++i)
+    {
+        const FrameStatistics::Stage stage = static_cast<FrameStatistics::Stage>(i);
+        const base::RollingHistogram& histogram = statistics.histogram(stage);
+
+        text += QString("%1 %2 %3 %4 %5 %6\n")
+            .arg(QString::fromLatin1(FrameStatistics::stageName(stage)), -12)
+            .arg(formatMilliseconds(histogram.mean()), 9)
+            .arg(formatMilliseconds(histogram.percentile(50)), 9)
+            .arg(formatMilliseconds(histogram.percentile(90)), 9)
+            .arg(formatMilliseconds(histogram.percentile(99)), 9)
+            .arg(formatMilliseconds(histogram.max()), 9);
+    }
+
+    text += tr("Frames: %1").arg(
+        statistics.histogram(FrameStatistics::STAGE_DECODE).count());
+
+    const base::RollingHistogram& compress_ratio = statistics.compressRatio();
+    if (compress_ratio.count())
+    {
+        text += '\n';
+        text += tr("Compression ratio: %1 (min %2, max %3)")
+            .arg(compress_ratio.mean())
+            .arg(compress_ratio.percentile(0))
+            .arg(compress_ratio.max());
+    }
+
+    ui.edit_statistics->setPlainText(text);
+}
+
+} // namespace client
@@ -0,0 +1,61 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CLIENT__UI__STATISTICS_DIALOG_H
+#define CLIENT__UI__STATISTICS_DIALOG_H
+
+#include <QPointer>
+
+#include "base/macros_magic.h"
+#include "ui_statistics_dialog.h"
+
+namespace client {
+
+class ClientDesktop;
+
+// Shows the latencies of the stages of the screen updates and saves them to a JSON file. The
+// statistics are updated every second while the dialog is open.
+class StatisticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    StatisticsDialog(ClientDesktop* client, QWidget* parent = nullptr);
+    ~StatisticsDialog() = default;
+
+protected:
+    // QDialog implementation.
+    void timerEvent(QTimerEvent* event) override;
+
+private slots:
+    void onSave();
+
+private:
+    void updateStatistics();
+
+    Ui::StatisticsDialog ui;
+
+    QPointer<ClientDesktop> client_;
+    int update_timer_id_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(StatisticsDialog);
+};
+
+} // namespace client
+
+#endif // CLIENT__UI__STATISTICS_DIALOG_H
@@ -0,0 +1,517 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+// Measures the video and cursor codecs outside a session. Each encoder/decoder pair runs over
+// the same frame sequences, so the results can be compared between the codecs and the builds.
+// Besides the options of base::Benchmark, the command line accepts:
+//   --recording=PATH   Also runs the codecs over the frames of a recording made with
+//                      desktop::FrameRecorder. Can be given several times.
+
+#include "base/benchmark.h"
+#include "base/logging.h"
+#include "codec/cursor_decoder.h"
+#include "codec/cursor_encoder.h"
+#include "codec/video_decoder.h"
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
+#include "codec/video_encoder_vpx.h"
+#include "codec/video_encoder_zstd.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/differ.h"
+#include "desktop/frame_pattern.h"
+#include "desktop/mouse_cursor.h"
+#include "desktop/screen_capturer_replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace codec {
+
+namespace {
+
+const int kAlignment = 32;
+
+// The number of frames of a synthetic sequence.
+const int kFrameCount = 30;
+
+// The frames of a recording are loaded into memory up to this size.
+const int64_t kMaxRecordingBytes = 512LL * 1024 * 1024;
+
+const int kCompressRatio = 8;
+const size_t kTileCacheSize = 1024;
+
+// The PSNR of identical images is infinite. This value is reported instead.
+const double kMaxPsnr = 100.0;
+
+const QSize kResolutions[] = { QSize(1920, 1080), QSize(2560, 1440) };
+
+const desktop::FramePattern kPatterns[] =
+{
+    desktop::FramePattern::IDLE,
+    desktop::FramePattern::CARET,
+    desktop::FramePattern::TYPING,
+    desktop::FramePattern::SCROLLING,
+    desktop::FramePattern::VIDEO
+};
+
+struct VideoCodec
+{
+    const char* name;
+    proto::desktop::VideoEncoding encoding;
+    bool lossy;
+    VideoEncoder* (*create)();
+};
+
+// The encoders are created with the default settings of the client.
+const VideoCodec kVideoCodecs[] =
+{
+    { "zstd", proto::desktop::VIDEO_ENCODING_ZSTD, false, []() -> VideoEncoder*
+        {
+            return VideoEncoderZstd::create(
+                desktop::PixelFormat::ARGB(), kCompressRatio, kTileCacheSize);
+        }
+    },
+    { "zstd_inter", proto::desktop::VIDEO_ENCODING_ZSTD, false, []() -> VideoEncoder*
+        {
+            return VideoEncoderZstd::create(
+                desktop::PixelFormat::ARGB(), kCompressRatio, kTileCacheSize, true);
+        }
+    },
+    { "zstd_rgb565", proto::desktop::VIDEO_ENCODING_ZSTD, true, []() -> VideoEncoder*
+        {
+            return VideoEncoderZstd::create(
+                desktop::PixelFormat::RGB565(), kCompressRatio, kTileCacheSize);
+        }
+    },
+    { "palette", proto::desktop::VIDEO_ENCODING_PALETTE, false, []() -> VideoEncoder*
+        {
+            return VideoEncoderPalette::create(
+                desktop::PixelFormat::ARGB(), kCompressRatio, kTileCacheSize);
+        }
+    },
+    { "hybrid", proto::desktop::VIDEO_ENCODING_HYBRID, true, []() -> VideoEncoder*
+        {
+            return VideoEncoderHybrid::create(
+                desktop::PixelFormat::ARGB(), kCompressRatio, kTileCacheSize);
+        }
+    },
+    { "vp8", proto::desktop::VIDEO_ENCODING_VP8, true, []() -> VideoEncoder*
+        {
+            return VideoEncoderVPX::createVP8();
+        }
+    },
+    { "vp9", proto::desktop::VIDEO_ENCODING_VP9, true, []() -> VideoEncoder*
+        {
+            return VideoEncoderVPX::createVP9();
+        }
+    }
+};
+
+// Screen updates as they come from the capturer. The first frame contains the whole screen, so
+// the sequence can be encoded and decoded in a loop.
+struct FrameSequence
+{
+    std::string scenario;
+    QSize size;
+    std::vector<std::unique_ptr<desktop::Frame>> frames;
+
+    int64_t frameBytes() const
+    {
+        return static_cast<int64_t>(size.width()) * size.height() * sizeof(uint32_t);
+    }
+};
+
+std::string sizeString(const QSize& size)
+{
+    return std::to_string(size.width()) + "x" + std::to_string(size.height());
+}
+
+std::unique_ptr<desktop::Frame> createFrame(const QSize& size)
+{
+    return desktop::FrameAligned::create(size, desktop::PixelFormat::ARGB(), kAlignment);
+}
+
+FrameSequence createSyntheticSequence(const QSize& size, desktop::FramePattern pattern)
+{
+    FrameSequence sequence;
+    sequence.scenario = desktop::framePatternName(pattern);
+    sequence.size = size;
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size);
+    desktop::drawDesktop(frame.get(), 1);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+    sequence.frames.push_back(std::move(frame));
+
+    desktop::Differ differ(size, 1);
+
+    for (int i = 1; i < kFrameCount; ++i)
+    {
+        const desktop::Frame* previous = sequence.frames.back().get();
+
+        frame = createFrame(size);
+        desktop::applyFramePattern(pattern, previous, frame.get(), i);
+        differ.calcDirtyRegion(previous->frameData(), frame->frameData(), frame->updatedRegion());
+
+        sequence.frames.push_back(std::move(frame));
+    }
+
+    return sequence;
+}
+
+// Loads the frames of the recording until the screen size changes or the memory limit is
+// reached.
+FrameSequence loadRecording(const std::string& file_path)
+{
+    FrameSequence sequence;
+
+    const size_t name_pos = file_path.find_last_of("/\\");
+    sequence.scenario = (name_pos == std::string::npos) ?
+        file_path : file_path.substr(name_pos + 1);
+
+    using Replay = desktop::ScreenCapturerReplay;
+
+    std::unique_ptr<Replay> capturer =
+        Replay::open(QString::fromStdString(file_path), Replay::Mode::AS_FAST_AS_POSSIBLE);
+    if (!capturer)
+    {
+        LOG(LS_WARNING) << "Unable to open the recording: " << file_path;
+        return sequence;
+    }
+
+    int64_t total_bytes = 0;
+
+    while (const desktop::Frame* captured_frame = capturer->captureFrame())
+    {
+        if (sequence.frames.empty())
+            sequence.size = captured_frame->size();
+        else if (captured_frame->size() != sequence.size)
+            break;
+
+        total_bytes += sequence.frameBytes();
+        if (total_bytes > kMaxRecordingBytes)
+        {
+            LOG(LS_WARNING) << "Only " << sequence.frames.size() << " of "
+                            << capturer->frameCount() << " frames are loaded";
+            break;
+        }
+
+        std::unique_ptr<desktop::Frame> frame = createFrame(sequence.size);
+        const QRect frame_rect(QPoint(), sequence.size);
+
+        frame->copyPixelsFrom(*captured_frame, desktop::DirtyRegion(frame_rect));
+
+        if (sequence.frames.empty())
+        {
+            frame->updatedRegion()->add(frame_rect);
+        }
+        else
+        {
+            *frame->updatedRegion() = captured_frame->constUpdatedRegion();
+            *frame->copyRects() = captured_frame->constCopyRects();
+        }
+
+        sequence.frames.push_back(std::move(frame));
+    }
+
+    return sequence;
+}
+
+// Returns the sum of the squared differences of the color channels of the frames.
+double squaredError(const desktop::Frame& source, const desktop::Frame& decoded)
+{
+    double error = 0.0;
+
+    for (int y = 0; y < source.size().height(); ++y)
+    {
+        const uint8_t* source_row = source.frameDataAtPos(0, y);
+        const uint8_t* decoded_row = decoded.frameDataAtPos(0, y);
+
+        int64_t row_error = 0;
+
+        for (int x = 0; x < source.size().width() * 4; x += 4)
+        {
+            // The alpha channel is not displayed.
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                const int diff = source_row[x + channel] - decoded_row[x + channel];
+                row_error += diff * diff;
+            }
+        }
+
+        error += static_cast<double>(row_error);
+    }
+
+    return error;
+}
+
+void benchmarkVideoCodec(base::Benchmark* benchmark,
+                         const VideoCodec& codec,
+                         const FrameSequence& sequence)
+{
+    const bool encode_enabled = benchmark->isEnabled(codec.name, "encode");
+    const bool decode_enabled = benchmark->isEnabled(codec.name, "decode");
+
+    if (!encode_enabled && !decode_enabled)
+        return;
+
+    std::unique_ptr<VideoEncoder> encoder(codec.create());
+    std::unique_ptr<VideoDecoder> decoder = VideoDecoder::create(codec.encoding);
+    if (!encoder || !decoder)
+    {
+        LOG(LS_WARNING) << "Unable to create the codec " << codec.name;
+        return;
+    }
+
+    std::unique_ptr<desktop::Frame> decoded_frame = createFrame(sequence.size);
+
+    // The sequence is encoded and decoded once to get the packets for the decoder and the size
+    // and the quality of the encoded frames.
+    std::vector<proto::desktop::VideoPacket> packets(sequence.frames.size());
+    int64_t total_bytes = 0;
+    double squared_error = 0.0;
+
+    for (size_t i = 0; i < sequence.frames.size(); ++i)
+    {
+        encoder->encode(sequence.frames[i].get(), &packets[i]);
+        total_bytes += packets[i].ByteSizeLong();
+
+        if (!decoder->decode(packets[i], decoded_frame.get()))
+        {
+            LOG(LS_WARNING) << "Unable to decode the packet of " << codec.name;
+            return;
+        }
+
+        if (codec.lossy)
+            squared_error += squaredError(*sequence.frames[i], *decoded_frame);
+    }
+
+    const base::Benchmark::Params params =
+    {
+        { "scenario", sequence.scenario },
+        { "resolution", sizeString(sequence.size) }
+    };
+
+    base::Benchmark::Counters counters =
+    {
+        { "bytes_per_frame", static_cast<double>(total_bytes) / sequence.frames.size() }
+    };
+
+    if (codec.lossy)
+    {
+        const double samples = static_cast<double>(sequence.size.width()) *
+            sequence.size.height() * 3 * sequence.frames.size();
+        const double mse = squared_error / samples;
+
+        counters.emplace_back("psnr_db",
+                              mse ? std::min(10.0 * std::log10(255.0 * 255.0 / mse), kMaxPsnr)
+                                  : kMaxPsnr);
+    }
+
+    if (encode_enabled)
+    {
+        proto::desktop::VideoPacket packet;
+        size_t index = 0;
+
+        // calls_per_second is the number of frames per second.
+        benchmark->run(codec.name, "encode", params, sequence.frameBytes(), counters, [&]()
+        {
+            packet.Clear();
+            encoder->encode(sequence.frames[index].get(), &packet);
+            index = (index + 1) % sequence.frames.size();
+        });
+    }
+
+    if (decode_enabled)
+    {
+        size_t index = 0;
+
+        benchmark->run(codec.name, "decode", params, sequence.frameBytes(), counters, [&]()
+        {
+            decoder->decode(packets[index], decoded_frame.get());
+            index = (index + 1) % packets.size();
+        });
+    }
+}
+
+void benchmarkVideoCodecs(base::Benchmark* benchmark, const FrameSequence& sequence)
+{
+    if (sequence.frames.empty())
+        return;
+
+    for (const auto& codec : kVideoCodecs)
+        benchmarkVideoCodec(benchmark, codec, sequence);
+}
+
+bool isVideoCodecEnabled(const base::Benchmark& benchmark)
+{
+    for (const auto& codec : kVideoCodecs)
+    {
+        if (benchmark.isEnabled(codec.name, "encode") || benchmark.isEnabled(codec.name, "decode"))
+            return true;
+    }
+
+    return false;
+}
+
+// Draws an arrow with a black outline and a soft shadow. |variant| changes the color of the
+// arrow, so that the cursors are different for the cache.
+std::unique_ptr<desktop::MouseCursor> createCursor(int size, uint32_t variant)
+{
+    std::unique_ptr<uint8_t[]> data = std::make_unique<uint8_t[]>(size * size * sizeof(uint32_t));
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(data.get());
+
+    const uint32_t fill_color = 0xFF000000 | (0x00FFFFFF - (variant & 0x00FFFFFF));
+
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            uint32_t color = 0;
+
+            if (x <= y / 2)
+                color = (x == 0 || x == y / 2 || y == size - 1) ? 0xFF000000 : fill_color;
+            else if (x <= y / 2 + 2)
+                color = 0x40000000;
+
+            pixels[y * size + x] = color;
+        }
+    }
+
+    return std::make_unique<desktop::MouseCursor>(std::move(data), QSize(size, size), QPoint());
+}
+
+void benchmarkCursorCodec(base::Benchmark* benchmark)
+{
+    const bool encode_enabled = benchmark->isEnabled("cursor", "encode");
+    const bool decode_enabled = benchmark->isEnabled("cursor", "decode");
+
+    if (!encode_enabled && !decode_enabled)
+        return;
+
+    // The number of different cursors which are decoded in turns. Less than the size of the
+    // cache, so that the decoder gets the cache indexes as in a session.
+    const uint32_t kCursorCount = 4;
+
+    for (int size : { 32, 64, 128 })
+    {
+        const int64_t cursor_bytes = static_cast<int64_t>(size) * size * sizeof(uint32_t);
+
+        // The first shape of each cursor contains the image, the next ones contain the index of
+        // the cursor in the cache.
+        std::vector<proto::desktop::CursorShape> shapes;
+        int64_t image_bytes = 0;
+
+        CursorEncoder shape_encoder;
+
+        for (uint32_t round = 0; round < 2; ++round)
+        {
+            for (uint32_t variant = 0; variant < kCursorCount; ++variant)
+            {
+                proto::desktop::CursorShape shape;
+                shape_encoder.encode(createCursor(size, variant), &shape);
+
+                if (round == 0)
+                    image_bytes += shape.ByteSizeLong();
+
+                shapes.push_back(std::move(shape));
+            }
+        }
+
+        const base::Benchmark::Params params = { { "size", sizeString(QSize(size, size)) } };
+        const base::Benchmark::Counters counters =
+        {
+            { "bytes_per_cursor", static_cast<double>(image_bytes) / kCursorCount }
+        };
+
+        if (encode_enabled)
+        {
+            CursorEncoder encoder;
+            proto::desktop::CursorShape shape;
+            uint32_t variant = 0;
+
+            // Each call gets a new cursor, so the image is compressed every time. The time
+            // includes the creation of the cursor.
+            benchmark->run("cursor", "encode", params, cursor_bytes, counters, [&]()
+            {
+                shape.Clear();
+                encoder.encode(createCursor(size, variant++), &shape);
+            });
+        }
+
+        if (decode_enabled)
+        {
+            CursorDecoder decoder;
+            size_t index = 0;
+
+            // The first shape resets the cache of the decoder, so the shapes are decoded in a
+            // loop.
+            benchmark->run("cursor", "decode", params, cursor_bytes, counters, [&]()
+            {
+                decoder.decode(shapes[index]);
+                index = (index + 1) % shapes.size();
+            });
+        }
+    }
+}
+
+} // namespace
+
+} // namespace codec
+
+int main(int argc, char* argv[])
+{
+    // The options of the harness are removed before the rest is passed to base::Benchmark.
+    const char kRecordingOption[] = "--recording=";
+
+    std::vector<std::string> recordings;
+    std::vector<char*> benchmark_argv;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        if (i != 0 && strncmp(argv[i], kRecordingOption, strlen(kRecordingOption)) == 0)
+            recordings.push_back(argv[i] + strlen(kRecordingOption));
+        else
+            benchmark_argv.push_back(argv[i]);
+    }
+
+    base::Benchmark benchmark(static_cast<int>(benchmark_argv.size()), benchmark_argv.data());
+    if (!benchmark.isValid())
+        return 1;
+
+    if (codec::isVideoCodecEnabled(benchmark))
+    {
+        for (const auto& size : codec::kResolutions)
+        {
+            for (auto pattern : codec::kPatterns)
+            {
+                codec::benchmarkVideoCodecs(
+                    &benchmark, codec::createSyntheticSequence(size, pattern));
+            }
+        }
+
+        for (const auto& recording : recordings)
+            codec::benchmarkVideoCodecs(&benchmark, codec::loadRecording(recording));
+    }
+
+    codec::benchmarkCursorCodec(&benchmark);
+
+    return 0;
+}
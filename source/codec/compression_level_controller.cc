@@ -0,0 +1,189 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/compression_level_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/logging.h"
+
+namespace codec {
+
+namespace {
+
+// The frames with less input are not measured: their encoding time is mostly the fixed overhead
+// of the compressor and the precision of the clock.
+const size_t kMinInputSize = 64 * 1024;
+
+// Weight of a new frame in the averages.
+const double kAverageWeight = 0.25;
+
+// The level is not changed until this number of frames is encoded with it.
+const int kMinLevelFrames = 8;
+
+// The level is changed only if the gain is larger than this factor, so that the level does not
+// switch back and forth because of the noise of the measurements.
+const double kMargin = 1.25;
+
+// Typical changes of the encoding time and of the compressed size between neighbouring levels.
+const double kLevelTimeFactor = 1.3;
+const double kLevelRatioFactor = 0.97;
+
+double average(double value, double sample, bool has_value)
+{
+    if (!has_value)
+        return sample;
+
+    return value + (sample - value) * kAverageWeight;
+}
+
+} // namespace
+
+CompressionLevelController::CompressionLevelController(
+    int min_level, int max_level, int initial_level)
+    : min_level_(min_level),
+      max_level_(max_level),
+      initial_level_(std::clamp(initial_level, min_level, max_level)),
+      level_(initial_level_),
+      stats_(max_level - min_level + 1)
+{
+    DCHECK_LE(min_level, max_level);
+}
+
+void CompressionLevelController::setTargetFrameTime(std::chrono::microseconds frame_time)
+{
+    frame_time_ = frame_time;
+}
+
+void CompressionLevelController::setBandwidth(int64_t bytes_per_second)
+{
+    bandwidth_ = bytes_per_second;
+}
+
+void CompressionLevelController::addFrame(size_t input_size,
+                                          size_t output_size,
+                                          std::chrono::microseconds encode_time)
+{
+    if (input_size < kMinInputSize)
+        return;
+
+    LevelStats& level_stats = stats(level_);
+
+    const double ns_per_byte = encode_time.count() * 1000.0 / input_size;
+    const double output_ratio = static_cast<double>(output_size) / input_size;
+
+    level_stats.ns_per_byte = average(level_stats.ns_per_byte, ns_per_byte, level_stats.measured);
+    level_stats.output_ratio =
+        average(level_stats.output_ratio, output_ratio, level_stats.measured);
+    level_stats.measured = true;
+
+    input_size_ = average(input_size_, static_cast<double>(input_size), input_size_ != 0);
+
+    if (++level_frames_ < kMinLevelFrames)
+        return;
+
+    const int old_level = level_;
+
+    chooseLevel();
+
+    if (level_ != old_level)
+    {
+        level_frames_ = 0;
+        LOG(LS_INFO) << "Compression level changed from " << old_level << " to " << level_;
+    }
+}
+
+double CompressionLevelController::predictedTime(int level) const
+{
+    if (stats(level).measured)
+        return stats(level).ns_per_byte;
+
+    return stats(level_).ns_per_byte * std::pow(kLevelTimeFactor, level - level_);
+}
+
+double CompressionLevelController::predictedRatio(int level) const
+{
+    if (stats(level).measured)
+        return stats(level).output_ratio;
+
+    return stats(level_).output_ratio * std::pow(kLevelRatioFactor, level - level_);
+}
+
+void CompressionLevelController::chooseLevel()
+{
+    // Times of a frame of the average size in microseconds.
+    auto encode_time = [&](int level)
+    {
+        return input_size_ * predictedTime(level) / 1000.0;
+    };
+
+    auto transfer_time = [&](int level)
+    {
+        return input_size_ * predictedRatio(level) * 1000000.0 / bandwidth_;
+    };
+
+    const double frame_time = static_cast<double>(frame_time_.count());
+    const double current_encode_time = encode_time(level_);
+
+    // The encoder can not keep up with the frame rate.
+    if (frame_time > 0 && current_encode_time > frame_time)
+    {
+        if (level_ > min_level_)
+            --level_;
+        return;
+    }
+
+    if (!bandwidth_)
+    {
+        // Return to the initial level when the encoder has the time for it.
+        if (level_ < initial_level_ &&
+            (frame_time <= 0 || encode_time(level_ + 1) * kMargin <= frame_time))
+        {
+            ++level_;
+        }
+        return;
+    }
+
+    const double current_transfer_time = transfer_time(level_);
+
+    if (current_transfer_time > current_encode_time * kMargin)
+    {
+        // The link is the bottleneck. The higher level reduces the transfer time, if it does not
+        // make the encoder the bottleneck.
+        if (level_ < max_level_)
+        {
+            const double next_encode_time = encode_time(level_ + 1);
+
+            if (next_encode_time * kMargin <= current_transfer_time &&
+                (frame_time <= 0 || next_encode_time <= frame_time))
+            {
+                ++level_;
+            }
+        }
+    }
+    else if (current_encode_time > current_transfer_time * kMargin)
+    {
+        // The encoder is the bottleneck. The lower level is faster, if the link can transfer the
+        // larger frames.
+        if (level_ > min_level_ && transfer_time(level_ - 1) * kMargin <= current_encode_time)
+            --level_;
+    }
+}
+
+} // namespace codec
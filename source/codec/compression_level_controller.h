@@ -0,0 +1,99 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__COMPRESSION_LEVEL_CONTROLLER_H
+#define CODEC__COMPRESSION_LEVEL_CONTROLLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace codec {
+
+// Chooses the compression level of the encoder from the measured encoding time and the compressed
+// size of the frames. The frames are encoded and sent in parallel, so the time of a frame is the
+// longer of its encoding time and its transfer time over the link. The level is changed by one
+// step at a time:
+//   - down, if the encoding takes longer than the target frame time;
+//   - up, if the transfer takes longer than the encoding and the next level is expected to be
+//     encoded faster than the current frames are transferred (a slow link);
+//   - down, if the encoding takes longer than the transfer and the previous level is expected to
+//     be transferred faster than the current frames are encoded (a fast link).
+// The time and the size of the neighbouring levels are taken from their previous measurements or
+// are predicted from the current level with the typical difference between the levels.
+//
+// While the bandwidth is unknown, the level is not raised above the initial level.
+class CompressionLevelController
+{
+public:
+    CompressionLevelController(int min_level, int max_level, int initial_level);
+    ~CompressionLevelController() = default;
+
+    void setTargetFrameTime(std::chrono::microseconds frame_time);
+
+    // Sets the estimated bandwidth of the link. 0 if the bandwidth is unknown.
+    void setBandwidth(int64_t bytes_per_second);
+
+    // Adds the result of the encoding of a frame with level() and chooses the level for the next
+    // frames. |input_size| is the size of the pixels passed to the compressor.
+    void addFrame(size_t input_size, size_t output_size, std::chrono::microseconds encode_time);
+
+    int level() const { return level_; }
+
+private:
+    struct LevelStats
+    {
+        // Averages of the encoding time per input byte and of the compressed size per input byte.
+        double ns_per_byte = 0;
+        double output_ratio = 0;
+        bool measured = false;
+    };
+
+    const LevelStats& stats(int level) const { return stats_[level - min_level_]; }
+    LevelStats& stats(int level) { return stats_[level - min_level_]; }
+
+    // Encoding time per input byte and compressed size per input byte of |level|.
+    double predictedTime(int level) const;
+    double predictedRatio(int level) const;
+
+    void chooseLevel();
+
+    const int min_level_;
+    const int max_level_;
+    const int initial_level_;
+    int level_;
+
+    std::chrono::microseconds frame_time_ { 0 };
+    int64_t bandwidth_ = 0;
+
+    // Average input size of the frames.
+    double input_size_ = 0;
+
+    // Number of frames encoded with the current level.
+    int level_frames_ = 0;
+
+    std::vector<LevelStats> stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(CompressionLevelController);
+};
+
+} // namespace codec
+
+#endif // CODEC__COMPRESSION_LEVEL_CONTROLLER_H
@@ -0,0 +1,130 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/compression_level_controller.h"
+
+#include <cmath>
+
+namespace codec {
+
+namespace {
+
+const int kMinLevel = 1;
+const int kMaxLevel = 19;
+
+const size_t kInputSize = 4 * 1024 * 1024;
+const int kFrameCount = 500;
+
+// The encoder model: the time and the compressed size of a frame of |kInputSize| bytes.
+std::chrono::microseconds encodeTime(int level)
+{
+    return std::chrono::microseconds(
+        static_cast<int64_t>(8000 * std::pow(1.3, level - 1)));
+}
+
+size_t outputSize(int level)
+{
+    return static_cast<size_t>(kInputSize * 0.3 * std::pow(0.95, level - 1));
+}
+
+// Encodes |kFrameCount| frames and returns the number of the level changes in the last half of
+// the frames.
+int encodeFrames(CompressionLevelController* controller)
+{
+    int changes = 0;
+
+    for (int i = 0; i < kFrameCount; ++i)
+    {
+        const int level = controller->level();
+
+        controller->addFrame(kInputSize, outputSize(level), encodeTime(level));
+
+        if (i >= kFrameCount / 2 && controller->level() != level)
+            ++changes;
+    }
+
+    return changes;
+}
+
+} // namespace
+
+TEST(compression_level_controller, fast_link)
+{
+    CompressionLevelController controller(kMinLevel, kMaxLevel, 10);
+    controller.setTargetFrameTime(std::chrono::milliseconds(100));
+    controller.setBandwidth(1000 * 1000 * 1000);
+
+    EXPECT_EQ(0, encodeFrames(&controller));
+
+    // The transfer takes almost no time, the fastest level is the best.
+    EXPECT_EQ(kMinLevel, controller.level());
+}
+
+TEST(compression_level_controller, slow_link)
+{
+    const std::chrono::microseconds frame_time = std::chrono::milliseconds(100);
+
+    CompressionLevelController controller(kMinLevel, kMaxLevel, 1);
+    controller.setTargetFrameTime(frame_time);
+    controller.setBandwidth(250 * 1000);
+
+    EXPECT_EQ(0, encodeFrames(&controller));
+
+    // The highest level which is encoded within the frame time.
+    EXPECT_LE(encodeTime(controller.level()), frame_time);
+    EXPECT_GT(encodeTime(controller.level() + 1), frame_time);
+}
+
+TEST(compression_level_controller, encoder_bound)
+{
+    const std::chrono::microseconds frame_time = std::chrono::milliseconds(20);
+
+    CompressionLevelController controller(kMinLevel, kMaxLevel, 10);
+    controller.setTargetFrameTime(frame_time);
+
+    EXPECT_EQ(0, encodeFrames(&controller));
+    EXPECT_LE(encodeTime(controller.level()), frame_time);
+    EXPECT_GE(controller.level(), 2);
+}
+
+TEST(compression_level_controller, unknown_bandwidth)
+{
+    CompressionLevelController controller(kMinLevel, kMaxLevel, 3);
+    controller.setTargetFrameTime(std::chrono::milliseconds(1000));
+
+    encodeFrames(&controller);
+
+    // Without the bandwidth the level is not raised above the initial level.
+    EXPECT_EQ(3, controller.level());
+}
+
+TEST(compression_level_controller, small_frames)
+{
+    CompressionLevelController controller(kMinLevel, kMaxLevel, 10);
+    controller.setTargetFrameTime(std::chrono::milliseconds(1));
+
+    for (int i = 0; i < kFrameCount; ++i)
+        controller.addFrame(1024, 512, std::chrono::milliseconds(10));
+
+    // The small frames are not measured.
+    EXPECT_EQ(10, controller.level());
+}
+
+} // namespace codec
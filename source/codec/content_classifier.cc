@@ -0,0 +1,234 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/content_classifier.h"
+
+#include "base/logging.h"
+#include "desktop/desktop_frame.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+// The size of the hash table of countColors(). It is more than twice the maximum number of the
+// colors, so the chains of the open addressing are short.
+const int kColorTableSize = 1024;
+const uint32_t kEmptySlot = 0xFFFFFFFF;
+
+static_assert(kColorTableSize >= ContentClassifier::kMaxLosslessColors * 2,
+              "The color table is too small");
+
+} // namespace
+
+void ContentClassifier::classify(const desktop::Frame* frame,
+                                 const desktop::DirtyRegion& region,
+                                 desktop::DirtyRegion* lossless_region,
+                                 desktop::DirtyRegion* lossy_region)
+{
+    DCHECK_EQ(frame->format().bytesPerPixel(), 4);
+
+    if (frame->size() != frame_size_)
+    {
+        frame_size_ = frame->size();
+        grid_size_ = QSize((frame_size_.width() + kBlockSize - 1) / kBlockSize,
+                           (frame_size_.height() + kBlockSize - 1) / kBlockSize);
+        reset();
+    }
+
+    changed_.assign(blocks_.size(), false);
+
+    const QRect frame_rect(QPoint(), frame_size_);
+
+    for (const auto& rect : region)
+    {
+        const QRect clipped_rect = rect.intersected(frame_rect);
+        if (clipped_rect.isEmpty())
+            continue;
+
+        for (int row = clipped_rect.top() / kBlockSize;
+             row <= clipped_rect.bottom() / kBlockSize; ++row)
+        {
+            for (int column = clipped_rect.left() / kBlockSize;
+                 column <= clipped_rect.right() / kBlockSize; ++column)
+            {
+                changed_[row * grid_size_.width() + column] = true;
+            }
+        }
+    }
+
+    *lossless_region = region;
+    lossless_region->intersect(frame_rect);
+
+    for (int row = 0; row < grid_size_.height(); ++row)
+    {
+        for (int column = 0; column < grid_size_.width(); ++column)
+        {
+            const int index = row * grid_size_.width() + column;
+            Block& block = blocks_[index];
+
+            if (!changed_[index])
+            {
+                block.changed_frames = 0;
+
+                // The block has stopped changing. The client gets the exact pixels.
+                if (block.lossy && ++block.static_frames >= kTopOffFrames)
+                {
+                    lossless_region->add(blockRect(column, row));
+                    block.lossy = false;
+                    block.static_frames = 0;
+                }
+
+                continue;
+            }
+
+            ++block.changed_frames;
+            block.static_frames = 0;
+
+            const QRect block_rect = blockRect(column, row);
+
+            // A lossy block stays lossy while it changes, even if it skips some frames (a video
+            // with a frame rate lower than the capture rate).
+            const bool lossy = (block.lossy || block.changed_frames >= kMinChangedFrames) &&
+                countColors(frame->frameDataAtPos(block_rect.topLeft()),
+                            frame->stride(),
+                            block_rect.width(),
+                            block_rect.height(),
+                            kMaxLosslessColors) > kMaxLosslessColors;
+
+            if (lossy)
+            {
+                lossless_region->subtract(block_rect);
+                lossy_region->add(block_rect);
+            }
+            else if (block.lossy)
+            {
+                // The unchanged parts of the block are lossy too.
+                lossless_region->add(block_rect);
+            }
+
+            block.lossy = lossy;
+        }
+    }
+}
+
+bool ContentClassifier::isLossy(const QRect& rect) const
+{
+    const QRect clipped_rect = rect.intersected(QRect(QPoint(), frame_size_));
+    if (clipped_rect.isEmpty())
+        return false;
+
+    for (int row = clipped_rect.top() / kBlockSize;
+         row <= clipped_rect.bottom() / kBlockSize; ++row)
+    {
+        for (int column = clipped_rect.left() / kBlockSize;
+             column <= clipped_rect.right() / kBlockSize; ++column)
+        {
+            if (blocks_[row * grid_size_.width() + column].lossy)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+QVector<desktop::CopyRect> ContentClassifier::exactCopyRects(
+    const QVector<desktop::CopyRect>& copy_rects) const
+{
+    QVector<desktop::CopyRect> exact_copy_rects;
+
+    for (const auto& copy_rect : copy_rects)
+    {
+        if (isLossy(copy_rect.source_rect))
+            break;
+
+        exact_copy_rects.push_back(copy_rect);
+    }
+
+    return exact_copy_rects;
+}
+
+bool ContentClassifier::hasLossyBlocks() const
+{
+    return std::any_of(blocks_.cbegin(), blocks_.cend(),
+                       [](const Block& block) { return block.lossy; });
+}
+
+void ContentClassifier::reset()
+{
+    blocks_.assign(grid_size_.width() * grid_size_.height(), Block());
+}
+
+// static
+int ContentClassifier::countColors(
+    const uint8_t* data, int stride, int width, int height, int max_count)
+{
+    DCHECK_LE(max_count * 2, kColorTableSize);
+
+    uint32_t table[kColorTableSize];
+    memset(table, 0xFF, sizeof(table));
+
+    int count = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uint32_t* pixel = reinterpret_cast<const uint32_t*>(data + y * stride);
+        uint32_t previous = kEmptySlot;
+
+        for (int x = 0; x < width; ++x)
+        {
+            // The alpha channel is not used.
+            const uint32_t color = pixel[x] & 0x00FFFFFF;
+
+            // Runs of the same color are common in the text and the UI.
+            if (color == previous)
+                continue;
+
+            previous = color;
+
+            uint32_t slot = (color * 0x9E3779B1) >> 22;
+
+            while (table[slot] != color)
+            {
+                if (table[slot] == kEmptySlot)
+                {
+                    table[slot] = color;
+
+                    if (++count > max_count)
+                        return count;
+
+                    break;
+                }
+
+                slot = (slot + 1) & (kColorTableSize - 1);
+            }
+        }
+    }
+
+    return count;
+}
+
+QRect ContentClassifier::blockRect(int column, int row) const
+{
+    return QRect(column * kBlockSize, row * kBlockSize, kBlockSize, kBlockSize)
+        .intersected(QRect(QPoint(), frame_size_));
+}
+
+} // namespace codec
@@ -0,0 +1,110 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__CONTENT_CLASSIFIER_H
+#define CODEC__CONTENT_CLASSIFIER_H
+
+#include <QSize>
+
+#include <vector>
+
+#include "base/macros_magic.h"
+#include "desktop/desktop_frame.h"
+#include "desktop/dirty_region.h"
+
+namespace codec {
+
+// Divides the changed areas of the screen between a lossless and a lossy encoder. The screen is
+// divided into blocks of kBlockSize x kBlockSize pixels. A changed block goes to the lossy encoder
+// if it has changed in several consecutive frames and has more than kMaxLosslessColors colors
+// (video, animations, photographic content). The text and the UI have few colors and go to the
+// lossless encoder. When a lossy block stops changing, it is sent once more to the lossless
+// encoder, so that the static content becomes exact.
+class ContentClassifier
+{
+public:
+    static const int kBlockSize = 64;
+    static const int kMaxLosslessColors = 512;
+
+    // A changed block goes to the lossy encoder after it has changed in this number of
+    // consecutive frames.
+    static const int kMinChangedFrames = 2;
+
+    // A lossy block is sent to the lossless encoder after it has not changed in this number of
+    // frames.
+    static const int kTopOffFrames = 10;
+
+    ContentClassifier() = default;
+    ~ContentClassifier() = default;
+
+    // Divides |region| of |frame| into |lossless_region| and |lossy_region|. The lossy region
+    // consists of whole blocks (clipped by the frame). The lossless region also gets the whole
+    // blocks that the client has from the lossy encoder and that have to be replaced with the
+    // exact pixels. The frame must have 32 bits per pixel.
+    void classify(const desktop::Frame* frame,
+                  const desktop::DirtyRegion& region,
+                  desktop::DirtyRegion* lossless_region,
+                  desktop::DirtyRegion* lossy_region);
+
+    // Returns true if the client has the pixels of |rect| (or a part of them) from the lossy
+    // encoder.
+    bool isLossy(const QRect& rect) const;
+
+    // Returns the leading rectangles of |copy_rects| whose sources the client has with the exact
+    // pixels. A rectangle copied from the lossy blocks and all following rectangles (they may copy
+    // from its destination) are dropped. The client applies the copy rectangles before the pixels
+    // of the packet, so this is called before classify() for the frame.
+    QVector<desktop::CopyRect> exactCopyRects(const QVector<desktop::CopyRect>& copy_rects) const;
+
+    // Returns true if the client has some blocks from the lossy encoder. They are sent to the
+    // lossless encoder when the following frames do not change them.
+    bool hasLossyBlocks() const;
+
+    // Forgets the state of the blocks. Called when the client has a new frame.
+    void reset();
+
+    // Returns the number of different colors of the 32 bit pixels, but not more than
+    // |max_count| + 1.
+    static int countColors(const uint8_t* data, int stride, int width, int height, int max_count);
+
+private:
+    struct Block
+    {
+        // Number of consecutive frames in which the block has changed or has not changed.
+        int changed_frames = 0;
+        int static_frames = 0;
+
+        // The client has the block from the lossy encoder.
+        bool lossy = false;
+    };
+
+    QRect blockRect(int column, int row) const;
+
+    QSize frame_size_;
+    QSize grid_size_;
+    std::vector<Block> blocks_;
+
+    // The blocks that intersect the region of the current frame.
+    std::vector<bool> changed_;
+
+    DISALLOW_COPY_AND_ASSIGN(ContentClassifier);
+};
+
+} // namespace codec
+
+#endif // CODEC__CONTENT_CLASSIFIER_H
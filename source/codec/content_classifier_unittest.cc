@@ -0,0 +1,234 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/content_classifier.h"
+#include "desktop/frame_test_util.h"
+
+namespace codec {
+
+namespace {
+
+const QSize kFrameSize(200, 130);
+
+std::unique_ptr<desktop::Frame> createFrame()
+{
+    std::unique_ptr<desktop::Frame> frame = desktop::createTestFrame(kFrameSize);
+
+    // A white background with black lines, like a text.
+    for (int y = 0; y < kFrameSize.height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+
+        for (int x = 0; x < kFrameSize.width(); ++x)
+            row[x] = (y % 8 == 0 && x % 3 != 0) ? 0xFF000000 : 0xFFFFFFFF;
+    }
+
+    return frame;
+}
+
+int countColors(const desktop::Frame* frame, const QRect& rect, int max_count)
+{
+    return ContentClassifier::countColors(frame->frameDataAtPos(rect.topLeft()),
+                                          frame->stride(),
+                                          rect.width(),
+                                          rect.height(),
+                                          max_count);
+}
+
+} // namespace
+
+TEST(content_classifier, count_colors)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+
+    EXPECT_EQ(1, countColors(frame.get(), QRect(0, 1, 64, 7), 512));
+    EXPECT_EQ(2, countColors(frame.get(), QRect(0, 0, 64, 64), 512));
+
+    // A gradient with 200 colors.
+    for (int y = 0; y < kFrameSize.height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+
+        for (int x = 0; x < kFrameSize.width(); ++x)
+            row[x] = 0xFF000000 | static_cast<uint32_t>(x * 0x010101);
+    }
+
+    EXPECT_EQ(200, countColors(frame.get(), QRect(QPoint(), kFrameSize), 512));
+
+    // The counting stops after |max_count| colors.
+    fillRandomPixels(frame.get(), QRect(QPoint(), kFrameSize), 1);
+    EXPECT_EQ(513, countColors(frame.get(), QRect(0, 0, 64, 64), 512));
+    EXPECT_EQ(101, countColors(frame.get(), QRect(0, 0, 64, 64), 100));
+}
+
+TEST(content_classifier, text_is_lossless)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    ContentClassifier classifier;
+
+    const desktop::DirtyRegion region(QRect(10, 10, 150, 100));
+
+    for (int i = 0; i < 5; ++i)
+    {
+        desktop::DirtyRegion lossless_region;
+        desktop::DirtyRegion lossy_region;
+
+        classifier.classify(frame.get(), region, &lossless_region, &lossy_region);
+
+        EXPECT_EQ(region, lossless_region);
+        EXPECT_TRUE(lossy_region.isEmpty());
+    }
+
+    EXPECT_FALSE(classifier.isLossy(QRect(QPoint(), kFrameSize)));
+}
+
+TEST(content_classifier, video_is_lossy)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    ContentClassifier classifier;
+
+    // The video covers the block (1, 0) and a part of the block (1, 1).
+    const QRect video_rect(64, 0, 64, 70);
+    const desktop::DirtyRegion region(video_rect);
+
+    desktop::DirtyRegion lossless_region;
+    desktop::DirtyRegion lossy_region;
+
+    // The first change is lossless, the block may be a single change of the UI.
+    fillRandomPixels(frame.get(), video_rect, 1);
+    classifier.classify(frame.get(), region, &lossless_region, &lossy_region);
+
+    EXPECT_EQ(region, lossless_region);
+    EXPECT_TRUE(lossy_region.isEmpty());
+
+    // The block (1, 1) has few colors and stays lossless.
+    fillRandomPixels(frame.get(), video_rect, 2);
+    lossless_region.clear();
+    classifier.classify(frame.get(), region, &lossless_region, &lossy_region);
+
+    EXPECT_EQ(desktop::DirtyRegion(QRect(64, 64, 64, 6)), lossless_region);
+    EXPECT_EQ(desktop::DirtyRegion(QRect(64, 0, 64, 64)), lossy_region);
+    EXPECT_TRUE(classifier.isLossy(QRect(100, 10, 1, 1)));
+    EXPECT_FALSE(classifier.isLossy(QRect(0, 0, 64, 64)));
+
+    // The video is replaced with the text. The whole block is sent losslessly.
+    const desktop::DirtyRegion text_region(QRect(64, 0, 10, 10));
+    std::unique_ptr<desktop::Frame> text_frame = createFrame();
+
+    lossless_region.clear();
+    lossy_region.clear();
+    classifier.classify(text_frame.get(), text_region, &lossless_region, &lossy_region);
+
+    EXPECT_EQ(desktop::DirtyRegion(QRect(64, 0, 64, 64)), lossless_region);
+    EXPECT_TRUE(lossy_region.isEmpty());
+    EXPECT_FALSE(classifier.isLossy(QRect(QPoint(), kFrameSize)));
+}
+
+TEST(content_classifier, top_off)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    ContentClassifier classifier;
+
+    // The video changes a part of the block (2, 1).
+    const QRect block_rect(128, 64, 64, 64);
+    const desktop::DirtyRegion region(QRect(130, 70, 20, 20));
+
+    fillRandomPixels(frame.get(), block_rect, 1);
+
+    desktop::DirtyRegion lossless_region;
+    desktop::DirtyRegion lossy_region;
+
+    for (int i = 0; i < ContentClassifier::kMinChangedFrames; ++i)
+    {
+        lossless_region.clear();
+        lossy_region.clear();
+        classifier.classify(frame.get(), region, &lossless_region, &lossy_region);
+    }
+
+    EXPECT_TRUE(lossless_region.isEmpty());
+    EXPECT_EQ(desktop::DirtyRegion(block_rect), lossy_region);
+
+    // The block is sent losslessly after it has not changed for some frames.
+    for (int i = 0; i < ContentClassifier::kTopOffFrames; ++i)
+    {
+        lossless_region.clear();
+        lossy_region.clear();
+        classifier.classify(frame.get(), desktop::DirtyRegion(), &lossless_region, &lossy_region);
+
+        EXPECT_TRUE(lossy_region.isEmpty());
+
+        if (i + 1 < ContentClassifier::kTopOffFrames)
+        {
+            EXPECT_TRUE(lossless_region.isEmpty());
+        }
+    }
+
+    EXPECT_EQ(desktop::DirtyRegion(block_rect), lossless_region);
+    EXPECT_FALSE(classifier.isLossy(QRect(QPoint(), kFrameSize)));
+}
+
+TEST(content_classifier, copy_from_topped_off_block)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    ContentClassifier classifier;
+
+    // The video in the block (2, 1).
+    const QRect block_rect(128, 64, 64, 64);
+    fillRandomPixels(frame.get(), block_rect, 1);
+
+    desktop::DirtyRegion lossless_region;
+    desktop::DirtyRegion lossy_region;
+
+    for (int i = 0; i < ContentClassifier::kMinChangedFrames; ++i)
+    {
+        classifier.classify(frame.get(), desktop::DirtyRegion(block_rect),
+                            &lossless_region, &lossy_region);
+    }
+
+    ASSERT_TRUE(classifier.isLossy(block_rect));
+
+    for (int i = 0; i + 1 < ContentClassifier::kTopOffFrames; ++i)
+    {
+        classifier.classify(frame.get(), desktop::DirtyRegion(),
+                            &lossless_region, &lossy_region);
+    }
+
+    // The frame that tops off the block also copies from it and from the text before it.
+    const QVector<desktop::CopyRect> copy_rects =
+    {
+        { QRect(0, 0, 64, 64), QPoint(0, 64) },
+        { QRect(140, 70, 40, 40), QPoint(10, 10) },
+        { QRect(64, 0, 32, 32), QPoint(10, 60) }
+    };
+
+    // The client copies before it gets the exact pixels of the block.
+    const QVector<desktop::CopyRect> exact_copy_rects = classifier.exactCopyRects(copy_rects);
+    ASSERT_EQ(1, exact_copy_rects.size());
+    EXPECT_EQ(copy_rects[0].source_rect, exact_copy_rects[0].source_rect);
+
+    lossless_region.clear();
+    lossy_region.clear();
+    classifier.classify(frame.get(), desktop::DirtyRegion(), &lossless_region, &lossy_region);
+
+    EXPECT_EQ(desktop::DirtyRegion(block_rect), lossless_region);
+    EXPECT_FALSE(classifier.isLossy(block_rect));
+}
+
+} // namespace codec
@@ -0,0 +1,344 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/palette_tile.h"
+
+#include <libyuv/cpu_id.h>
+
+#include "base/logging.h"
+#include "codec/palette_tile_sse3.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+const int kMaxShortRun = 15;
+
+typedef void(*ExpandFunc)(const uint8_t* indices, const uint32_t* palette, uint32_t* dst,
+                          int count);
+
+void expandPalette_C(const uint8_t* indices, const uint32_t* palette, uint32_t* dst, int count)
+{
+    for (int i = 0; i < count; ++i)
+        dst[i] = palette[indices[i] & 0x0F];
+}
+
+ExpandFunc expandFunc()
+{
+    static const ExpandFunc func =
+        libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3) ? expandPalette_SSE3 : expandPalette_C;
+    return func;
+}
+
+int bitsPerIndex(int color_count)
+{
+    if (color_count <= 2)
+        return 1;
+
+    if (color_count <= 4)
+        return 2;
+
+    return 4;
+}
+
+size_t varintSize(uint32_t value)
+{
+    size_t size = 1;
+
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        ++size;
+    }
+
+    return size;
+}
+
+void appendVarint(uint32_t value, std::string* output)
+{
+    while (value >= 0x80)
+    {
+        output->push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+
+    output->push_back(static_cast<char>(value));
+}
+
+bool readVarint(const uint8_t** input, const uint8_t* end, uint32_t* value)
+{
+    *value = 0;
+
+    for (int shift = 0; shift < 32; shift += 7)
+    {
+        if (*input == end)
+            return false;
+
+        const uint8_t byte = *(*input)++;
+        *value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+size_t runSize(uint32_t length)
+{
+    if (length <= kMaxShortRun)
+        return 1;
+
+    return 1 + varintSize(length - kMaxShortRun - 1);
+}
+
+void appendRun(uint8_t index, uint32_t length, std::string* output)
+{
+    if (length <= kMaxShortRun)
+    {
+        output->push_back(static_cast<char>(index | ((length - 1) << 4)));
+    }
+    else
+    {
+        output->push_back(static_cast<char>(index | (kMaxShortRun << 4)));
+        appendVarint(length - kMaxShortRun - 1, output);
+    }
+}
+
+} // namespace
+
+// static
+bool PaletteTile::encode(const uint8_t* data, int stride, const QSize& size, std::string* output)
+{
+    DCHECK(size.width() > 0 && size.width() <= kMaxTileSize);
+    DCHECK(size.height() > 0 && size.height() <= kMaxTileSize);
+
+    uint32_t palette[kMaxColors];
+    int color_count = 0;
+
+    // The indices of the pixels in the row order and the size of the run-length form.
+    uint8_t indices[kMaxTileSize * kMaxTileSize];
+    uint8_t* index = indices;
+    size_t run_length_size = 0;
+
+    uint32_t run_color = 0;
+    uint8_t run_index = 0;
+    uint32_t run_length = 0;
+
+    for (int y = 0; y < size.height(); ++y)
+    {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(data + y * stride);
+
+        for (int x = 0; x < size.width(); ++x)
+        {
+            const uint32_t color = row[x];
+
+            // The palette is searched only at the end of a run.
+            if (color != run_color || !run_length)
+            {
+                if (run_length)
+                    run_length_size += runSize(run_length);
+
+                int i = 0;
+                while (i < color_count && palette[i] != color)
+                    ++i;
+
+                if (i == color_count)
+                {
+                    if (color_count == kMaxColors)
+                        return false;
+
+                    palette[color_count++] = color;
+                }
+
+                run_color = color;
+                run_index = static_cast<uint8_t>(i);
+                run_length = 0;
+            }
+
+            ++run_length;
+            *index++ = run_index;
+        }
+    }
+
+    run_length_size += runSize(run_length);
+
+    const int bits = bitsPerIndex(color_count);
+    const size_t row_size = (size.width() * bits + 7) / 8;
+    const bool run_length_mode = run_length_size < row_size * size.height();
+
+    output->push_back(
+        static_cast<char>((color_count - 1) | (run_length_mode ? kRunLengthFlag : 0)));
+    output->append(reinterpret_cast<const char*>(palette), color_count * sizeof(uint32_t));
+
+    if (color_count == 1)
+        return true;
+
+    const int pixel_count = size.width() * size.height();
+
+    if (run_length_mode)
+    {
+        int start = 0;
+
+        for (int i = 1; i <= pixel_count; ++i)
+        {
+            if (i == pixel_count || indices[i] != indices[start])
+            {
+                appendRun(indices[start], i - start, output);
+                start = i;
+            }
+        }
+    }
+    else
+    {
+        const size_t offset = output->size();
+        output->resize(offset + row_size * size.height());
+
+        uint8_t* packed = reinterpret_cast<uint8_t*>(&(*output)[offset]);
+        index = indices;
+
+        for (int y = 0; y < size.height(); ++y)
+        {
+            for (int x = 0; x < size.width(); ++x)
+                packed[(x * bits) >> 3] |= *index++ << ((x * bits) & 7);
+
+            packed += row_size;
+        }
+    }
+
+    return true;
+}
+
+// static
+size_t PaletteTile::decode(const uint8_t* input,
+                           size_t input_size,
+                           const QSize& size,
+                           uint8_t* data,
+                           int stride)
+{
+    DCHECK(size.width() > 0 && size.width() <= kMaxTileSize);
+    DCHECK(size.height() > 0 && size.height() <= kMaxTileSize);
+
+    if (!input_size || (input[0] & ~(kRunLengthFlag | (kMaxColors - 1))))
+        return 0;
+
+    const int color_count = (input[0] & (kMaxColors - 1)) + 1;
+    const size_t palette_size = color_count * sizeof(uint32_t);
+
+    if (input_size < 1 + palette_size)
+        return 0;
+
+    // The unused entries are 0, so the invalid indices do not need to be checked.
+    alignas(16) uint32_t palette[kMaxColors] = { 0 };
+    memcpy(palette, input + 1, palette_size);
+
+    const uint8_t* pos = input + 1 + palette_size;
+    const uint8_t* end = input + input_size;
+
+    if (color_count == 1)
+    {
+        for (int y = 0; y < size.height(); ++y)
+        {
+            uint32_t* row = reinterpret_cast<uint32_t*>(data + y * stride);
+            std::fill(row, row + size.width(), palette[0]);
+        }
+    }
+    else if (input[0] & kRunLengthFlag)
+    {
+        uint32_t remaining = size.width() * size.height();
+        uint32_t* row = reinterpret_cast<uint32_t*>(data);
+        int x = 0;
+
+        while (remaining)
+        {
+            if (pos == end)
+                return 0;
+
+            const uint8_t run = *pos++;
+            uint32_t length = (run >> 4) + 1;
+
+            if (length > kMaxShortRun)
+            {
+                uint32_t extra_length;
+                if (!readVarint(&pos, end, &extra_length) || extra_length >= remaining)
+                    return 0;
+
+                length += extra_length;
+            }
+
+            if (length > remaining)
+                return 0;
+
+            remaining -= length;
+
+            const uint32_t color = palette[run & (kMaxColors - 1)];
+
+            // A run may continue on the next rows.
+            while (length)
+            {
+                const int count = std::min(static_cast<int>(length), size.width() - x);
+
+                std::fill(row + x, row + x + count, color);
+
+                x += count;
+                length -= count;
+
+                if (x == size.width())
+                {
+                    x = 0;
+                    row = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(row) + stride);
+                }
+            }
+        }
+    }
+    else
+    {
+        const int bits = bitsPerIndex(color_count);
+        const int mask = (1 << bits) - 1;
+        const size_t row_size = (size.width() * bits + 7) / 8;
+
+        if (static_cast<size_t>(end - pos) < row_size * size.height())
+            return 0;
+
+        const ExpandFunc expand = expandFunc();
+        const int simd_width = size.width() & ~15;
+
+        uint8_t indices[kMaxTileSize];
+
+        for (int y = 0; y < size.height(); ++y)
+        {
+            for (int x = 0; x < size.width(); ++x)
+                indices[x] = (pos[(x * bits) >> 3] >> ((x * bits) & 7)) & mask;
+
+            uint32_t* row = reinterpret_cast<uint32_t*>(data + y * stride);
+
+            expand(indices, palette, row, simd_width);
+            expandPalette_C(indices + simd_width, palette, row + simd_width,
+                            size.width() - simd_width);
+
+            pos += row_size;
+        }
+    }
+
+    return pos - input;
+}
+
+} // namespace codec
@@ -0,0 +1,66 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__PALETTE_TILE_H
+#define CODEC__PALETTE_TILE_H
+
+#include <QSize>
+
+#include <cstdint>
+#include <string>
+
+#include "base/macros_magic.h"
+
+namespace codec {
+
+// Encoding of the 32 bit tiles with at most kMaxColors colors (toolbars, dialogs, terminals).
+// A tile is stored as:
+//   * the header byte: the number of colors - 1 in bits 0-3 and kRunLengthFlag;
+//   * the palette: 4 bytes of each color in the byte order of the frame;
+//   * the indices of the pixels, nothing if the tile has one color.
+// Without kRunLengthFlag the indices are packed to 1, 2 or 4 bits (up to 2, 4 and 16 colors) from
+// the low bits of each byte, each row starts with a new byte. With kRunLengthFlag the indices are
+// stored as runs of the same index in the row order of the tile. A run is a byte with the index
+// in bits 0-3 and the length - 1 in bits 4-7. If bits 4-7 are 15, the length - 16 follows as a
+// varint. The encoder chooses the shorter form.
+class PaletteTile
+{
+public:
+    static const int kMaxColors = 16;
+    static const int kMaxTileSize = 64;
+    static const uint8_t kRunLengthFlag = 0x10;
+
+    // Appends the tile of |size| pixels (at most kMaxTileSize x kMaxTileSize) to |output|.
+    // Returns false and does not change |output| if the tile has more than kMaxColors colors.
+    static bool encode(const uint8_t* data, int stride, const QSize& size, std::string* output);
+
+    // Decodes the tile of |size| pixels from |input|. Returns the number of bytes of the tile
+    // or 0 if the input is invalid.
+    static size_t decode(const uint8_t* input,
+                         size_t input_size,
+                         const QSize& size,
+                         uint8_t* data,
+                         int stride);
+
+private:
+    DISALLOW_IMPLICIT_CONSTRUCTORS(PaletteTile);
+};
+
+} // namespace codec
+
+#endif // CODEC__PALETTE_TILE_H
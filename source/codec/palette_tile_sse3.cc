@@ -0,0 +1,80 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/palette_tile_sse3.h"
+#include "build/build_config.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <tmmintrin.h>
+#endif
+
+namespace codec {
+
+void expandPalette_SSE3(const uint8_t* indices, const uint32_t* palette, uint32_t* dst, int count)
+{
+    // The colors are split into four tables of the bytes, so that one shuffle looks up one byte
+    // of 16 pixels.
+    const __m128i split_mask =
+        _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m128i* colors = reinterpret_cast<const __m128i*>(palette);
+
+    const __m128i c0 = _mm_shuffle_epi8(_mm_loadu_si128(colors), split_mask);
+    const __m128i c1 = _mm_shuffle_epi8(_mm_loadu_si128(colors + 1), split_mask);
+    const __m128i c2 = _mm_shuffle_epi8(_mm_loadu_si128(colors + 2), split_mask);
+    const __m128i c3 = _mm_shuffle_epi8(_mm_loadu_si128(colors + 3), split_mask);
+
+    // The byte 0 of the colors 0-3, 4-7, 8-11 and 12-15, then the byte 1 and so on.
+    const __m128i c01_low = _mm_unpacklo_epi32(c0, c1);
+    const __m128i c23_low = _mm_unpacklo_epi32(c2, c3);
+    const __m128i c01_high = _mm_unpackhi_epi32(c0, c1);
+    const __m128i c23_high = _mm_unpackhi_epi32(c2, c3);
+
+    const __m128i byte0 = _mm_unpacklo_epi64(c01_low, c23_low);
+    const __m128i byte1 = _mm_unpackhi_epi64(c01_low, c23_low);
+    const __m128i byte2 = _mm_unpacklo_epi64(c01_high, c23_high);
+    const __m128i byte3 = _mm_unpackhi_epi64(c01_high, c23_high);
+
+    const __m128i index_mask = _mm_set1_epi8(0x0F);
+
+    for (int i = 0; i < count; i += 16)
+    {
+        const __m128i index = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)), index_mask);
+
+        const __m128i b0 = _mm_shuffle_epi8(byte0, index);
+        const __m128i b1 = _mm_shuffle_epi8(byte1, index);
+        const __m128i b2 = _mm_shuffle_epi8(byte2, index);
+        const __m128i b3 = _mm_shuffle_epi8(byte3, index);
+
+        const __m128i b01_low = _mm_unpacklo_epi8(b0, b1);
+        const __m128i b01_high = _mm_unpackhi_epi8(b0, b1);
+        const __m128i b23_low = _mm_unpacklo_epi8(b2, b3);
+        const __m128i b23_high = _mm_unpackhi_epi8(b2, b3);
+
+        __m128i* dst_ptr = reinterpret_cast<__m128i*>(dst + i);
+
+        _mm_storeu_si128(dst_ptr, _mm_unpacklo_epi16(b01_low, b23_low));
+        _mm_storeu_si128(dst_ptr + 1, _mm_unpackhi_epi16(b01_low, b23_low));
+        _mm_storeu_si128(dst_ptr + 2, _mm_unpacklo_epi16(b01_high, b23_high));
+        _mm_storeu_si128(dst_ptr + 3, _mm_unpackhi_epi16(b01_high, b23_high));
+    }
+}
+
+} // namespace codec
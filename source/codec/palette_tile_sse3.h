@@ -0,0 +1,32 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__PALETTE_TILE_SSE3_H
+#define CODEC__PALETTE_TILE_SSE3_H
+
+#include <cstdint>
+
+namespace codec {
+
+// Writes the colors of |count| 8 bit indices of the palette of 16 colors to |dst|. |count| must be
+// a multiple of 16. Only bits 0-3 of the indices are used. The kernel uses SSSE3 instructions.
+void expandPalette_SSE3(const uint8_t* indices, const uint32_t* palette, uint32_t* dst, int count);
+
+} // namespace codec
+
+#endif // CODEC__PALETTE_TILE_SSE3_H
@@ -0,0 +1,197 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <libyuv/cpu_id.h>
+
+#include "codec/palette_tile.h"
+#include "codec/palette_tile_sse3.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace codec {
+
+namespace {
+
+const int kTileSize = PaletteTile::kMaxTileSize;
+const int kStride = kTileSize * 4;
+
+// Creates a tile with |color_count| colors. If |runs| is true, the colors change every 8
+// pixels, otherwise every pixel has a random color of the palette (and each color is used).
+std::vector<uint32_t> createTile(int color_count, bool runs, uint32_t seed)
+{
+    std::vector<uint32_t> tile(kTileSize * kTileSize);
+    std::mt19937 random(seed);
+
+    std::vector<uint32_t> palette(color_count);
+    for (auto& color : palette)
+        color = static_cast<uint32_t>(random());
+
+    for (size_t i = 0; i < tile.size(); ++i)
+    {
+        if (runs)
+            tile[i] = palette[(i / 8) % palette.size()];
+        else if (i < palette.size())
+            tile[i] = palette[i];
+        else
+            tile[i] = palette[random() % palette.size()];
+    }
+
+    return tile;
+}
+
+bool isEqualTiles(const uint32_t* first, const uint32_t* second, const QSize& size)
+{
+    for (int y = 0; y < size.height(); ++y)
+    {
+        if (memcmp(first + y * kTileSize, second + y * kTileSize, size.width() * 4) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+void testRoundTrip(int color_count, bool runs, const QSize& size)
+{
+    std::vector<uint32_t> tile = createTile(color_count, runs, color_count);
+    std::string data;
+
+    ASSERT_TRUE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+
+    std::vector<uint32_t> decoded_tile(kTileSize * kTileSize);
+
+    EXPECT_EQ(data.size(),
+              PaletteTile::decode(reinterpret_cast<const uint8_t*>(data.data()),
+                                  data.size(),
+                                  size,
+                                  reinterpret_cast<uint8_t*>(decoded_tile.data()),
+                                  kStride));
+    EXPECT_TRUE(isEqualTiles(tile.data(), decoded_tile.data(), size));
+}
+
+} // namespace
+
+TEST(palette_tile, round_trip)
+{
+    for (int color_count : { 1, 2, 3, 4, 5, 16 })
+    {
+        for (bool runs : { false, true })
+        {
+            testRoundTrip(color_count, runs, QSize(kTileSize, kTileSize));
+            testRoundTrip(color_count, runs, QSize(37, 21));
+            testRoundTrip(color_count, runs, QSize(1, 1));
+        }
+    }
+}
+
+TEST(palette_tile, encoded_size)
+{
+    const QSize size(kTileSize, kTileSize);
+    std::string data;
+
+    // A solid tile is the header and one color.
+    std::vector<uint32_t> tile = createTile(1, false, 1);
+    ASSERT_TRUE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+    EXPECT_EQ(5U, data.size());
+
+    // Two colors without runs are packed to 1 bit per pixel.
+    data.clear();
+    tile = createTile(2, false, 2);
+    ASSERT_TRUE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+    EXPECT_EQ(1U + 2 * 4 + kTileSize * kTileSize / 8, data.size());
+    EXPECT_EQ(0, data[0] & PaletteTile::kRunLengthFlag);
+
+    // Runs of 8 pixels take one byte each, it is shorter than 4 bits per pixel.
+    data.clear();
+    tile = createTile(16, true, 3);
+    ASSERT_TRUE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+    EXPECT_EQ(1U + 16 * 4 + kTileSize * kTileSize / 8, data.size());
+    EXPECT_NE(0, data[0] & PaletteTile::kRunLengthFlag);
+
+    // The tiles with more colors are not encoded.
+    data.clear();
+    tile = createTile(17, false, 4);
+    EXPECT_FALSE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+    EXPECT_TRUE(data.empty());
+}
+
+TEST(palette_tile, invalid_data)
+{
+    const QSize size(kTileSize, kTileSize);
+
+    std::vector<uint32_t> tile = createTile(16, true, 5);
+    std::string data;
+
+    ASSERT_TRUE(PaletteTile::encode(
+        reinterpret_cast<const uint8_t*>(tile.data()), kStride, size, &data));
+
+    std::vector<uint32_t> decoded_tile(kTileSize * kTileSize);
+
+    // The truncated data.
+    for (size_t data_size : { size_t(0), size_t(1), size_t(64), data.size() - 1 })
+    {
+        EXPECT_EQ(0U, PaletteTile::decode(reinterpret_cast<const uint8_t*>(data.data()),
+                                          data_size,
+                                          size,
+                                          reinterpret_cast<uint8_t*>(decoded_tile.data()),
+                                          kStride));
+    }
+
+    // The data of a smaller tile.
+    data.clear();
+    ASSERT_TRUE(PaletteTile::encode(reinterpret_cast<const uint8_t*>(tile.data()),
+                                    kStride,
+                                    QSize(kTileSize, kTileSize / 2),
+                                    &data));
+    EXPECT_EQ(0U, PaletteTile::decode(reinterpret_cast<const uint8_t*>(data.data()),
+                                      data.size(),
+                                      size,
+                                      reinterpret_cast<uint8_t*>(decoded_tile.data()),
+                                      kStride));
+}
+
+TEST(palette_tile, sse3_kernel)
+{
+    if (!libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+        return;
+
+    std::mt19937 random(6);
+
+    uint32_t palette[PaletteTile::kMaxColors];
+    for (auto& color : palette)
+        color = static_cast<uint32_t>(random());
+
+    uint8_t indices[256];
+    for (auto& index : indices)
+        index = static_cast<uint8_t>(random());
+
+    uint32_t pixels[256];
+    expandPalette_SSE3(indices, palette, pixels, 256);
+
+    for (int i = 0; i < 256; ++i)
+        EXPECT_EQ(palette[indices[i] & 0x0F], pixels[i]);
+}
+
+} // namespace codec
@@ -20,6 +20,11 @@
 
 #include "build/build_config.h"
 #include "base/macros_magic.h"
+#include "codec/pixel_translator_avx2.h"
+#include "codec/pixel_translator_sse2.h"
+#include "codec/pixel_translator_sse3.h"
+
+#include <libyuv/cpu_id.h>
 
 namespace codec {
 
@@ -210,11 +215,117 @@ private:
     DISALLOW_COPY_AND_ASSIGN(PixelTranslatorFrom8_16bppT);
 };
 
+typedef void(*TranslateFunc)(const uint8_t* src, int src_stride,
+                             uint8_t* dst, int dst_stride,
+                             int width, int height);
+
+// Translates the blocks of |kBlockSize| pixels with a SIMD kernel and the rest of each row with
+// the table translator.
+class PixelTranslatorSimd : public PixelTranslator
+{
+public:
+    PixelTranslatorSimd(TranslateFunc func,
+                        std::unique_ptr<PixelTranslator> table_translator,
+                        const desktop::PixelFormat& source_format,
+                        const desktop::PixelFormat& target_format)
+        : func_(func),
+          table_translator_(std::move(table_translator)),
+          source_bytes_per_pixel_(source_format.bytesPerPixel()),
+          target_bytes_per_pixel_(target_format.bytesPerPixel())
+    {
+        // Nothing
+    }
+
+    ~PixelTranslatorSimd() = default;
+
+    void translate(const uint8_t* src, int src_stride,
+                   uint8_t* dst, int dst_stride,
+                   int width, int height) override
+    {
+        const int simd_width = width - (width % kBlockSize);
+
+        if (simd_width)
+            func_(src, src_stride, dst, dst_stride, simd_width, height);
+
+        if (simd_width != width)
+        {
+            table_translator_->translate(src + simd_width * source_bytes_per_pixel_, src_stride,
+                                         dst + simd_width * target_bytes_per_pixel_, dst_stride,
+                                         width - simd_width, height);
+        }
+    }
+
+private:
+    const TranslateFunc func_;
+    std::unique_ptr<PixelTranslator> table_translator_;
+
+    const int source_bytes_per_pixel_;
+    const int target_bytes_per_pixel_;
+
+    DISALLOW_COPY_AND_ASSIGN(PixelTranslatorSimd);
+};
+
+// Returns the fastest kernel for the pair of formats or nullptr if the pair has no kernels.
+TranslateFunc simdTranslateFunc(const desktop::PixelFormat& source_format,
+                                const desktop::PixelFormat& target_format)
+{
+    if (source_format.isEqual(desktop::PixelFormat::ARGB()))
+    {
+        if (target_format.isEqual(desktop::PixelFormat::RGB565()))
+        {
+            if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+                return translateARGBToRGB565_AVX2;
+            else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+                return translateARGBToRGB565_SSE3;
+            else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+                return translateARGBToRGB565_SSE2;
+        }
+        else if (target_format.isEqual(desktop::PixelFormat::RGB332()))
+        {
+            if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+                return translateARGBToRGB332_AVX2;
+            else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+                return translateARGBToRGB332_SSE3;
+            else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+                return translateARGBToRGB332_SSE2;
+        }
+    }
+    else if (source_format.isEqual(desktop::PixelFormat::RGB565()))
+    {
+        if (target_format.isEqual(desktop::PixelFormat::ARGB()))
+        {
+            if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+                return translateRGB565ToARGB_AVX2;
+            else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+                return translateRGB565ToARGB_SSE2;
+        }
+    }
+
+    return nullptr;
+}
+
 } // namespace
 
 // static
 std::unique_ptr<PixelTranslator> PixelTranslator::create(
     const desktop::PixelFormat& source_format, const desktop::PixelFormat& target_format)
+{
+    std::unique_ptr<PixelTranslator> table_translator =
+        createTable(source_format, target_format);
+    if (!table_translator)
+        return nullptr;
+
+    TranslateFunc func = simdTranslateFunc(source_format, target_format);
+    if (!func)
+        return table_translator;
+
+    return std::make_unique<PixelTranslatorSimd>(
+        func, std::move(table_translator), source_format, target_format);
+}
+
+// static
+std::unique_ptr<PixelTranslator> PixelTranslator::createTable(
+    const desktop::PixelFormat& source_format, const desktop::PixelFormat& target_format)
 {
     switch (target_format.bytesPerPixel())
     {
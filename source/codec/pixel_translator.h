@@ -30,9 +30,16 @@ class PixelTranslator
 public:
     virtual ~PixelTranslator() = default;
 
+    // Creates the translator for the pair of formats. The common pairs use SIMD kernels if the
+    // CPU supports them.
     static std::unique_ptr<PixelTranslator> create(const desktop::PixelFormat& source_format,
                                                    const desktop::PixelFormat& target_format);
 
+    // Creates the translator which converts the pixels with lookup tables. It supports all
+    // pairs of formats and gives the same result as the SIMD kernels.
+    static std::unique_ptr<PixelTranslator> createTable(
+        const desktop::PixelFormat& source_format, const desktop::PixelFormat& target_format);
+
     virtual void translate(const uint8_t* src,
                            int src_stride,
                            uint8_t* dst,
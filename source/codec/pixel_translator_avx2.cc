@@ -0,0 +1,175 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/pixel_translator_avx2.h"
+#include "build/build_config.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+namespace codec {
+
+namespace {
+
+// Scales 8 bit values in 16 bit lanes to 0..|max| as the table translator does:
+// (value * max + 127) / 255. The division is (x + (x >> 8) + 1) >> 8, which is exact for
+// x < 65535.
+FORCEINLINE __m256i scaleDown(__m256i value, __m256i max)
+{
+    __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(value, max), _mm256_set1_epi16(127));
+    x = _mm256_add_epi16(x, _mm256_srli_epi16(x, 8));
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(x, 8);
+}
+
+// Splits 16 ARGB pixels to the red, green and blue values in 16 bit lanes. The packing works in
+// 128 bit lanes, so the pixels are in the order 0-3, 8-11, 4-7, 12-15.
+FORCEINLINE void unpackARGB(const uint8_t* src, __m256i* red, __m256i* green, __m256i* blue)
+{
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+
+    const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src) + 1);
+
+    *blue = _mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+    *green = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                                _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+    *red = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                              _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+}
+
+// Translates 16 ARGB pixels to RGB565 in 16 bit lanes in the order of unpackARGB.
+FORCEINLINE __m256i toRGB565(const uint8_t* src)
+{
+    __m256i red, green, blue;
+    unpackARGB(src, &red, &green, &blue);
+
+    red = scaleDown(red, _mm256_set1_epi16(31));
+    green = scaleDown(green, _mm256_set1_epi16(63));
+    blue = scaleDown(blue, _mm256_set1_epi16(31));
+
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_slli_epi16(red, 11), _mm256_slli_epi16(green, 5)), blue);
+}
+
+// Translates 16 ARGB pixels to RGB332 in 16 bit lanes in the order of unpackARGB.
+FORCEINLINE __m256i toRGB332(const uint8_t* src)
+{
+    __m256i red, green, blue;
+    unpackARGB(src, &red, &green, &blue);
+
+    red = scaleDown(red, _mm256_set1_epi16(7));
+    green = scaleDown(green, _mm256_set1_epi16(7));
+    blue = scaleDown(blue, _mm256_set1_epi16(3));
+
+    return _mm256_or_si256(
+        _mm256_or_si256(_mm256_slli_epi16(red, 5), _mm256_slli_epi16(green, 2)), blue);
+}
+
+} // namespace
+
+void translateARGBToRGB565_AVX2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; x += 16)
+        {
+            // Restore the order of the pixels: 0-3, 4-7, 8-11, 12-15.
+            const __m256i pixels = _mm256_permute4x64_epi64(toRGB565(src + x * 4), 0xD8);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 2), pixels);
+        }
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+void translateARGBToRGB332_AVX2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; x += 16)
+        {
+            // Restore the order of the pixels: 0-3, 4-7, 8-11, 12-15.
+            const __m256i pixels = _mm256_permute4x64_epi64(toRGB332(src + x * 4), 0xD8);
+
+            const __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(pixels),
+                                                    _mm256_extracti128_si256(pixels, 1));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), packed);
+        }
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+void translateRGB565ToARGB_AVX2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height)
+{
+    // The table translator does not round when it scales the values up: value * 255 / max.
+    // The division is done by a multiplication with 2^n / max rounded up, which is exact for
+    // these values.
+    const __m256i max = _mm256_set1_epi16(255);
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; x += 16)
+        {
+            const __m256i pixels =
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+
+            __m256i red = _mm256_srli_epi16(pixels, 11);
+            __m256i green = _mm256_and_si256(_mm256_srli_epi16(pixels, 5), _mm256_set1_epi16(63));
+            __m256i blue = _mm256_and_si256(pixels, _mm256_set1_epi16(31));
+
+            red = _mm256_srli_epi16(
+                _mm256_mulhi_epu16(_mm256_mullo_epi16(red, max), _mm256_set1_epi16(8457)), 2);
+            green = _mm256_srli_epi16(
+                _mm256_mulhi_epu16(_mm256_mullo_epi16(green, max), _mm256_set1_epi16(8323)), 3);
+            blue = _mm256_srli_epi16(
+                _mm256_mulhi_epu16(_mm256_mullo_epi16(blue, max), _mm256_set1_epi16(8457)), 2);
+
+            const __m256i blue_green = _mm256_or_si256(blue, _mm256_slli_epi16(green, 8));
+
+            // The unpacking works in 128 bit lanes: |low| has the pixels 0-3, 8-11 and |high|
+            // has the pixels 4-7, 12-15.
+            const __m256i low = _mm256_unpacklo_epi16(blue_green, red);
+            const __m256i high = _mm256_unpackhi_epi16(blue_green, red);
+
+            __m256i* dst_ptr = reinterpret_cast<__m256i*>(dst + x * 4);
+
+            _mm256_storeu_si256(dst_ptr, _mm256_permute2x128_si256(low, high, 0x20));
+            _mm256_storeu_si256(dst_ptr + 1, _mm256_permute2x128_si256(low, high, 0x31));
+        }
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+} // namespace codec
@@ -0,0 +1,43 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__PIXEL_TRANSLATOR_SSE2_H
+#define CODEC__PIXEL_TRANSLATOR_SSE2_H
+
+#include <cstdint>
+
+namespace codec {
+
+// The kernels translate |height| rows of |width| pixels. |width| must be a multiple of 16. The
+// result is the same as the result of the table translator.
+
+void translateARGBToRGB565_SSE2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height);
+
+void translateARGBToRGB332_SSE2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height);
+
+void translateRGB565ToARGB_SSE2(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height);
+
+} // namespace codec
+
+#endif // CODEC__PIXEL_TRANSLATOR_SSE2_H
@@ -0,0 +1,129 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/pixel_translator_sse3.h"
+#include "build/build_config.h"
+
+#if defined(CC_MSVC)
+#include <intrin.h>
+#else
+#include <tmmintrin.h>
+#endif
+
+namespace codec {
+
+namespace {
+
+// Scales 8 bit values in 16 bit lanes to 0..|max| as the table translator does:
+// (value * max + 127) / 255. The division is (x + (x >> 8) + 1) >> 8, which is exact for
+// x < 65535.
+FORCEINLINE __m128i scaleDown(__m128i value, __m128i max)
+{
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(value, max), _mm_set1_epi16(127));
+    x = _mm_add_epi16(x, _mm_srli_epi16(x, 8));
+    x = _mm_add_epi16(x, _mm_set1_epi16(1));
+    return _mm_srli_epi16(x, 8);
+}
+
+// Splits 8 ARGB pixels to the red, green and blue values in 16 bit lanes. One shuffle moves the
+// blue values of 4 pixels to the low half of the register and the green values to the high half.
+FORCEINLINE void unpackARGB(const uint8_t* src, __m128i* red, __m128i* green, __m128i* blue)
+{
+    const __m128i blue_green_mask =
+        _mm_setr_epi8(0, -1, 4, -1, 8, -1, 12, -1, 1, -1, 5, -1, 9, -1, 13, -1);
+    const __m128i red_mask =
+        _mm_setr_epi8(2, -1, 6, -1, 10, -1, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+
+    const __m128i p0 = _mm_lddqu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i p1 = _mm_lddqu_si128(reinterpret_cast<const __m128i*>(src) + 1);
+
+    const __m128i blue_green0 = _mm_shuffle_epi8(p0, blue_green_mask);
+    const __m128i blue_green1 = _mm_shuffle_epi8(p1, blue_green_mask);
+
+    *blue = _mm_unpacklo_epi64(blue_green0, blue_green1);
+    *green = _mm_unpackhi_epi64(blue_green0, blue_green1);
+    *red = _mm_unpacklo_epi64(_mm_shuffle_epi8(p0, red_mask), _mm_shuffle_epi8(p1, red_mask));
+}
+
+// Translates 8 ARGB pixels to RGB565 in 16 bit lanes.
+FORCEINLINE __m128i toRGB565(const uint8_t* src)
+{
+    __m128i red, green, blue;
+    unpackARGB(src, &red, &green, &blue);
+
+    red = scaleDown(red, _mm_set1_epi16(31));
+    green = scaleDown(green, _mm_set1_epi16(63));
+    blue = scaleDown(blue, _mm_set1_epi16(31));
+
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(red, 11), _mm_slli_epi16(green, 5)), blue);
+}
+
+// Translates 8 ARGB pixels to RGB332 in 16 bit lanes.
+FORCEINLINE __m128i toRGB332(const uint8_t* src)
+{
+    __m128i red, green, blue;
+    unpackARGB(src, &red, &green, &blue);
+
+    red = scaleDown(red, _mm_set1_epi16(7));
+    green = scaleDown(green, _mm_set1_epi16(7));
+    blue = scaleDown(blue, _mm_set1_epi16(3));
+
+    return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(red, 5), _mm_slli_epi16(green, 2)), blue);
+}
+
+} // namespace
+
+void translateARGBToRGB565_SSE3(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; x += 16)
+        {
+            __m128i* dst_ptr = reinterpret_cast<__m128i*>(dst + x * 2);
+
+            _mm_storeu_si128(dst_ptr, toRGB565(src + x * 4));
+            _mm_storeu_si128(dst_ptr + 1, toRGB565(src + x * 4 + 32));
+        }
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+void translateARGBToRGB332_SSE3(const uint8_t* src, int src_stride,
+                                uint8_t* dst, int dst_stride,
+                                int width, int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; x += 16)
+        {
+            const __m128i pixels =
+                _mm_packus_epi16(toRGB332(src + x * 4), toRGB332(src + x * 4 + 32));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), pixels);
+        }
+
+        src += src_stride;
+        dst += dst_stride;
+    }
+}
+
+} // namespace codec
@@ -0,0 +1,153 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <libyuv/cpu_id.h>
+
+#include "codec/pixel_translator.h"
+#include "codec/pixel_translator_avx2.h"
+#include "codec/pixel_translator_sse2.h"
+#include "codec/pixel_translator_sse3.h"
+#include "desktop/desktop_frame_aligned.h"
+
+#include <cstring>
+#include <random>
+
+namespace codec {
+
+namespace {
+
+const int kAlignment = 32;
+const QSize kFrameSize(256, 16);
+
+typedef void(*TranslateFunc)(const uint8_t* src, int src_stride,
+                             uint8_t* dst, int dst_stride,
+                             int width, int height);
+
+std::unique_ptr<desktop::Frame> createRandomFrame(const desktop::PixelFormat& format)
+{
+    std::unique_ptr<desktop::Frame> frame =
+        desktop::FrameAligned::create(kFrameSize, format, kAlignment);
+    std::mt19937 random(format.bytesPerPixel());
+
+    for (int i = 0; i < frame->stride() * kFrameSize.height(); ++i)
+        frame->frameData()[i] = static_cast<uint8_t>(random());
+
+    return frame;
+}
+
+// Compares the result of |func| with the result of the table translator.
+void testKernel(TranslateFunc func,
+                const desktop::PixelFormat& source_format,
+                const desktop::PixelFormat& target_format)
+{
+    std::unique_ptr<desktop::Frame> source = createRandomFrame(source_format);
+    std::unique_ptr<desktop::Frame> expected =
+        desktop::FrameAligned::create(kFrameSize, target_format, kAlignment);
+    std::unique_ptr<desktop::Frame> actual =
+        desktop::FrameAligned::create(kFrameSize, target_format, kAlignment);
+
+    PixelTranslator::createTable(source_format, target_format)->translate(
+        source->frameData(), source->stride(),
+        expected->frameData(), expected->stride(),
+        kFrameSize.width(), kFrameSize.height());
+
+    func(source->frameData(), source->stride(),
+         actual->frameData(), actual->stride(),
+         kFrameSize.width(), kFrameSize.height());
+
+    EXPECT_EQ(0, memcmp(expected->frameData(), actual->frameData(),
+                        expected->stride() * kFrameSize.height()));
+}
+
+} // namespace
+
+TEST(pixel_translator, sse2_kernels)
+{
+    if (!libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+        return;
+
+    testKernel(translateARGBToRGB565_SSE2,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB565());
+    testKernel(translateARGBToRGB332_SSE2,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB332());
+    testKernel(translateRGB565ToARGB_SSE2,
+               desktop::PixelFormat::RGB565(), desktop::PixelFormat::ARGB());
+}
+
+TEST(pixel_translator, sse3_kernels)
+{
+    if (!libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+        return;
+
+    testKernel(translateARGBToRGB565_SSE3,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB565());
+    testKernel(translateARGBToRGB332_SSE3,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB332());
+}
+
+TEST(pixel_translator, avx2_kernels)
+{
+    if (!libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+        return;
+
+    testKernel(translateARGBToRGB565_AVX2,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB565());
+    testKernel(translateARGBToRGB332_AVX2,
+               desktop::PixelFormat::ARGB(), desktop::PixelFormat::RGB332());
+    testKernel(translateRGB565ToARGB_AVX2,
+               desktop::PixelFormat::RGB565(), desktop::PixelFormat::ARGB());
+}
+
+TEST(pixel_translator, partial_blocks)
+{
+    const desktop::PixelFormat source_format = desktop::PixelFormat::ARGB();
+    const desktop::PixelFormat target_format = desktop::PixelFormat::RGB565();
+
+    std::unique_ptr<desktop::Frame> source = createRandomFrame(source_format);
+
+    std::unique_ptr<PixelTranslator> translator =
+        PixelTranslator::create(source_format, target_format);
+    std::unique_ptr<PixelTranslator> table_translator =
+        PixelTranslator::createTable(source_format, target_format);
+
+    // The widths with and without the blocks of the kernels and with the rest.
+    for (int width : { 1, 15, 16, 37, 255 })
+    {
+        std::unique_ptr<desktop::Frame> expected =
+            desktop::FrameAligned::create(kFrameSize, target_format, kAlignment);
+        std::unique_ptr<desktop::Frame> actual =
+            desktop::FrameAligned::create(kFrameSize, target_format, kAlignment);
+
+        memset(expected->frameData(), 0, expected->stride() * kFrameSize.height());
+        memset(actual->frameData(), 0, actual->stride() * kFrameSize.height());
+
+        table_translator->translate(source->frameData(), source->stride(),
+                                    expected->frameData(), expected->stride(),
+                                    width, kFrameSize.height());
+
+        translator->translate(source->frameData(), source->stride(),
+                              actual->frameData(), actual->stride(),
+                              width, kFrameSize.height());
+
+        EXPECT_EQ(0, memcmp(expected->frameData(), actual->frameData(),
+                            expected->stride() * kFrameSize.height()));
+    }
+}
+
+} // namespace codec
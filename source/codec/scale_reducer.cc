@@ -20,7 +20,10 @@
 
 #include <libyuv/scale_argb.h>
 
+#include <algorithm>
+
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "desktop/desktop_frame_aligned.h"
 
 namespace codec {
@@ -31,107 +34,181 @@ const int kMinScaleFactor = 50;
 const int kMaxScaleFactor = 100;
 const int kDefScaleFactor = 100;
 
-int div(int num, int div)
+// The scaled rectangles are divided into bands of this number of rows which are scaled in
+// parallel. The smaller updates are scaled by the calling thread.
+const int kBandHeight = 32;
+const int64_t kMinParallelPixels = 256 * 256;
+
+int div(int64_t num, int64_t div)
 {
-    return (num + div - 1) / div;
+    return static_cast<int>((num + div - 1) / div);
 }
 
-QSize scaledSize(const QSize& source_size, int scale_factor)
+} // namespace
+
+ScaleReducer::ScaleReducer(int scale_factor, const QSize& max_size)
+    : scale_factor_(scale_factor),
+      max_size_(max_size)
 {
-    return QSize(div(source_size.width() * scale_factor, kDefScaleFactor),
-                 div(source_size.height() * scale_factor, kDefScaleFactor));
+    // Nothing
 }
 
-QRect scaledRect(const QRect& source_rect, int scale_factor)
-{
-    int left = (source_rect.left() * scale_factor) / kDefScaleFactor;
-    int top = (source_rect.top() * scale_factor) / kDefScaleFactor;
-    int right = div(source_rect.right() * scale_factor, kDefScaleFactor);
-    int bottom = div(source_rect.bottom() * scale_factor, kDefScaleFactor);
+ScaleReducer::~ScaleReducer() = default;
 
-    static const int kPadding = 1;
+// static
+ScaleReducer* ScaleReducer::create(int scale_factor, const QSize& max_size)
+{
+    if (scale_factor < kMinScaleFactor || scale_factor > kMaxScaleFactor)
+        return nullptr;
 
-    return QRect(QPoint(left - kPadding, top - kPadding),
-                 QPoint(right + kPadding, bottom + kPadding));
+    return new ScaleReducer(scale_factor, max_size);
 }
 
-} // namespace
+QSize ScaleReducer::scaledSize(const QSize& source_size) const
+{
+    QSize size(div(int64_t(source_size.width()) * scale_factor_, kDefScaleFactor),
+               div(int64_t(source_size.height()) * scale_factor_, kDefScaleFactor));
+
+    if (!max_size_.isEmpty() &&
+        (size.width() > max_size_.width() || size.height() > max_size_.height()))
+    {
+        size.scale(max_size_, Qt::KeepAspectRatio);
+    }
+
+    return size.expandedTo(QSize(1, 1));
+}
 
-ScaleReducer::ScaleReducer(int scale_factor)
-    : scale_factor_(scale_factor)
+QRect ScaleReducer::scaledRect(const QRect& source_rect) const
 {
-    // Nothing
+    const QSize& source_size = screen_settings_tracker_.screenSize();
+    const QSize& scaled_size = scaled_frame_->size();
+
+    const int left = static_cast<int>(
+        int64_t(source_rect.left()) * scaled_size.width() / source_size.width());
+    const int top = static_cast<int>(
+        int64_t(source_rect.top()) * scaled_size.height() / source_size.height());
+    const int right = div(
+        int64_t(source_rect.right() + 1) * scaled_size.width(), source_size.width());
+    const int bottom = div(
+        int64_t(source_rect.bottom() + 1) * scaled_size.height(), source_size.height());
+
+    // The filter uses the pixels around the rectangle.
+    static const int kPadding = 1;
+
+    return QRect(QPoint(left - kPadding, top - kPadding),
+                 QPoint(right - 1 + kPadding, bottom - 1 + kPadding));
 }
 
-// static
-ScaleReducer* ScaleReducer::create(int scale_factor)
+void ScaleReducer::scaleBand(const desktop::Frame* source_frame, const QRect& band)
 {
-    if (scale_factor < kMinScaleFactor || scale_factor > kMaxScaleFactor)
-        return nullptr;
+    const QSize& source_size = source_frame->size();
+    const QSize& scaled_size = scaled_frame_->size();
 
-    return new ScaleReducer(scale_factor);
+    int height = band.height();
+
+    // libyuv reads the source rows below the frame for the last row of the image when the image
+    // is clipped. The last row is the box of the source rows from |source_top| to the bottom of
+    // the frame, so it is scaled separately from these rows without the vertical clipping.
+    const bool has_last_row = band.bottom() == scaled_size.height() - 1;
+    if (has_last_row)
+        --height;
+
+    if (height > 0 && libyuv::ARGBScaleClip(source_frame->frameData(),
+                                            source_frame->stride(),
+                                            source_size.width(),
+                                            source_size.height(),
+                                            scaled_frame_->frameData(),
+                                            scaled_frame_->stride(),
+                                            scaled_size.width(),
+                                            scaled_size.height(),
+                                            band.x(),
+                                            band.y(),
+                                            band.width(),
+                                            height,
+                                            libyuv::kFilterBox) == -1)
+    {
+        LOG(LS_WARNING) << "libyuv::ARGBScaleClip failed";
+    }
+
+    if (!has_last_row)
+        return;
+
+    const int source_top = static_cast<int>(
+        int64_t(scaled_size.height() - 1) * source_size.height() / scaled_size.height());
+
+    if (libyuv::ARGBScaleClip(source_frame->frameDataAtPos(0, source_top),
+                              source_frame->stride(),
+                              source_size.width(),
+                              source_size.height() - source_top,
+                              scaled_frame_->frameDataAtPos(0, band.bottom()),
+                              scaled_frame_->stride(),
+                              scaled_size.width(),
+                              1,
+                              band.x(),
+                              0,
+                              band.width(),
+                              1,
+                              libyuv::kFilterBox) == -1)
+    {
+        LOG(LS_WARNING) << "libyuv::ARGBScaleClip failed";
+    }
 }
 
 const desktop::Frame* ScaleReducer::scaleFrame(const desktop::Frame* source_frame)
 {
     DCHECK(source_frame);
-    DCHECK(!source_frame->constUpdatedRegion().isEmpty());
     DCHECK(source_frame->format() == desktop::PixelFormat::ARGB());
 
-    if (scale_factor_ == kDefScaleFactor)
-        return source_frame;
-
     if (screen_settings_tracker_.isSizeChanged(source_frame->size()))
         scaled_frame_.reset();
 
     if (!scaled_frame_)
     {
-        QSize size = scaledSize(source_frame->size(), scale_factor_);
+        const QSize size = scaledSize(source_frame->size());
+        if (size == source_frame->size())
+            return source_frame;
 
         scaled_frame_ = desktop::FrameAligned::create(size, source_frame->format(), 32);
         if (!scaled_frame_)
             return nullptr;
     }
 
-    const QSize& source_size = source_frame->size();
-    const QSize& scaled_size = scaled_frame_->size();
-
-    QRect scaled_frame_rect = QRect(QPoint(), scaled_size);
-    QRegion* updated_region = scaled_frame_->updatedRegion();
+    const QRect scaled_frame_rect = QRect(QPoint(), scaled_frame_->size());
+    desktop::DirtyRegion* updated_region = scaled_frame_->updatedRegion();
 
-    *updated_region = QRegion();
+    updated_region->clear();
 
     for (const auto& rect : source_frame->constUpdatedRegion())
+        updated_region->add(scaledRect(rect).intersected(scaled_frame_rect));
+
+    int64_t pixel_count = 0;
+    bands_.clear();
+
+    for (const auto& rect : *updated_region)
     {
-        QRect scaled_rect = scaledRect(rect, scale_factor_).intersected(scaled_frame_rect);
-
-#if 1
-        int height = scaled_rect.height();
-
-        // FIXME: A bug in libyuv? If the coordinate |bottom| of rectangle is equal to coordinate
-        // |bottom| in the frame, then a crash occurs.
-        if (scaled_rect.bottom() == scaled_frame_rect.bottom())
-            height -= 1;
-#endif
-
-        if (libyuv::ARGBScaleClip(source_frame->frameData(),
-                                  source_frame->stride(),
-                                  source_size.width(),
-                                  source_size.height(),
-                                  scaled_frame_->frameData(),
-                                  scaled_frame_->stride(),
-                                  scaled_size.width(),
-                                  scaled_size.height(),
-                                  scaled_rect.x(),
-                                  scaled_rect.y(),
-                                  scaled_rect.width(),
-                                  height,
-                                  libyuv::kFilterBox) == -1)
+        pixel_count += int64_t(rect.width()) * rect.height();
+
+        for (int top = rect.top(); top <= rect.bottom(); top += kBandHeight)
         {
-            LOG(LS_WARNING) << "libyuv::ARGBScaleClip failed";
+            bands_.emplace_back(rect.left(), top, rect.width(),
+                                std::min(kBandHeight, rect.bottom() + 1 - top));
         }
+    }
+
+    if (pixel_count < kMinParallelPixels)
+    {
+        for (const auto& band : bands_)
+            scaleBand(source_frame, band);
+    }
+    else
+    {
+        if (!thread_pool_)
+            thread_pool_ = std::make_unique<base::ThreadPool>();
 
-        *updated_region += scaled_rect;
+        thread_pool_->parallelFor(static_cast<int>(bands_.size()), [&](int index)
+        {
+            scaleBand(source_frame, bands_[index]);
+        });
     }
 
     scaled_frame_->setTopLeft(source_frame->topLeft());
@@ -19,34 +19,56 @@
 #ifndef CODEC__SCALE_REDUCER_H
 #define CODEC__SCALE_REDUCER_H
 
+#include <QRect>
+
 #include <memory>
+#include <vector>
 
 #include "base/macros_magic.h"
 #include "desktop/screen_settings_tracker.h"
 
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace desktop {
 class Frame;
 } // namespace aspia
 
 namespace codec {
 
+// Reduces the screen before the encoding. The size of the image is |scale_factor| percent of the
+// screen size. If |max_size| is not empty, the image is reduced further to fit in it keeping the
+// aspect ratio (for example, the size of the client window). The image is never enlarged.
 class ScaleReducer
 {
 public:
-    ~ScaleReducer() = default;
+    ~ScaleReducer();
 
-    static ScaleReducer* create(int scale_factor);
+    static ScaleReducer* create(int scale_factor, const QSize& max_size = QSize());
 
+    // Returns |source_frame| if the image has the size of the screen.
     const desktop::Frame* scaleFrame(const desktop::Frame* source_frame);
 
 protected:
-    explicit ScaleReducer(int scale_factor);
+    ScaleReducer(int scale_factor, const QSize& max_size);
 
 private:
+    QSize scaledSize(const QSize& source_size) const;
+    QRect scaledRect(const QRect& source_rect) const;
+    void scaleBand(const desktop::Frame* source_frame, const QRect& band);
+
     const int scale_factor_;
+    const QSize max_size_;
+
     std::unique_ptr<desktop::Frame> scaled_frame_;
     desktop::ScreenSettingsTracker screen_settings_tracker_;
 
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
+    // The bands of the scaled rectangles of the current frame.
+    std::vector<QRect> bands_;
+
     DISALLOW_COPY_AND_ASSIGN(ScaleReducer);
 };
 
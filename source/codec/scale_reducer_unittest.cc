@@ -0,0 +1,112 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/scale_reducer.h"
+#include "desktop/frame_test_util.h"
+
+#include <memory>
+
+namespace codec {
+
+namespace {
+
+const uint32_t kColor = 0xFF336699;
+
+std::unique_ptr<desktop::Frame> createFrame(const QSize& size)
+{
+    std::unique_ptr<desktop::Frame> frame = desktop::createTestFrame(size);
+
+    for (int y = 0; y < size.height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+        std::fill(row, row + size.width(), kColor);
+    }
+
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+    return frame;
+}
+
+// Returns true if all pixels of the frame have |kColor|.
+bool isFilled(const desktop::Frame& frame)
+{
+    for (int y = 0; y < frame.size().height(); ++y)
+    {
+        const uint32_t* row = reinterpret_cast<const uint32_t*>(frame.frameDataAtPos(0, y));
+
+        for (int x = 0; x < frame.size().width(); ++x)
+        {
+            if (row[x] != kColor)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+TEST(scale_reducer, scaled_size)
+{
+    std::unique_ptr<desktop::Frame> source_frame = createFrame(QSize(1920, 1080));
+
+    std::unique_ptr<ScaleReducer> reducer(ScaleReducer::create(100));
+    EXPECT_EQ(source_frame.get(), reducer->scaleFrame(source_frame.get()));
+
+    reducer.reset(ScaleReducer::create(50));
+    EXPECT_EQ(QSize(960, 540), reducer->scaleFrame(source_frame.get())->size());
+
+    // The image fits in the window keeping the aspect ratio.
+    reducer.reset(ScaleReducer::create(100, QSize(1280, 1024)));
+    EXPECT_EQ(QSize(1280, 720), reducer->scaleFrame(source_frame.get())->size());
+
+    reducer.reset(ScaleReducer::create(50, QSize(1280, 1024)));
+    EXPECT_EQ(QSize(960, 540), reducer->scaleFrame(source_frame.get())->size());
+
+    // The image is not enlarged.
+    reducer.reset(ScaleReducer::create(100, QSize(2560, 1440)));
+    EXPECT_EQ(source_frame.get(), reducer->scaleFrame(source_frame.get()));
+
+    EXPECT_EQ(nullptr, ScaleReducer::create(10));
+}
+
+TEST(scale_reducer, whole_frame)
+{
+    // The sizes are not divisible by the scale and the bands have different heights.
+    for (const auto& max_size : { QSize(1000, 1000), QSize(333, 333), QSize(150, 77) })
+    {
+        std::unique_ptr<desktop::Frame> source_frame = createFrame(QSize(1366, 768));
+        std::unique_ptr<ScaleReducer> reducer(ScaleReducer::create(100, max_size));
+
+        const desktop::Frame* scaled_frame = reducer->scaleFrame(source_frame.get());
+        ASSERT_NE(nullptr, scaled_frame);
+
+        // All rows are scaled, including the last one.
+        EXPECT_EQ(desktop::DirtyRegion(QRect(QPoint(), scaled_frame->size())),
+                  scaled_frame->constUpdatedRegion());
+        EXPECT_TRUE(isFilled(*scaled_frame));
+
+        // A frame without changes has no changes after the scaling.
+        source_frame->updatedRegion()->clear();
+        scaled_frame = reducer->scaleFrame(source_frame.get());
+        EXPECT_TRUE(scaled_frame->constUpdatedRegion().isEmpty());
+    }
+}
+
+} // namespace codec
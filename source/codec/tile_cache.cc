@@ -0,0 +1,193 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/tile_cache.h"
+
+#include "base/logging.h"
+#include "build/build_config.h"
+
+#include <cstring>
+
+namespace codec {
+
+namespace {
+
+FORCEINLINE uint64_t mix(uint64_t hash, uint64_t value)
+{
+    hash ^= value * 0x9E3779B97F4A7C15ULL;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * 0xC2B2AE3D27D4EB4FULL;
+}
+
+} // namespace
+
+const int TileCache::kTileSize;
+const size_t TileCache::kMinCacheSize;
+const size_t TileCache::kMaxCacheSize;
+const size_t TileCache::kInvalidIndex;
+
+TileCache::TileCache(size_t cache_size, int bytes_per_pixel)
+    : cache_size_(cache_size),
+      bytes_per_pixel_(bytes_per_pixel),
+      bytes_per_row_(kTileSize * bytes_per_pixel)
+{
+    DCHECK(isValidCacheSize(cache_size));
+    slots_.resize(cache_size_);
+}
+
+// static
+bool TileCache::isValidCacheSize(size_t size)
+{
+    return size >= kMinCacheSize && size <= kMaxCacheSize;
+}
+
+// static
+uint64_t TileCache::tileHash(const uint8_t* data, int stride, int bytes_per_pixel)
+{
+    // A fast non-cryptographic hash. Collisions are harmless: the host compares the pixels of
+    // the tiles with the same hash before sending a reference to the cache.
+    const int words_per_row = (kTileSize * bytes_per_pixel) / sizeof(uint64_t);
+    uint64_t hash = 0;
+
+    for (int y = 0; y < kTileSize; ++y)
+    {
+        const uint64_t* row = reinterpret_cast<const uint64_t*>(data);
+
+        for (int x = 0; x < words_per_row; ++x)
+            hash = mix(hash, row[x]);
+
+        data += stride;
+    }
+
+    return hash;
+}
+
+size_t TileCache::find(uint64_t hash, const uint8_t* data, int stride)
+{
+    auto result = index_.find(hash);
+    if (result == index_.end())
+        return kInvalidIndex;
+
+    const size_t index = result->second;
+    Slot& slot = slots_[index];
+
+    if (!isSlotEqual(slot, data, stride))
+        return kInvalidIndex;
+
+    // Move the slot to the end of the list (most recently used).
+    lru_.splice(lru_.end(), lru_, slot.lru_position);
+    return index;
+}
+
+size_t TileCache::add(uint64_t hash, const uint8_t* data, int stride)
+{
+    size_t index;
+
+    if (lru_.size() < cache_size_)
+    {
+        index = lru_.size();
+        slots_[index].lru_position = lru_.insert(lru_.end(), index);
+    }
+    else
+    {
+        // Evict the least recently used tile.
+        index = lru_.front();
+        lru_.splice(lru_.end(), lru_, lru_.begin());
+
+        auto evicted = index_.find(slots_[index].hash);
+        if (evicted != index_.end() && evicted->second == index)
+            index_.erase(evicted);
+    }
+
+    Slot& slot = slots_[index];
+
+    copyToSlot(&slot, data, stride);
+    slot.hash = hash;
+
+    // On a collision the old tile with the same hash is no longer found.
+    index_[hash] = index;
+    return index;
+}
+
+bool TileCache::store(size_t index, const uint8_t* data, int stride)
+{
+    if (index >= cache_size_)
+    {
+        LOG(LS_WARNING) << "Invalid tile cache index: " << index;
+        return false;
+    }
+
+    copyToSlot(&slots_[index], data, stride);
+    return true;
+}
+
+bool TileCache::load(size_t index, uint8_t* data, int stride) const
+{
+    if (index >= cache_size_ || !slots_[index].data)
+    {
+        LOG(LS_WARNING) << "Invalid tile cache index: " << index;
+        return false;
+    }
+
+    const uint8_t* source = slots_[index].data.get();
+
+    for (int y = 0; y < kTileSize; ++y)
+    {
+        memcpy(data, source, bytes_per_row_);
+        source += bytes_per_row_;
+        data += stride;
+    }
+
+    return true;
+}
+
+void TileCache::copyToSlot(Slot* slot, const uint8_t* data, int stride)
+{
+    if (!slot->data)
+        slot->data = std::make_unique<uint8_t[]>(bytes_per_row_ * kTileSize);
+
+    uint8_t* dest = slot->data.get();
+
+    for (int y = 0; y < kTileSize; ++y)
+    {
+        memcpy(dest, data, bytes_per_row_);
+        dest += bytes_per_row_;
+        data += stride;
+    }
+}
+
+bool TileCache::isSlotEqual(const Slot& slot, const uint8_t* data, int stride) const
+{
+    if (!slot.data)
+        return false;
+
+    const uint8_t* source = slot.data.get();
+
+    for (int y = 0; y < kTileSize; ++y)
+    {
+        if (memcmp(source, data, bytes_per_row_) != 0)
+            return false;
+
+        source += bytes_per_row_;
+        data += stride;
+    }
+
+    return true;
+}
+
+} // namespace codec
@@ -0,0 +1,99 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__TILE_CACHE_H
+#define CODEC__TILE_CACHE_H
+
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace codec {
+
+// Cache of screen tiles (kTileSize x kTileSize pixels) addressed by content. The host and the
+// client have the caches of the same size. The host selects the slot for each new tile and sends
+// the slot index to the client, so the client does not need to know the eviction policy.
+//
+// On the host side, the methods find() and add() are used. On the client side, the methods
+// store() and load() are used.
+class TileCache
+{
+public:
+    static const int kTileSize = 64;
+    static const size_t kMinCacheSize = 16;
+    static const size_t kMaxCacheSize = 4096; // 64 MB for 32 bits per pixel.
+    static const size_t kInvalidIndex = std::numeric_limits<size_t>::max();
+
+    TileCache(size_t cache_size, int bytes_per_pixel);
+    ~TileCache() = default;
+
+    static bool isValidCacheSize(size_t size);
+
+    // Calculates the hash of the tile at |data|.
+    static uint64_t tileHash(const uint8_t* data, int stride, int bytes_per_pixel);
+
+    // Looks for the tile with hash |hash| and pixels |data| in the cache. Returns the index of
+    // the slot or kInvalidIndex if the tile is not in the cache.
+    size_t find(uint64_t hash, const uint8_t* data, int stride);
+
+    // Adds the tile to the cache. The least recently used tile is evicted if the cache is full.
+    // Returns the index of the slot that contains the tile now.
+    size_t add(uint64_t hash, const uint8_t* data, int stride);
+
+    // Stores the tile to slot |index|. Returns false if the index is out of range.
+    bool store(size_t index, const uint8_t* data, int stride);
+
+    // Copies the tile from slot |index| to |data|. Returns false if the index is out of range or
+    // the slot is empty.
+    bool load(size_t index, uint8_t* data, int stride) const;
+
+    size_t size() const { return cache_size_; }
+    int bytesPerPixel() const { return bytes_per_pixel_; }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<uint8_t[]> data;
+        uint64_t hash = 0;
+        std::list<size_t>::iterator lru_position;
+    };
+
+    void copyToSlot(Slot* slot, const uint8_t* data, int stride);
+    bool isSlotEqual(const Slot& slot, const uint8_t* data, int stride) const;
+
+    const size_t cache_size_;
+    const int bytes_per_pixel_;
+    const int bytes_per_row_;
+
+    std::vector<Slot> slots_;
+
+    // Slot indexes from the least recently used to the most recently used (host side only).
+    std::list<size_t> lru_;
+    std::unordered_map<uint64_t, size_t> index_;
+
+    DISALLOW_COPY_AND_ASSIGN(TileCache);
+};
+
+} // namespace codec
+
+#endif // CODEC__TILE_CACHE_H
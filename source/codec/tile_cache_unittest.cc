@@ -0,0 +1,139 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/tile_cache.h"
+
+#include <cstring>
+#include <random>
+
+namespace codec {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+const int kTileCount = 24;
+const int kStride = kTileCount * TileCache::kTileSize * kBytesPerPixel;
+
+// Creates an image of |kTileCount| tiles in a row filled with random pixels.
+std::vector<uint8_t> createImage(uint32_t seed)
+{
+    std::vector<uint8_t> image(kStride * TileCache::kTileSize);
+    std::mt19937 random(seed);
+
+    for (auto& value : image)
+        value = static_cast<uint8_t>(random());
+
+    return image;
+}
+
+const uint8_t* tileData(const std::vector<uint8_t>& image, int tile)
+{
+    return image.data() + tile * TileCache::kTileSize * kBytesPerPixel;
+}
+
+bool isEqualTile(const uint8_t* first, int first_stride, const uint8_t* second, int second_stride)
+{
+    for (int y = 0; y < TileCache::kTileSize; ++y)
+    {
+        if (memcmp(first, second, TileCache::kTileSize * kBytesPerPixel) != 0)
+            return false;
+
+        first += first_stride;
+        second += second_stride;
+    }
+
+    return true;
+}
+
+size_t findTile(TileCache* cache, const uint8_t* data)
+{
+    return cache->find(TileCache::tileHash(data, kStride, kBytesPerPixel), data, kStride);
+}
+
+} // namespace
+
+TEST(TileCacheTest, find_and_load)
+{
+    TileCache host_cache(TileCache::kMinCacheSize, kBytesPerPixel);
+    TileCache client_cache(TileCache::kMaxCacheSize, kBytesPerPixel);
+
+    std::vector<uint8_t> image = createImage(1);
+
+    for (int tile = 0; tile < static_cast<int>(TileCache::kMinCacheSize); ++tile)
+    {
+        const uint8_t* data = tileData(image, tile);
+
+        EXPECT_EQ(findTile(&host_cache, data), TileCache::kInvalidIndex);
+
+        size_t index = host_cache.add(
+            TileCache::tileHash(data, kStride, kBytesPerPixel), data, kStride);
+        ASSERT_TRUE(client_cache.store(index, data, kStride));
+    }
+
+    const int kLoadStride = TileCache::kTileSize * kBytesPerPixel;
+    std::vector<uint8_t> loaded(kLoadStride * TileCache::kTileSize);
+
+    for (int tile = 0; tile < static_cast<int>(TileCache::kMinCacheSize); ++tile)
+    {
+        const uint8_t* data = tileData(image, tile);
+
+        size_t index = findTile(&host_cache, data);
+        ASSERT_NE(index, TileCache::kInvalidIndex);
+        ASSERT_TRUE(client_cache.load(index, loaded.data(), kLoadStride));
+        EXPECT_TRUE(isEqualTile(loaded.data(), kLoadStride, data, kStride));
+    }
+}
+
+TEST(TileCacheTest, lru_eviction)
+{
+    TileCache cache(TileCache::kMinCacheSize, kBytesPerPixel);
+    std::vector<uint8_t> image = createImage(2);
+
+    for (int tile = 0; tile < static_cast<int>(TileCache::kMinCacheSize); ++tile)
+    {
+        const uint8_t* data = tileData(image, tile);
+        cache.add(TileCache::tileHash(data, kStride, kBytesPerPixel), data, kStride);
+    }
+
+    // Tile 0 becomes the most recently used, so tile 1 is evicted first.
+    EXPECT_NE(findTile(&cache, tileData(image, 0)), TileCache::kInvalidIndex);
+
+    const uint8_t* data = tileData(image, TileCache::kMinCacheSize);
+    cache.add(TileCache::tileHash(data, kStride, kBytesPerPixel), data, kStride);
+
+    EXPECT_NE(findTile(&cache, tileData(image, 0)), TileCache::kInvalidIndex);
+    EXPECT_EQ(findTile(&cache, tileData(image, 1)), TileCache::kInvalidIndex);
+    EXPECT_NE(findTile(&cache, data), TileCache::kInvalidIndex);
+}
+
+TEST(TileCacheTest, invalid_index)
+{
+    TileCache cache(TileCache::kMinCacheSize, kBytesPerPixel);
+    std::vector<uint8_t> image = createImage(3);
+    std::vector<uint8_t> loaded(kStride * TileCache::kTileSize);
+
+    // The slot is empty.
+    EXPECT_FALSE(cache.load(0, loaded.data(), kStride));
+
+    EXPECT_FALSE(cache.store(TileCache::kMinCacheSize, tileData(image, 0), kStride));
+    EXPECT_FALSE(cache.load(TileCache::kMinCacheSize, loaded.data(), kStride));
+}
+
+} // namespace codec
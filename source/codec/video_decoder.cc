@@ -18,8 +18,13 @@
 
 #include "codec/video_decoder.h"
 
+#include "base/logging.h"
+#include "codec/video_decoder_hybrid.h"
+#include "codec/video_decoder_palette.h"
 #include "codec/video_decoder_vpx.h"
 #include "codec/video_decoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
 
 namespace codec {
 
@@ -37,9 +42,41 @@ std::unique_ptr<VideoDecoder> VideoDecoder::create(proto::desktop::VideoEncoding
         case proto::desktop::VIDEO_ENCODING_VP9:
             return VideoDecoderVPX::createVP9();
 
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+            return VideoDecoderHybrid::create();
+
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+            return VideoDecoderPalette::create();
+
         default:
             return nullptr;
     }
 }
 
+// static
+bool VideoDecoder::applyCopyRects(const proto::desktop::VideoPacket& packet,
+                                  desktop::Frame* frame)
+{
+    const QRect frame_rect(QPoint(), frame->size());
+
+    for (int i = 0; i < packet.copy_rect_size(); ++i)
+    {
+        const proto::desktop::CopyRect& copy_rect = packet.copy_rect(i);
+
+        const QRect source_rect = VideoUtil::fromVideoRect(copy_rect.source_rect());
+        const QPoint dest_pos(copy_rect.dest_x(), copy_rect.dest_y());
+
+        if (!frame_rect.contains(source_rect) ||
+            !frame_rect.contains(QRect(dest_pos, source_rect.size())))
+        {
+            LOG(LS_WARNING) << "The copy rectangle is outside the screen area";
+            return false;
+        }
+
+        frame->copyRect(source_rect, dest_pos);
+    }
+
+    return true;
+}
+
 } // namespace codec
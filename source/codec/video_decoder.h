@@ -37,6 +37,11 @@ public:
     static std::unique_ptr<VideoDecoder> create(proto::desktop::VideoEncoding encoding);
 
     virtual bool decode(const proto::desktop::VideoPacket& packet, desktop::Frame* frame) = 0;
+
+protected:
+    // Copies the rectangles listed in |copy_rect| field of the packet inside the frame. Returns
+    // false if any of the rectangles is outside the frame.
+    static bool applyCopyRects(const proto::desktop::VideoPacket& packet, desktop::Frame* frame);
 };
 
 } // namespace codec
@@ -0,0 +1,60 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder_hybrid.h"
+
+#include "codec/video_decoder_vpx.h"
+#include "codec/video_decoder_zstd.h"
+
+namespace codec {
+
+VideoDecoderHybrid::VideoDecoderHybrid()
+    : lossless_decoder_(VideoDecoderZstd::create())
+{
+    // Nothing
+}
+
+VideoDecoderHybrid::~VideoDecoderHybrid() = default;
+
+// static
+std::unique_ptr<VideoDecoderHybrid> VideoDecoderHybrid::create()
+{
+    return std::unique_ptr<VideoDecoderHybrid>(new VideoDecoderHybrid());
+}
+
+bool VideoDecoderHybrid::decode(const proto::desktop::VideoPacket& packet,
+                                desktop::Frame* frame)
+{
+    if (!lossless_decoder_->decode(packet, frame))
+        return false;
+
+    if (!packet.has_lossy())
+        return true;
+
+    if (!lossy_decoder_)
+        lossy_decoder_ = VideoDecoderVPX::createVP9();
+
+    lossy_packet_.Clear();
+    lossy_packet_.set_encoding(proto::desktop::VIDEO_ENCODING_VP9);
+    *lossy_packet_.mutable_dirty_rect() = packet.lossy().dirty_rect();
+    lossy_packet_.set_data(packet.lossy().data());
+
+    return lossy_decoder_->decode(lossy_packet_, frame);
+}
+
+} // namespace codec
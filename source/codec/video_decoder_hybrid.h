@@ -0,0 +1,55 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_DECODER_HYBRID_H
+#define CODEC__VIDEO_DECODER_HYBRID_H
+
+#include "base/macros_magic.h"
+#include "codec/video_decoder.h"
+
+namespace codec {
+
+class VideoDecoderVPX;
+class VideoDecoderZstd;
+
+// Decodes the Zstd part of the packet and then the VP9 part. The parts have different
+// rectangles, so the VP9 pixels are not overwritten.
+class VideoDecoderHybrid : public VideoDecoder
+{
+public:
+    ~VideoDecoderHybrid();
+
+    static std::unique_ptr<VideoDecoderHybrid> create();
+
+    bool decode(const proto::desktop::VideoPacket& packet, desktop::Frame* frame) override;
+
+private:
+    VideoDecoderHybrid();
+
+    std::unique_ptr<VideoDecoderZstd> lossless_decoder_;
+
+    // Created when the first packet with the VP9 part is received.
+    std::unique_ptr<VideoDecoderVPX> lossy_decoder_;
+    proto::desktop::VideoPacket lossy_packet_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoDecoderHybrid);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_DECODER_HYBRID_H
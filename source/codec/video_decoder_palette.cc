@@ -0,0 +1,101 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_decoder_palette.h"
+
+#include "base/logging.h"
+#include "codec/palette_tile.h"
+#include "codec/video_decoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame.h"
+
+namespace codec {
+
+VideoDecoderPalette::VideoDecoderPalette()
+    : zstd_decoder_(VideoDecoderZstd::create())
+{
+    // Nothing
+}
+
+VideoDecoderPalette::~VideoDecoderPalette() = default;
+
+// static
+std::unique_ptr<VideoDecoderPalette> VideoDecoderPalette::create()
+{
+    return std::unique_ptr<VideoDecoderPalette>(new VideoDecoderPalette());
+}
+
+bool VideoDecoderPalette::decode(const proto::desktop::VideoPacket& packet,
+                                 desktop::Frame* frame)
+{
+    if (!zstd_decoder_->decode(packet, frame))
+        return false;
+
+    if (!packet.has_palette())
+        return true;
+
+    if (frame->format().bytesPerPixel() != 4)
+    {
+        LOG(LS_WARNING) << "Palette tiles require 32 bits per pixel";
+        return false;
+    }
+
+    const proto::desktop::PaletteVideoData& palette = packet.palette();
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(palette.data().data());
+    size_t data_size = palette.data().size();
+
+    const QRect frame_rect(QPoint(), frame->size());
+
+    for (int i = 0; i < palette.tile_size(); ++i)
+    {
+        const QRect tile_rect = VideoUtil::fromVideoRect(palette.tile(i));
+
+        if (tile_rect.isEmpty() || !frame_rect.contains(tile_rect) ||
+            tile_rect.width() > PaletteTile::kMaxTileSize ||
+            tile_rect.height() > PaletteTile::kMaxTileSize)
+        {
+            LOG(LS_WARNING) << "Invalid palette tile rectangle";
+            return false;
+        }
+
+        const size_t tile_size = PaletteTile::decode(data,
+                                                     data_size,
+                                                     tile_rect.size(),
+                                                     frame->frameDataAtPos(tile_rect.topLeft()),
+                                                     frame->stride());
+        if (!tile_size)
+        {
+            LOG(LS_WARNING) << "Invalid palette tile data";
+            return false;
+        }
+
+        data += tile_size;
+        data_size -= tile_size;
+    }
+
+    if (data_size)
+    {
+        LOG(LS_WARNING) << "Unexpected palette data after the last tile";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace codec
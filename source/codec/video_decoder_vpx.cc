@@ -18,10 +18,11 @@
 
 #include "codec/video_decoder_vpx.h"
 
-#include <libyuv/convert_from.h>
-#include <libyuv/convert_argb.h>
+#include <algorithm>
+#include <cstring>
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "codec/video_util.h"
 #include "desktop/desktop_frame.h"
 
@@ -29,72 +30,39 @@ namespace codec {
 
 namespace {
 
-bool convertImage(const proto::desktop::VideoPacket& packet,
-                  vpx_image_t* image,
-                  desktop::Frame* frame)
-{
-    if (image->fmt != VPX_IMG_FMT_I420)
-        return false;
-
-    QRect frame_rect(QPoint(), frame->size());
-
-    uint8_t* y_data = image->planes[0];
-    uint8_t* u_data = image->planes[1];
-    uint8_t* v_data = image->planes[2];
-
-    int y_stride = image->stride[0];
-    int uv_stride = image->stride[1];
-
-    for (int i = 0; i < packet.dirty_rect_size(); ++i)
-    {
-        QRect rect = VideoUtil::fromVideoRect(packet.dirty_rect(i));
-
-        if (!frame_rect.contains(rect))
-        {
-            LOG(LS_WARNING) << "The rectangle is outside the screen area";
-            return false;
-        }
-
-        int y_offset = y_stride * rect.y() + rect.x();
-        int uv_offset = uv_stride * rect.y() / 2 + rect.x() / 2;
-
-        libyuv::I420ToARGB(y_data + y_offset, y_stride,
-                           u_data + uv_offset, uv_stride,
-                           v_data + uv_offset, uv_stride,
-                           frame->frameDataAtPos(rect.topLeft()),
-                           frame->stride(),
-                           rect.width(),
-                           rect.height());
-    }
-
-    return true;
-}
+// The decoder threads work on the VP9 tile columns or rows and on the VP8 token partitions. The
+// host creates at most 8 token partitions and uses 8 tile columns for the 4K frames.
+const int kMaxThreads = 8;
 
 } // namespace
 
 // static
-std::unique_ptr<VideoDecoderVPX> VideoDecoderVPX::createVP8()
+std::unique_ptr<VideoDecoderVPX> VideoDecoderVPX::createVP8(int thread_count)
 {
     return std::unique_ptr<VideoDecoderVPX>(
-        new VideoDecoderVPX(proto::desktop::VIDEO_ENCODING_VP8));
+        new VideoDecoderVPX(proto::desktop::VIDEO_ENCODING_VP8, thread_count));
 }
 
 // static
-std::unique_ptr<VideoDecoderVPX> VideoDecoderVPX::createVP9()
+std::unique_ptr<VideoDecoderVPX> VideoDecoderVPX::createVP9(int thread_count)
 {
     return std::unique_ptr<VideoDecoderVPX>(
-        new VideoDecoderVPX(proto::desktop::VIDEO_ENCODING_VP9));
+        new VideoDecoderVPX(proto::desktop::VIDEO_ENCODING_VP9, thread_count));
 }
 
-VideoDecoderVPX::VideoDecoderVPX(proto::desktop::VideoEncoding encoding)
+VideoDecoderVPX::VideoDecoderVPX(proto::desktop::VideoEncoding encoding, int thread_count)
+    : yuv_converter_(thread_count)
 {
     codec_.reset(new vpx_codec_ctx_t());
 
+    if (thread_count <= 0)
+        thread_count = std::min(base::ThreadPool::processorCount(), kMaxThreads);
+
     vpx_codec_dec_cfg_t config;
 
     config.w = 0;
     config.h = 0;
-    config.threads = 2;
+    config.threads = thread_count;
 
     vpx_codec_iface_t* algo;
 
@@ -115,9 +83,32 @@ VideoDecoderVPX::VideoDecoderVPX(proto::desktop::VideoEncoding encoding)
 
     int ret = vpx_codec_dec_init(codec_.get(), algo, &config, 0);
     CHECK_EQ(ret, VPX_CODEC_OK);
+
+#if defined(VPX_CTRL_VP9D_SET_ROW_MT)
+    // The rows of the frames with fewer tile columns than threads are decoded in parallel too.
+    if (encoding == proto::desktop::VIDEO_ENCODING_VP9 && thread_count > 1)
+    {
+        ret = vpx_codec_control(codec_.get(), VP9D_SET_ROW_MT, 1);
+        if (ret != VPX_CODEC_OK)
+            LOG(LS_WARNING) << "VP9D_SET_ROW_MT failed: " << ret;
+    }
+#endif
 }
 
 bool VideoDecoderVPX::decode(const proto::desktop::VideoPacket& packet, desktop::Frame* frame)
+{
+    // If the screen has not changed, the packet has only the top-off.
+    if (!packet.data().empty() && !decodeImage(packet, frame))
+        return false;
+
+    if (packet.has_top_off())
+        return decodeTopOff(packet.top_off(), frame);
+
+    return true;
+}
+
+bool VideoDecoderVPX::decodeImage(const proto::desktop::VideoPacket& packet,
+                                  desktop::Frame* frame)
 {
     // Do the actual decoding.
     vpx_codec_err_t ret =
@@ -155,4 +146,101 @@ bool VideoDecoderVPX::decode(const proto::desktop::VideoPacket& packet, desktop:
     return convertImage(packet, image, frame);
 }
 
+bool VideoDecoderVPX::convertImage(const proto::desktop::VideoPacket& packet,
+                                   const vpx_image_t* image,
+                                   desktop::Frame* frame)
+{
+    if (image->fmt != VPX_IMG_FMT_I420)
+        return false;
+
+    const QRect frame_rect(QPoint(), frame->size());
+
+    rects_.clear();
+
+    for (int i = 0; i < packet.dirty_rect_size(); ++i)
+    {
+        const QRect rect = VideoUtil::fromVideoRect(packet.dirty_rect(i));
+
+        if (!frame_rect.contains(rect))
+        {
+            LOG(LS_WARNING) << "The rectangle is outside the screen area";
+            return false;
+        }
+
+        rects_.push_back(rect);
+    }
+
+    yuv_converter_.convertFromI420(
+        image, rects_.data(), static_cast<int>(rects_.size()), frame);
+    return true;
+}
+
+bool VideoDecoderVPX::decodeTopOff(const proto::desktop::TopOffData& top_off,
+                                   desktop::Frame* frame)
+{
+    const QRect frame_rect(QPoint(), frame->size());
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+    size_t expected_size = 0;
+
+    for (int i = 0; i < top_off.dirty_rect_size(); ++i)
+    {
+        const QRect rect = VideoUtil::fromVideoRect(top_off.dirty_rect(i));
+
+        if (!frame_rect.contains(rect))
+        {
+            LOG(LS_WARNING) << "The top-off rectangle is outside the screen area";
+            return false;
+        }
+
+        expected_size += rect.width() * rect.height() * bytes_per_pixel;
+    }
+
+    if (!expected_size)
+        return true;
+
+    if (top_off_buffer_size_ < expected_size)
+    {
+        top_off_buffer_ = std::make_unique<uint8_t[]>(expected_size);
+        top_off_buffer_size_ = expected_size;
+    }
+
+    if (!top_off_stream_)
+        top_off_stream_.reset(ZSTD_createDStream());
+
+    const size_t ret = ZSTD_decompressDCtx(top_off_stream_.get(),
+                                           top_off_buffer_.get(),
+                                           expected_size,
+                                           top_off.data().data(),
+                                           top_off.data().size());
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_decompressDCtx failed: " << ZSTD_getErrorName(ret);
+        return false;
+    }
+
+    if (ret != expected_size)
+    {
+        LOG(LS_WARNING) << "Size of the top-off doesn't match its rectangles";
+        return false;
+    }
+
+    const uint8_t* input = top_off_buffer_.get();
+
+    for (int i = 0; i < top_off.dirty_rect_size(); ++i)
+    {
+        const QRect rect = VideoUtil::fromVideoRect(top_off.dirty_rect(i));
+        const size_t row_size = rect.width() * bytes_per_pixel;
+        uint8_t* output = frame->frameDataAtPos(rect.topLeft());
+
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            memcpy(output, input, row_size);
+            input += row_size;
+            output += frame->stride();
+        }
+    }
+
+    return true;
+}
+
 } // namespace codec
@@ -25,7 +25,11 @@
 
 #include "base/macros_magic.h"
 #include "codec/scoped_vpx_codec.h"
+#include "codec/scoped_zstd_stream.h"
 #include "codec/video_decoder.h"
+#include "codec/yuv_converter.h"
+
+#include <vector>
 
 namespace codec {
 
@@ -34,16 +38,31 @@ class VideoDecoderVPX : public VideoDecoder
 public:
     ~VideoDecoderVPX() = default;
 
-    static std::unique_ptr<VideoDecoderVPX> createVP8();
-    static std::unique_ptr<VideoDecoderVPX> createVP9();
+    // If |thread_count| is 0, the number of the decoder threads is chosen from the number of
+    // processors.
+    static std::unique_ptr<VideoDecoderVPX> createVP8(int thread_count = 0);
+    static std::unique_ptr<VideoDecoderVPX> createVP9(int thread_count = 0);
 
     bool decode(const proto::desktop::VideoPacket& packet, desktop::Frame* frame) override;
 
 private:
-    explicit VideoDecoderVPX(proto::desktop::VideoEncoding encoding);
+    VideoDecoderVPX(proto::desktop::VideoEncoding encoding, int thread_count);
+
+    bool decodeImage(const proto::desktop::VideoPacket& packet, desktop::Frame* frame);
+    bool convertImage(const proto::desktop::VideoPacket& packet,
+                      const vpx_image_t* image,
+                      desktop::Frame* frame);
+    bool decodeTopOff(const proto::desktop::TopOffData& top_off, desktop::Frame* frame);
 
     ScopedVpxCodec codec_;
 
+    YuvConverter yuv_converter_;
+    std::vector<QRect> rects_;
+
+    ScopedZstdDStream top_off_stream_;
+    std::unique_ptr<uint8_t[]> top_off_buffer_;
+    size_t top_off_buffer_size_ = 0;
+
     DISALLOW_COPY_AND_ASSIGN(VideoDecoderVPX);
 };
 
@@ -19,51 +19,143 @@
 #include "codec/video_decoder_zstd.h"
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "codec/pixel_translator.h"
 #include "codec/video_util.h"
 #include "desktop/desktop_frame_aligned.h"
 
+#include <atomic>
+#include <cstring>
+
 namespace codec {
 
-VideoDecoderZstd::VideoDecoderZstd()
-    : stream_(ZSTD_createDStream())
+namespace {
+
+// Copies the pixels of |count| rectangles of |frame| one after another to |buffer|.
+void gatherRects(const desktop::Frame* frame, const QRect* rects, int count, uint8_t* buffer)
 {
-    // Nothing
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int row_size = rects[i].width() * bytes_per_pixel;
+        const uint8_t* source = frame->frameDataAtPos(rects[i].topLeft());
+
+        for (int y = 0; y < rects[i].height(); ++y)
+        {
+            memcpy(buffer, source, row_size);
+            buffer += row_size;
+            source += frame->stride();
+        }
+    }
 }
 
+size_t rectsSize(const QRect* rects, int count, int bytes_per_pixel)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < count; ++i)
+        size += static_cast<size_t>(rects[i].width()) * rects[i].height() * bytes_per_pixel;
+
+    return size;
+}
+
+} // namespace
+
+VideoDecoderZstd::VideoDecoderZstd() = default;
+VideoDecoderZstd::~VideoDecoderZstd() = default;
+
 // static
 std::unique_ptr<VideoDecoderZstd> VideoDecoderZstd::create()
 {
     return std::unique_ptr<VideoDecoderZstd>(new VideoDecoderZstd());
 }
 
-bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
-                              desktop::Frame* target_frame)
+bool VideoDecoderZstd::drawCachedTiles(const proto::desktop::VideoPacket& packet,
+                                       desktop::Frame* target_frame)
 {
-    if (packet.has_format())
+    if (!packet.cached_tile_size())
+        return true;
+
+    if (!tile_cache_)
     {
-        const proto::desktop::VideoPacketFormat& format = packet.format();
+        LOG(LS_WARNING) << "Cached tile received before any tile was stored";
+        return false;
+    }
+
+    const QRect frame_rect(QPoint(), decode_frame_->size());
+
+    for (int i = 0; i < packet.cached_tile_size(); ++i)
+    {
+        const proto::desktop::CachedTile& tile = packet.cached_tile(i);
+        const QRect tile_rect(tile.x(), tile.y(), TileCache::kTileSize, TileCache::kTileSize);
+
+        if (!frame_rect.contains(tile_rect))
+        {
+            LOG(LS_WARNING) << "The tile is outside the screen area";
+            return false;
+        }
+
+        if (!tile_cache_->load(tile.index(),
+                               decode_frame_->frameDataAtPos(tile_rect.topLeft()),
+                               decode_frame_->stride()))
+        {
+            return false;
+        }
 
-        source_frame_ = desktop::FrameAligned::create(
-            QSize(format.screen_rect().width(), format.screen_rect().height()),
-            VideoUtil::fromVideoPixelFormat(format.pixel_format()), 32);
+        if (!translator_)
+            continue;
 
-        translator_ = PixelTranslator::create(source_frame_->format(), target_frame->format());
+        translator_->translate(decode_frame_->frameDataAtPos(tile_rect.topLeft()),
+                               decode_frame_->stride(),
+                               target_frame->frameDataAtPos(tile_rect.topLeft()),
+                               target_frame->stride(),
+                               tile_rect.width(),
+                               tile_rect.height());
     }
 
-    DCHECK(source_frame_->size() == target_frame->size());
+    return true;
+}
+
+bool VideoDecoderZstd::storeTiles(const proto::desktop::VideoPacket& packet)
+{
+    if (!packet.store_tile_size())
+        return true;
+
+    const int bytes_per_pixel = decode_frame_->format().bytesPerPixel();
+
+    if (!tile_cache_)
+        tile_cache_ = std::make_unique<TileCache>(TileCache::kMaxCacheSize, bytes_per_pixel);
+
+    const QRect frame_rect(QPoint(), decode_frame_->size());
 
-    if (!source_frame_ || !translator_)
+    for (int i = 0; i < packet.store_tile_size(); ++i)
     {
-        LOG(LS_WARNING) << "A packet with image information was not received";
-        return false;
+        const proto::desktop::CachedTile& tile = packet.store_tile(i);
+        const QRect tile_rect(tile.x(), tile.y(), TileCache::kTileSize, TileCache::kTileSize);
+
+        if (!frame_rect.contains(tile_rect))
+        {
+            LOG(LS_WARNING) << "The tile is outside the screen area";
+            return false;
+        }
+
+        if (!tile_cache_->store(tile.index(),
+                                decode_frame_->frameDataAtPos(tile_rect.topLeft()),
+                                decode_frame_->stride()))
+        {
+            return false;
+        }
     }
 
-    size_t ret = ZSTD_initDStream(stream_.get());
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    return true;
+}
 
-    QRect frame_rect(QPoint(), source_frame_->size());
-    ZSTD_inBuffer input = { packet.data().data(), packet.data().size(), 0 };
+bool VideoDecoderZstd::createSlices(const proto::desktop::VideoPacket& packet)
+{
+    const QRect frame_rect(QPoint(), decode_frame_->size());
+
+    rects_.clear();
 
     for (int i = 0; i < packet.dirty_rect_size(); ++i)
     {
@@ -75,40 +167,263 @@ bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
             return false;
         }
 
-        uint8_t* output_data = source_frame_->frameDataAtPos(rect.x(), rect.y());
-        const size_t output_size = rect.width() * source_frame_->format().bytesPerPixel();
+        rects_.push_back(rect);
+    }
+
+    slices_.clear();
+
+    if (rects_.empty())
+        return true;
+
+    const int bytes_per_pixel = decode_frame_->format().bytesPerPixel();
+
+    // The packets without slices contain one stream for all rectangles.
+    if (!packet.slice_size())
+    {
+        Slice slice;
+        slice.rect_count = static_cast<int>(rects_.size());
+        slice.data_size = packet.data().size();
+        slice.prefix_size = rectsSize(rects_.data(), slice.rect_count, bytes_per_pixel);
+
+        slices_.push_back(slice);
+    }
+    else
+    {
+        int first_rect = 0;
+        size_t data_offset = 0;
+        size_t prefix_offset = 0;
+
+        for (int i = 0; i < packet.slice_size(); ++i)
+        {
+            const proto::desktop::VideoSlice& packet_slice = packet.slice(i);
+
+            if (packet_slice.rect_count() > rects_.size() - first_rect ||
+                packet_slice.data_size() > packet.data().size() - data_offset)
+            {
+                LOG(LS_WARNING) << "The slice is outside the packet data";
+                return false;
+            }
+
+            Slice slice;
+            slice.first_rect = first_rect;
+            slice.rect_count = static_cast<int>(packet_slice.rect_count());
+            slice.data_offset = data_offset;
+            slice.data_size = packet_slice.data_size();
+            slice.prefix_offset = prefix_offset;
+            slice.prefix_size =
+                rectsSize(&rects_[first_rect], slice.rect_count, bytes_per_pixel);
+
+            slices_.push_back(slice);
+
+            first_rect += slice.rect_count;
+            data_offset += slice.data_size;
+            prefix_offset += slice.prefix_size;
+        }
+
+        if (first_rect != static_cast<int>(rects_.size()))
+        {
+            LOG(LS_WARNING) << "The slices do not contain all rectangles";
+            return false;
+        }
+    }
+
+    if (packet.inter_frame())
+    {
+        const Slice& last_slice = slices_.back();
+        const size_t prefix_size = last_slice.prefix_offset + last_slice.prefix_size;
+
+        if (prefix_buffer_size_ < prefix_size)
+        {
+            prefix_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(prefix_size, 32)));
+            prefix_buffer_size_ = prefix_size;
+        }
+    }
+
+    return true;
+}
+
+bool VideoDecoderZstd::decodeSlice(const uint8_t* data,
+                                   const Slice& slice,
+                                   bool inter_frame,
+                                   desktop::Frame* target_frame)
+{
+    ScopedZstdDStream stream = takeStream();
+
+    size_t ret = ZSTD_initDStream(stream.get());
+    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+
+    if (inter_frame)
+    {
+        // The previous pixels are collected before the rectangles are overwritten.
+        uint8_t* prefix_data = prefix_buffer_.get() + slice.prefix_offset;
+
+        gatherRects(decode_frame_, &rects_[slice.first_rect], slice.rect_count,
+                    prefix_data);
+
+        ret = ZSTD_DCtx_refPrefix(stream.get(), prefix_data, slice.prefix_size);
+        DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    }
+
+    ZSTD_inBuffer input = { data + slice.data_offset, slice.data_size, 0 };
+    bool result = true;
+
+    for (int i = slice.first_rect; i < slice.first_rect + slice.rect_count && result; ++i)
+    {
+        const QRect& rect = rects_[i];
+
+        uint8_t* output_data = decode_frame_->frameDataAtPos(rect.x(), rect.y());
+        const size_t output_size = rect.width() * decode_frame_->format().bytesPerPixel();
 
         ZSTD_outBuffer output = { output_data, output_size, 0 };
         int row_y = 0;
 
         while (row_y < rect.height())
         {
-            ret = ZSTD_decompressStream(stream_.get(), &output, &input);
+            const size_t prev_output_pos = output.pos;
+
+            ret = ZSTD_decompressStream(stream.get(), &output, &input);
             if (ZSTD_isError(ret))
             {
                 LOG(LS_WARNING) << "ZSTD_decompressStream failed: " << ZSTD_getErrorName(ret);
-                return false;
+                result = false;
+                break;
             }
 
             // If we completely unpacked the row in the rectangle.
             if (output.pos == output.size)
             {
+                // The row is translated while it is still in the cache.
+                if (translator_)
+                {
+                    translator_->translate(output_data,
+                                           decode_frame_->stride(),
+                                           target_frame->frameDataAtPos(rect.x(), rect.y() + row_y),
+                                           target_frame->stride(),
+                                           rect.width(),
+                                           1);
+                }
+
                 ++row_y;
-                output_data += source_frame_->stride();
+                output_data += decode_frame_->stride();
                 output.dst = output_data;
                 output.pos = 0;
             }
+            else if (output.pos == prev_output_pos && input.pos == input.size)
+            {
+                // All data of the slice is read and the stream has no more pixels.
+                LOG(LS_WARNING) << "Not enough data for the rectangle";
+                result = false;
+                break;
+            }
         }
+    }
 
-        translator_->translate(source_frame_->frameDataAtPos(rect.topLeft()),
-                               source_frame_->stride(),
-                               target_frame->frameDataAtPos(rect.topLeft()),
-                               target_frame->stride(),
-                               rect.width(),
-                               rect.height());
+    releaseStream(std::move(stream));
+    return result;
+}
+
+ScopedZstdDStream VideoDecoderZstd::takeStream()
+{
+    std::scoped_lock lock(streams_lock_);
+
+    if (free_streams_.empty())
+        return ScopedZstdDStream(ZSTD_createDStream());
+
+    ScopedZstdDStream stream = std::move(free_streams_.back());
+    free_streams_.pop_back();
+    return stream;
+}
+
+void VideoDecoderZstd::releaseStream(ScopedZstdDStream stream)
+{
+    std::scoped_lock lock(streams_lock_);
+    free_streams_.push_back(std::move(stream));
+}
+
+bool VideoDecoderZstd::decode(const proto::desktop::VideoPacket& packet,
+                              desktop::Frame* target_frame)
+{
+    if (packet.has_format())
+    {
+        const proto::desktop::VideoPacketFormat& format = packet.format();
+
+        source_format_ = VideoUtil::fromVideoPixelFormat(format.pixel_format());
+
+        if (source_format_.isEqual(target_frame->format()))
+        {
+            source_frame_.reset();
+            translator_.reset();
+        }
+        else
+        {
+            source_frame_ = desktop::FrameAligned::create(
+                QSize(format.screen_rect().width(), format.screen_rect().height()),
+                source_format_, 32);
+
+            translator_ = PixelTranslator::create(source_format_, target_frame->format());
+            if (!translator_)
+                source_format_ = desktop::PixelFormat();
+        }
+
+        desktop::Frame* frame = source_frame_ ? source_frame_.get() : target_frame;
+
+        // The host uses the zero-filled frame as the reference for the first inter-frame packet.
+        memset(frame->frameData(), 0, frame->stride() * frame->size().height());
+
+        // The cached tiles of a different pixel format can not be used.
+        if (tile_cache_ && tile_cache_->bytesPerPixel() != source_format_.bytesPerPixel())
+            tile_cache_.reset();
     }
 
-    return true;
+    if (!source_format_.isValid())
+    {
+        LOG(LS_WARNING) << "A packet with image information was not received";
+        return false;
+    }
+
+    decode_frame_ = source_frame_ ? source_frame_.get() : target_frame;
+
+    DCHECK(decode_frame_->size() == target_frame->size());
+
+    // Scrolled and moved areas are copied before the changed areas are decoded. The source frame
+    // is the reference of the inter-frame packets and must have the same content as the screen.
+    if (!applyCopyRects(packet, target_frame))
+        return false;
+
+    if (source_frame_ && !applyCopyRects(packet, source_frame_.get()))
+        return false;
+
+    if (!drawCachedTiles(packet, target_frame))
+        return false;
+
+    if (!createSlices(packet))
+        return false;
+
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(packet.data().data());
+
+    if (slices_.size() == 1)
+    {
+        if (!decodeSlice(data, slices_.front(), packet.inter_frame(), target_frame))
+            return false;
+    }
+    else if (!slices_.empty())
+    {
+        if (!thread_pool_)
+            thread_pool_ = std::make_unique<base::ThreadPool>();
+
+        std::atomic_bool failed { false };
+
+        thread_pool_->parallelFor(static_cast<int>(slices_.size()), [&](int index)
+        {
+            if (!decodeSlice(data, slices_[index], packet.inter_frame(), target_frame))
+                failed = true;
+        });
+
+        if (failed)
+            return false;
+    }
+
+    return storeTiles(packet);
 }
 
 } // namespace codec
@@ -19,18 +19,33 @@
 #ifndef CODEC__VIDEO_DECODER_ZSTD_H
 #define CODEC__VIDEO_DECODER_ZSTD_H
 
+#include "base/aligned_memory.h"
 #include "base/macros_magic.h"
 #include "codec/scoped_zstd_stream.h"
+#include "codec/tile_cache.h"
 #include "codec/video_decoder.h"
+#include "desktop/pixel_format.h"
+
+#include <QRect>
+
+#include <mutex>
+#include <vector>
+
+namespace base {
+class ThreadPool;
+} // namespace base
 
 namespace codec {
 
 class PixelTranslator;
 
+// If the packets have the pixel format of the target frame, the pixels are decompressed directly
+// to the target frame. Otherwise they are decompressed to |source_frame_| and each row is
+// translated to the target frame right after it is decompressed.
 class VideoDecoderZstd : public VideoDecoder
 {
 public:
-    ~VideoDecoderZstd() = default;
+    ~VideoDecoderZstd();
 
     static std::unique_ptr<VideoDecoderZstd> create();
 
@@ -39,11 +54,61 @@ public:
 private:
     VideoDecoderZstd();
 
-    ScopedZstdDStream stream_;
+    bool drawCachedTiles(const proto::desktop::VideoPacket& packet,
+                         desktop::Frame* target_frame);
+    bool storeTiles(const proto::desktop::VideoPacket& packet);
+
+    struct Slice
+    {
+        int first_rect = 0;
+        int rect_count = 0;
+        size_t data_offset = 0;
+        size_t data_size = 0;
+
+        // The position of the previous pixels of the slice in |prefix_buffer_|.
+        size_t prefix_offset = 0;
+        size_t prefix_size = 0;
+    };
+
+    bool createSlices(const proto::desktop::VideoPacket& packet);
+    bool decodeSlice(const uint8_t* data,
+                     const Slice& slice,
+                     bool inter_frame,
+                     desktop::Frame* target_frame);
+
+    ScopedZstdDStream takeStream();
+    void releaseStream(ScopedZstdDStream stream);
 
+    // The rectangles and the slices of the current packet.
+    std::vector<QRect> rects_;
+    std::vector<Slice> slices_;
+
+    // Created when the first packet with several slices is decoded.
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
+    // The streams which are not used by the slice tasks now.
+    std::mutex streams_lock_;
+    std::vector<ScopedZstdDStream> free_streams_;
+
+    // The previous pixels of the slices for the inter-frame packets.
+    std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> prefix_buffer_;
+    size_t prefix_buffer_size_ = 0;
+
+    // The pixel format of the packets. Not valid until a packet with the format is received.
+    desktop::PixelFormat source_format_;
+
+    // Created only if the pixel format of the packets differs from the target frame.
     std::unique_ptr<PixelTranslator> translator_;
     std::unique_ptr<desktop::Frame> source_frame_;
 
+    // The frame with the pixels in |source_format_| for the current packet: |source_frame_| or
+    // the target frame.
+    desktop::Frame* decode_frame_ = nullptr;
+
+    // Tiles in |source_format_|. The host selects the slots, so the cache
+    // has the maximum size and the slots are allocated when they are first used.
+    std::unique_ptr<TileCache> tile_cache_;
+
     DISALLOW_COPY_AND_ASSIGN(VideoDecoderZstd);
 };
 
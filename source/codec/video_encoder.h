@@ -35,6 +35,15 @@ public:
 
     virtual void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) = 0;
 
+    // Sets the estimated bandwidth of the link to the client in bytes per second. 0 if the
+    // bandwidth is unknown.
+    virtual void setBandwidth(int64_t /* bytes_per_second */) {}
+
+    // Returns true if the encoder has to send an update although the screen has not changed (the
+    // areas encoded with losses have stopped changing and can be sent without losses). Then
+    // encode() is called with an empty updated region. May be called from any thread.
+    virtual bool hasPendingUpdate() const { return false; }
+
 protected:
     void fillPacketInfo(proto::desktop::VideoEncoding encoding,
                         const desktop::Frame* frame,
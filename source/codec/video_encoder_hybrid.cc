@@ -0,0 +1,116 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_encoder_hybrid.h"
+
+#include "codec/video_encoder_vpx.h"
+#include "codec/video_encoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame_view.h"
+
+namespace codec {
+
+VideoEncoderHybrid::VideoEncoderHybrid(std::unique_ptr<VideoEncoderZstd> lossless_encoder,
+                                       std::unique_ptr<VideoEncoderVPX> lossy_encoder)
+    : lossless_encoder_(std::move(lossless_encoder)),
+      lossy_encoder_(std::move(lossy_encoder))
+{
+    // Nothing
+}
+
+VideoEncoderHybrid::~VideoEncoderHybrid() = default;
+
+// static
+VideoEncoderHybrid* VideoEncoderHybrid::create(const desktop::PixelFormat& target_format,
+                                               int compression_ratio,
+                                               size_t tile_cache_size)
+{
+    std::unique_ptr<VideoEncoderZstd> lossless_encoder(
+        VideoEncoderZstd::create(target_format, compression_ratio, tile_cache_size, false));
+    if (!lossless_encoder)
+        return nullptr;
+
+    std::unique_ptr<VideoEncoderVPX> lossy_encoder(VideoEncoderVPX::createVP9());
+    if (!lossy_encoder)
+        return nullptr;
+
+    return new VideoEncoderHybrid(std::move(lossless_encoder), std::move(lossy_encoder));
+}
+
+void VideoEncoderHybrid::setAutoCompressRatio(std::chrono::milliseconds target_frame_time)
+{
+    lossless_encoder_->setAutoCompressRatio(target_frame_time);
+}
+
+void VideoEncoderHybrid::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    // The copy rectangles are applied by the client before both parts of the packet. The client
+    // has inexact pixels in the lossy areas, so a rectangle copied from them (and all following
+    // rectangles, which may copy from its destination) is encoded again. The destinations are
+    // in the updated region of the frame. The sources are checked before the classification of
+    // this frame: the blocks that become exact in this packet are still lossy when the client
+    // copies.
+    const QVector<desktop::CopyRect> copy_rects =
+        classifier_.exactCopyRects(frame->constCopyRects());
+
+    desktop::DirtyRegion lossless_region;
+    desktop::DirtyRegion lossy_region;
+
+    classifier_.classify(frame, frame->constUpdatedRegion(), &lossless_region, &lossy_region);
+    has_lossy_blocks_ = classifier_.hasLossyBlocks();
+
+    desktop::FrameView lossless_frame(frame);
+    *lossless_frame.updatedRegion() = lossless_region;
+    *lossless_frame.copyRects() = copy_rects;
+
+    // The Zstd encoder is called even if the lossless region is empty: it sends the screen size
+    // and the pixel format.
+    lossless_encoder_->encode(&lossless_frame, packet);
+    packet->set_encoding(proto::desktop::VIDEO_ENCODING_HYBRID);
+
+    if (lossy_region.isEmpty())
+        return;
+
+    desktop::FrameView lossy_frame(frame);
+    *lossy_frame.updatedRegion() = lossy_region;
+
+    proto::desktop::VideoPacket lossy_packet;
+    lossy_encoder_->encode(&lossy_frame, &lossy_packet);
+
+    // The VP9 encoder pads the rectangles with the unchanged pixels around them. The padding may
+    // overlap the lossless areas, so the client gets only the classified blocks.
+    proto::desktop::LossyVideoData* lossy = packet->mutable_lossy();
+
+    for (const auto& rect : lossy_region)
+        VideoUtil::toVideoRect(rect, lossy->add_dirty_rect());
+
+    lossy->set_data(std::move(*lossy_packet.mutable_data()));
+}
+
+bool VideoEncoderHybrid::hasPendingUpdate() const
+{
+    return has_lossy_blocks_;
+}
+
+void VideoEncoderHybrid::setBandwidth(int64_t bytes_per_second)
+{
+    lossless_encoder_->setBandwidth(bytes_per_second);
+    lossy_encoder_->setBandwidth(bytes_per_second);
+}
+
+} // namespace codec
@@ -0,0 +1,79 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_ENCODER_HYBRID_H
+#define CODEC__VIDEO_ENCODER_HYBRID_H
+
+#include "base/macros_magic.h"
+#include "codec/content_classifier.h"
+#include "codec/video_encoder.h"
+#include "desktop/pixel_format.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace codec {
+
+class VideoEncoderVPX;
+class VideoEncoderZstd;
+
+// The areas of the screen with video and photographic content are encoded with VP9 and the rest
+// (the text and the UI) is encoded with Zstd (see ContentClassifier). The VP9 data is sent in
+// |lossy| field of the packet.
+//
+// The Zstd encoder does not use the inter-frame mode: the client has the VP9 pixels in the lossy
+// areas, so the previous frame of the host is not the reference of the client.
+class VideoEncoderHybrid : public VideoEncoder
+{
+public:
+    ~VideoEncoderHybrid();
+
+    static VideoEncoderHybrid* create(const desktop::PixelFormat& target_format,
+                                      int compression_ratio,
+                                      size_t tile_cache_size = 0);
+
+    // Enables the automatic choice of the compression level of the Zstd encoder.
+    void setAutoCompressRatio(std::chrono::milliseconds target_frame_time);
+
+    // VideoEncoder implementation.
+    void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+    void setBandwidth(int64_t bytes_per_second) override;
+
+    // The unchanged lossy blocks are sent to the Zstd encoder after kTopOffFrames frames, so the
+    // frames are encoded while the client has some lossy blocks.
+    bool hasPendingUpdate() const override;
+
+private:
+    VideoEncoderHybrid(std::unique_ptr<VideoEncoderZstd> lossless_encoder,
+                       std::unique_ptr<VideoEncoderVPX> lossy_encoder);
+
+    ContentClassifier classifier_;
+
+    // It is read by hasPendingUpdate() from other threads.
+    std::atomic_bool has_lossy_blocks_ { false };
+
+    std::unique_ptr<VideoEncoderZstd> lossless_encoder_;
+    std::unique_ptr<VideoEncoderVPX> lossy_encoder_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoEncoderHybrid);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_ENCODER_HYBRID_H
@@ -0,0 +1,122 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/video_encoder_palette.h"
+
+#include "base/logging.h"
+#include "codec/palette_tile.h"
+#include "codec/video_encoder_zstd.h"
+#include "codec/video_util.h"
+#include "desktop/desktop_frame_view.h"
+
+namespace codec {
+
+VideoEncoderPalette::VideoEncoderPalette(std::unique_ptr<VideoEncoderZstd> zstd_encoder)
+    : zstd_encoder_(std::move(zstd_encoder))
+{
+    // Nothing
+}
+
+VideoEncoderPalette::~VideoEncoderPalette() = default;
+
+// static
+VideoEncoderPalette* VideoEncoderPalette::create(const desktop::PixelFormat& target_format,
+                                                 int compression_ratio,
+                                                 size_t tile_cache_size)
+{
+    // The client does not have the previous pixels of the palette tiles in the pixel format of
+    // the Zstd tiles, so the inter-frame mode is not used.
+    std::unique_ptr<VideoEncoderZstd> zstd_encoder(
+        VideoEncoderZstd::create(target_format, compression_ratio, tile_cache_size, false));
+    if (!zstd_encoder)
+        return nullptr;
+
+    return new VideoEncoderPalette(std::move(zstd_encoder));
+}
+
+void VideoEncoderPalette::setAutoCompressRatio(std::chrono::milliseconds target_frame_time)
+{
+    zstd_encoder_->setAutoCompressRatio(target_frame_time);
+}
+
+void VideoEncoderPalette::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
+{
+    DCHECK_EQ(frame->format().bytesPerPixel(), 4);
+
+    fillPacketInfo(proto::desktop::VIDEO_ENCODING_PALETTE, frame, packet);
+
+    desktop::DirtyRegion region = frame->constUpdatedRegion();
+
+    // The Zstd encoder sends the copy rectangles if the screen size has not changed. The client
+    // gets the pixels of their destinations by copying.
+    if (!packet->has_format())
+    {
+        for (const auto& copy_rect : frame->constCopyRects())
+            region.subtract(QRect(copy_rect.dest_pos, copy_rect.source_rect.size()));
+    }
+
+    desktop::FrameView zstd_frame(frame);
+    *zstd_frame.copyRects() = frame->constCopyRects();
+
+    proto::desktop::PaletteVideoData* palette = packet->mutable_palette();
+
+    for (const auto& rect : region)
+    {
+        const int first_row = rect.top() / PaletteTile::kMaxTileSize;
+        const int last_row = rect.bottom() / PaletteTile::kMaxTileSize;
+        const int first_column = rect.left() / PaletteTile::kMaxTileSize;
+        const int last_column = rect.right() / PaletteTile::kMaxTileSize;
+
+        for (int row = first_row; row <= last_row; ++row)
+        {
+            for (int column = first_column; column <= last_column; ++column)
+            {
+                const QRect tile_rect =
+                    QRect(column * PaletteTile::kMaxTileSize, row * PaletteTile::kMaxTileSize,
+                          PaletteTile::kMaxTileSize, PaletteTile::kMaxTileSize).intersected(rect);
+
+                if (PaletteTile::encode(frame->frameDataAtPos(tile_rect.topLeft()),
+                                        frame->stride(),
+                                        tile_rect.size(),
+                                        palette->mutable_data()))
+                {
+                    VideoUtil::toVideoRect(tile_rect, palette->add_tile());
+                }
+                else
+                {
+                    zstd_frame.updatedRegion()->add(tile_rect);
+                }
+            }
+        }
+    }
+
+    if (!palette->tile_size())
+        packet->clear_palette();
+
+    // The Zstd encoder is called even if all tiles have a palette: it sends the copy rectangles
+    // and the pixel format.
+    zstd_encoder_->encode(&zstd_frame, packet);
+    packet->set_encoding(proto::desktop::VIDEO_ENCODING_PALETTE);
+}
+
+void VideoEncoderPalette::setBandwidth(int64_t bytes_per_second)
+{
+    zstd_encoder_->setBandwidth(bytes_per_second);
+}
+
+} // namespace codec
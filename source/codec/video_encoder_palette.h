@@ -0,0 +1,63 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__VIDEO_ENCODER_PALETTE_H
+#define CODEC__VIDEO_ENCODER_PALETTE_H
+
+#include "base/macros_magic.h"
+#include "codec/video_encoder.h"
+#include "desktop/pixel_format.h"
+
+#include <chrono>
+#include <memory>
+
+namespace codec {
+
+class VideoEncoderZstd;
+
+// The changed rectangles are divided by the grid of PaletteTile::kMaxTileSize pixels. The tiles
+// with few colors are encoded with PaletteTile in |palette| field of the packet and the rest is
+// encoded with Zstd. The palette colors are always sent in 32 bits, the pixel format applies to
+// the Zstd tiles only.
+class VideoEncoderPalette : public VideoEncoder
+{
+public:
+    ~VideoEncoderPalette();
+
+    static VideoEncoderPalette* create(const desktop::PixelFormat& target_format,
+                                       int compression_ratio,
+                                       size_t tile_cache_size = 0);
+
+    // Enables the automatic choice of the compression level of the Zstd encoder.
+    void setAutoCompressRatio(std::chrono::milliseconds target_frame_time);
+
+    // VideoEncoder implementation.
+    void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+    void setBandwidth(int64_t bytes_per_second) override;
+
+private:
+    explicit VideoEncoderPalette(std::unique_ptr<VideoEncoderZstd> zstd_encoder);
+
+    std::unique_ptr<VideoEncoderZstd> zstd_encoder_;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoEncoderPalette);
+};
+
+} // namespace codec
+
+#endif // CODEC__VIDEO_ENCODER_PALETTE_H
@@ -0,0 +1,146 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/video_decoder_palette.h"
+#include "codec/video_encoder_palette.h"
+#include "desktop/frame_test_util.h"
+
+namespace codec {
+
+namespace {
+
+const QSize kFrameSize(400, 300);
+
+// A photo with random pixels.
+const QRect kPhotoRect(70, 90, 150, 100);
+
+// Creates a frame like a dialog: a few colors with a text and a photo in the middle.
+std::unique_ptr<desktop::Frame> createFrame()
+{
+    std::unique_ptr<desktop::Frame> frame = desktop::createTestFrame(kFrameSize);
+
+    for (int y = 0; y < kFrameSize.height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+
+        for (int x = 0; x < kFrameSize.width(); ++x)
+        {
+            if (y < 20)
+                row[x] = 0x0078D7;
+            else if ((x / 3 + y / 4) % 5 == 0)
+                row[x] = 0x000000;
+            else
+                row[x] = 0xF0F0F0;
+        }
+    }
+
+    fillRandomPixels(frame.get(), kPhotoRect, 1, 0);
+    return frame;
+}
+
+} // namespace
+
+TEST(video_encoder_palette, round_trip)
+{
+    std::unique_ptr<VideoEncoderPalette> encoder(
+        VideoEncoderPalette::create(desktop::PixelFormat::ARGB(), 3));
+    std::unique_ptr<VideoDecoderPalette> decoder = VideoDecoderPalette::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    frame->updatedRegion()->add(QRect(QPoint(), kFrameSize));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    EXPECT_EQ(proto::desktop::VIDEO_ENCODING_PALETTE, packet.encoding());
+    EXPECT_TRUE(packet.has_format());
+
+    // Only the tiles with the photo are compressed with Zstd.
+    EXPECT_GT(packet.palette().tile_size(), 0);
+    EXPECT_GT(packet.dirty_rect_size(), 0);
+
+    for (int i = 0; i < packet.dirty_rect_size(); ++i)
+    {
+        const proto::desktop::Rect& rect = packet.dirty_rect(i);
+
+        EXPECT_TRUE(QRect(rect.x(), rect.y(), rect.width(), rect.height())
+                    .intersects(kPhotoRect));
+    }
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(kFrameSize);
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+
+    // Scroll up by 10 rows. The rows at the bottom are new.
+    const QRect scroll_rect(0, 10, kFrameSize.width(), kFrameSize.height() - 10);
+    frame->copyRect(scroll_rect, QPoint(0, 0));
+
+    uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, kFrameSize.height() - 1));
+    row[5] = 0x102030;
+
+    frame->copyRects()->push_back({ scroll_rect, QPoint(0, 0) });
+    frame->updatedRegion()->clear();
+    frame->updatedRegion()->add(QRect(QPoint(), kFrameSize));
+
+    packet.Clear();
+    encoder->encode(frame.get(), &packet);
+
+    EXPECT_FALSE(packet.has_format());
+    EXPECT_EQ(1, packet.copy_rect_size());
+    EXPECT_EQ(0, packet.dirty_rect_size());
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+}
+
+TEST(video_encoder_palette, invalid_tiles)
+{
+    std::unique_ptr<VideoEncoderPalette> encoder(
+        VideoEncoderPalette::create(desktop::PixelFormat::ARGB(), 3));
+    std::unique_ptr<VideoDecoderPalette> decoder = VideoDecoderPalette::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame();
+    frame->updatedRegion()->add(QRect(QPoint(), kFrameSize));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(kFrameSize);
+
+    // A tile outside the frame.
+    proto::desktop::VideoPacket invalid_packet = packet;
+    invalid_packet.mutable_palette()->mutable_tile(0)->set_x(kFrameSize.width());
+    EXPECT_FALSE(decoder->decode(invalid_packet, decoded_frame.get()));
+
+    // The data of the last tile is truncated.
+    invalid_packet = packet;
+    invalid_packet.mutable_palette()->mutable_data()->pop_back();
+    EXPECT_FALSE(decoder->decode(invalid_packet, decoded_frame.get()));
+
+    // The data after the last tile.
+    invalid_packet = packet;
+    invalid_packet.mutable_palette()->mutable_data()->push_back(0);
+    EXPECT_FALSE(decoder->decode(invalid_packet, decoded_frame.get()));
+
+    EXPECT_TRUE(decoder->decode(packet, decoded_frame.get()));
+}
+
+} // namespace codec
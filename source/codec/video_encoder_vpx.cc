@@ -18,11 +18,11 @@
 
 #include "codec/video_encoder_vpx.h"
 
-#include <thread>
-
-#include <libyuv/convert_from_argb.h>
+#include <algorithm>
+#include <cstring>
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "codec/video_util.h"
 #include "desktop/desktop_frame.h"
 
@@ -39,7 +39,93 @@ const int kVp9I420ProfileNumber = 0;
 // Magic encoder constant for adaptive quantization strategy.
 const int kVp9AqModeCyclicRefresh = 3;
 
-void setCommonCodecParameters(vpx_codec_enc_cfg_t* config, const QSize& size)
+// One encoder thread is added for each this number of pixels of the frame. The threads for smaller
+// parts of the frame spend more time on the synchronization than they save, and on low end
+// systems the extra threads can really hurt performance: http://crbug.com/99179
+const int kPixelsPerThread = 640 * 360;
+const int kMaxThreads = 16;
+
+// VP9 tile columns are at least 256 pixels wide. VP8 has at most 8 token partitions.
+const int kMinTileColumnWidth = 256;
+const int kMaxTileColumnsLog2 = 6;
+const int kMaxTokenPartitionsLog2 = 3;
+
+// Part of the estimated bandwidth for the video. The rest is left for the cursor, the clipboard and
+// the overshoots of the rate control.
+const double kBandwidthUsage = 0.8;
+
+// Range of the target bitrate in kilobits per second.
+const unsigned int kMinTargetBitrate = 100;
+const unsigned int kMaxTargetBitrate = 100000;
+
+// The encoder is reconfigured if the target bitrate changes by more than this part.
+const double kMinBitrateChange = 0.1;
+
+// Compression ratio of the lossless top-off. It is sent once for each area, so the ratio is
+// higher than the default ratio of VideoEncoderZstd.
+const int kTopOffCompressRatio = 8;
+
+// The quantizer range is chosen by the bits per pixel of a full screen update at |kFrameRate|.
+const int kFrameRate = 30;
+
+struct QuantizerRange
+{
+    double min_bits_per_pixel;
+    unsigned int min_quantizer;
+    unsigned int max_quantizer;
+};
+
+const QuantizerRange kQuantizerRanges[] =
+{
+    // Fast links (LAN): the screen is shown in the full quality.
+    { 0.5, 4, 20 },
+
+    // The default range.
+    { 0.05, 20, 30 },
+
+    // Slow links: the quality is reduced, so that the encoder keeps the target bitrate and the
+    // packets do not wait in the queues.
+    { 0, 20, 52 }
+};
+
+int threadCount(const QSize& size, int requested_count)
+{
+    if (requested_count > 0)
+        return requested_count;
+
+    const int size_count = std::max(1, size.width() * size.height() / kPixelsPerThread);
+
+    return std::min({ base::ThreadPool::processorCount(), size_count, kMaxThreads });
+}
+
+// Returns the base 2 logarithm of the number of VP9 tile columns. Each tile column is encoded by
+// its own thread, the row-based multithreading divides the rows of the columns between the rest
+// of the threads.
+int tileColumnsLog2(int width, int thread_count)
+{
+    int columns_log2 = 0;
+
+    while (columns_log2 < kMaxTileColumnsLog2 &&
+           (1 << (columns_log2 + 1)) <= thread_count &&
+           (width >> (columns_log2 + 1)) >= kMinTileColumnWidth)
+    {
+        ++columns_log2;
+    }
+
+    return columns_log2;
+}
+
+int tokenPartitionsLog2(int thread_count)
+{
+    int partitions_log2 = 0;
+
+    while (partitions_log2 < kMaxTokenPartitionsLog2 && (2 << partitions_log2) <= thread_count)
+        ++partitions_log2;
+
+    return partitions_log2;
+}
+
+void setCommonCodecParameters(vpx_codec_enc_cfg_t* config, const QSize& size, int thread_count)
 {
     // Use millisecond granularity time base.
     config->g_timebase.num = 1;
@@ -58,11 +144,7 @@ void setCommonCodecParameters(vpx_codec_enc_cfg_t* config, const QSize& size)
     config->kf_min_dist = 10000;
     config->kf_max_dist = 10000;
 
-    // Using 2 threads gives a great boost in performance for most systems with
-    // adequate processing power. NB: Going to multiple threads on low end
-    // windows systems can really hurt performance.
-    // http://crbug.com/99179
-    config->g_threads = (std::thread::hardware_concurrency() > 2) ? 2 : 1;
+    config->g_threads = thread_count;
 }
 
 void createImage(const QSize& size,
@@ -133,22 +215,88 @@ QRect alignRect(const QRect& rect)
 } // namespace
 
 // static
-VideoEncoderVPX* VideoEncoderVPX::createVP8()
+VideoEncoderVPX* VideoEncoderVPX::createVP8(int thread_count)
 {
-    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP8);
+    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP8, thread_count);
 }
 
 // static
-VideoEncoderVPX* VideoEncoderVPX::createVP9()
+VideoEncoderVPX* VideoEncoderVPX::createVP9(int thread_count)
 {
-    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP9);
+    return new VideoEncoderVPX(proto::desktop::VIDEO_ENCODING_VP9, thread_count);
 }
 
-VideoEncoderVPX::VideoEncoderVPX(proto::desktop::VideoEncoding encoding)
-    : encoding_(encoding)
+VideoEncoderVPX::VideoEncoderVPX(proto::desktop::VideoEncoding encoding, int thread_count)
+    : encoding_(encoding),
+      requested_thread_count_(thread_count),
+      yuv_converter_(thread_count),
+      next_top_off_time_(Clock::time_point::max().time_since_epoch().count())
 {
     memset(&active_map_, 0, sizeof(active_map_));
     memset(&image_, 0, sizeof(image_));
+    memset(&config_, 0, sizeof(config_));
+}
+
+void VideoEncoderVPX::setBandwidth(int64_t bytes_per_second)
+{
+    bandwidth_ = bytes_per_second;
+
+    if (codec_ && bandwidth_)
+        updateRateControl();
+}
+
+void VideoEncoderVPX::setTopOffDelay(std::chrono::milliseconds delay)
+{
+    top_off_delay_ = delay;
+
+    if (top_off_delay_.count() <= 0)
+    {
+        top_off_times_.clear();
+        next_top_off_time_ = Clock::time_point::max().time_since_epoch().count();
+    }
+}
+
+bool VideoEncoderVPX::hasPendingUpdate() const
+{
+    return Clock::now().time_since_epoch().count() >= next_top_off_time_.load();
+}
+
+void VideoEncoderVPX::updateRateControl()
+{
+    const unsigned int target_bitrate = static_cast<unsigned int>(std::clamp<int64_t>(
+        static_cast<int64_t>(bandwidth_ * 8 * kBandwidthUsage / 1000),
+        kMinTargetBitrate, kMaxTargetBitrate));
+
+    const double bits_per_pixel = target_bitrate * 1000.0 /
+        (static_cast<double>(config_.g_w) * config_.g_h * kFrameRate);
+
+    const QuantizerRange* range = &kQuantizerRanges[0];
+    while (bits_per_pixel < range->min_bits_per_pixel)
+        ++range;
+
+    const unsigned int bitrate_change = (target_bitrate > config_.rc_target_bitrate) ?
+        target_bitrate - config_.rc_target_bitrate : config_.rc_target_bitrate - target_bitrate;
+
+    if (bitrate_change <= config_.rc_target_bitrate * kMinBitrateChange &&
+        range->min_quantizer == config_.rc_min_quantizer &&
+        range->max_quantizer == config_.rc_max_quantizer)
+    {
+        return;
+    }
+
+    config_.rc_target_bitrate = target_bitrate;
+    config_.rc_min_quantizer = range->min_quantizer;
+    config_.rc_max_quantizer = range->max_quantizer;
+
+    vpx_codec_err_t ret = vpx_codec_enc_config_set(codec_.get(), &config_);
+    if (ret != VPX_CODEC_OK)
+    {
+        LOG(LS_WARNING) << "vpx_codec_enc_config_set failed: " << ret;
+        return;
+    }
+
+    LOG(LS_INFO) << "Target bitrate: " << target_bitrate << " kbps, quantizer: "
+                 << range->min_quantizer << "-" << range->max_quantizer;
 }
 
 void VideoEncoderVPX::createActiveMap(const QSize& size)
@@ -166,29 +314,31 @@ void VideoEncoderVPX::createVp8Codec(const QSize& size)
 {
     codec_.reset(new vpx_codec_ctx_t());
 
-    vpx_codec_enc_cfg_t config = { 0 };
+    memset(&config_, 0, sizeof(config_));
 
     // Configure the encoder.
     vpx_codec_iface_t* algo = vpx_codec_vp8_cx();
 
-    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config, 0);
+    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Adjust default target bit-rate to account for actual desktop size.
-    config.rc_target_bitrate = size.width() * size.height() *
-        config.rc_target_bitrate / config.g_w / config.g_h;
+    config_.rc_target_bitrate = size.width() * size.height() *
+        config_.rc_target_bitrate / config_.g_w / config_.g_h;
+
+    const int thread_count = threadCount(size, requested_thread_count_);
 
-    setCommonCodecParameters(&config, size);
+    setCommonCodecParameters(&config_, size, thread_count);
 
     // Value of 2 means using the real time profile. This is basically a redundant option since we
     // explicitly select real time mode when doing encoding.
-    config.g_profile = 2;
+    config_.g_profile = 2;
 
     // Clamping the quantizer constrains the worst-case quality and CPU usage.
-    config.rc_min_quantizer = 20;
-    config.rc_max_quantizer = 30;
+    config_.rc_min_quantizer = 20;
+    config_.rc_max_quantizer = 30;
 
-    ret = vpx_codec_enc_init(codec_.get(), algo, &config, 0);
+    ret = vpx_codec_enc_init(codec_.get(), algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Value of 16 will have the smallest CPU load. This turns off subpixel motion search.
@@ -202,33 +352,40 @@ void VideoEncoderVPX::createVp8Codec(const QSize& size)
     // inter-prediction mode.
     ret = vpx_codec_control(codec_.get(), VP8E_SET_NOISE_SENSITIVITY, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
+
+    // The token partitions are packed by the encoder threads and unpacked by the decoder threads
+    // in parallel.
+    ret = vpx_codec_control(
+        codec_.get(), VP8E_SET_TOKEN_PARTITIONS, tokenPartitionsLog2(thread_count));
+    DCHECK_EQ(VPX_CODEC_OK, ret);
 }
 
 void VideoEncoderVPX::createVp9Codec(const QSize& size)
 {
     codec_.reset(new vpx_codec_ctx_t());
 
-    vpx_codec_enc_cfg_t config = { 0 };
+    memset(&config_, 0, sizeof(config_));
 
     // Configure the encoder.
     vpx_codec_iface_t* algo = vpx_codec_vp9_cx();
 
-    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config, 0);
+    vpx_codec_err_t ret = vpx_codec_enc_config_default(algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
-    setCommonCodecParameters(&config, size);
+    const int thread_count = threadCount(size, requested_thread_count_);
+
+    setCommonCodecParameters(&config_, size, thread_count);
 
     // Configure VP9 for I420 source frames.
-    config.g_profile = kVp9I420ProfileNumber;
-    config.rc_min_quantizer = 20;
-    config.rc_max_quantizer = 30;
-    config.rc_end_usage = VPX_CBR;
+    config_.g_profile = kVp9I420ProfileNumber;
+    config_.rc_min_quantizer = 20;
+    config_.rc_max_quantizer = 30;
+    config_.rc_end_usage = VPX_CBR;
 
-    // In the absence of a good bandwidth estimator set the target bitrate to a
-    // conservative default.
-    config.rc_target_bitrate = 500;
+    // Until the bandwidth is estimated, the target bitrate is a conservative default.
+    config_.rc_target_bitrate = 500;
 
-    ret = vpx_codec_enc_init(codec_.get(), algo, &config, 0);
+    ret = vpx_codec_enc_init(codec_.get(), algo, &config_, 0);
     DCHECK_EQ(VPX_CODEC_OK, ret);
 
     // Request the lowest-CPU usage that VP9 supports, which depends on whether we are encoding
@@ -247,6 +404,15 @@ void VideoEncoderVPX::createVp9Codec(const QSize& size)
     // Set cyclic refresh (aka "top-off") only for lossy encoding.
     ret = vpx_codec_control(codec_.get(), VP9E_SET_AQ_MODE, kVp9AqModeCyclicRefresh);
     DCHECK_EQ(VPX_CODEC_OK, ret);
+
+    // Without the tile columns and the row-based multithreading the VP9 encoder uses only one
+    // thread. The tile columns also allow the client to decode the frame in parallel.
+    ret = vpx_codec_control(
+        codec_.get(), VP9E_SET_TILE_COLUMNS, tileColumnsLog2(size.width(), thread_count));
+    DCHECK_EQ(VPX_CODEC_OK, ret);
+
+    ret = vpx_codec_control(codec_.get(), VP9E_SET_ROW_MT, thread_count > 1 ? 1 : 0);
+    DCHECK_EQ(VPX_CODEC_OK, ret);
 }
 
 void VideoEncoderVPX::setActiveMap(const QRect& rect)
@@ -273,7 +439,7 @@ void VideoEncoderVPX::prepareImageAndActiveMap(
     const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
 {
     int padding = ((encoding_ == proto::desktop::VIDEO_ENCODING_VP9) ? 8 : 3);
-    QRegion updated_region;
+    desktop::DirtyRegion updated_region;
 
     for (const auto& rect : frame->constUpdatedRegion())
     {
@@ -287,35 +453,21 @@ void VideoEncoderVPX::prepareImageAndActiveMap(
             QRect(QPoint(rect.left() - padding, rect.top() - padding),
                   QPoint(rect.right() + padding, rect.bottom() + padding));
 
-        updated_region += alignRect(rect_with_padding);
+        updated_region.add(alignRect(rect_with_padding));
     }
 
     // Clip back to the screen dimensions, in case they're not macroblock aligned. The conversion
     // routines don't require even width & height, so this is safe even if the source dimensions
     // are not even.
-    updated_region = updated_region.intersected(QRect(QPoint(), QSize(image_->w, image_->h)));
+    updated_region.intersect(QRect(QPoint(), QSize(image_->w, image_->h)));
 
     memset(active_map_.active_map, 0, active_map_size_);
 
-    int y_stride = image_->stride[0];
-    int uv_stride = image_->stride[1];
-    uint8_t* y_data = image_->planes[0];
-    uint8_t* u_data = image_->planes[1];
-    uint8_t* v_data = image_->planes[2];
+    yuv_converter_.convertToI420(
+        frame, updated_region.begin(), updated_region.rectCount(), image_.get());
 
     for (const auto& rect : updated_region)
     {
-        int y_offset = y_stride * rect.y() + rect.x();
-        int uv_offset = uv_stride * rect.y() / 2 + rect.x() / 2;
-
-        libyuv::ARGBToI420(frame->frameDataAtPos(rect.topLeft()),
-                           frame->stride(),
-                           y_data + y_offset, y_stride,
-                           u_data + uv_offset, uv_stride,
-                           v_data + uv_offset, uv_stride,
-                           rect.width(),
-                           rect.height());
-
         VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
         setActiveMap(rect);
     }
@@ -341,6 +493,19 @@ void VideoEncoderVPX::encode(const desktop::Frame* frame, proto::desktop::VideoP
             DCHECK_EQ(encoding_, proto::desktop::VIDEO_ENCODING_VP9);
             createVp9Codec(screen_size);
         }
+
+        if (bandwidth_)
+            updateRateControl();
+
+        top_off_times_.clear();
+    }
+
+    // If the screen has not changed, only the top-off is sent.
+    if (frame->constUpdatedRegion().isEmpty())
+    {
+        memset(active_map_.active_map, 0, active_map_size_);
+        encodeTopOff(frame, packet);
+        return;
     }
 
     // Convert the updated capture data ready for encode.
@@ -370,6 +535,127 @@ void VideoEncoderVPX::encode(const desktop::Frame* frame, proto::desktop::VideoP
             break;
         }
     }
+
+    encodeTopOff(frame, packet);
+}
+
+void VideoEncoderVPX::encodeTopOff(const desktop::Frame* frame,
+                                   proto::desktop::VideoPacket* packet)
+{
+    if (top_off_delay_.count() <= 0)
+        return;
+
+    if (top_off_times_.size() != active_map_size_)
+        top_off_times_.assign(active_map_size_, Clock::time_point::max());
+
+    const Clock::time_point now = Clock::now();
+    Clock::time_point next_time = Clock::time_point::max();
+
+    const int width = frame->size().width();
+    const int height = frame->size().height();
+
+    // The macroblocks encoded in this frame are sent without losses after they stop changing. The
+    // region of the due macroblocks is built from top to bottom.
+    desktop::DirtyRegion region;
+    std::vector<desktop::DirtyRegion::Span> spans;
+
+    for (int row = 0; row < active_map_.rows; ++row)
+    {
+        const int index = row * active_map_.cols;
+        spans.clear();
+
+        for (int col = 0; col < active_map_.cols; ++col)
+        {
+            Clock::time_point& time = top_off_times_[index + col];
+
+            if (active_map_.active_map[index + col])
+            {
+                time = now + top_off_delay_;
+            }
+            else if (time <= now)
+            {
+                time = Clock::time_point::max();
+
+                const int left = col * kMacroBlockSize;
+                const int right = std::min(left + kMacroBlockSize, width);
+
+                if (!spans.empty() && spans.back().right == left)
+                    spans.back().right = right;
+                else
+                    spans.push_back({ left, right });
+
+                continue;
+            }
+
+            next_time = std::min(next_time, time);
+        }
+
+        if (!spans.empty())
+        {
+            const int top = row * kMacroBlockSize;
+            const int bottom = std::min(top + kMacroBlockSize, height);
+
+            region.appendBand(top, bottom, spans.data(), static_cast<int>(spans.size()));
+        }
+    }
+
+    next_top_off_time_ = next_time.time_since_epoch().count();
+
+    if (region.isEmpty())
+        return;
+
+    size_t input_size = 0;
+
+    for (const auto& rect : region)
+        input_size += rect.width() * rect.height() * frame->format().bytesPerPixel();
+
+    if (top_off_buffer_size_ < input_size)
+    {
+        top_off_buffer_ = std::make_unique<uint8_t[]>(input_size);
+        top_off_buffer_size_ = input_size;
+    }
+
+    proto::desktop::TopOffData* top_off = packet->mutable_top_off();
+    uint8_t* output = top_off_buffer_.get();
+
+    for (const auto& rect : region)
+    {
+        const size_t row_size = rect.width() * frame->format().bytesPerPixel();
+        const uint8_t* input = frame->frameDataAtPos(rect.topLeft());
+
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            memcpy(output, input, row_size);
+            output += row_size;
+            input += frame->stride();
+        }
+
+        VideoUtil::toVideoRect(rect, top_off->add_dirty_rect());
+    }
+
+    if (!top_off_stream_)
+        top_off_stream_.reset(ZSTD_createCStream());
+
+    ZSTD_CCtx_reset(top_off_stream_.get(), ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(
+        top_off_stream_.get(), ZSTD_c_compressionLevel, kTopOffCompressRatio);
+
+    std::string* data = top_off->mutable_data();
+    data->resize(ZSTD_compressBound(input_size));
+
+    const size_t ret = ZSTD_compress2(top_off_stream_.get(),
+                                      data->data(),
+                                      data->size(),
+                                      top_off_buffer_.get(),
+                                      input_size);
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_compress2 failed: " << ZSTD_getErrorName(ret);
+        packet->clear_top_off();
+        return;
+    }
+
+    data->resize(ret);
 }
 
 } // namespace codec
@@ -23,9 +23,15 @@
 #include <vpx/vpx_encoder.h>
 #include <vpx/vp8cx.h>
 
+#include <atomic>
+#include <chrono>
+#include <vector>
+
 #include "base/macros_magic.h"
 #include "codec/scoped_vpx_codec.h"
+#include "codec/scoped_zstd_stream.h"
 #include "codec/video_encoder.h"
+#include "codec/yuv_converter.h"
 
 namespace codec {
 
@@ -34,23 +40,44 @@ class VideoEncoderVPX : public VideoEncoder
 public:
     ~VideoEncoderVPX() = default;
 
-    static VideoEncoderVPX* createVP8();
-    static VideoEncoderVPX* createVP9();
+    // If |thread_count| is 0, the number of the encoder threads is chosen from the frame size and
+    // the number of processors.
+    static VideoEncoderVPX* createVP8(int thread_count = 0);
+    static VideoEncoderVPX* createVP9(int thread_count = 0);
 
+    // VideoEncoder implementation.
     void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
 
+    // The target bitrate and the quantizer range of the encoder are changed with the bandwidth.
+    void setBandwidth(int64_t bytes_per_second) override;
+
+    // The macroblocks which have not changed for |delay| after they were encoded are sent once
+    // more without losses in the |top_off| field of the packet. 0 disables the top-off.
+    void setTopOffDelay(std::chrono::milliseconds delay);
+
+    bool hasPendingUpdate() const override;
+
 private:
-    VideoEncoderVPX(proto::desktop::VideoEncoding encoding);
+    using Clock = std::chrono::steady_clock;
+
+    VideoEncoderVPX(proto::desktop::VideoEncoding encoding, int thread_count);
 
     void createActiveMap(const QSize& size);
     void createVp8Codec(const QSize& size);
     void createVp9Codec(const QSize& size);
     void prepareImageAndActiveMap(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
     void setActiveMap(const QRect& rect);
+    void updateRateControl();
+    void encodeTopOff(const desktop::Frame* frame, proto::desktop::VideoPacket* packet);
 
     const proto::desktop::VideoEncoding encoding_;
+    const int requested_thread_count_;
 
     ScopedVpxCodec codec_ = nullptr;
+    vpx_codec_enc_cfg_t config_;
+
+    // Estimated bandwidth in bytes per second, 0 if unknown.
+    int64_t bandwidth_ = 0;
 
     size_t active_map_size_ = 0;
 
@@ -61,6 +88,21 @@ private:
     std::unique_ptr<vpx_image_t> image_;
     std::unique_ptr<uint8_t[]> image_buffer_;
 
+    YuvConverter yuv_converter_;
+
+    std::chrono::milliseconds top_off_delay_ { 0 };
+
+    // The time of the top-off of each macroblock. Clock::time_point::max() if the macroblock has
+    // been sent without losses.
+    std::vector<Clock::time_point> top_off_times_;
+
+    // The nearest time of |top_off_times_|. It is read by hasPendingUpdate() from other threads.
+    std::atomic<Clock::rep> next_top_off_time_;
+
+    ScopedZstdCStream top_off_stream_;
+    std::unique_ptr<uint8_t[]> top_off_buffer_;
+    size_t top_off_buffer_size_ = 0;
+
     DISALLOW_COPY_AND_ASSIGN(VideoEncoderVPX);
 };
 
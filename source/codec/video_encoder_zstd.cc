@@ -19,38 +19,115 @@
 #include "codec/video_encoder_zstd.h"
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
+#include "codec/compression_level_controller.h"
 #include "codec/pixel_translator.h"
 #include "codec/video_util.h"
-#include "desktop/desktop_frame.h"
+#include "desktop/desktop_frame_aligned.h"
+
+#include <algorithm>
+#include <cstring>
 
 namespace codec {
 
 namespace {
 
-// Retrieves a pointer to the output buffer in |update| used for storing the
-// encoded rectangle data. Will resize the buffer to |size|.
-uint8_t* outputBuffer(proto::desktop::VideoPacket* packet, size_t size)
+// Rectangles higher than this are cut into bands, so that a large update can be divided into
+// slices of similar size.
+const int kMaxBandHeight = 64;
+
+// Minimum size of the translated pixels of a slice. Smaller slices are compressed worse and the
+// overhead of the parallel compression exceeds the gain.
+const size_t kMinSliceSize = 256 * 1024;
+
+// The update is divided into more slices than the number of threads, so that the threads which
+// have compressed the slices that are simpler to compress take the remaining slices.
+const size_t kSlicesPerThread = 2;
+
+// The matches with the reference prefix are at the distance of the slice size, so the window must
+// contain the prefix and the slice. The maximum is the default window limit of the decoders.
+const int kMinWindowLog = 10;
+const int kMaxWindowLog = 27;
+
+// Range of the automatic choice of the compression level. The higher levels need much more memory
+// and are too slow for the screen updates.
+const int kMinAutoCompressRatio = 1;
+const int kMaxAutoCompressRatio = 19;
+
+int windowLog(size_t size)
+{
+    int window_log = kMinWindowLog;
+
+    while ((static_cast<size_t>(1) << window_log) < size && window_log < kMaxWindowLog)
+        ++window_log;
+
+    return window_log;
+}
+
+// Copies the pixels of |count| rectangles of |frame| one after another to |buffer|.
+void gatherRects(const desktop::Frame* frame, const QRect* rects, int count, uint8_t* buffer)
+{
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int row_size = rects[i].width() * bytes_per_pixel;
+        const uint8_t* source = frame->frameDataAtPos(rects[i].topLeft());
+
+        for (int y = 0; y < rects[i].height(); ++y)
+        {
+            memcpy(buffer, source, row_size);
+            buffer += row_size;
+            source += frame->stride();
+        }
+    }
+}
+
+// Copies the pixels of |count| rectangles from |buffer| to |frame|. The opposite of gatherRects.
+void scatterRects(const uint8_t* buffer, const QRect* rects, int count, desktop::Frame* frame)
 {
-    packet->mutable_data()->resize(size);
-    return reinterpret_cast<uint8_t*>(packet->mutable_data()->data());
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int row_size = rects[i].width() * bytes_per_pixel;
+        uint8_t* target = frame->frameDataAtPos(rects[i].topLeft());
+
+        for (int y = 0; y < rects[i].height(); ++y)
+        {
+            memcpy(target, buffer, row_size);
+            buffer += row_size;
+            target += frame->stride();
+        }
+    }
 }
 
 } // namespace
 
 VideoEncoderZstd::VideoEncoderZstd(std::unique_ptr<PixelTranslator> translator,
                                    const desktop::PixelFormat& target_format,
-                                   int compression_ratio)
+                                   int compression_ratio,
+                                   size_t tile_cache_size,
+                                   bool inter_frame)
     : target_format_(target_format),
       compress_ratio_(compression_ratio),
-      stream_(ZSTD_createCStream()),
+      inter_frame_(inter_frame),
       translator_(std::move(translator))
 {
-    // Nothing
+    if (tile_cache_size)
+    {
+        tile_cache_ = std::make_unique<TileCache>(
+            tile_cache_size, desktop::PixelFormat::ARGB().bytesPerPixel());
+    }
 }
 
+VideoEncoderZstd::~VideoEncoderZstd() = default;
+
 // static
-VideoEncoderZstd* VideoEncoderZstd::create(
-    const desktop::PixelFormat& target_format, int compression_ratio)
+VideoEncoderZstd* VideoEncoderZstd::create(const desktop::PixelFormat& target_format,
+                                           int compression_ratio,
+                                           size_t tile_cache_size,
+                                           bool inter_frame)
 {
     if (compression_ratio > ZSTD_maxCLevel())
         compression_ratio = ZSTD_maxCLevel();
@@ -65,80 +142,503 @@ VideoEncoderZstd* VideoEncoderZstd::create(
         return nullptr;
     }
 
-    return new VideoEncoderZstd(std::move(translator), target_format, compression_ratio);
+    if (tile_cache_size && !TileCache::isValidCacheSize(tile_cache_size))
+    {
+        LOG(LS_WARNING) << "Invalid tile cache size: " << tile_cache_size;
+        tile_cache_size = 0;
+    }
+
+    return new VideoEncoderZstd(
+        std::move(translator), target_format, compression_ratio, tile_cache_size, inter_frame);
+}
+
+void VideoEncoderZstd::setAutoCompressRatio(std::chrono::milliseconds target_frame_time)
+{
+    level_controller_ = std::make_unique<CompressionLevelController>(
+        kMinAutoCompressRatio, kMaxAutoCompressRatio, compress_ratio_);
+    level_controller_->setTargetFrameTime(target_frame_time);
+
+    compress_ratio_ = level_controller_->level();
+}
+
+void VideoEncoderZstd::setBandwidth(int64_t bytes_per_second)
+{
+    if (level_controller_)
+        level_controller_->setBandwidth(bytes_per_second);
 }
 
-void VideoEncoderZstd::compressPacket(proto::desktop::VideoPacket* packet,
-                                      const uint8_t* input_data,
-                                      size_t input_size)
+void VideoEncoderZstd::encodeCachedTiles(const desktop::Frame* frame,
+                                         desktop::DirtyRegion* region,
+                                         proto::desktop::VideoPacket* packet)
 {
-    size_t ret = ZSTD_initCStream(stream_.get(), compress_ratio_);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    const int kTileSize = TileCache::kTileSize;
+    const int kTileArea = kTileSize * kTileSize;
 
-    const size_t output_size = ZSTD_compressBound(input_size);
-    uint8_t* output_data = outputBuffer(packet, output_size);
+    const QSize grid_size(frame->size().width() / kTileSize,
+                          frame->size().height() / kTileSize);
+    const size_t tile_count = grid_size.width() * grid_size.height();
 
-    ZSTD_inBuffer input = { input_data, input_size, 0 };
-    ZSTD_outBuffer output = { output_data, output_size, 0 };
+    if (grid_size != tile_grid_size_)
+    {
+        tile_grid_size_ = grid_size;
+        tile_changed_.assign(tile_count, true);
+    }
+
+    if (!tile_count)
+        return;
+
+    // The rectangles of the region do not overlap, so a tile is completely changed when the sum of
+    // the areas of its intersections with the rectangles equals the tile area.
+    tile_coverage_.assign(tile_count, 0);
 
-    while (input.pos < input.size)
+    const QRect grid_rect(0, 0, grid_size.width() * kTileSize, grid_size.height() * kTileSize);
+
+    for (const auto& region_rect : *region)
     {
-        ret = ZSTD_compressStream(stream_.get(), &output, &input);
-        if (ZSTD_isError(ret))
+        const QRect rect = region_rect.intersected(grid_rect);
+        if (rect.isEmpty())
+            continue;
+
+        for (int tile_y = rect.top() / kTileSize; tile_y <= rect.bottom() / kTileSize; ++tile_y)
         {
-            LOG(LS_WARNING) << "ZSTD_compressStream failed: " << ZSTD_getErrorName(ret);
-            return;
+            for (int tile_x = rect.left() / kTileSize; tile_x <= rect.right() / kTileSize; ++tile_x)
+            {
+                const QRect tile_rect(tile_x * kTileSize, tile_y * kTileSize, kTileSize, kTileSize);
+                const QRect covered = tile_rect.intersected(rect);
+
+                tile_coverage_[tile_y * grid_size.width() + tile_x] +=
+                    covered.width() * covered.height();
+            }
+        }
+    }
+
+    const int bytes_per_pixel = frame->format().bytesPerPixel();
+
+    // The client draws the cached tiles before it stores the new ones, so the slots stored in
+    // this packet can not be referenced in the same packet.
+    std::vector<bool> stored_slots(tile_cache_->size(), false);
+
+    for (int tile_y = 0; tile_y < grid_size.height(); ++tile_y)
+    {
+        for (int tile_x = 0; tile_x < grid_size.width(); ++tile_x)
+        {
+            const size_t tile_index = tile_y * grid_size.width() + tile_x;
+            const int coverage = tile_coverage_[tile_index];
+            const bool changed_before = tile_changed_[tile_index];
+
+            tile_changed_[tile_index] = coverage != 0;
+
+            if (coverage != kTileArea)
+                continue;
+
+            const QPoint pos(tile_x * kTileSize, tile_y * kTileSize);
+            const uint8_t* data = frame->frameDataAtPos(pos);
+            const uint64_t hash = TileCache::tileHash(data, frame->stride(), bytes_per_pixel);
+
+            size_t cache_index = tile_cache_->find(hash, data, frame->stride());
+            if (cache_index != TileCache::kInvalidIndex)
+            {
+                if (stored_slots[cache_index])
+                    continue;
+
+                proto::desktop::CachedTile* cached_tile = packet->add_cached_tile();
+                cached_tile->set_x(pos.x());
+                cached_tile->set_y(pos.y());
+                cached_tile->set_index(cache_index);
+
+                region->subtract(QRect(pos, QSize(kTileSize, kTileSize)));
+
+                // The client loads the tile to its frame.
+                if (reference_frame_)
+                {
+                    translator_->translate(data,
+                                           frame->stride(),
+                                           reference_frame_->frameDataAtPos(pos),
+                                           reference_frame_->stride(),
+                                           kTileSize,
+                                           kTileSize);
+                }
+                continue;
+            }
+
+            // Tiles that change in consecutive frames (video, animations) are rarely repeated and
+            // would only evict useful tiles from the cache.
+            if (changed_before)
+                continue;
+
+            cache_index = tile_cache_->add(hash, data, frame->stride());
+            stored_slots[cache_index] = true;
+
+            proto::desktop::CachedTile* store_tile = packet->add_store_tile();
+            store_tile->set_x(pos.x());
+            store_tile->set_y(pos.y());
+            store_tile->set_index(cache_index);
+        }
+    }
+}
+
+void VideoEncoderZstd::createSlices(const desktop::Frame* frame,
+                                    const desktop::DirtyRegion& region,
+                                    proto::desktop::VideoPacket* packet)
+{
+    const size_t bytes_per_pixel = target_format_.bytesPerPixel();
+
+    rects_.clear();
+    size_t data_size = 0;
+
+    for (const auto& rect : region)
+    {
+        for (int top = rect.top(); top <= rect.bottom(); top += kMaxBandHeight)
+        {
+            const QRect band(rect.left(), top,
+                             rect.width(), std::min(kMaxBandHeight, rect.bottom() - top + 1));
+
+            rects_.push_back(band);
+            data_size += band.width() * band.height() * bytes_per_pixel;
+
+            VideoUtil::toVideoRect(band, packet->add_dirty_rect());
+        }
+    }
+
+    const size_t slice_size = std::max(
+        kMinSliceSize, data_size / (base::ThreadPool::processorCount() * kSlicesPerThread));
+
+    slices_.clear();
+
+    size_t input_offset = 0;
+    size_t output_offset = 0;
+
+    for (int i = 0; i < static_cast<int>(rects_.size()); ++i)
+    {
+        if (slices_.empty() || slices_.back().input_size >= slice_size)
+        {
+            if (!slices_.empty())
+                output_offset += ZSTD_compressBound(slices_.back().input_size);
+
+            Slice slice;
+            slice.first_rect = i;
+            slice.input_offset = input_offset;
+            slice.output_offset = output_offset;
+
+            slices_.push_back(slice);
         }
+
+        const size_t rect_size = rects_[i].width() * rects_[i].height() * bytes_per_pixel;
+
+        slices_.back().rect_count += 1;
+        slices_.back().input_size += rect_size;
+        input_offset += rect_size;
+    }
+
+    if (slices_.empty())
+        return;
+
+    bool need_translate_buffer = false;
+
+    for (auto& slice : slices_)
+    {
+        slice.direct_input = isDirectInput(frame, slice);
+        if (!slice.direct_input)
+            need_translate_buffer = true;
+    }
+
+    if (need_translate_buffer && translate_buffer_size_ < data_size)
+    {
+        translate_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(data_size, 32)));
+        translate_buffer_size_ = data_size;
     }
 
-    ret = ZSTD_endStream(stream_.get(), &output);
-    DCHECK(!ZSTD_isError(ret)) << ZSTD_getErrorName(ret);
+    output_offset += ZSTD_compressBound(slices_.back().input_size);
 
-    packet->mutable_data()->resize(output.pos);
+    if (output_buffer_size_ < output_offset)
+    {
+        output_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(output_offset, 32)));
+        output_buffer_size_ = output_offset;
+    }
+
+    if (reference_frame_ && prefix_buffer_size_ < data_size)
+    {
+        prefix_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(data_size, 32)));
+        prefix_buffer_size_ = data_size;
+    }
+}
+
+bool VideoEncoderZstd::isDirectInput(const desktop::Frame* frame, const Slice& slice) const
+{
+    if (!frame->format().isEqual(target_format_))
+        return false;
+
+    const int frame_width = frame->size().width();
+
+    // The rows of the frame must follow each other without gaps.
+    if (frame->stride() != frame_width * frame->format().bytesPerPixel())
+        return false;
+
+    int next_top = rects_[slice.first_rect].top();
+
+    for (int i = slice.first_rect; i < slice.first_rect + slice.rect_count; ++i)
+    {
+        const QRect& rect = rects_[i];
+
+        if (rect.left() != 0 || rect.width() != frame_width || rect.top() != next_top)
+            return false;
+
+        next_top = rect.bottom() + 1;
+    }
+
+    return true;
+}
+
+void VideoEncoderZstd::translateSlice(const desktop::Frame* frame,
+                                      const Slice& slice,
+                                      uint8_t* buffer)
+{
+    const QRect* rects = &rects_[slice.first_rect];
+
+    // The same pixel format only needs a copy. Unlike the translator, the copy keeps the alpha
+    // channel, but the client does not use it.
+    if (frame->format().isEqual(target_format_))
+    {
+        gatherRects(frame, rects, slice.rect_count, buffer);
+        return;
+    }
+
+    for (int i = 0; i < slice.rect_count; ++i)
+    {
+        const int stride = rects[i].width() * target_format_.bytesPerPixel();
+
+        translator_->translate(frame->frameDataAtPos(rects[i].topLeft()),
+                               frame->stride(),
+                               buffer,
+                               stride,
+                               rects[i].width(),
+                               rects[i].height());
+
+        buffer += rects[i].height() * stride;
+    }
+}
+
+void VideoEncoderZstd::encodeSlice(const desktop::Frame* frame, Slice* slice)
+{
+    const QRect* rects = &rects_[slice->first_rect];
+    const uint8_t* input_data;
+
+    if (slice->direct_input)
+    {
+        input_data = frame->frameDataAtPos(rects[0].topLeft());
+    }
+    else
+    {
+        uint8_t* translate_data = translate_buffer_.get() + slice->input_offset;
+        translateSlice(frame, *slice, translate_data);
+        input_data = translate_data;
+    }
+
+    ScopedZstdCStream stream = takeStream();
+
+    ZSTD_CCtx_reset(stream.get(), ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(stream.get(), ZSTD_c_compressionLevel, compress_ratio_);
+
+    if (reference_frame_)
+    {
+        // The prefix has the same size and the same layout as the input.
+        uint8_t* prefix_data = prefix_buffer_.get() + slice->input_offset;
+        gatherRects(reference_frame_.get(), rects, slice->rect_count, prefix_data);
+
+        // The matches in the prefix are far for the hash tables of the fast levels, so they
+        // are found with the long distance matcher.
+        ZSTD_CCtx_setParameter(
+            stream.get(), ZSTD_c_windowLog, windowLog(slice->input_size * 2));
+        ZSTD_CCtx_setParameter(stream.get(), ZSTD_c_enableLongDistanceMatching, 1);
+        ZSTD_CCtx_refPrefix(stream.get(), prefix_data, slice->input_size);
+    }
+
+    const size_t ret = ZSTD_compress2(stream.get(),
+                                      output_buffer_.get() + slice->output_offset,
+                                      ZSTD_compressBound(slice->input_size),
+                                      input_data,
+                                      slice->input_size);
+    if (ZSTD_isError(ret))
+    {
+        LOG(LS_WARNING) << "ZSTD_compress2 failed: " << ZSTD_getErrorName(ret);
+        slice->output_size = 0;
+    }
+    else
+    {
+        slice->output_size = ret;
+    }
+
+    releaseStream(std::move(stream));
+
+    // The slices do not overlap, so each slice updates its own part of the reference.
+    if (reference_frame_)
+        scatterRects(input_data, rects, slice->rect_count, reference_frame_.get());
+}
+
+void VideoEncoderZstd::discardUpdate(proto::desktop::VideoPacket* packet)
+{
+    packet->clear_dirty_rect();
+    packet->clear_slice();
+    packet->clear_data();
+
+    // The client stores the tiles from the decoded pixels, so it does not get the tiles of this
+    // packet and the slots of the host cache no longer match the client's ones.
+    packet->clear_store_tile();
+
+    if (tile_cache_)
+    {
+        tile_cache_ = std::make_unique<TileCache>(
+            tile_cache_->size(), tile_cache_->bytesPerPixel());
+    }
+
+    // The failed slices did not reach the client. The reference is created again for the key
+    // frame, zero-filled like the client's new frame.
+    reference_frame_.reset();
+
+    key_frame_ = true;
+}
+
+ScopedZstdCStream VideoEncoderZstd::takeStream()
+{
+    std::scoped_lock lock(streams_lock_);
+
+    if (free_streams_.empty())
+        return ScopedZstdCStream(ZSTD_createCStream());
+
+    ScopedZstdCStream stream = std::move(free_streams_.back());
+    free_streams_.pop_back();
+    return stream;
+}
+
+void VideoEncoderZstd::releaseStream(ScopedZstdCStream stream)
+{
+    std::scoped_lock lock(streams_lock_);
+    free_streams_.push_back(std::move(stream));
 }
 
 void VideoEncoderZstd::encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet)
 {
     fillPacketInfo(proto::desktop::VIDEO_ENCODING_ZSTD, frame, packet);
 
+    const bool key_frame = key_frame_;
+    key_frame_ = false;
+
+    if (key_frame)
+    {
+        VideoUtil::toVideoRect(QRect(frame->topLeft(), frame->size()),
+                               packet->mutable_format()->mutable_screen_rect());
+    }
+
     if (packet->has_format())
     {
         VideoUtil::toVideoPixelFormat(
             target_format_, packet->mutable_format()->mutable_pixel_format());
     }
 
-    size_t data_size = 0;
+    if (inter_frame_ && packet->has_format())
+    {
+        // The client creates a new frame filled with zeros.
+        reference_frame_ = desktop::FrameAligned::create(frame->size(), target_format_, 32);
+        if (reference_frame_)
+        {
+            memset(reference_frame_->frameData(), 0,
+                   reference_frame_->stride() * frame->size().height());
+        }
+    }
+
+    desktop::DirtyRegion encode_region = frame->constUpdatedRegion();
 
-    for (const auto& rect : frame->constUpdatedRegion())
+    if (key_frame)
+        encode_region = desktop::DirtyRegion(QRect(QPoint(), frame->size()));
+
+    // After a screen resize the client does not have a previous frame to copy from.
+    if (!packet->has_format())
     {
-        data_size += rect.width() * rect.height() * target_format_.bytesPerPixel();
-        VideoUtil::toVideoRect(rect, packet->add_dirty_rect());
+        for (const auto& copy_rect : frame->constCopyRects())
+        {
+            proto::desktop::CopyRect* packet_copy_rect = packet->add_copy_rect();
+
+            VideoUtil::toVideoRect(copy_rect.source_rect, packet_copy_rect->mutable_source_rect());
+            packet_copy_rect->set_dest_x(copy_rect.dest_pos.x());
+            packet_copy_rect->set_dest_y(copy_rect.dest_pos.y());
+
+            // The client gets the pixels of the destination rectangle by copying.
+            encode_region.subtract(QRect(copy_rect.dest_pos, copy_rect.source_rect.size()));
+
+            if (reference_frame_)
+                reference_frame_->copyRect(copy_rect.source_rect, copy_rect.dest_pos);
+        }
     }
 
-    if (translate_buffer_size_ < data_size)
+    if (tile_cache_)
+        encodeCachedTiles(frame, &encode_region, packet);
+
+    const std::chrono::steady_clock::time_point encode_start_time =
+        std::chrono::steady_clock::now();
+
+    createSlices(frame, encode_region, packet);
+
+    if (slices_.empty())
+        return;
+
+    if (slices_.size() == 1)
     {
-        translate_buffer_.reset(static_cast<uint8_t*>(base::alignedAlloc(data_size, 32)));
-        translate_buffer_size_ = data_size;
+        encodeSlice(frame, &slices_.front());
     }
+    else
+    {
+        if (!thread_pool_)
+            thread_pool_ = std::make_unique<base::ThreadPool>();
 
-    uint8_t* translate_pos = translate_buffer_.get();
+        thread_pool_->parallelFor(static_cast<int>(slices_.size()), [&](int index)
+        {
+            encodeSlice(frame, &slices_[index]);
+        });
+    }
+
+    // The slices are compressed to the positions with the maximum compressed size of the previous
+    // slices. Only the compressed data is copied to the packet.
+    size_t input_size = 0;
+    size_t data_size = 0;
 
-    for (const auto& rect : frame->constUpdatedRegion())
+    for (const auto& slice : slices_)
     {
-        const int stride = rect.width() * target_format_.bytesPerPixel();
+        if (!slice.output_size)
+        {
+            discardUpdate(packet);
+            return;
+        }
 
-        translator_->translate(frame->frameDataAtPos(rect.topLeft()),
-                               frame->stride(),
-                               translate_pos,
-                               stride,
-                               rect.width(),
-                               rect.height());
+        input_size += slice.input_size;
+        data_size += slice.output_size;
+    }
+
+    packet->mutable_timings()->set_compress_ratio(compress_ratio_);
+
+    if (level_controller_)
+    {
+        level_controller_->addFrame(
+            input_size, data_size, std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - encode_start_time));
+
+        compress_ratio_ = level_controller_->level();
+    }
+
+    std::string* data = packet->mutable_data();
+    data->reserve(data_size);
+
+    for (const auto& slice : slices_)
+    {
+        data->append(reinterpret_cast<const char*>(output_buffer_.get() + slice.output_offset),
+                     slice.output_size);
 
-        translate_pos += rect.height() * stride;
+        proto::desktop::VideoSlice* packet_slice = packet->add_slice();
+        packet_slice->set_rect_count(slice.rect_count);
+        packet_slice->set_data_size(static_cast<uint32_t>(slice.output_size));
     }
 
-    // Compress data with using Zstd compressor.
-    compressPacket(packet, translate_buffer_.get(), data_size);
+    if (reference_frame_)
+        packet->set_inter_frame(true);
 }
 
 } // namespace codec
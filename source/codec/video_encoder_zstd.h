@@ -21,39 +21,143 @@
 
 #include "base/aligned_memory.h"
 #include "codec/scoped_zstd_stream.h"
+#include "codec/tile_cache.h"
 #include "codec/video_encoder.h"
+#include "desktop/dirty_region.h"
 #include "desktop/pixel_format.h"
 
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
 namespace codec {
 
+class CompressionLevelController;
 class PixelTranslator;
 
+// The changed rectangles are divided into slices which are translated and compressed in
+// parallel. Each slice is an independent Zstd frame, so the client can decode them in parallel too.
+// If the frame is in the client's pixel format and the rectangles of a slice are whole rows of the
+// frame, the slice is compressed directly from the frame.
+//
+// In the inter-frame mode each slice is compressed with the previous pixels of its rectangles as
+// the reference prefix. The client has the same pixels in its frame, so the unchanged and the
+// slightly changed parts of the rectangles (text edits, small UI changes) take only a few bytes.
+//
+// In the automatic mode the compression level is changed between the frames, so that a frame is
+// encoded within the target frame time and is not transferred much longer than it is encoded.
 class VideoEncoderZstd : public VideoEncoder
 {
 public:
-    ~VideoEncoderZstd() = default;
+    ~VideoEncoderZstd();
+
+    // If |tile_cache_size| is not 0, the unchanged parts of the screen that were sent earlier
+    // are sent as references to the tile cache. If |inter_frame| is true, the previous frame is
+    // used as the reference for the compression.
+    static VideoEncoderZstd* create(const desktop::PixelFormat& target_format,
+                                    int compression_ratio,
+                                    size_t tile_cache_size = 0,
+                                    bool inter_frame = false);
+
+    // Enables the automatic choice of the compression level. The level passed to create() is the
+    // initial level and the maximum level while the bandwidth is unknown.
+    void setAutoCompressRatio(std::chrono::milliseconds target_frame_time);
 
-    static VideoEncoderZstd* create(
-        const desktop::PixelFormat& target_format, int compression_ratio);
+    int compressRatio() const { return compress_ratio_; }
 
+    // VideoEncoder implementation.
     void encode(const desktop::Frame* frame, proto::desktop::VideoPacket* packet) override;
+    void setBandwidth(int64_t bytes_per_second) override;
 
 private:
     VideoEncoderZstd(std::unique_ptr<PixelTranslator> translator,
                      const desktop::PixelFormat& target_format,
-                     int compression_ratio);
-    void compressPacket(proto::desktop::VideoPacket* packet,
-                        const uint8_t* input_data,
-                        size_t input_size);
+                     int compression_ratio,
+                     size_t tile_cache_size,
+                     bool inter_frame);
+    void encodeCachedTiles(const desktop::Frame* frame,
+                           desktop::DirtyRegion* region,
+                           proto::desktop::VideoPacket* packet);
+
+    struct Slice
+    {
+        int first_rect = 0;
+        int rect_count = 0;
+
+        // Position of the translated pixels in |translate_buffer_|.
+        size_t input_offset = 0;
+        size_t input_size = 0;
+
+        // If true, the pixels are compressed directly from the frame.
+        bool direct_input = false;
+
+        // Position of the compressed data in |output_buffer_|. |output_size| is 0 if the
+        // compression failed.
+        size_t output_offset = 0;
+        size_t output_size = 0;
+    };
+
+    void createSlices(const desktop::Frame* frame,
+                      const desktop::DirtyRegion& region,
+                      proto::desktop::VideoPacket* packet);
+    bool isDirectInput(const desktop::Frame* frame, const Slice& slice) const;
+    void translateSlice(const desktop::Frame* frame, const Slice& slice, uint8_t* buffer);
+    void encodeSlice(const desktop::Frame* frame, Slice* slice);
+
+    // Removes the pixels of the update from |packet| when the compression failed. The client keeps
+    // the previous image of the changed areas, so the next frame is sent whole.
+    void discardUpdate(proto::desktop::VideoPacket* packet);
+
+    ScopedZstdCStream takeStream();
+    void releaseStream(ScopedZstdCStream stream);
 
     // Client's pixel format
     desktop::PixelFormat target_format_;
     int compress_ratio_;
-    ScopedZstdCStream stream_;
+    std::unique_ptr<CompressionLevelController> level_controller_;
+    const bool inter_frame_;
     std::unique_ptr<PixelTranslator> translator_;
     std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> translate_buffer_;
     size_t translate_buffer_size_ = 0;
 
+    // The slices are compressed here with the space for the maximum compressed size of each
+    // slice. The buffer is kept between the packets and only the compressed data is copied to
+    // the packet.
+    std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> output_buffer_;
+    size_t output_buffer_size_ = 0;
+
+    // The image of the client in |target_format_| for the inter-frame mode. The previous pixels
+    // of each slice are collected to |prefix_buffer_| with the same offsets as in
+    // |translate_buffer_|.
+    std::unique_ptr<desktop::Frame> reference_frame_;
+    std::unique_ptr<uint8_t[], base::AlignedFreeDeleter> prefix_buffer_;
+    size_t prefix_buffer_size_ = 0;
+
+    // The rectangles of the packet (the tall rectangles are cut into bands) and the slices.
+    std::vector<QRect> rects_;
+    std::vector<Slice> slices_;
+
+    // Created when the first update with several slices is encoded.
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
+    // The streams which are not used by the slice tasks now.
+    std::mutex streams_lock_;
+    std::vector<ScopedZstdCStream> free_streams_;
+
+    std::unique_ptr<TileCache> tile_cache_;
+
+    // Per-tile state for the tile grid of the current frame size.
+    QSize tile_grid_size_;
+    std::vector<int> tile_coverage_;
+    std::vector<bool> tile_changed_;
+
+    // The next frame is sent with the format and the whole screen.
+    bool key_frame_ = false;
+
     DISALLOW_COPY_AND_ASSIGN(VideoEncoderZstd);
 };
 
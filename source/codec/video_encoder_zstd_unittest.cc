@@ -0,0 +1,356 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/pixel_translator.h"
+#include "codec/video_decoder_zstd.h"
+#include "codec/video_encoder_zstd.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/frame_test_util.h"
+
+#include <chrono>
+
+namespace codec {
+
+namespace {
+
+const int kAlignment = 32;
+
+// Creates an ARGB frame with smooth areas and noise, so that the slices are compressed with
+// different speed. The pixel translators do not keep the alpha channel, so it is 0.
+std::unique_ptr<desktop::Frame> createFrame(const QSize& size, uint32_t seed)
+{
+    std::unique_ptr<desktop::Frame> frame = desktop::createTestFrame(size);
+
+    for (int y = 0; y < size.height(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(0, y));
+
+        for (int x = 0; x < size.width(); ++x)
+            row[x] = static_cast<uint32_t>(((x + seed) << 8 | y) & 0xFFFFFF);
+    }
+
+    const int kCellSize = 64;
+
+    for (int y = 0; y < size.height(); y += kCellSize)
+    {
+        for (int x = 0; x < size.width(); x += kCellSize)
+        {
+            if ((x / kCellSize + y / kCellSize) % 3 != 0)
+                continue;
+
+            const QRect cell_rect = QRect(x, y, kCellSize, kCellSize).intersected(
+                QRect(QPoint(), size));
+
+            fillRandomPixels(frame.get(), cell_rect, seed * 65536 + y * size.width() + x, 0);
+        }
+    }
+
+    return frame;
+}
+
+// Returns the pixels of |frame| as the client sees them: converted to |format| and back.
+std::unique_ptr<desktop::Frame> clientFrame(const desktop::Frame* frame,
+                                            const desktop::PixelFormat& format)
+{
+    const QSize size = frame->size();
+
+    std::unique_ptr<desktop::Frame> target_frame =
+        desktop::FrameAligned::create(size, format, kAlignment);
+    std::unique_ptr<desktop::Frame> client_frame =
+        desktop::FrameAligned::create(size, frame->format(), kAlignment);
+
+    PixelTranslator::create(frame->format(), format)->translate(
+        frame->frameData(), frame->stride(), target_frame->frameData(), target_frame->stride(),
+        size.width(), size.height());
+    PixelTranslator::create(format, frame->format())->translate(
+        target_frame->frameData(), target_frame->stride(),
+        client_frame->frameData(), client_frame->stride(),
+        size.width(), size.height());
+
+    return client_frame;
+}
+
+} // namespace
+
+TEST(video_encoder_zstd, full_update_in_slices)
+{
+    const QSize size(1920, 1080);
+
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 3));
+    std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size, 1);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    // A full screen update is divided into several slices.
+    EXPECT_GT(packet.slice_size(), 1);
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+
+    // The next update changes a small area and is encoded as one slice.
+    std::unique_ptr<desktop::Frame> next_frame = createFrame(size, 2);
+    memcpy(next_frame->frameData(), frame->frameData(), frame->stride() * size.height());
+
+    const QRect changed_rect(100, 200, 48, 16);
+    for (int y = changed_rect.top(); y <= changed_rect.bottom(); ++y)
+    {
+        uint32_t* row =
+            reinterpret_cast<uint32_t*>(next_frame->frameDataAtPos(changed_rect.left(), y));
+
+        for (int x = 0; x < changed_rect.width(); ++x)
+            row[x] = 0x7F7F7F;
+    }
+
+    next_frame->updatedRegion()->add(changed_rect);
+
+    packet.Clear();
+    encoder->encode(next_frame.get(), &packet);
+    EXPECT_EQ(1, packet.slice_size());
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(next_frame.get(), decoded_frame.get()));
+}
+
+TEST(video_encoder_zstd, packet_without_slices)
+{
+    const QSize size(1280, 720);
+
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1));
+    std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size, 3);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    // The slices are Zstd frames which follow each other, so a decoder that does not know about
+    // the slices reads them as one stream.
+    packet.clear_slice();
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+}
+
+TEST(video_encoder_zstd, translated_pixels)
+{
+    const QSize size(1280, 720);
+    const desktop::PixelFormat target_format = desktop::PixelFormat::RGB565();
+
+    std::unique_ptr<VideoEncoderZstd> encoder(VideoEncoderZstd::create(target_format, 3));
+    std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size, 6);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+
+    // The client gets the pixels converted to RGB565 and back.
+    EXPECT_TRUE(isEqualFrames(clientFrame(frame.get(), target_format).get(),
+                              decoded_frame.get()));
+}
+
+TEST(video_encoder_zstd, inter_frame)
+{
+    const QSize size(1280, 720);
+
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 3, 0, true));
+    std::unique_ptr<VideoEncoderZstd> intra_encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 3));
+    std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size, 5);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+    EXPECT_TRUE(packet.inter_frame());
+
+    ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+    EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+
+    proto::desktop::VideoPacket intra_packet;
+    intra_encoder->encode(frame.get(), &intra_packet);
+    EXPECT_FALSE(intra_packet.inter_frame());
+
+    // A few pixels change in each frame, but the whole area with the noise is updated.
+    const QRect changed_rect(0, 0, 256, 128);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int y = 10 + i; y < 20 + i; ++y)
+        {
+            uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(30 * i, y));
+
+            for (int x = 0; x < 8; ++x)
+                row[x] = 0x102030;
+        }
+
+        frame->updatedRegion()->clear();
+        frame->updatedRegion()->add(changed_rect);
+
+        packet.Clear();
+        encoder->encode(frame.get(), &packet);
+
+        ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+        EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+
+        intra_packet.Clear();
+        intra_encoder->encode(frame.get(), &intra_packet);
+
+        EXPECT_LT(packet.data().size() * 10, intra_packet.data().size());
+    }
+}
+
+TEST(video_encoder_zstd, inter_frame_with_copy_rects)
+{
+    const QSize size(640, 480);
+
+    // The client decodes ARGB directly to its frame and RGB565 through the source frame.
+    for (const auto& target_format : { desktop::PixelFormat::ARGB(),
+                                       desktop::PixelFormat::RGB565() })
+    {
+        std::unique_ptr<VideoEncoderZstd> encoder(
+            VideoEncoderZstd::create(target_format, 3, 0, true));
+        std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+        std::unique_ptr<desktop::Frame> frame = createFrame(size, 7);
+        frame->updatedRegion()->add(QRect(QPoint(), size));
+
+        std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+        proto::desktop::VideoPacket packet;
+        encoder->encode(frame.get(), &packet);
+        ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+
+        // Scroll up by 32 rows. The rows at the bottom are new.
+        const QRect scroll_rect(0, 32, size.width(), size.height() - 32);
+        frame->copyRect(scroll_rect, QPoint(0, 0));
+        frame->copyRects()->push_back({ scroll_rect, QPoint(0, 0) });
+        frame->updatedRegion()->clear();
+        frame->updatedRegion()->add(QRect(0, 0, size.width(), size.height()));
+
+        packet.Clear();
+        encoder->encode(frame.get(), &packet);
+        ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+        EXPECT_TRUE(isEqualFrames(clientFrame(frame.get(), target_format).get(),
+                                  decoded_frame.get()));
+
+        // A change in the scrolled area is compressed with the scrolled pixels as the prefix.
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(10, 10));
+        row[0] = 0x204060;
+
+        frame->copyRects()->clear();
+        frame->updatedRegion()->clear();
+        frame->updatedRegion()->add(QRect(0, 0, 128, 128));
+
+        packet.Clear();
+        encoder->encode(frame.get(), &packet);
+        ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+        EXPECT_TRUE(isEqualFrames(clientFrame(frame.get(), target_format).get(),
+                                  decoded_frame.get()));
+    }
+}
+
+TEST(video_encoder_zstd, auto_compress_ratio)
+{
+    const QSize size(640, 480);
+
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1));
+    std::unique_ptr<VideoDecoderZstd> decoder = VideoDecoderZstd::create();
+
+    // A slow link. Higher levels are chosen while the encoding is much faster than the transfer.
+    encoder->setAutoCompressRatio(std::chrono::milliseconds(1000));
+    encoder->setBandwidth(1000);
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+    uint32_t last_ratio = 0;
+
+    for (uint32_t i = 0; i < 24; ++i)
+    {
+        std::unique_ptr<desktop::Frame> frame = createFrame(size, i);
+        frame->updatedRegion()->add(QRect(QPoint(), size));
+
+        proto::desktop::VideoPacket packet;
+        encoder->encode(frame.get(), &packet);
+
+        ASSERT_TRUE(decoder->decode(packet, decoded_frame.get()));
+        EXPECT_TRUE(isEqualFrames(frame.get(), decoded_frame.get()));
+
+        last_ratio = packet.timings().compress_ratio();
+    }
+
+    EXPECT_GT(last_ratio, 1U);
+}
+
+TEST(video_encoder_zstd, invalid_slices)
+{
+    const QSize size(1280, 720);
+
+    std::unique_ptr<VideoEncoderZstd> encoder(
+        VideoEncoderZstd::create(desktop::PixelFormat::ARGB(), 1));
+
+    std::unique_ptr<desktop::Frame> frame = createFrame(size, 4);
+    frame->updatedRegion()->add(QRect(QPoint(), size));
+
+    proto::desktop::VideoPacket packet;
+    encoder->encode(frame.get(), &packet);
+    ASSERT_GT(packet.slice_size(), 1);
+
+    std::unique_ptr<desktop::Frame> decoded_frame = desktop::createTestFrame(size);
+
+    // The slices contain more data than the packet.
+    proto::desktop::VideoPacket broken_packet(packet);
+    broken_packet.mutable_slice(0)->set_data_size(packet.data().size() + 1);
+    EXPECT_FALSE(VideoDecoderZstd::create()->decode(broken_packet, decoded_frame.get()));
+
+    // The slices do not contain all rectangles.
+    broken_packet = packet;
+    broken_packet.mutable_slice()->RemoveLast();
+    EXPECT_FALSE(VideoDecoderZstd::create()->decode(broken_packet, decoded_frame.get()));
+
+    // The data of the last slice is truncated.
+    broken_packet = packet;
+    broken_packet.mutable_data()->resize(packet.data().size() - 16);
+    broken_packet.mutable_slice(packet.slice_size() - 1)->set_data_size(
+        packet.slice(packet.slice_size() - 1).data_size() - 16);
+    EXPECT_FALSE(VideoDecoderZstd::create()->decode(broken_packet, decoded_frame.get()));
+}
+
+} // namespace codec
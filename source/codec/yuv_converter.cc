@@ -0,0 +1,135 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "codec/yuv_converter.h"
+
+#include <libyuv/convert_argb.h>
+#include <libyuv/convert_from_argb.h>
+
+#include <algorithm>
+
+#include "base/thread_pool.h"
+#include "desktop/desktop_frame.h"
+
+namespace codec {
+
+namespace {
+
+// The height of the bands is even, so each band starts at a row of the I420 chroma planes.
+const int kBandHeight = 32;
+
+// The smaller updates are converted by the calling thread: waking up the pool threads costs more
+// than the conversion.
+const int64_t kMinParallelPixels = 256 * 256;
+
+} // namespace
+
+YuvConverter::YuvConverter(int thread_count)
+    : thread_count_(thread_count > 0 ? thread_count : base::ThreadPool::processorCount())
+{
+    // Nothing
+}
+
+YuvConverter::~YuvConverter() = default;
+
+void YuvConverter::convertToI420(const desktop::Frame* frame,
+                                 const QRect* rects,
+                                 int count,
+                                 vpx_image_t* image)
+{
+    const int y_stride = image->stride[0];
+    const int uv_stride = image->stride[1];
+
+    convertBands(rects, count, [&](const QRect& rect)
+    {
+        const int y_offset = y_stride * rect.y() + rect.x();
+        const int uv_offset = uv_stride * (rect.y() / 2) + rect.x() / 2;
+
+        libyuv::ARGBToI420(frame->frameDataAtPos(rect.topLeft()),
+                           frame->stride(),
+                           image->planes[0] + y_offset, y_stride,
+                           image->planes[1] + uv_offset, uv_stride,
+                           image->planes[2] + uv_offset, uv_stride,
+                           rect.width(),
+                           rect.height());
+    });
+}
+
+void YuvConverter::convertFromI420(const vpx_image_t* image,
+                                   const QRect* rects,
+                                   int count,
+                                   desktop::Frame* frame)
+{
+    const int y_stride = image->stride[0];
+    const int uv_stride = image->stride[1];
+
+    convertBands(rects, count, [&](const QRect& rect)
+    {
+        const int y_offset = y_stride * rect.y() + rect.x();
+        const int uv_offset = uv_stride * (rect.y() / 2) + rect.x() / 2;
+
+        libyuv::I420ToARGB(image->planes[0] + y_offset, y_stride,
+                           image->planes[1] + uv_offset, uv_stride,
+                           image->planes[2] + uv_offset, uv_stride,
+                           frame->frameDataAtPos(rect.topLeft()),
+                           frame->stride(),
+                           rect.width(),
+                           rect.height());
+    });
+}
+
+void YuvConverter::convertBands(const QRect* rects, int count, const ConvertFunction& convert)
+{
+    int64_t pixel_count = 0;
+
+    for (int i = 0; i < count; ++i)
+        pixel_count += static_cast<int64_t>(rects[i].width()) * rects[i].height();
+
+    if (thread_count_ == 1 || pixel_count < kMinParallelPixels)
+    {
+        for (int i = 0; i < count; ++i)
+            convert(rects[i]);
+
+        return;
+    }
+
+    bands_.clear();
+
+    // The bands start at the even offsets from the tops of the rectangles, so the chroma rows are
+    // shared in the same way as in the conversion of the whole rectangles.
+    for (int i = 0; i < count; ++i)
+    {
+        const QRect& rect = rects[i];
+
+        for (int top = rect.top(); top <= rect.bottom(); top += kBandHeight)
+        {
+            bands_.emplace_back(rect.left(), top, rect.width(),
+                                std::min(kBandHeight, rect.bottom() + 1 - top));
+        }
+    }
+
+    if (!thread_pool_)
+        thread_pool_ = std::make_unique<base::ThreadPool>(thread_count_);
+
+    thread_pool_->parallelFor(static_cast<int>(bands_.size()), [&](int index)
+    {
+        convert(bands_[index]);
+    });
+}
+
+} // namespace codec
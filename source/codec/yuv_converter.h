@@ -0,0 +1,80 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef CODEC__YUV_CONVERTER_H
+#define CODEC__YUV_CONVERTER_H
+
+#include <QRect>
+
+#include <vpx/vpx_image.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base/macros_magic.h"
+
+namespace base {
+class ThreadPool;
+} // namespace base
+
+namespace desktop {
+class Frame;
+} // namespace desktop
+
+namespace codec {
+
+// Converts the rectangles of the screen between the ARGB frame and the I420 image of the VPX
+// codecs. The large updates are divided into bands of rows which are converted in parallel.
+class YuvConverter
+{
+public:
+    // If |thread_count| is 0, the number of threads is equal to the number of processors.
+    explicit YuvConverter(int thread_count = 0);
+    ~YuvConverter();
+
+    // The top left corners of the rectangles must be even. The rectangles must be inside the
+    // frame and the image.
+    void convertToI420(const desktop::Frame* frame,
+                       const QRect* rects,
+                       int count,
+                       vpx_image_t* image);
+    void convertFromI420(const vpx_image_t* image,
+                         const QRect* rects,
+                         int count,
+                         desktop::Frame* frame);
+
+    int threadCount() const { return thread_count_; }
+
+private:
+    using ConvertFunction = std::function<void(const QRect& rect)>;
+
+    void convertBands(const QRect* rects, int count, const ConvertFunction& convert);
+
+    const int thread_count_;
+    std::unique_ptr<base::ThreadPool> thread_pool_;
+
+    // The bands of the rectangles of the current conversion.
+    std::vector<QRect> bands_;
+
+    DISALLOW_COPY_AND_ASSIGN(YuvConverter);
+};
+
+} // namespace codec
+
+#endif // CODEC__YUV_CONVERTER_H
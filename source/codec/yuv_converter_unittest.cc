@@ -0,0 +1,105 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "codec/yuv_converter.h"
+#include "desktop/frame_test_util.h"
+
+#include <cstring>
+#include <vector>
+
+namespace codec {
+
+namespace {
+
+const QSize kFrameSize(1000, 600);
+
+// I420 image with the planes in |buffer|.
+struct Image
+{
+    explicit Image(const QSize& size)
+        : y_stride((size.width() + 15) & ~15),
+          uv_stride(((size.width() + 1) / 2 + 15) & ~15),
+          uv_rows((size.height() + 1) / 2),
+          buffer(y_stride * size.height() + uv_stride * uv_rows * 2)
+    {
+        memset(&image, 0, sizeof(image));
+
+        image.fmt = VPX_IMG_FMT_I420;
+        image.d_w = image.w = size.width();
+        image.d_h = image.h = size.height();
+        image.planes[0] = buffer.data();
+        image.planes[1] = image.planes[0] + y_stride * size.height();
+        image.planes[2] = image.planes[1] + uv_stride * uv_rows;
+        image.stride[0] = y_stride;
+        image.stride[1] = image.stride[2] = uv_stride;
+    }
+
+    const int y_stride;
+    const int uv_stride;
+    const int uv_rows;
+    std::vector<uint8_t> buffer;
+    vpx_image_t image;
+};
+
+std::unique_ptr<desktop::Frame> createFrame(uint32_t seed)
+{
+    std::unique_ptr<desktop::Frame> frame = desktop::createTestFrame(kFrameSize);
+    fillRandomPixels(frame.get(), QRect(QPoint(), kFrameSize), seed);
+    return frame;
+}
+
+} // namespace
+
+TEST(yuv_converter, parallel_conversion)
+{
+    std::unique_ptr<desktop::Frame> frame = createFrame(1);
+
+    // The whole frame, a large rectangle with odd size and a small rectangle.
+    const QRect rects[] =
+    {
+        QRect(QPoint(), kFrameSize),
+        QRect(100, 50, 701, 455),
+        QRect(10, 10, 16, 16)
+    };
+
+    for (const auto& rect : rects)
+    {
+        Image serial_image(kFrameSize);
+        Image parallel_image(kFrameSize);
+
+        YuvConverter serial_converter(1);
+        YuvConverter parallel_converter(4);
+
+        serial_converter.convertToI420(frame.get(), &rect, 1, &serial_image.image);
+        parallel_converter.convertToI420(frame.get(), &rect, 1, &parallel_image.image);
+
+        EXPECT_EQ(serial_image.buffer, parallel_image.buffer);
+
+        std::unique_ptr<desktop::Frame> serial_frame = createFrame(2);
+        std::unique_ptr<desktop::Frame> parallel_frame = createFrame(2);
+
+        serial_converter.convertFromI420(&serial_image.image, &rect, 1, serial_frame.get());
+        parallel_converter.convertFromI420(&serial_image.image, &rect, 1, parallel_frame.get());
+
+        EXPECT_TRUE(isEqualFrames(serial_frame.get(), parallel_frame.get()));
+    }
+}
+
+} // namespace codec
@@ -29,6 +29,7 @@ namespace {
 const int kDefUpdateInterval = 30;
 const int kDefScaleFactor = 100;
 const int kDefCompressRatio = 8;
+const int kDefTileCacheSize = 1024;
 
 void setDefaultDesktopManageConfig(proto::desktop::Config* config)
 {
@@ -36,13 +37,15 @@ void setDefaultDesktopManageConfig(proto::desktop::Config* config)
 
     static const uint32_t kDefaultFlags =
         proto::desktop::ENABLE_CLIPBOARD | proto::desktop::ENABLE_CURSOR_SHAPE |
-        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER;
+        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER |
+        proto::desktop::ENABLE_INTER_FRAME_COMPRESSION;
 
     config->set_flags(kDefaultFlags);
     config->set_video_encoding(proto::desktop::VideoEncoding::VIDEO_ENCODING_ZSTD);
     config->set_compress_ratio(kDefCompressRatio);
     config->set_scale_factor(kDefScaleFactor);
     config->set_update_interval(kDefUpdateInterval);
+    config->set_tile_cache_size(kDefTileCacheSize);
 
     codec::VideoUtil::toVideoPixelFormat(
         desktop::PixelFormat::RGB565(), config->mutable_pixel_format());
@@ -53,13 +56,15 @@ void setDefaultDesktopViewConfig(proto::desktop::Config* config)
     DCHECK(config);
 
     static const uint32_t kDefaultFlags =
-        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER;
+        proto::desktop::DISABLE_DESKTOP_EFFECTS | proto::desktop::DISABLE_DESKTOP_WALLPAPER |
+        proto::desktop::ENABLE_INTER_FRAME_COMPRESSION;
 
     config->set_flags(kDefaultFlags);
     config->set_video_encoding(proto::desktop::VideoEncoding::VIDEO_ENCODING_ZSTD);
     config->set_compress_ratio(kDefCompressRatio);
     config->set_scale_factor(kDefScaleFactor);
     config->set_update_interval(kDefUpdateInterval);
+    config->set_tile_cache_size(kDefTileCacheSize);
 
     codec::VideoUtil::toVideoPixelFormat(
         desktop::PixelFormat::RGB565(), config->mutable_pixel_format());
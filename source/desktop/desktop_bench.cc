@@ -0,0 +1,666 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "base/benchmark.h"
+#include "base/thread_pool.h"
+#include "codec/pixel_translator.h"
+#include "codec/pixel_translator_avx2.h"
+#include "codec/pixel_translator_sse2.h"
+#include "codec/pixel_translator_sse3.h"
+#include "codec/scale_reducer.h"
+#include "codec/video_decoder_vpx.h"
+#include "codec/video_encoder_vpx.h"
+#include "codec/yuv_converter.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/diff_block_avx2.h"
+#include "desktop/diff_block_c.h"
+#include "desktop/diff_block_sse2.h"
+#include "desktop/diff_block_sse3.h"
+#include "desktop/differ.h"
+#include "desktop/frame_pattern.h"
+#include "desktop/move_detector.h"
+
+#include <libyuv/cpu_id.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace desktop {
+
+namespace {
+
+const int kAlignment = 32;
+
+const QSize kResolutions[] = { QSize(1920, 1080), QSize(2560, 1440), QSize(3840, 2160) };
+
+const FramePattern kPatterns[] =
+{
+    FramePattern::IDLE,
+    FramePattern::CARET,
+    FramePattern::TYPING,
+    FramePattern::SCROLLING,
+    FramePattern::VIDEO
+};
+
+std::string sizeString(const QSize& size)
+{
+    return std::to_string(size.width()) + "x" + std::to_string(size.height());
+}
+
+// The previous and the current frame of a screen update.
+struct FramePair
+{
+    FramePair(const QSize& size, FramePattern pattern)
+        : previous(FrameAligned::create(size, PixelFormat::ARGB(), kAlignment)),
+          current(FrameAligned::create(size, PixelFormat::ARGB(), kAlignment))
+    {
+        drawDesktop(previous.get(), 1);
+        applyFramePattern(pattern, previous.get(), current.get(), 1);
+    }
+
+    int64_t frameBytes() const
+    {
+        return static_cast<int64_t>(current->stride()) * current->size().height();
+    }
+
+    std::unique_ptr<Frame> previous;
+    std::unique_ptr<Frame> current;
+};
+
+typedef uint8_t(*DiffFullBlockFunc)(const uint8_t*, const uint8_t*, int);
+
+struct DiffKernel
+{
+    const char* cpu;
+    int cpu_flag; // 0 if the kernel does not need special instructions.
+    int block_size;
+    DiffFullBlockFunc func;
+};
+
+const DiffKernel kDiffKernels[] =
+{
+    { "C",    0,                      8,  diffFullBlock_8x8_C },
+    { "C",    0,                      16, diffFullBlock_16x16_C },
+    { "C",    0,                      32, diffFullBlock_32x32_C },
+    { "SSE2", libyuv::kCpuHasSSE2,    8,  diffFullBlock_8x8_SSE2 },
+    { "SSE2", libyuv::kCpuHasSSE2,    16, diffFullBlock_16x16_SSE2 },
+    { "SSE2", libyuv::kCpuHasSSE2,    32, diffFullBlock_32x32_SSE2 },
+    { "SSE3", libyuv::kCpuHasSSSE3,   8,  diffFullBlock_8x8_SSE3 },
+    { "SSE3", libyuv::kCpuHasSSSE3,   16, diffFullBlock_16x16_SSE3 },
+    { "SSE3", libyuv::kCpuHasSSSE3,   32, diffFullBlock_32x32_SSE3 },
+    { "AVX2", libyuv::kCpuHasAVX2,    8,  diffFullBlock_8x8_AVX2 },
+    { "AVX2", libyuv::kCpuHasAVX2,    16, diffFullBlock_16x16_AVX2 },
+    { "AVX2", libyuv::kCpuHasAVX2,    32, diffFullBlock_32x32_AVX2 }
+};
+
+// Compares all full blocks of the frames with the kernel. The result is accumulated, so that the
+// compiler does not remove the calls.
+int diffAllBlocks(DiffFullBlockFunc func, int block_size, const Frame* previous,
+                  const Frame* current)
+{
+    const int blocks_x = current->size().width() / block_size;
+    const int blocks_y = current->size().height() / block_size;
+    const int stride = current->stride();
+
+    int dirty_blocks = 0;
+
+    for (int y = 0; y < blocks_y; ++y)
+    {
+        for (int x = 0; x < blocks_x; ++x)
+        {
+            dirty_blocks += func(previous->frameDataAtPos(x * block_size, y * block_size),
+                                 current->frameDataAtPos(x * block_size, y * block_size),
+                                 stride);
+        }
+    }
+
+    return dirty_blocks;
+}
+
+void benchmarkDiffKernels(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("diff_block", "diffFullBlock"))
+        return;
+
+    const QSize size = kResolutions[0];
+
+    for (auto pattern : kPatterns)
+    {
+        FramePair frames(size, pattern);
+
+        for (const auto& kernel : kDiffKernels)
+        {
+            if (kernel.cpu_flag && !libyuv::TestCpuFlag(kernel.cpu_flag))
+                continue;
+
+            volatile int dirty_blocks = 0;
+
+            benchmark->run("diff_block", "diffFullBlock",
+                           { { "cpu", kernel.cpu },
+                             { "block_size", std::to_string(kernel.block_size) },
+                             { "resolution", sizeString(size) },
+                             { "pattern", framePatternName(pattern) } },
+                           frames.frameBytes() * 2,
+                           [&]()
+            {
+                dirty_blocks = diffAllBlocks(kernel.func, kernel.block_size,
+                                             frames.previous.get(), frames.current.get());
+            });
+        }
+    }
+}
+
+void benchmarkDiffer(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("differ", "calcDirtyRegion"))
+        return;
+
+    for (const auto& size : kResolutions)
+    {
+        for (auto pattern : kPatterns)
+        {
+            FramePair frames(size, pattern);
+
+            for (int block_size : { 8, 16, 32 })
+            {
+                for (int thread_count : { 1, Differ::kAutoThreadCount })
+                {
+                    Differ differ(size, thread_count);
+                    differ.setBlockSize(block_size);
+
+                    DirtyRegion region;
+
+                    benchmark->run("differ", "calcDirtyRegion",
+                                   { { "resolution", sizeString(size) },
+                                     { "pattern", framePatternName(pattern) },
+                                     { "block_size", std::to_string(block_size) },
+                                     { "threads", std::to_string(differ.threadCount()) } },
+                                   frames.frameBytes() * 2,
+                                   [&]()
+                    {
+                        differ.calcDirtyRegion(frames.previous->frameData(),
+                                               frames.current->frameData(),
+                                               &region);
+                    });
+                }
+            }
+        }
+    }
+}
+
+// Keeping the previous frame in a reference buffer: the differ copies the changed blocks to the
+// reference during the search ("fused") or the changed region is copied after the search
+// ("separate"). The reference is compared alternately with the current and the previous frame,
+// so that each call finds the changes of the pattern.
+void benchmarkReferenceUpdate(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("differ", "updateReference"))
+        return;
+
+    for (const auto& size : kResolutions)
+    {
+        for (auto pattern : kPatterns)
+        {
+            FramePair frames(size, pattern);
+
+            std::unique_ptr<Frame> reference =
+                FrameAligned::create(size, PixelFormat::ARGB(), kAlignment);
+
+            for (bool fused : { true, false })
+            {
+                Differ differ(size, 1);
+                DirtyRegion region;
+                bool toggle = false;
+
+                memcpy(reference->frameData(), frames.previous->frameData(), frames.frameBytes());
+
+                benchmark->run("differ", "updateReference",
+                               { { "resolution", sizeString(size) },
+                                 { "pattern", framePatternName(pattern) },
+                                 { "mode", fused ? "fused" : "separate" } },
+                               frames.frameBytes() * 2,
+                               [&]()
+                {
+                    toggle = !toggle;
+                    const Frame* source = toggle ? frames.current.get() : frames.previous.get();
+
+                    if (fused)
+                    {
+                        differ.calcDirtyRegionAndUpdate(
+                            reference->frameData(), source->frameData(), &region);
+                    }
+                    else
+                    {
+                        differ.calcDirtyRegion(
+                            reference->frameData(), source->frameData(), &region);
+                        reference->copyPixelsFrom(*source, region);
+                    }
+                });
+            }
+        }
+    }
+}
+
+// Search for the moved areas in the dirty region of the pattern. On the first frame the window
+// search runs for each large dirty rectangle ("first"). For the repeated frames of the same
+// pattern the search is skipped for the rectangles that changed in place ("repeated").
+void benchmarkMoveDetector(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("move_detector", "detect"))
+        return;
+
+    for (const auto& size : kResolutions)
+    {
+        for (auto pattern : kPatterns)
+        {
+            FramePair frames(size, pattern);
+
+            Differ differ(size, 1);
+            DirtyRegion region;
+            differ.calcDirtyRegion(frames.previous->frameData(), frames.current->frameData(),
+                                   &region);
+
+            for (bool repeated : { false, true })
+            {
+                MoveDetector repeated_detector;
+                QVector<CopyRect> copy_rects;
+
+                benchmark->run("move_detector", "detect",
+                               { { "resolution", sizeString(size) },
+                                 { "pattern", framePatternName(pattern) },
+                                 { "frames", repeated ? "repeated" : "first" } },
+                               frames.frameBytes() * 2,
+                               [&]()
+                {
+                    if (repeated)
+                    {
+                        repeated_detector.detect(frames.previous.get(), frames.current.get(),
+                                                 region, &copy_rects);
+                    }
+                    else
+                    {
+                        MoveDetector detector;
+                        detector.detect(frames.previous.get(), frames.current.get(), region,
+                                        &copy_rects);
+                    }
+                });
+            }
+        }
+    }
+}
+
+void benchmarkPixelTranslator(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("pixel_translator", "translate"))
+        return;
+
+    struct Format
+    {
+        const char* name;
+        PixelFormat format;
+    };
+
+    const Format kFormats[] =
+    {
+        { "ARGB",   PixelFormat::ARGB() },
+        { "RGB565", PixelFormat::RGB565() },
+        { "RGB332", PixelFormat::RGB332() },
+        { "RGB222", PixelFormat::RGB222() },
+        { "RGB111", PixelFormat::RGB111() }
+    };
+
+    const QSize size = kResolutions[0];
+
+    for (const auto& source : kFormats)
+    {
+        std::unique_ptr<Frame> source_frame =
+            FrameAligned::create(size, source.format, kAlignment);
+
+        // The content does not matter for the table based translators, but random pixels avoid
+        // the unrealistic best case of the same value everywhere.
+        uint32_t value = 1;
+        for (int i = 0; i < source_frame->stride() * size.height(); ++i)
+        {
+            value = value * 1664525 + 1013904223;
+            source_frame->frameData()[i] = static_cast<uint8_t>(value >> 24);
+        }
+
+        for (const auto& target : kFormats)
+        {
+            std::unique_ptr<codec::PixelTranslator> translator =
+                codec::PixelTranslator::create(source.format, target.format);
+            if (!translator)
+                continue;
+
+            std::unique_ptr<Frame> target_frame =
+                FrameAligned::create(size, target.format, kAlignment);
+
+            benchmark->run("pixel_translator", "translate",
+                           { { "source", source.name },
+                             { "target", target.name },
+                             { "resolution", sizeString(size) } },
+                           static_cast<int64_t>(source_frame->stride()) * size.height(),
+                           [&]()
+            {
+                translator->translate(source_frame->frameData(), source_frame->stride(),
+                                      target_frame->frameData(), target_frame->stride(),
+                                      size.width(), size.height());
+            });
+        }
+    }
+}
+
+typedef void(*TranslateFunc)(const uint8_t* src, int src_stride,
+                             uint8_t* dst, int dst_stride,
+                             int width, int height);
+
+struct TranslateKernel
+{
+    const char* cpu;
+    int cpu_flag; // 0 if the kernel does not need special instructions.
+    const char* source;
+    const char* target;
+    TranslateFunc func; // nullptr for the table translator.
+};
+
+const TranslateKernel kTranslateKernels[] =
+{
+    { "C",    0,                    "ARGB",   "RGB565", nullptr },
+    { "SSE2", libyuv::kCpuHasSSE2,  "ARGB",   "RGB565", codec::translateARGBToRGB565_SSE2 },
+    { "SSE3", libyuv::kCpuHasSSSE3, "ARGB",   "RGB565", codec::translateARGBToRGB565_SSE3 },
+    { "AVX2", libyuv::kCpuHasAVX2,  "ARGB",   "RGB565", codec::translateARGBToRGB565_AVX2 },
+    { "C",    0,                    "ARGB",   "RGB332", nullptr },
+    { "SSE2", libyuv::kCpuHasSSE2,  "ARGB",   "RGB332", codec::translateARGBToRGB332_SSE2 },
+    { "SSE3", libyuv::kCpuHasSSSE3, "ARGB",   "RGB332", codec::translateARGBToRGB332_SSE3 },
+    { "AVX2", libyuv::kCpuHasAVX2,  "ARGB",   "RGB332", codec::translateARGBToRGB332_AVX2 },
+    { "C",    0,                    "RGB565", "ARGB",   nullptr },
+    { "SSE2", libyuv::kCpuHasSSE2,  "RGB565", "ARGB",   codec::translateRGB565ToARGB_SSE2 },
+    { "AVX2", libyuv::kCpuHasAVX2,  "RGB565", "ARGB",   codec::translateRGB565ToARGB_AVX2 }
+};
+
+PixelFormat pixelFormatByName(const std::string& name)
+{
+    if (name == "RGB565")
+        return PixelFormat::RGB565();
+
+    if (name == "RGB332")
+        return PixelFormat::RGB332();
+
+    return PixelFormat::ARGB();
+}
+
+// The table translator and the SIMD kernels for the pairs of formats which have the kernels.
+void benchmarkTranslateKernels(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("pixel_translator", "translateKernel"))
+        return;
+
+    const QSize size = kResolutions[0];
+
+    for (const auto& kernel : kTranslateKernels)
+    {
+        if (kernel.cpu_flag && !libyuv::TestCpuFlag(kernel.cpu_flag))
+            continue;
+
+        const PixelFormat source_format = pixelFormatByName(kernel.source);
+        const PixelFormat target_format = pixelFormatByName(kernel.target);
+
+        FramePair frames(size, FramePattern::TYPING);
+
+        std::unique_ptr<Frame> source_frame =
+            FrameAligned::create(size, source_format, kAlignment);
+        std::unique_ptr<Frame> target_frame =
+            FrameAligned::create(size, target_format, kAlignment);
+
+        std::unique_ptr<codec::PixelTranslator> table_translator =
+            codec::PixelTranslator::createTable(PixelFormat::ARGB(), source_format);
+
+        // The desktop image in the source format.
+        table_translator->translate(frames.current->frameData(), frames.current->stride(),
+                                    source_frame->frameData(), source_frame->stride(),
+                                    size.width(), size.height());
+
+        table_translator = codec::PixelTranslator::createTable(source_format, target_format);
+
+        benchmark->run("pixel_translator", "translateKernel",
+                       { { "cpu", kernel.cpu },
+                         { "source", kernel.source },
+                         { "target", kernel.target },
+                         { "resolution", sizeString(size) } },
+                       static_cast<int64_t>(source_frame->stride()) * size.height(),
+                       [&]()
+        {
+            if (kernel.func)
+            {
+                kernel.func(source_frame->frameData(), source_frame->stride(),
+                            target_frame->frameData(), target_frame->stride(),
+                            size.width(), size.height());
+            }
+            else
+            {
+                table_translator->translate(source_frame->frameData(), source_frame->stride(),
+                                            target_frame->frameData(), target_frame->stride(),
+                                            size.width(), size.height());
+            }
+        });
+    }
+}
+
+void benchmarkScaleReducer(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("scale_reducer", "scaleFrame"))
+        return;
+
+    for (const auto& size : kResolutions)
+    {
+        for (auto pattern : kPatterns)
+        {
+            // The scale reducer is not called for the frames without changes.
+            if (pattern == FramePattern::IDLE)
+                continue;
+
+            FramePair frames(size, pattern);
+
+            Differ differ(size, 1);
+            differ.calcDirtyRegion(frames.previous->frameData(),
+                                   frames.current->frameData(),
+                                   frames.current->updatedRegion());
+
+            for (int scale_factor : { 50, 75 })
+            {
+                std::unique_ptr<codec::ScaleReducer> scale_reducer(
+                    codec::ScaleReducer::create(scale_factor));
+
+                benchmark->run("scale_reducer", "scaleFrame",
+                               { { "resolution", sizeString(size) },
+                                 { "pattern", framePatternName(pattern) },
+                                 { "scale", std::to_string(scale_factor) } },
+                               frames.frameBytes(),
+                               [&]()
+                {
+                    scale_reducer->scaleFrame(frames.current.get());
+                });
+            }
+        }
+    }
+}
+
+// Thread counts up to the number of processors.
+std::vector<int> threadCounts()
+{
+    std::vector<int> counts;
+
+    for (int count = 1; count <= base::ThreadPool::processorCount() && count <= 16; count *= 2)
+        counts.push_back(count);
+
+    return counts;
+}
+
+void benchmarkYuvConverter(base::Benchmark* benchmark)
+{
+    if (!benchmark->isEnabled("yuv_converter", "convertToI420") &&
+        !benchmark->isEnabled("yuv_converter", "convertFromI420"))
+    {
+        return;
+    }
+
+    for (const auto& size : kResolutions)
+    {
+        std::unique_ptr<Frame> frame = FrameAligned::create(size, PixelFormat::ARGB(), kAlignment);
+        drawDesktop(frame.get(), 1);
+
+        // The planes are aligned in the same way as the planes of the VPX encoder.
+        const int y_stride = (size.width() + 15) & ~15;
+        const int uv_stride = (y_stride / 2 + 15) & ~15;
+        const int uv_rows = (size.height() + 1) / 2;
+
+        std::vector<uint8_t> buffer(y_stride * size.height() + uv_stride * uv_rows * 2);
+
+        vpx_image_t image;
+        memset(&image, 0, sizeof(image));
+
+        image.fmt = VPX_IMG_FMT_I420;
+        image.d_w = image.w = size.width();
+        image.d_h = image.h = size.height();
+        image.planes[0] = buffer.data();
+        image.planes[1] = image.planes[0] + y_stride * size.height();
+        image.planes[2] = image.planes[1] + uv_stride * uv_rows;
+        image.stride[0] = y_stride;
+        image.stride[1] = image.stride[2] = uv_stride;
+
+        // A full screen update.
+        const QRect rect(QPoint(), size);
+        const int64_t frame_bytes = static_cast<int64_t>(frame->stride()) * size.height();
+
+        for (int thread_count : threadCounts())
+        {
+            const base::Benchmark::Params params =
+            {
+                { "resolution", sizeString(size) },
+                { "threads", std::to_string(thread_count) }
+            };
+
+            codec::YuvConverter converter(thread_count);
+
+            benchmark->run("yuv_converter", "convertToI420", params, frame_bytes, [&]()
+            {
+                converter.convertToI420(frame.get(), &rect, 1, &image);
+            });
+
+            benchmark->run("yuv_converter", "convertFromI420", params, frame_bytes, [&]()
+            {
+                converter.convertFromI420(&image, &rect, 1, frame.get());
+            });
+        }
+    }
+}
+
+void benchmarkVp9(base::Benchmark* benchmark)
+{
+    const bool encode_enabled = benchmark->isEnabled("vp9", "encode");
+    const bool decode_enabled = benchmark->isEnabled("vp9", "decode");
+
+    if (!encode_enabled && !decode_enabled)
+        return;
+
+    for (const auto& size : kResolutions)
+    {
+        for (auto pattern : { FramePattern::SCROLLING, FramePattern::VIDEO })
+        {
+            FramePair frames(size, pattern);
+
+            Differ differ(size, 1);
+            differ.calcDirtyRegion(frames.previous->frameData(),
+                                   frames.current->frameData(),
+                                   frames.current->updatedRegion());
+
+            // The frames are encoded in turns, so each frame differs from the previous one.
+            *frames.previous->updatedRegion() = frames.current->constUpdatedRegion();
+
+            for (int thread_count : threadCounts())
+            {
+                const base::Benchmark::Params params =
+                {
+                    { "resolution", sizeString(size) },
+                    { "pattern", framePatternName(pattern) },
+                    { "threads", std::to_string(thread_count) }
+                };
+
+                std::unique_ptr<codec::VideoEncoderVPX> encoder(
+                    codec::VideoEncoderVPX::createVP9(thread_count));
+
+                // The first packet is a key frame with the whole screen.
+                proto::desktop::VideoPacket key_packet;
+                encoder->encode(frames.previous.get(), &key_packet);
+
+                if (encode_enabled)
+                {
+                    proto::desktop::VideoPacket packet;
+                    int index = 0;
+
+                    benchmark->run("vp9", "encode", params, frames.frameBytes(), [&]()
+                    {
+                        packet.Clear();
+                        encoder->encode(
+                            (index++ & 1) ? frames.previous.get() : frames.current.get(),
+                            &packet);
+                    });
+                }
+
+                if (decode_enabled)
+                {
+                    std::unique_ptr<codec::VideoDecoderVPX> decoder =
+                        codec::VideoDecoderVPX::createVP9(thread_count);
+                    std::unique_ptr<Frame> decoded_frame =
+                        FrameAligned::create(size, PixelFormat::ARGB(), kAlignment);
+
+                    // The key frame does not depend on the previous frames and can be decoded
+                    // repeatedly.
+                    benchmark->run("vp9", "decode", params, frames.frameBytes(), [&]()
+                    {
+                        decoder->decode(key_packet, decoded_frame.get());
+                    });
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+} // namespace desktop
+
+int main(int argc, char* argv[])
+{
+    base::Benchmark benchmark(argc, argv);
+    if (!benchmark.isValid())
+        return 1;
+
+    desktop::benchmarkDiffKernels(&benchmark);
+    desktop::benchmarkDiffer(&benchmark);
+    desktop::benchmarkReferenceUpdate(&benchmark);
+    desktop::benchmarkMoveDetector(&benchmark);
+    desktop::benchmarkPixelTranslator(&benchmark);
+    desktop::benchmarkTranslateKernels(&benchmark);
+    desktop::benchmarkScaleReducer(&benchmark);
+    desktop::benchmarkYuvConverter(&benchmark);
+    desktop::benchmarkVp9(&benchmark);
+
+    return 0;
+}
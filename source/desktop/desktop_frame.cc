@@ -18,6 +18,10 @@
 
 #include "desktop/desktop_frame.h"
 
+#include "base/logging.h"
+
+#include <cstring>
+
 namespace desktop {
 
 Frame::Frame(const QSize& size, const PixelFormat& format, int stride, uint8_t* data)
@@ -44,4 +48,63 @@ uint8_t* Frame::frameDataAtPos(int x, int y) const
     return frameData() + stride() * y + format_.bytesPerPixel() * x;
 }
 
+void Frame::copyRect(const QRect& source_rect, const QPoint& dest_pos)
+{
+    if (source_rect.topLeft() == dest_pos)
+        return;
+
+    const int row_size = source_rect.width() * format_.bytesPerPixel();
+    const int height = source_rect.height();
+
+    const uint8_t* source = frameDataAtPos(source_rect.topLeft());
+    uint8_t* dest = frameDataAtPos(dest_pos);
+
+    if (dest_pos.y() > source_rect.y())
+    {
+        // The rectangle moves down. Copy the rows from the bottom so that the source rows are
+        // not overwritten before they are copied.
+        source += stride_ * (height - 1);
+        dest += stride_ * (height - 1);
+
+        for (int y = 0; y < height; ++y)
+        {
+            memmove(dest, source, row_size);
+            source -= stride_;
+            dest -= stride_;
+        }
+    }
+    else
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            memmove(dest, source, row_size);
+            source += stride_;
+            dest += stride_;
+        }
+    }
+}
+
+void Frame::copyPixelsFrom(const Frame& source, const DirtyRegion& region)
+{
+    DCHECK(source.size() == size_);
+    DCHECK(source.format() == format_);
+
+    const int bytes_per_pixel = format_.bytesPerPixel();
+
+    for (const auto& rect : region)
+    {
+        const int row_size = rect.width() * bytes_per_pixel;
+
+        const uint8_t* source_row = source.frameDataAtPos(rect.topLeft());
+        uint8_t* dest_row = frameDataAtPos(rect.topLeft());
+
+        for (int y = 0; y < rect.height(); ++y)
+        {
+            memcpy(dest_row, source_row, row_size);
+            source_row += source.stride();
+            dest_row += stride_;
+        }
+    }
+}
+
 } // namespace desktop
@@ -19,13 +19,22 @@
 #ifndef DESKTOP__DESKTOP_FRAME_H
 #define DESKTOP__DESKTOP_FRAME_H
 
-#include <QRegion>
+#include <QVector>
 
 #include "base/macros_magic.h"
+#include "desktop/dirty_region.h"
 #include "desktop/pixel_format.h"
 
 namespace desktop {
 
+// The rectangle |source_rect| of the previous frame which has moved to position |dest_pos| in
+// the current frame (scrolling or moving a window).
+struct CopyRect
+{
+    QRect source_rect;
+    QPoint dest_pos;
+};
+
 class Frame
 {
 public:
@@ -39,8 +48,21 @@ public:
     int stride() const { return stride_; }
     bool contains(int x, int y) const;
 
-    const QRegion& constUpdatedRegion() const { return updated_region_; }
-    QRegion* updatedRegion() { return &updated_region_; }
+    const DirtyRegion& constUpdatedRegion() const { return updated_region_; }
+    DirtyRegion* updatedRegion() { return &updated_region_; }
+
+    // The areas of |updated_region| which are the exact copies of other areas of the previous
+    // frame.
+    const QVector<CopyRect>& constCopyRects() const { return copy_rects_; }
+    QVector<CopyRect>* copyRects() { return &copy_rects_; }
+
+    // Copies the rectangle |source_rect| of the frame to the position |dest_pos|. The source and
+    // destination rectangles may overlap. Both rectangles must be inside the frame.
+    void copyRect(const QRect& source_rect, const QPoint& dest_pos);
+
+    // Copies the pixels of |region| from the frame |source|. The frames must have the same size
+    // and pixel format.
+    void copyPixelsFrom(const Frame& source, const DirtyRegion& region);
 
     const QPoint& topLeft() const { return top_left_; }
     void setTopLeft(const QPoint& top_left) { top_left_ = top_left; }
@@ -58,7 +80,8 @@ private:
     const PixelFormat format_;
     const int stride_;
 
-    QRegion updated_region_;
+    DirtyRegion updated_region_;
+    QVector<CopyRect> copy_rects_;
     QPoint top_left_;
 
     DISALLOW_COPY_AND_ASSIGN(Frame);
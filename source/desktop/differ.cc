@@ -19,6 +19,7 @@
 #include "desktop/differ.h"
 
 #include "base/logging.h"
+#include "base/thread_pool.h"
 #include "desktop/diff_block_avx2.h"
 #include "desktop/diff_block_sse2.h"
 #include "desktop/diff_block_sse3.h"
@@ -26,19 +27,73 @@
 
 #include <libyuv/cpu_id.h>
 
+#include <algorithm>
+
 namespace desktop {
 
 namespace {
 
 const int kBytesPerPixel = 4;
-const int kBlockSize = 8;
-const int kBytesPerBlock = kBytesPerPixel * kBlockSize;
+const int kDefaultBlockSize = 8;
+
+// Thresholds of the smoothed change density (fraction of the screen area) for switching the block
+// size in adaptive mode. The thresholds for increasing and decreasing the size differ, so that the
+// size does not flap when the density is near a threshold.
+const double kDensityUpTo16 = 0.06;
+const double kDensityDownTo8 = 0.03;
+const double kDensityUpTo32 = 0.35;
+const double kDensityDownTo16 = 0.25;
+
+// Weight of the last frame in the smoothed change density.
+const double kDensitySmoothing = 0.25;
+
+int blockSizeForDensity(double density, int current_block_size)
+{
+    switch (current_block_size)
+    {
+        case 8:
+            return (density > kDensityUpTo16) ? 16 : 8;
+
+        case 16:
+        {
+            if (density > kDensityUpTo32)
+                return 32;
+
+            if (density < kDensityDownTo8)
+                return 8;
+
+            return 16;
+        }
+
+        default:
+            return (density < kDensityDownTo16) ? 16 : 32;
+    }
+}
+
+// Frames with fewer pixels are compared in one thread. Below this size the cost of waking the
+// threads is comparable with the cost of the comparison.
+const int kMinPixelsForParallelDiff = 1920 * 1080;
+
+// Each thread gets several bands so that a thread that has got bands without changes (they are
+// compared slower, because all bytes of the block are read) does not slow down the others.
+const int kBandsPerThread = 4;
+
+int autoThreadCount(const QSize& size)
+{
+    if (size.width() * size.height() < kMinPixelsForParallelDiff)
+        return 1;
+
+    // One thread per 1920x1080 pixels, but not more than the number of processors.
+    int thread_count = (size.width() * size.height()) / kMinPixelsForParallelDiff + 1;
+
+    return std::min(thread_count, base::ThreadPool::processorCount());
+}
 
 //
 // Check for diffs in upper-left portion of the block. The size of the portion
 // to check is specified by the |width| and |height| values.
 // Note that if we force the capturer to always return images whose width and
-// height are multiples of kBlockSize, then this will never be called.
+// height are multiples of the block size, then this will never be called.
 //
 uint8_t diffPartialBlock(const uint8_t* prev_image,
                         const uint8_t* curr_image,
@@ -58,88 +113,199 @@ uint8_t diffPartialBlock(const uint8_t* prev_image,
     return 0U;
 }
 
+void copyBlock(uint8_t* dest_image,
+               const uint8_t* source_image,
+               int bytes_per_row,
+               int bytes_per_block,
+               int height)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        memcpy(dest_image, source_image, bytes_per_block);
+
+        dest_image += bytes_per_row;
+        source_image += bytes_per_row;
+    }
+}
+
 } // namespace
 
-Differ::Differ(const QSize& size)
+Differ::Differ(const QSize& size, int thread_count)
     : screen_rect_(QRect(QPoint(), size)),
-      bytes_per_row_(size.width() * kBytesPerPixel),
-      diff_width_(((size.width() + kBlockSize - 1) / kBlockSize) + 1),
-      diff_height_(((size.height() + kBlockSize - 1) / kBlockSize) + 1),
-      full_blocks_x_(size.width() / kBlockSize),
-      full_blocks_y_(size.height() / kBlockSize)
+      bytes_per_row_(size.width() * kBytesPerPixel)
 {
-    const int diff_info_size = diff_width_ * diff_height_;
+    if (thread_count == kAutoThreadCount)
+        thread_count = autoThreadCount(size);
 
-    diff_info_ = std::make_unique<uint8_t[]>(diff_info_size);
-    memset(diff_info_.get(), 0, diff_info_size);
-
-    // Calc size of partial blocks which may be present on right and bottom edge.
-    partial_column_width_ = size.width() - (full_blocks_x_ * kBlockSize);
-    partial_row_height_ = size.height() - (full_blocks_y_ * kBlockSize);
+    // The bands can not be thinner than one row of the smallest blocks.
+    thread_count_ = std::min(thread_count, (size.height() + kMinBlockSize - 1) / kMinBlockSize);
 
-    // Offset from the start of one block-row to the next.
-    block_stride_y_ = bytes_per_row_ * kBlockSize;
+    if (thread_count_ > 1)
+    {
+        thread_pool_ = std::make_unique<base::ThreadPool>(thread_count_);
+        LOG(LS_INFO) << "Parallel differ: " << thread_count_ << " threads";
+    }
+    else
+    {
+        thread_count_ = 1;
+    }
 
     if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
-    {
         LOG(LS_INFO) << "AVX2 differ loaded";
+    else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
+        LOG(LS_INFO) << "SSE3 differ loaded";
+    else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
+        LOG(LS_INFO) << "SSE2 differ loaded";
+    else
+        LOG(LS_INFO) << "C differ loaded";
+
+    resetBlocks(kDefaultBlockSize);
+}
+
+Differ::~Differ() = default;
+
+int Differ::threadCount() const
+{
+    return thread_pool_ ? thread_pool_->threadCount() : 1;
+}
+
+void Differ::setBlockSize(int block_size)
+{
+    if (block_size == kAdaptiveBlockSize)
+    {
+        adaptive_ = true;
+        change_density_ = 0;
+        resetBlocks(kMinBlockSize);
+        return;
+    }
+
+    DCHECK(block_size == 8 || block_size == 16 || block_size == 32);
 
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_AVX2;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_AVX2;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_AVX2;
+    adaptive_ = false;
+    resetBlocks(block_size);
+}
+
+// static
+Differ::DiffFullBlockFunc Differ::diffFullBlockFunc(int block_size)
+{
+    if (libyuv::TestCpuFlag(libyuv::kCpuHasAVX2))
+    {
+        switch (block_size)
+        {
+            case 8: return diffFullBlock_8x8_AVX2;
+            case 16: return diffFullBlock_16x16_AVX2;
+            default: return diffFullBlock_32x32_AVX2;
+        }
     }
     else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSSE3))
     {
-        LOG(LS_INFO) << "SSE3 differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_SSE3;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_SSE3;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_SSE3;
+        switch (block_size)
+        {
+            case 8: return diffFullBlock_8x8_SSE3;
+            case 16: return diffFullBlock_16x16_SSE3;
+            default: return diffFullBlock_32x32_SSE3;
+        }
     }
     else if (libyuv::TestCpuFlag(libyuv::kCpuHasSSE2))
     {
-        LOG(LS_INFO) << "SSE2 differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_SSE2;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_SSE2;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_SSE2;
+        switch (block_size)
+        {
+            case 8: return diffFullBlock_8x8_SSE2;
+            case 16: return diffFullBlock_16x16_SSE2;
+            default: return diffFullBlock_32x32_SSE2;
+        }
     }
     else
     {
-        LOG(LS_INFO) << "C differ loaded";
-
-        if constexpr (kBlockSize == 8)
-            diff_full_block_func_ = diffFullBlock_8x8_C;
-        else if constexpr (kBlockSize == 16)
-            diff_full_block_func_ = diffFullBlock_16x16_C;
-        else if constexpr (kBlockSize == 32)
-            diff_full_block_func_ = diffFullBlock_32x32_C;
+        switch (block_size)
+        {
+            case 8: return diffFullBlock_8x8_C;
+            case 16: return diffFullBlock_16x16_C;
+            default: return diffFullBlock_32x32_C;
+        }
     }
 }
 
+void Differ::resetBlocks(int block_size)
+{
+    const QSize& size = screen_rect_.size();
+
+    block_size_ = block_size;
+    bytes_per_block_ = kBytesPerPixel * block_size_;
+
+    diff_width_ = ((size.width() + block_size_ - 1) / block_size_) + 1;
+    diff_height_ = ((size.height() + block_size_ - 1) / block_size_) + 1;
+
+    full_blocks_x_ = size.width() / block_size_;
+    full_blocks_y_ = size.height() / block_size_;
+
+    const int diff_info_size = diff_width_ * diff_height_;
+
+    diff_info_ = std::make_unique<uint8_t[]>(diff_info_size);
+    memset(diff_info_.get(), 0, diff_info_size);
+
+    // A row of blocks can not have more spans than half of its blocks plus one.
+    spans_ = std::make_unique<DirtyRegion::Span[]>(diff_width_ / 2 + 1);
+
+    // Calc size of partial blocks which may be present on right and bottom edge.
+    partial_column_width_ = size.width() - (full_blocks_x_ * block_size_);
+    partial_row_height_ = size.height() - (full_blocks_y_ * block_size_);
+
+    // Offset from the start of one block-row to the next.
+    block_stride_y_ = bytes_per_row_ * block_size_;
+
+    block_rows_ = full_blocks_y_ + ((partial_row_height_ != 0) ? 1 : 0);
+    band_count_ = std::max(std::min(thread_count_ * kBandsPerThread, block_rows_), 1);
+
+    diff_full_block_func_ = diffFullBlockFunc(block_size_);
+}
+
 //
 // Identify all of the blocks that contain changed pixels.
 //
-void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image)
+void Differ::markDirtyBlocks(const uint8_t* prev_image,
+                             const uint8_t* curr_image,
+                             uint8_t* update_image)
+{
+    if (!thread_pool_)
+    {
+        markDirtyBlockRows(prev_image, curr_image, update_image, 0, block_rows_);
+        return;
+    }
+
+    // Each band writes only its own rows of |diff_info_|, so the results of the bands do not
+    // overlap and are merged simply by waiting for the completion of all bands.
+    thread_pool_->parallelFor(band_count_, [&](int band)
+    {
+        const int first_row = (block_rows_ * band) / band_count_;
+        const int last_row = (block_rows_ * (band + 1)) / band_count_;
+
+        markDirtyBlockRows(prev_image, curr_image, update_image, first_row, last_row);
+    });
+}
+
+//
+// Identify the blocks that contain changed pixels in block rows [first_row, last_row). If
+// |update_image| is not null, the changed blocks are copied from |curr_image| to |update_image|
+// right after the comparison, while they are still in the cache.
+//
+void Differ::markDirtyBlockRows(const uint8_t* prev_image,
+                                const uint8_t* curr_image,
+                                uint8_t* update_image,
+                                int first_row,
+                                int last_row)
 {
-    const uint8_t* prev_block_row_start = prev_image;
-    const uint8_t* curr_block_row_start = curr_image;
+    const uint8_t* prev_block_row_start = prev_image + first_row * block_stride_y_;
+    const uint8_t* curr_block_row_start = curr_image + first_row * block_stride_y_;
 
     // Offset from the start of one diff_info row to the next.
     const int diff_stride = diff_width_;
 
-    uint8_t* is_diff_row_start = diff_info_.get();
+    uint8_t* is_diff_row_start = diff_info_.get() + first_row * diff_stride;
+
+    const int last_full_row = std::min(last_row, full_blocks_y_);
 
-    for (int y = 0; y < full_blocks_y_; ++y)
+    for (int y = first_row; y < last_full_row; ++y)
     {
         const uint8_t* prev_block = prev_block_row_start;
         const uint8_t* curr_block = curr_block_row_start;
@@ -152,8 +318,14 @@ void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_imag
             // incorporated into a dirty rect.
             *is_different = diff_full_block_func_(prev_block, curr_block, bytes_per_row_);
 
-            prev_block += kBytesPerBlock;
-            curr_block += kBytesPerBlock;
+            if (*is_different && update_image)
+            {
+                copyBlock(update_image + (curr_block - curr_image), curr_block,
+                          bytes_per_row_, bytes_per_block_, block_size_);
+            }
+
+            prev_block += bytes_per_block_;
+            curr_block += bytes_per_block_;
 
             ++is_different;
         }
@@ -165,8 +337,14 @@ void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_imag
             *is_different = diffPartialBlock(prev_block,
                                              curr_block,
                                              bytes_per_row_,
-                                             kBytesPerBlock,
-                                             kBlockSize);
+                                             partial_column_width_ * kBytesPerPixel,
+                                             block_size_);
+
+            if (*is_different && update_image)
+            {
+                copyBlock(update_image + (curr_block - curr_image), curr_block,
+                          bytes_per_row_, partial_column_width_ * kBytesPerPixel, block_size_);
+            }
         }
 
         // Update pointers for next row.
@@ -179,7 +357,7 @@ void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_imag
     // If the screen height is not a multiple of the block size, then this
     // handles the last partial row. This situation is far more common than
     // the 'partial column' case.
-    if (partial_row_height_ != 0)
+    if (partial_row_height_ != 0 && last_row > full_blocks_y_)
     {
         const uint8_t* prev_block = prev_block_row_start;
         const uint8_t* curr_block = curr_block_row_start;
@@ -191,11 +369,17 @@ void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_imag
             *is_different = diffPartialBlock(prev_block,
                                              curr_block,
                                              bytes_per_row_,
-                                             kBytesPerBlock,
+                                             bytes_per_block_,
                                              partial_row_height_);
 
-            prev_block += kBytesPerBlock;
-            curr_block += kBytesPerBlock;
+            if (*is_different && update_image)
+            {
+                copyBlock(update_image + (curr_block - curr_image), curr_block,
+                          bytes_per_row_, bytes_per_block_, partial_row_height_);
+            }
+
+            prev_block += bytes_per_block_;
+            curr_block += bytes_per_block_;
             ++is_different;
         }
 
@@ -207,111 +391,122 @@ void Differ::markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_imag
                                  bytes_per_row_,
                                  partial_column_width_ * kBytesPerPixel,
                                  partial_row_height_);
+
+            if (*is_different && update_image)
+            {
+                copyBlock(update_image + (curr_block - curr_image), curr_block,
+                          bytes_per_row_, partial_column_width_ * kBytesPerPixel,
+                          partial_row_height_);
+            }
         }
     }
 }
 
 //
-// After the dirty blocks have been identified, this routine merges adjacent
-// blocks into a region.
-// The goal is to minimize the region that covers the dirty blocks.
+// After the dirty blocks have been identified, this routine converts each row of blocks into a
+// band of the region: the adjacent dirty blocks of the row become one rectangle. The region
+// merges the adjacent bands with the same rectangles, so the rows are added from top to bottom
+// without sorting and without memory allocation.
 //
-void Differ::mergeBlocks(QRegion* dirty_region)
+void Differ::mergeBlocks(DirtyRegion* dirty_region)
 {
-    uint8_t* is_diff_row_start = diff_info_.get();
-    const int diff_stride = diff_width_;
+    dirty_blocks_ = 0;
 
-    for (int y = 0; y < diff_height_; ++y)
+    const uint8_t* is_diff_row_start = diff_info_.get();
+    const int screen_width = screen_rect_.width();
+    const int screen_height = screen_rect_.height();
+
+    for (int y = 0; y < block_rows_; ++y)
     {
-        uint8_t* is_different = is_diff_row_start;
+        int span_count = 0;
+        int x = 0;
 
-        for (int x = 0; x < diff_width_; ++x)
+        // The last column is a boundary block which is never marked as having diffs.
+        while (x < diff_width_ - 1)
         {
-            // We've found a modified block. Look at blocks to the right and
-            // below to group this block with as many others as we can.
-            if (*is_different != 0)
+            if (is_diff_row_start[x] == 0)
             {
-                // Width and height of the rectangle in blocks.
-                int width  = 1;
-                int height = 1;
-
-                *is_different = 0;
-
-                // Group with blocks to the right.
-                // We can keep looking until we find an unchanged block because
-                // we have a boundary block which is never marked as having
-                // diffs.
-                uint8_t* right = is_different + 1;
-
-                while (*right != 0)
-                {
-                    *right++ = 0;
-                    ++width;
-                }
-
-                // Group with blocks below.
-                // The entire width of blocks that we matched above much match
-                // for each row that we add.
-                uint8_t* bottom = is_different;
-                bool found_new_row;
-
-                do
-                {
-                    found_new_row = true;
-                    bottom += diff_stride;
-                    right = bottom;
-
-                    for (int x2 = 0; x2 < width; ++x2)
-                    {
-                        if (*right++ == 0)
-                            found_new_row = false;
-                    }
-
-                    if (found_new_row)
-                    {
-                        ++height;
-
-                        // We need to go back and erase the diff markers so
-                        // that we don't try to add these blocks a second time.
-                        right = bottom;
-
-                        for (int x2 = 0; x2 < width; ++x2)
-                        {
-                            *right++ = 0;
-                        }
-                    }
-                } while (found_new_row);
-
-                QRect dirty_rect = QRect(x * kBlockSize, y * kBlockSize,
-                                         width * kBlockSize, height * kBlockSize);
-
-                // Add rect to region.
-                *dirty_region += dirty_rect.intersected(screen_rect_);
+                ++x;
+                continue;
             }
 
-            // Increment to next block in this row.
-            ++is_different;
+            const int first_block = x;
+
+            while (is_diff_row_start[x] != 0)
+                ++x;
+
+            dirty_blocks_ += x - first_block;
+
+            spans_[span_count++] =
+                { first_block * block_size_, std::min(x * block_size_, screen_width) };
+        }
+
+        if (span_count != 0)
+        {
+            const int top = y * block_size_;
+            const int bottom = std::min(top + block_size_, screen_height);
+
+            dirty_region->appendBand(top, bottom, spans_.get(), span_count);
         }
 
         // Go to start of next row.
-        is_diff_row_start += diff_stride;
+        is_diff_row_start += diff_width_;
     }
 }
 
 void Differ::calcDirtyRegion(const uint8_t* prev_image,
                              const uint8_t* curr_image,
-                             QRegion* dirty_region)
+                             DirtyRegion* dirty_region)
 {
-    *dirty_region = QRegion();
+    dirty_region->clear();
 
     // Identify all the blocks that contain changed pixels.
-    markDirtyBlocks(prev_image, curr_image);
+    markDirtyBlocks(prev_image, curr_image, nullptr);
 
     //
     // Now that we've identified the blocks that have changed, merge adjacent
     // blocks to minimize the number of rects that we return.
     //
     mergeBlocks(dirty_region);
+
+    if (adaptive_)
+        updateAdaptiveBlockSize();
+}
+
+void Differ::calcDirtyRegionAndUpdate(uint8_t* reference_image,
+                                      const uint8_t* curr_image,
+                                      DirtyRegion* dirty_region)
+{
+    dirty_region->clear();
+
+    // The reference image is the previous image. The changed blocks are written back to it during
+    // the search, so the unchanged blocks are only read.
+    markDirtyBlocks(reference_image, curr_image, reference_image);
+    mergeBlocks(dirty_region);
+
+    if (adaptive_)
+        updateAdaptiveBlockSize();
+}
+
+//
+// Selects the block size for the next frame. When most of the screen changes (video, scrolling),
+// the coarse blocks reduce the number of comparisons and rectangles. When a few pixels change
+// (caret, typing), the fine blocks give the minimum area for the encoder.
+//
+void Differ::updateAdaptiveBlockSize()
+{
+    const int total_blocks = (diff_width_ - 1) * (diff_height_ - 1);
+    const double density = static_cast<double>(dirty_blocks_) / total_blocks;
+
+    change_density_ += (density - change_density_) * kDensitySmoothing;
+
+    const int block_size = blockSizeForDensity(change_density_, block_size_);
+    if (block_size != block_size_)
+    {
+        DLOG(LS_INFO) << "Differ block size changed: " << block_size_ << " -> " << block_size
+                      << " (density: " << change_density_ << ")";
+        resetBlocks(block_size);
+    }
 }
 
 } // namespace desktop
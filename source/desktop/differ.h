@@ -19,10 +19,14 @@
 #ifndef DESKTOP__DIFFER_H
 #define DESKTOP__DIFFER_H
 
-#include <QRegion>
 #include <memory>
 
 #include "base/macros_magic.h"
+#include "desktop/dirty_region.h"
+
+namespace base {
+class ThreadPool;
+} // namespace base
 
 namespace desktop {
 
@@ -30,36 +34,102 @@ namespace desktop {
 class Differ
 {
 public:
-    explicit Differ(const QSize& size);
-    ~Differ() = default;
+    // The number of threads is selected depending on the frame size and the number of processors.
+    static const int kAutoThreadCount = 0;
+
+    // Supported sizes of the block (in pixels) by which the frames are compared.
+    static const int kMinBlockSize = 8;
+    static const int kMaxBlockSize = 32;
+
+    // The block size is selected depending on the density of changes in previous frames: coarse
+    // blocks for full screen updates (video), fine blocks for small updates (caret, typing).
+    static const int kAdaptiveBlockSize = 0;
+
+    // If |thread_count| is greater than 1, the frame is divided into horizontal bands of block
+    // rows and the bands are compared in parallel.
+    explicit Differ(const QSize& size, int thread_count = kAutoThreadCount);
+    ~Differ();
+
+    int threadCount() const;
+
+    // Sets the block size. Valid values are 8, 16, 32 and |kAdaptiveBlockSize|. By default, the
+    // block size is 8.
+    void setBlockSize(int block_size);
+
+    // Returns the current block size in pixels. In adaptive mode, the value may change after each
+    // call of calcDirtyRegion.
+    int blockSize() const { return block_size_; }
 
     void calcDirtyRegion(const uint8_t* prev_image,
                          const uint8_t* curr_image,
-                         QRegion* changed_region);
+                         DirtyRegion* changed_region);
+
+    // Same as calcDirtyRegion, but the changed blocks of |curr_image| are copied to
+    // |reference_image| as soon as they are found. After the call |reference_image| is equal to
+    // |curr_image|, and only the changed blocks have been written to it. It allows to keep the
+    // previous frame in a single reference buffer instead of a second full frame.
+    void calcDirtyRegionAndUpdate(uint8_t* reference_image,
+                                  const uint8_t* curr_image,
+                                  DirtyRegion* changed_region);
 
 private:
-    void markDirtyBlocks(const uint8_t* prev_image, const uint8_t* curr_image);
-    void mergeBlocks(QRegion* dirty_region);
+    typedef uint8_t(*DiffFullBlockFunc)(const uint8_t*, const uint8_t*, int);
+
+    static DiffFullBlockFunc diffFullBlockFunc(int block_size);
+
+    void resetBlocks(int block_size);
+    void markDirtyBlocks(const uint8_t* prev_image,
+                         const uint8_t* curr_image,
+                         uint8_t* update_image);
+    void markDirtyBlockRows(const uint8_t* prev_image,
+                            const uint8_t* curr_image,
+                            uint8_t* update_image,
+                            int first_row,
+                            int last_row);
+    void mergeBlocks(DirtyRegion* dirty_region);
+    void updateAdaptiveBlockSize();
 
     const QRect screen_rect_;
 
     const int bytes_per_row_;
 
-    const int full_blocks_x_;
-    const int full_blocks_y_;
+    int block_size_ = 0;
+    int bytes_per_block_ = 0;
+
+    int full_blocks_x_ = 0;
+    int full_blocks_y_ = 0;
 
-    int partial_column_width_;
-    int partial_row_height_;
+    int partial_column_width_ = 0;
+    int partial_row_height_ = 0;
 
-    int block_stride_y_;
+    int block_stride_y_ = 0;
 
-    const int diff_width_;
-    const int diff_height_;
+    int diff_width_ = 0;
+    int diff_height_ = 0;
 
     std::unique_ptr<uint8_t[]> diff_info_;
 
-    typedef uint8_t(*DiffFullBlockFunc)(const uint8_t*, const uint8_t*, int);
-    DiffFullBlockFunc diff_full_block_func_;
+    // Buffer for the spans of dirty blocks of one block row.
+    std::unique_ptr<DirtyRegion::Span[]> spans_;
+
+    DiffFullBlockFunc diff_full_block_func_ = nullptr;
+
+    // Number of block rows including the partial row at the bottom edge.
+    int block_rows_ = 0;
+
+    // Adaptive block size mode.
+    bool adaptive_ = false;
+
+    // Number of dirty blocks found in the last frame.
+    int dirty_blocks_ = 0;
+
+    // Smoothed fraction of the screen area changed in the recent frames.
+    double change_density_ = 0;
+
+    // Number of bands the frame is divided into for the parallel search.
+    int thread_count_ = 1;
+    int band_count_ = 1;
+    std::unique_ptr<base::ThreadPool> thread_pool_;
 
     DISALLOW_COPY_AND_ASSIGN(Differ);
 };
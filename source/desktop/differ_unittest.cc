@@ -0,0 +1,308 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "base/aligned_memory.h"
+#include "base/thread_pool.h"
+#include "desktop/differ.h"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+
+namespace desktop {
+
+namespace {
+
+using AlignedBuffer = std::unique_ptr<uint8_t, base::AlignedFreeDeleter>;
+
+const int kBytesPerPixel = 4;
+const int kAlignment = 32;
+
+AlignedBuffer createImage(const QSize& size)
+{
+    const size_t image_size = size.width() * size.height() * kBytesPerPixel;
+
+    AlignedBuffer image(static_cast<uint8_t*>(base::alignedAlloc(image_size, kAlignment)));
+
+    for (size_t i = 0; i < image_size; ++i)
+        image.get()[i] = static_cast<uint8_t>(i * 7);
+
+    return image;
+}
+
+AlignedBuffer copyImage(const uint8_t* source, const QSize& size)
+{
+    const size_t image_size = size.width() * size.height() * kBytesPerPixel;
+
+    AlignedBuffer image(static_cast<uint8_t*>(base::alignedAlloc(image_size, kAlignment)));
+    memcpy(image.get(), source, image_size);
+
+    return image;
+}
+
+void changePixels(uint8_t* image, const QSize& size, int count, uint32_t seed)
+{
+    std::mt19937 random(seed);
+
+    std::uniform_int_distribution<int> x_distribution(0, size.width() - 1);
+    std::uniform_int_distribution<int> y_distribution(0, size.height() - 1);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int x = x_distribution(random);
+        const int y = y_distribution(random);
+
+        image[(y * size.width() + x) * kBytesPerPixel] += 1;
+    }
+}
+
+DirtyRegion calcRegion(const QSize& size, int thread_count, const uint8_t* prev, const uint8_t* curr)
+{
+    Differ differ(size, thread_count);
+    DirtyRegion region;
+
+    differ.calcDirtyRegion(prev, curr, &region);
+    return region;
+}
+
+} // namespace
+
+TEST(differ, parallel_same_as_serial)
+{
+    const QSize kSizes[] = { QSize(640, 480), QSize(1366, 768), QSize(1923, 1085), QSize(37, 13) };
+
+    for (const auto& size : kSizes)
+    {
+        AlignedBuffer prev = createImage(size);
+        AlignedBuffer curr = copyImage(prev.get(), size);
+
+        changePixels(curr.get(), size, 50, size.width());
+
+        DirtyRegion serial_region = calcRegion(size, 1, prev.get(), curr.get());
+        EXPECT_FALSE(serial_region.isEmpty());
+
+        for (int thread_count = 2; thread_count <= 8; ++thread_count)
+        {
+            EXPECT_EQ(serial_region, calcRegion(size, thread_count, prev.get(), curr.get()));
+        }
+    }
+}
+
+TEST(differ, parallel_no_changes)
+{
+    const QSize size(1920, 1080);
+
+    AlignedBuffer prev = createImage(size);
+    AlignedBuffer curr = copyImage(prev.get(), size);
+
+    EXPECT_TRUE(calcRegion(size, 4, prev.get(), curr.get()).isEmpty());
+}
+
+TEST(differ, parallel_last_pixel)
+{
+    const QSize size(1921, 1081);
+
+    AlignedBuffer prev = createImage(size);
+    AlignedBuffer curr = copyImage(prev.get(), size);
+
+    curr.get()[size.width() * size.height() * kBytesPerPixel - 1] += 1;
+
+    DirtyRegion region = calcRegion(size, 4, prev.get(), curr.get());
+    EXPECT_TRUE(region.contains(QPoint(size.width() - 1, size.height() - 1)));
+}
+
+TEST(differ, block_sizes)
+{
+    const QSize size(1283, 721);
+
+    AlignedBuffer prev = createImage(size);
+    AlignedBuffer curr = copyImage(prev.get(), size);
+
+    changePixels(curr.get(), size, 20, 3);
+
+    Differ differ(size, 1);
+    DirtyRegion fine_region;
+
+    differ.calcDirtyRegion(prev.get(), curr.get(), &fine_region);
+    EXPECT_FALSE(fine_region.isEmpty());
+
+    for (int block_size : { 16, 32 })
+    {
+        differ.setBlockSize(block_size);
+        EXPECT_EQ(block_size, differ.blockSize());
+
+        DirtyRegion coarse_region;
+        differ.calcDirtyRegion(prev.get(), curr.get(), &coarse_region);
+
+        // Coarse blocks cover all fine blocks and are aligned to the block size.
+        DirtyRegion uncovered_region = fine_region;
+        for (const auto& rect : coarse_region)
+            uncovered_region.subtract(rect);
+
+        EXPECT_TRUE(uncovered_region.isEmpty());
+
+        for (const auto& rect : coarse_region)
+        {
+            EXPECT_EQ(0, rect.x() % block_size);
+            EXPECT_EQ(0, rect.y() % block_size);
+        }
+    }
+}
+
+TEST(differ, partial_column)
+{
+    // The width is not a multiple of any block size.
+    const QSize size(1366, 768);
+
+    AlignedBuffer prev = createImage(size);
+
+    for (int block_size : { 8, 16, 32 })
+    {
+        AlignedBuffer curr = copyImage(prev.get(), size);
+
+        // The first pixel of the second row of blocks. The partial block at the end of the first
+        // row of blocks must not see it.
+        curr.get()[block_size * size.width() * kBytesPerPixel] += 1;
+
+        Differ differ(size, 1);
+        differ.setBlockSize(block_size);
+
+        DirtyRegion region;
+        differ.calcDirtyRegion(prev.get(), curr.get(), &region);
+
+        EXPECT_EQ(DirtyRegion(QRect(0, block_size, block_size, block_size)), region);
+    }
+}
+
+TEST(differ, adaptive_block_size)
+{
+    const QSize size(1280, 720);
+
+    AlignedBuffer prev = createImage(size);
+    AlignedBuffer curr = createImage(size);
+
+    // Change every pixel of the frame.
+    for (int i = 0; i < size.width() * size.height() * kBytesPerPixel; ++i)
+        curr.get()[i] += 1;
+
+    Differ differ(size, 1);
+    differ.setBlockSize(Differ::kAdaptiveBlockSize);
+    EXPECT_EQ(8, differ.blockSize());
+
+    DirtyRegion region;
+
+    // Full screen changes (video) switch the differ to the coarse blocks.
+    for (int i = 0; i < 20; ++i)
+    {
+        differ.calcDirtyRegion(prev.get(), curr.get(), &region);
+        EXPECT_EQ(DirtyRegion(QRect(QPoint(), size)), region);
+    }
+
+    EXPECT_EQ(32, differ.blockSize());
+
+    // Without changes the differ returns to the fine blocks.
+    for (int i = 0; i < 20; ++i)
+    {
+        differ.calcDirtyRegion(prev.get(), prev.get(), &region);
+        EXPECT_TRUE(region.isEmpty());
+    }
+
+    EXPECT_EQ(8, differ.blockSize());
+}
+
+TEST(differ, update_reference)
+{
+    const QSize kSizes[] = { QSize(640, 480), QSize(1923, 1085), QSize(37, 13) };
+
+    for (const auto& size : kSizes)
+    {
+        for (int thread_count : { 1, 4 })
+        {
+            AlignedBuffer prev = createImage(size);
+            AlignedBuffer curr = copyImage(prev.get(), size);
+            AlignedBuffer reference = copyImage(prev.get(), size);
+
+            changePixels(curr.get(), size, 50, size.height());
+
+            // The last pixel is in the partial block at the bottom right corner.
+            curr.get()[size.width() * size.height() * kBytesPerPixel - 1] += 1;
+
+            Differ differ(size, thread_count);
+            DirtyRegion region;
+
+            differ.calcDirtyRegionAndUpdate(reference.get(), curr.get(), &region);
+
+            EXPECT_EQ(calcRegion(size, 1, prev.get(), curr.get()), region);
+            EXPECT_EQ(0, memcmp(reference.get(), curr.get(),
+                                size.width() * size.height() * kBytesPerPixel));
+
+            // The reference is equal to the current image now.
+            differ.calcDirtyRegionAndUpdate(reference.get(), curr.get(), &region);
+            EXPECT_TRUE(region.isEmpty());
+        }
+    }
+}
+
+// Measures the speedup of the parallel search depending on the number of threads.
+// Run with --gtest_also_run_disabled_tests.
+TEST(differ, DISABLED_parallel_benchmark)
+{
+    const QSize kSizes[] = { QSize(1920, 1080), QSize(3840, 2160), QSize(7680, 4320) };
+    const int kFrameCount = 30;
+
+    for (const auto& size : kSizes)
+    {
+        AlignedBuffer prev = createImage(size);
+        AlignedBuffer curr = copyImage(prev.get(), size);
+
+        // Typical desktop update: a small number of changed blocks, the rest of the frame is
+        // compared completely.
+        changePixels(curr.get(), size, 100, 1);
+
+        double serial_time = 0;
+
+        for (int thread_count = 1; thread_count <= base::ThreadPool::processorCount();
+             thread_count *= 2)
+        {
+            Differ differ(size, thread_count);
+            DirtyRegion region;
+
+            auto start_time = std::chrono::high_resolution_clock::now();
+
+            for (int i = 0; i < kFrameCount; ++i)
+                differ.calcDirtyRegion(prev.get(), curr.get(), &region);
+
+            std::chrono::duration<double, std::milli> duration =
+                std::chrono::high_resolution_clock::now() - start_time;
+
+            const double frame_time = duration.count() / kFrameCount;
+
+            if (thread_count == 1)
+                serial_time = frame_time;
+
+            std::cout << size.width() << "x" << size.height()
+                      << " threads: " << differ.threadCount()
+                      << " time: " << frame_time << " ms"
+                      << " speedup: " << serial_time / frame_time << std::endl;
+        }
+    }
+}
+
+} // namespace desktop
@@ -0,0 +1,487 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/dirty_region.h"
+
+#include "base/logging.h"
+
+#include <algorithm>
+
+namespace desktop {
+
+namespace {
+
+// The gap (in pixels) between the rectangles of a band that are merged first when the region
+// does not fit into the array. The gap is doubled until the region fits.
+const int kMinMergeGap = 8;
+
+using Span = DirtyRegion::Span;
+
+// Merges two sorted lists of spans.
+int unionSpans(const Span* first, int first_count,
+               const Span* second, int second_count,
+               Span* out)
+{
+    int out_count = 0;
+    int i = 0;
+    int j = 0;
+
+    while (i < first_count || j < second_count)
+    {
+        const Span& span = (j >= second_count ||
+                            (i < first_count && first[i].left <= second[j].left)) ?
+            first[i++] : second[j++];
+
+        if (out_count && span.left <= out[out_count - 1].right)
+            out[out_count - 1].right = std::max(out[out_count - 1].right, span.right);
+        else
+            out[out_count++] = span;
+    }
+
+    return out_count;
+}
+
+int subtractSpan(const Span* spans, int count, const Span& other, Span* out)
+{
+    int out_count = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const Span& span = spans[i];
+
+        if (span.right <= other.left || span.left >= other.right)
+        {
+            out[out_count++] = span;
+            continue;
+        }
+
+        if (span.left < other.left)
+            out[out_count++] = { span.left, other.left };
+
+        if (span.right > other.right)
+            out[out_count++] = { other.right, span.right };
+    }
+
+    return out_count;
+}
+
+int intersectSpan(const Span* spans, int count, const Span& other, Span* out)
+{
+    int out_count = 0;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const int left = std::max(spans[i].left, other.left);
+        const int right = std::min(spans[i].right, other.right);
+
+        if (left < right)
+            out[out_count++] = { left, right };
+    }
+
+    return out_count;
+}
+
+// Returns the number of spans after merging the spans with the gap not greater than |gap|.
+int mergedSpanCount(const Span* spans, int count, int gap)
+{
+    int merged_count = 0;
+    int i = 0;
+
+    while (i < count)
+    {
+        const int left = spans[i].left;
+        int right = spans[i].right;
+
+        for (++i; i < count && spans[i].left - right <= gap; ++i)
+            right = std::max(right, spans[i].right);
+
+        if (left < right)
+            ++merged_count;
+    }
+
+    return merged_count;
+}
+
+} // namespace
+
+const int DirtyRegion::kMaxRects;
+
+DirtyRegion::DirtyRegion(const QRect& rect)
+{
+    add(rect);
+}
+
+DirtyRegion::DirtyRegion(const DirtyRegion& other)
+{
+    *this = other;
+}
+
+DirtyRegion& DirtyRegion::operator=(const DirtyRegion& other)
+{
+    if (this != &other)
+    {
+        // Only the used part of the array is copied.
+        std::copy(other.begin(), other.end(), rects());
+
+        count_ = other.count_;
+        last_band_ = other.last_band_;
+        merge_gap_ = other.merge_gap_;
+    }
+
+    return *this;
+}
+
+QRect DirtyRegion::boundingRect() const
+{
+    if (isEmpty())
+        return QRect();
+
+    const QRect* rects = this->rects();
+
+    int left = rects[0].left();
+    int right = rects[0].right();
+
+    for (int i = 1; i < count_; ++i)
+    {
+        left = std::min(left, rects[i].left());
+        right = std::max(right, rects[i].right());
+    }
+
+    return QRect(QPoint(left, rects[0].top()), QPoint(right, rects[count_ - 1].bottom()));
+}
+
+bool DirtyRegion::contains(const QPoint& point) const
+{
+    for (const auto& rect : *this)
+    {
+        if (rect.contains(point))
+            return true;
+    }
+
+    return false;
+}
+
+void DirtyRegion::clear()
+{
+    count_ = 0;
+    last_band_ = 0;
+    merge_gap_ = 0;
+}
+
+void DirtyRegion::add(const QRect& rect)
+{
+    if (rect.isEmpty())
+        return;
+
+    const Span span = { rect.x(), rect.x() + rect.width() };
+    addBand(rect.y(), rect.y() + rect.height(), &span, 1);
+}
+
+void DirtyRegion::subtract(const QRect& rect)
+{
+    if (rect.isEmpty() || isEmpty())
+        return;
+
+    const Span span = { rect.x(), rect.x() + rect.width() };
+    combine(rect.y(), rect.y() + rect.height(), &span, 1, Operation::SUBTRACT);
+}
+
+void DirtyRegion::intersect(const QRect& rect)
+{
+    if (rect.isEmpty())
+    {
+        clear();
+        return;
+    }
+
+    if (isEmpty())
+        return;
+
+    const Span span = { rect.x(), rect.x() + rect.width() };
+    combine(rect.y(), rect.y() + rect.height(), &span, 1, Operation::INTERSECT);
+}
+
+void DirtyRegion::addBand(int top, int bottom, const Span* spans, int count)
+{
+    if (top >= bottom || count <= 0)
+        return;
+
+    // Fast path: the band is below the region.
+    if (isEmpty() || top > rects()[last_band_].bottom())
+    {
+        appendBand(top, bottom, spans, count);
+        return;
+    }
+
+    if (count > kMaxRects)
+    {
+        const Span span = { spans[0].left, spans[count - 1].right };
+        combine(top, bottom, &span, 1, Operation::ADD);
+        return;
+    }
+
+    combine(top, bottom, spans, count, Operation::ADD);
+}
+
+void DirtyRegion::appendBand(int top, int bottom, const Span* spans, int count)
+{
+    if (top >= bottom || count <= 0)
+        return;
+
+    DCHECK(isEmpty() || top > rects()[last_band_].bottom());
+
+    int merged_count = mergedSpanCount(spans, count, merge_gap_);
+    if (!merged_count)
+        return;
+
+    if (count_ + merged_count > kMaxRects)
+    {
+        simplify();
+
+        merged_count = mergedSpanCount(spans, count, merge_gap_);
+
+        // After simplification at least half of the array is free. If the band still does not
+        // fit, it is merged into one rectangle.
+        if (count_ + merged_count > kMaxRects)
+        {
+            Span span = { spans[0].left, spans[0].right };
+
+            for (int i = 1; i < count; ++i)
+            {
+                span.left = std::min(span.left, spans[i].left);
+                span.right = std::max(span.right, spans[i].right);
+            }
+
+            appendBand(top, bottom, &span, 1);
+            return;
+        }
+    }
+
+    QRect* rects = this->rects();
+    const int band_start = count_;
+    int i = 0;
+
+    while (i < count)
+    {
+        const int left = spans[i].left;
+        int right = spans[i].right;
+
+        // Merge the spans that touch each other (or are close when the region is simplified).
+        for (++i; i < count && spans[i].left - right <= merge_gap_; ++i)
+            right = std::max(right, spans[i].right);
+
+        if (left < right)
+            rects[count_++] = QRect(left, top, right - left, bottom - top);
+    }
+
+    // Merge the band with the previous band if it is adjacent and has the same spans.
+    if (band_start != 0 && rects[last_band_].bottom() + 1 == top &&
+        band_start - last_band_ == count_ - band_start)
+    {
+        bool equal = true;
+
+        for (int k = 0; k < count_ - band_start; ++k)
+        {
+            const QRect& previous = rects[last_band_ + k];
+            const QRect& current = rects[band_start + k];
+
+            if (previous.left() != current.left() || previous.right() != current.right())
+            {
+                equal = false;
+                break;
+            }
+        }
+
+        if (equal)
+        {
+            for (int k = last_band_; k < band_start; ++k)
+                rects[k].setBottom(bottom - 1);
+
+            count_ = band_start;
+            return;
+        }
+    }
+
+    last_band_ = band_start;
+}
+
+bool DirtyRegion::operator==(const DirtyRegion& other) const
+{
+    return count_ == other.count_ && std::equal(begin(), end(), other.begin());
+}
+
+void DirtyRegion::combine(int top, int bottom, const Span* spans, int count, Operation operation)
+{
+    DCHECK(count <= kMaxRects);
+    DCHECK(operation == Operation::ADD || count == 1);
+
+    const QRect* rects = this->rects();
+
+    DirtyRegion result;
+    result.merge_gap_ = merge_gap_;
+
+    Span band_spans[kMaxRects];
+    Span out_spans[kMaxRects * 2];
+
+    int band_start = 0;
+    int band_end = bandEnd(0);
+    int loaded_band = -1;
+
+    int y = std::min(rects[0].top(), top);
+    const int end_y = std::max(rects[count_ - 1].bottom() + 1, bottom);
+
+    // Walk through the horizontal intervals in which neither the bands of the region nor the
+    // combined band change.
+    while (y < end_y)
+    {
+        int next_y = end_y;
+        int span_count = 0;
+
+        if (band_start < count_)
+        {
+            const QRect& band = rects[band_start];
+
+            if (y < band.top())
+            {
+                next_y = band.top();
+            }
+            else
+            {
+                next_y = band.bottom() + 1;
+
+                if (loaded_band != band_start)
+                {
+                    for (int i = band_start; i < band_end; ++i)
+                        band_spans[i - band_start] = { rects[i].x(), rects[i].right() + 1 };
+
+                    loaded_band = band_start;
+                }
+
+                span_count = band_end - band_start;
+            }
+        }
+
+        const bool in_band = y >= top && y < bottom;
+
+        if (y < top)
+            next_y = std::min(next_y, top);
+        else if (y < bottom)
+            next_y = std::min(next_y, bottom);
+
+        if (!in_band)
+        {
+            if (operation != Operation::INTERSECT)
+                result.appendBand(y, next_y, band_spans, span_count);
+        }
+        else
+        {
+            int out_count = 0;
+
+            switch (operation)
+            {
+                case Operation::ADD:
+                    out_count = unionSpans(band_spans, span_count, spans, count, out_spans);
+                    break;
+
+                case Operation::SUBTRACT:
+                    out_count = subtractSpan(band_spans, span_count, spans[0], out_spans);
+                    break;
+
+                case Operation::INTERSECT:
+                    out_count = intersectSpan(band_spans, span_count, spans[0], out_spans);
+                    break;
+            }
+
+            result.appendBand(y, next_y, out_spans, out_count);
+        }
+
+        y = next_y;
+
+        if (band_start < count_ && y > rects[band_start].bottom())
+        {
+            band_start = band_end;
+            band_end = bandEnd(band_start);
+        }
+    }
+
+    *this = result;
+}
+
+int DirtyRegion::bandEnd(int band_start) const
+{
+    if (band_start >= count_)
+        return count_;
+
+    const QRect* rects = this->rects();
+    const int top = rects[band_start].top();
+    int band_end = band_start + 1;
+
+    while (band_end < count_ && rects[band_end].top() == top)
+        ++band_end;
+
+    return band_end;
+}
+
+void DirtyRegion::simplify()
+{
+    const int kTargetCount = kMaxRects / 2;
+    const QRect bounding_rect = boundingRect();
+
+    Span spans[kMaxRects];
+
+    merge_gap_ = std::max(merge_gap_ * 2, kMinMergeGap);
+
+    while (true)
+    {
+        const DirtyRegion source(*this);
+        const QRect* source_rects = source.rects();
+
+        count_ = 0;
+        last_band_ = 0;
+
+        int band_start = 0;
+
+        // The region is built again with the new gap. The number of rectangles can only decrease.
+        while (band_start < source.count_)
+        {
+            const int band_end = source.bandEnd(band_start);
+            const QRect& band = source_rects[band_start];
+
+            for (int i = band_start; i < band_end; ++i)
+                spans[i - band_start] = { source_rects[i].x(), source_rects[i].right() + 1 };
+
+            appendBand(band.top(), band.bottom() + 1, spans, band_end - band_start);
+            band_start = band_end;
+        }
+
+        if (count_ <= kTargetCount)
+            return;
+
+        if (merge_gap_ >= bounding_rect.width())
+            break;
+
+        merge_gap_ *= 2;
+    }
+
+    // Too many bands: the region becomes one rectangle.
+    rects()[0] = bounding_rect;
+    count_ = 1;
+    last_band_ = 0;
+}
+
+} // namespace desktop
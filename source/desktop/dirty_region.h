@@ -0,0 +1,106 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__DIRTY_REGION_H
+#define DESKTOP__DIRTY_REGION_H
+
+#include <QRect>
+
+#include <type_traits>
+
+namespace desktop {
+
+// Set of non-overlapping rectangles of changed pixels. It is a replacement for QRegion in the
+// path from the capturer to the encoder which never allocates memory.
+//
+// The rectangles are stored in a fixed-size array in the y-x banded form (the same as QRegion):
+// the region is divided into horizontal bands, all rectangles of a band have the same top and
+// bottom, they are sorted from left to right and do not touch each other. Adjacent bands with
+// the same rectangles are merged. This form is unique, so two regions can be compared.
+//
+// If the rectangles do not fit into the array, the nearest rectangles of the bands are merged
+// (the region becomes larger than requested). For the dirty region this only means that some
+// unchanged pixels are encoded.
+class DirtyRegion
+{
+public:
+    static const int kMaxRects = 512;
+
+    // Horizontal range [left, right) of a band.
+    struct Span
+    {
+        int left;
+        int right;
+    };
+
+    DirtyRegion() = default;
+    explicit DirtyRegion(const QRect& rect);
+    DirtyRegion(const DirtyRegion& other);
+    DirtyRegion& operator=(const DirtyRegion& other);
+
+    bool isEmpty() const { return count_ == 0; }
+    int rectCount() const { return count_; }
+
+    const QRect* begin() const { return rects(); }
+    const QRect* end() const { return rects() + count_; }
+
+    QRect boundingRect() const;
+    bool contains(const QPoint& point) const;
+
+    void clear();
+
+    void add(const QRect& rect);
+    void subtract(const QRect& rect);
+    void intersect(const QRect& rect);
+
+    // Adds the band [top, bottom) with the horizontal ranges |spans|. The spans must be sorted
+    // from left to right and must not overlap.
+    void addBand(int top, int bottom, const Span* spans, int count);
+
+    // The same as addBand, but the band must not be above the last band of the region. It is the
+    // fast way to build a region from top to bottom.
+    void appendBand(int top, int bottom, const Span* spans, int count);
+
+    bool operator==(const DirtyRegion& other) const;
+    bool operator!=(const DirtyRegion& other) const { return !(*this == other); }
+
+private:
+    enum class Operation { ADD, SUBTRACT, INTERSECT };
+
+    QRect* rects() { return reinterpret_cast<QRect*>(storage_); }
+    const QRect* rects() const { return reinterpret_cast<const QRect*>(storage_); }
+
+    void combine(int top, int bottom, const Span* spans, int count, Operation operation);
+    int bandEnd(int band_start) const;
+    void simplify();
+
+    // The storage is not initialized, so creating a region costs nothing.
+    std::aligned_storage<sizeof(QRect), alignof(QRect)>::type storage_[kMaxRects];
+    int count_ = 0;
+
+    // Index of the first rectangle of the last band.
+    int last_band_ = 0;
+
+    // The rectangles of a band with a smaller gap between them are merged. It is greater than 0
+    // after the region did not fit into the array.
+    int merge_gap_ = 0;
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__DIRTY_REGION_H
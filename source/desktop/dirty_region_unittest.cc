@@ -0,0 +1,345 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "desktop/dirty_region.h"
+
+#include <QRegion>
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace desktop {
+
+namespace {
+
+const QSize kMapSize(160, 120);
+
+// Reference implementation: one byte per pixel.
+class PixelMap
+{
+public:
+    PixelMap() : pixels_(kMapSize.width() * kMapSize.height(), 0) {}
+
+    void fill(const QRect& rect, uint8_t value)
+    {
+        const QRect clipped = rect.intersected(QRect(QPoint(), kMapSize));
+
+        for (int y = clipped.top(); y <= clipped.bottom(); ++y)
+        {
+            for (int x = clipped.left(); x <= clipped.right(); ++x)
+                pixels_[y * kMapSize.width() + x] = value;
+        }
+    }
+
+    void intersect(const QRect& rect)
+    {
+        for (int y = 0; y < kMapSize.height(); ++y)
+        {
+            for (int x = 0; x < kMapSize.width(); ++x)
+            {
+                if (!rect.contains(QPoint(x, y)))
+                    pixels_[y * kMapSize.width() + x] = 0;
+            }
+        }
+    }
+
+    bool isEqual(const DirtyRegion& region) const
+    {
+        PixelMap other;
+
+        for (const auto& rect : region)
+        {
+            for (int y = rect.top(); y <= rect.bottom(); ++y)
+            {
+                for (int x = rect.left(); x <= rect.right(); ++x)
+                {
+                    // The rectangles must not overlap.
+                    if (other.pixels_[y * kMapSize.width() + x])
+                        return false;
+
+                    other.pixels_[y * kMapSize.width() + x] = 1;
+                }
+            }
+        }
+
+        return pixels_ == other.pixels_;
+    }
+
+private:
+    std::vector<uint8_t> pixels_;
+};
+
+// Checks the y-x banded form: the bands go from top to bottom, the rectangles of a band have the
+// same top and bottom, go from left to right and do not touch each other.
+bool isBanded(const DirtyRegion& region)
+{
+    const QRect* previous = nullptr;
+
+    for (const auto& rect : region)
+    {
+        if (rect.isEmpty())
+            return false;
+
+        if (previous)
+        {
+            if (rect.top() == previous->top())
+            {
+                if (rect.bottom() != previous->bottom() || rect.left() <= previous->right() + 1)
+                    return false;
+            }
+            else if (rect.top() <= previous->bottom())
+            {
+                return false;
+            }
+        }
+
+        previous = &rect;
+    }
+
+    return true;
+}
+
+QRect randomRect(std::mt19937* random)
+{
+    std::uniform_int_distribution<int> x_distribution(-10, kMapSize.width());
+    std::uniform_int_distribution<int> y_distribution(-10, kMapSize.height());
+    std::uniform_int_distribution<int> size_distribution(1, 40);
+
+    return QRect(x_distribution(*random), y_distribution(*random),
+                 size_distribution(*random), size_distribution(*random));
+}
+
+} // namespace
+
+TEST(dirty_region, random_operations)
+{
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> operation_distribution(0, 9);
+
+    for (int iteration = 0; iteration < 50; ++iteration)
+    {
+        DirtyRegion region;
+        PixelMap map;
+
+        for (int i = 0; i < 40; ++i)
+        {
+            const QRect rect = randomRect(&random);
+            const int operation = operation_distribution(random);
+
+            if (operation < 6)
+            {
+                region.add(rect.intersected(QRect(QPoint(), kMapSize)));
+                map.fill(rect, 1);
+            }
+            else if (operation < 9)
+            {
+                region.subtract(rect);
+                map.fill(rect, 0);
+            }
+            else
+            {
+                const QRect big_rect(rect.topLeft(), QSize(rect.width() * 3, rect.height() * 3));
+
+                region.intersect(big_rect);
+                map.intersect(big_rect);
+            }
+
+            ASSERT_TRUE(isBanded(region));
+            ASSERT_TRUE(map.isEqual(region));
+        }
+    }
+}
+
+TEST(dirty_region, unique_form)
+{
+    const QRect kRects[] =
+    {
+        QRect(0, 0, 10, 10), QRect(10, 0, 10, 10), QRect(0, 10, 20, 10),
+        QRect(30, 5, 10, 30), QRect(5, 30, 50, 5)
+    };
+
+    DirtyRegion forward;
+    for (const auto& rect : kRects)
+        forward.add(rect);
+
+    DirtyRegion backward;
+    for (int i = static_cast<int>(std::size(kRects)) - 1; i >= 0; --i)
+        backward.add(kRects[i]);
+
+    EXPECT_EQ(forward, backward);
+
+    // The first three rectangles are merged, but the band of the fourth rectangle splits them.
+    ASSERT_EQ(5, forward.rectCount());
+    EXPECT_EQ(QRect(0, 0, 20, 5), forward.begin()[0]);
+    EXPECT_EQ(QRect(0, 5, 20, 15), forward.begin()[1]);
+}
+
+TEST(dirty_region, append_band)
+{
+    const DirtyRegion::Span kSpans[] = { { 0, 8 }, { 8, 16 }, { 32, 40 } };
+
+    DirtyRegion region;
+    region.appendBand(0, 8, kSpans, 3);
+    region.appendBand(8, 16, kSpans, 3);
+    region.appendBand(24, 32, kSpans, 1);
+
+    ASSERT_EQ(3, region.rectCount());
+    EXPECT_EQ(QRect(0, 0, 16, 16), region.begin()[0]);
+    EXPECT_EQ(QRect(32, 0, 8, 16), region.begin()[1]);
+    EXPECT_EQ(QRect(0, 24, 8, 8), region.begin()[2]);
+}
+
+TEST(dirty_region, overflow)
+{
+    DirtyRegion region;
+    PixelMap map;
+
+    // A checkerboard has more rectangles than fit in the region.
+    for (int y = 0; y < kMapSize.height(); y += 2)
+    {
+        for (int x = (y / 2) % 2; x < kMapSize.width(); x += 2)
+        {
+            region.add(QRect(x, y, 1, 1));
+            map.fill(QRect(x, y, 1, 1), 1);
+        }
+    }
+
+    EXPECT_LE(region.rectCount(), DirtyRegion::kMaxRects);
+    EXPECT_TRUE(isBanded(region));
+
+    // The region covers all the added rectangles.
+    for (const auto& rect : region)
+        map.fill(rect, 0);
+
+    EXPECT_TRUE(map.isEqual(DirtyRegion()));
+}
+
+// Compares building and iterating the region with QRegion on the dirty maps of typical updates.
+// Run with --gtest_also_run_disabled_tests.
+TEST(dirty_region, DISABLED_benchmark)
+{
+    const int kBlockSize = 8;
+    const QSize kScreenSize(1920, 1080);
+    const int kBlocksX = kScreenSize.width() / kBlockSize;
+    const int kBlocksY = kScreenSize.height() / kBlockSize;
+    const int kIterations = 1000;
+
+    struct Pattern
+    {
+        const char* name;
+        QRect area;     // Area of the changes in blocks.
+        double density; // Fraction of the changed blocks in the area.
+    };
+
+    const Pattern kPatterns[] =
+    {
+        { "caret",     QRect(40, 30, 1, 2),     1.0 },
+        { "typing",    QRect(20, 30, 60, 3),    0.6 },
+        { "scrolling", QRect(10, 10, 150, 110), 0.7 },
+        { "video",     QRect(40, 20, 160, 90),  1.0 },
+        { "scattered", QRect(0, 0, kBlocksX, kBlocksY), 0.05 }
+    };
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+    for (const auto& pattern : kPatterns)
+    {
+        std::vector<uint8_t> blocks(kBlocksX * kBlocksY, 0);
+
+        for (int y = pattern.area.top(); y <= pattern.area.bottom(); ++y)
+        {
+            for (int x = pattern.area.left(); x <= pattern.area.right(); ++x)
+                blocks[y * kBlocksX + x] = distribution(random) < pattern.density;
+        }
+
+        // Rectangles of the dirty rows: QRegion gets them one by one, DirtyRegion gets them by
+        // bands as the differ makes them.
+        std::vector<QRect> rects;
+        std::vector<std::vector<DirtyRegion::Span>> bands(kBlocksY);
+
+        for (int y = 0; y < kBlocksY; ++y)
+        {
+            for (int x = 0; x < kBlocksX; ++x)
+            {
+                if (!blocks[y * kBlocksX + x])
+                    continue;
+
+                const int first = x;
+                while (x < kBlocksX && blocks[y * kBlocksX + x])
+                    ++x;
+
+                rects.emplace_back(first * kBlockSize, y * kBlockSize,
+                                   (x - first) * kBlockSize, kBlockSize);
+                bands[y].push_back({ first * kBlockSize, x * kBlockSize });
+            }
+        }
+
+        int64_t checksum = 0;
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < kIterations; ++i)
+        {
+            QRegion region;
+
+            for (const auto& rect : rects)
+                region += rect;
+
+            for (const auto& rect : region)
+                checksum += rect.width();
+        }
+
+        std::chrono::duration<double, std::micro> qregion_time =
+            std::chrono::high_resolution_clock::now() - start_time;
+
+        start_time = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < kIterations; ++i)
+        {
+            DirtyRegion region;
+
+            for (int y = 0; y < kBlocksY; ++y)
+            {
+                if (!bands[y].empty())
+                {
+                    region.appendBand(y * kBlockSize, (y + 1) * kBlockSize,
+                                      bands[y].data(), static_cast<int>(bands[y].size()));
+                }
+            }
+
+            for (const auto& rect : region)
+                checksum += rect.width();
+        }
+
+        std::chrono::duration<double, std::micro> append_time =
+            std::chrono::high_resolution_clock::now() - start_time;
+
+        std::cout << pattern.name << " rects: " << rects.size()
+                  << " QRegion: " << qregion_time.count() / kIterations << " us"
+                  << " DirtyRegion: " << append_time.count() / kIterations << " us"
+                  << " (" << checksum << ")" << std::endl;
+    }
+}
+
+} // namespace desktop
@@ -0,0 +1,240 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_pattern.h"
+
+#include "base/logging.h"
+#include "desktop/desktop_frame.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace desktop {
+
+namespace {
+
+const uint32_t kBackgroundColor = 0xFF2D5A88;
+const uint32_t kWindowColor = 0xFFF0F0F0;
+const uint32_t kTitleColor = 0xFF3C3C3C;
+const uint32_t kTextColor = 0xFF101010;
+
+const int kTitleHeight = 24;
+const int kGlyphWidth = 8;
+const int kGlyphHeight = 14;
+const int kLineHeight = 18;
+const int kScrollLines = 3;
+
+void fillRect(Frame* frame, const QRect& rect, uint32_t color)
+{
+    const QRect clipped = rect.intersected(QRect(QPoint(), frame->size()));
+
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(clipped.left(), y));
+        std::fill(row, row + clipped.width(), color);
+    }
+}
+
+void invertRect(Frame* frame, const QRect& rect)
+{
+    const QRect clipped = rect.intersected(QRect(QPoint(), frame->size()));
+
+    for (int y = clipped.top(); y <= clipped.bottom(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(clipped.left(), y));
+
+        for (int x = 0; x < clipped.width(); ++x)
+            row[x] ^= 0x00FFFFFF;
+    }
+}
+
+void drawGlyph(Frame* frame, const QPoint& pos, std::mt19937* random)
+{
+    const QRect rect = QRect(pos, QSize(kGlyphWidth, kGlyphHeight))
+        .intersected(QRect(QPoint(), frame->size()));
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(rect.left(), y));
+
+        // The last column is the space between characters.
+        for (int x = 0; x < rect.width() - 1; ++x)
+            row[x] = ((*random)() % 3 == 0) ? kTextColor : kWindowColor;
+    }
+}
+
+void drawTextLine(Frame* frame, const QPoint& pos, int width, std::mt19937* random)
+{
+    for (int x = 0; x + kGlyphWidth <= width; x += kGlyphWidth)
+    {
+        // Every sixth character is a space.
+        if ((*random)() % 6 != 0)
+            drawGlyph(frame, QPoint(pos.x() + x, pos.y()), random);
+    }
+}
+
+QRect mainWindowRect(const QSize& size)
+{
+    return QRect(size.width() / 8, size.height() / 8,
+                 size.width() * 5 / 8, size.height() * 6 / 8);
+}
+
+QRect textRect(const QRect& window_rect)
+{
+    return QRect(window_rect.left() + 8, window_rect.top() + kTitleHeight + 8,
+                 window_rect.width() - 16, window_rect.height() - kTitleHeight - 16);
+}
+
+void copyFrame(const Frame* source, Frame* target)
+{
+    const int row_size = source->size().width() * source->format().bytesPerPixel();
+
+    for (int y = 0; y < source->size().height(); ++y)
+        memcpy(target->frameDataAtPos(0, y), source->frameDataAtPos(0, y), row_size);
+}
+
+} // namespace
+
+const char* framePatternName(FramePattern pattern)
+{
+    switch (pattern)
+    {
+        case FramePattern::IDLE: return "idle";
+        case FramePattern::CARET: return "caret";
+        case FramePattern::TYPING: return "typing";
+        case FramePattern::SCROLLING: return "scrolling";
+        case FramePattern::VIDEO: return "video";
+    }
+
+    return "unknown";
+}
+
+void drawDesktop(Frame* frame, uint32_t seed)
+{
+    DCHECK_EQ(frame->format().bytesPerPixel(), 4);
+
+    std::mt19937 random(seed);
+    const QSize& size = frame->size();
+
+    fillRect(frame, QRect(QPoint(), size), kBackgroundColor);
+
+    const QRect windows[] =
+    {
+        QRect(size.width() / 2, size.height() / 16, size.width() * 7 / 16, size.height() / 3),
+        mainWindowRect(size)
+    };
+
+    for (const auto& window_rect : windows)
+    {
+        fillRect(frame, window_rect, kWindowColor);
+        fillRect(frame, QRect(window_rect.topLeft(), QSize(window_rect.width(), kTitleHeight)),
+                 kTitleColor);
+
+        const QRect text_rect = textRect(window_rect);
+
+        for (int y = text_rect.top(); y + kLineHeight <= text_rect.bottom(); y += kLineHeight)
+        {
+            // The lines have different lengths.
+            const int width = text_rect.width() * (50 + random() % 50) / 100;
+            drawTextLine(frame, QPoint(text_rect.left(), y), width, &random);
+        }
+    }
+}
+
+void applyFramePattern(FramePattern pattern, const Frame* previous, Frame* current, int step)
+{
+    DCHECK(previous->size() == current->size());
+    DCHECK_EQ(previous->format().bytesPerPixel(), 4);
+    DCHECK_EQ(current->format().bytesPerPixel(), 4);
+
+    copyFrame(previous, current);
+
+    const QSize& size = current->size();
+    const QRect text_rect = textRect(mainWindowRect(size));
+
+    std::mt19937 random(step);
+
+    switch (pattern)
+    {
+        case FramePattern::IDLE:
+            break;
+
+        case FramePattern::CARET:
+            invertRect(current, QRect(text_rect.center(), QSize(2, kLineHeight)));
+            break;
+
+        case FramePattern::TYPING:
+        {
+            const int columns = text_rect.width() / kGlyphWidth - 1;
+            const QPoint pos(text_rect.left() + (step % columns) * kGlyphWidth,
+                             text_rect.center().y());
+
+            drawGlyph(current, pos, &random);
+            invertRect(current, QRect(pos + QPoint(kGlyphWidth, 0), QSize(2, kLineHeight)));
+        }
+        break;
+
+        case FramePattern::SCROLLING:
+        {
+            const int shift = kScrollLines * kLineHeight;
+            const int row_size = text_rect.width() * 4;
+
+            for (int y = text_rect.top(); y <= text_rect.bottom() - shift; ++y)
+            {
+                memcpy(current->frameDataAtPos(text_rect.left(), y),
+                       previous->frameDataAtPos(text_rect.left(), y + shift),
+                       row_size);
+            }
+
+            // New lines appear at the bottom.
+            const QRect new_rect(text_rect.left(), text_rect.bottom() - shift + 1,
+                                 text_rect.width(), shift);
+
+            fillRect(current, new_rect, kWindowColor);
+
+            for (int y = new_rect.top(); y + kLineHeight <= new_rect.bottom() + 1; y += kLineHeight)
+                drawTextLine(current, QPoint(new_rect.left(), y), new_rect.width(), &random);
+        }
+        break;
+
+        case FramePattern::VIDEO:
+        {
+            const QRect video_rect(size.width() / 4, size.height() / 4,
+                                   size.width() / 2, size.height() / 2);
+
+            // A cheap generator: the mersenne twister is too slow for the whole area.
+            uint32_t value = static_cast<uint32_t>(random());
+
+            for (int y = video_rect.top(); y <= video_rect.bottom(); ++y)
+            {
+                uint32_t* row =
+                    reinterpret_cast<uint32_t*>(current->frameDataAtPos(video_rect.left(), y));
+
+                for (int x = 0; x < video_rect.width(); ++x)
+                {
+                    value = value * 1664525 + 1013904223;
+                    row[x] = 0xFF000000 | (value >> 8);
+                }
+            }
+        }
+        break;
+    }
+}
+
+} // namespace desktop
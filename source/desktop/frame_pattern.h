@@ -0,0 +1,52 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_PATTERN_H
+#define DESKTOP__FRAME_PATTERN_H
+
+#include <cstdint>
+
+namespace desktop {
+
+class Frame;
+
+// Synthetic screen content and typical screen updates. Used to measure the capture and encoding
+// path without a real screen.
+enum class FramePattern
+{
+    IDLE,      // Nothing changes.
+    CARET,     // The text caret blinks.
+    TYPING,    // A character is typed and the caret moves.
+    SCROLLING, // The text in a window is scrolled by three lines.
+    VIDEO      // A quarter of the screen changes completely.
+};
+
+const char* framePatternName(FramePattern pattern);
+
+// Fills the ARGB frame with a picture similar to a desktop: a background and windows with lines
+// of text.
+void drawDesktop(Frame* frame, uint32_t seed);
+
+// Makes |current| from |previous| by applying the update |pattern|. The frames must have the
+// same size and the ARGB format. |step| changes the update between calls (the next character is
+// typed, the next video frame is shown).
+void applyFramePattern(FramePattern pattern, const Frame* previous, Frame* current, int step);
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_PATTERN_H
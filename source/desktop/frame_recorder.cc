@@ -0,0 +1,142 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/frame_recorder.h"
+
+#include "base/logging.h"
+#include "desktop/frame_recording.h"
+
+namespace desktop {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+
+template <class T>
+void appendStruct(QByteArray* buffer, const T& value)
+{
+    buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+RecordedRect toRecordedRect(const QRect& rect)
+{
+    return { rect.x(), rect.y(), rect.width(), rect.height() };
+}
+
+} // namespace
+
+FrameRecorder::FrameRecorder(std::unique_ptr<QFile> file)
+    : file_(std::move(file))
+{
+    // Nothing
+}
+
+FrameRecorder::~FrameRecorder() = default;
+
+// static
+std::unique_ptr<FrameRecorder> FrameRecorder::create(const QString& file_path)
+{
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(file_path);
+    if (!file->open(QFile::WriteOnly | QFile::Truncate))
+    {
+        LOG(LS_WARNING) << "Unable to create the recording file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    RecordingHeader header;
+    header.magic = kRecordingMagic;
+    header.version = kRecordingVersion;
+
+    if (file->write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header))
+    {
+        LOG(LS_WARNING) << "Unable to write the recording header";
+        return nullptr;
+    }
+
+    return std::unique_ptr<FrameRecorder>(new FrameRecorder(std::move(file)));
+}
+
+bool FrameRecorder::writeFrame(const Frame& frame)
+{
+    if (frame.format().bytesPerPixel() != kBytesPerPixel)
+    {
+        LOG(LS_WARNING) << "Unsupported pixel format for recording";
+        return false;
+    }
+
+    const QRect frame_rect(QPoint(), frame.size());
+    const bool full_frame = frame_size_ != frame.size();
+
+    if (frame_size_.isEmpty())
+        start_time_ = std::chrono::steady_clock::now();
+
+    frame_size_ = frame.size();
+
+    // After a change of the screen size the player has no previous image, so the whole frame is
+    // written.
+    const DirtyRegion full_region(frame_rect);
+    const DirtyRegion& dirty_region = full_frame ? full_region : frame.constUpdatedRegion();
+
+    RecordedFrameHeader header;
+    header.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time_).count();
+    header.width = frame.size().width();
+    header.height = frame.size().height();
+    header.copy_rect_count = full_frame ? 0 : frame.constCopyRects().size();
+    header.dirty_rect_count = dirty_region.rectCount();
+
+    buffer_.clear();
+    appendStruct(&buffer_, header);
+
+    if (!full_frame)
+    {
+        for (const auto& copy_rect : frame.constCopyRects())
+        {
+            RecordedCopyRect recorded_copy_rect;
+            recorded_copy_rect.source_rect = toRecordedRect(copy_rect.source_rect);
+            recorded_copy_rect.dest_x = copy_rect.dest_pos.x();
+            recorded_copy_rect.dest_y = copy_rect.dest_pos.y();
+
+            appendStruct(&buffer_, recorded_copy_rect);
+        }
+    }
+
+    for (const auto& rect : dirty_region)
+        appendStruct(&buffer_, toRecordedRect(rect));
+
+    for (const auto& rect : dirty_region)
+    {
+        const int row_size = rect.width() * kBytesPerPixel;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            buffer_.append(reinterpret_cast<const char*>(frame.frameDataAtPos(rect.left(), y)),
+                           row_size);
+        }
+    }
+
+    if (file_->write(buffer_) != buffer_.size())
+    {
+        LOG(LS_WARNING) << "Unable to write the frame to the recording";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace desktop
@@ -0,0 +1,60 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_RECORDER_H
+#define DESKTOP__FRAME_RECORDER_H
+
+#include <QByteArray>
+#include <QFile>
+
+#include <chrono>
+#include <memory>
+
+#include "desktop/desktop_frame.h"
+
+namespace desktop {
+
+// Writes the captured frames to a file which can be played by ScreenCapturerReplay. The
+// recordings reproduce real workloads for benchmarks and regression tests without a screen.
+class FrameRecorder
+{
+public:
+    ~FrameRecorder();
+
+    // Creates a recorder which writes to the file |file_path|. If the file exists, it is
+    // overwritten. Returns nullptr if the file can not be created.
+    static std::unique_ptr<FrameRecorder> create(const QString& file_path);
+
+    // Writes the updated region and the copy rectangles of |frame|. Only 32-bit frames are
+    // supported.
+    bool writeFrame(const Frame& frame);
+
+private:
+    explicit FrameRecorder(std::unique_ptr<QFile> file);
+
+    std::unique_ptr<QFile> file_;
+    std::chrono::steady_clock::time_point start_time_;
+    QSize frame_size_;
+    QByteArray buffer_;
+
+    DISALLOW_COPY_AND_ASSIGN(FrameRecorder);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_RECORDER_H
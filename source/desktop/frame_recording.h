@@ -0,0 +1,76 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_RECORDING_H
+#define DESKTOP__FRAME_RECORDING_H
+
+#include <cstdint>
+
+namespace desktop {
+
+// Format of the screen recordings written by FrameRecorder and played by ScreenCapturerReplay.
+// All values are in little-endian byte order.
+//
+// The file starts with RecordingHeader and is followed by the frames. Each frame consists of:
+//   RecordedFrameHeader
+//   RecordedCopyRect[copy_rect_count]
+//   RecordedRect[dirty_rect_count]
+//   Pixels of each dirty rectangle in the ARGB format, row by row without padding.
+//
+// Only the changed areas of the frame are stored. The first frame and each frame after a change
+// of the screen size contain the whole screen.
+
+const uint32_t kRecordingMagic = 0x52505341; // "ASPR"
+const uint32_t kRecordingVersion = 1;
+
+struct RecordingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct RecordedFrameHeader
+{
+    // Time of the capture in microseconds from the start of the recording.
+    int64_t timestamp;
+
+    int32_t width;
+    int32_t height;
+
+    uint32_t copy_rect_count;
+    uint32_t dirty_rect_count;
+};
+
+struct RecordedRect
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+struct RecordedCopyRect
+{
+    RecordedRect source_rect;
+    int32_t dest_x;
+    int32_t dest_y;
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_RECORDING_H
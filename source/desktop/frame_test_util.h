@@ -0,0 +1,82 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__FRAME_TEST_UTIL_H
+#define DESKTOP__FRAME_TEST_UTIL_H
+
+#include "desktop/desktop_frame_aligned.h"
+
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace desktop {
+
+// Frames for the unit tests of the desktop and codec modules.
+
+inline std::unique_ptr<Frame> createTestFrame(const QSize& size)
+{
+    return FrameAligned::create(size, PixelFormat::ARGB(), 32);
+}
+
+// Fills |rect| of the frame with random colors. The pixel translators do not keep the alpha
+// channel, so the tests of the encoders pass 0 for |alpha|.
+inline void fillRandomPixels(Frame* frame, const QRect& rect, uint32_t seed,
+                             uint32_t alpha = 0xFF000000)
+{
+    std::mt19937 random(seed);
+
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        uint32_t* row = reinterpret_cast<uint32_t*>(frame->frameDataAtPos(rect.left(), y));
+
+        for (int x = 0; x < rect.width(); ++x)
+            row[x] = (static_cast<uint32_t>(random()) & 0xFFFFFF) | alpha;
+    }
+}
+
+inline std::unique_ptr<Frame> copyTestFrame(const Frame* source)
+{
+    std::unique_ptr<Frame> frame = createTestFrame(source->size());
+    const int row_size = source->size().width() * source->format().bytesPerPixel();
+
+    for (int y = 0; y < source->size().height(); ++y)
+        memcpy(frame->frameDataAtPos(0, y), source->frameDataAtPos(0, y), row_size);
+
+    return frame;
+}
+
+inline bool isEqualFrames(const Frame* first, const Frame* second)
+{
+    if (first->size() != second->size())
+        return false;
+
+    const int row_size = first->size().width() * first->format().bytesPerPixel();
+
+    for (int y = 0; y < first->size().height(); ++y)
+    {
+        if (memcmp(first->frameDataAtPos(0, y), second->frameDataAtPos(0, y), row_size) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace desktop
+
+#endif // DESKTOP__FRAME_TEST_UTIL_H
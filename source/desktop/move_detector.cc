@@ -0,0 +1,318 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/move_detector.h"
+
+#include <QRegion>
+
+#include "base/logging.h"
+#include "build/build_config.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+
+// Width of the row segment (anchor) which is searched for in the previous frame.
+const int kAnchorWidth = 32;
+
+// Number of rows that are checked when searching for an anchor inside a rectangle.
+const int kMaxAnchorTries = 16;
+
+// Moves of smaller areas are cheaper to encode as usual.
+const int kMinMoveArea = 64 * 64;
+
+// Maximum offset for the search of a moved window. For vertical scrolling, the offset is limited
+// only by the frame height.
+const int kMaxMoveOffset = 256;
+
+// The window search checks about 263k offsets. Content that changes in place (video, animation)
+// gives the same dirty rectangle on every frame and the search fails for it every time, so for
+// such rectangles the search is repeated only once in this number of frames.
+const int kMaxSkippedSearches = 15;
+
+// Number of anchor matches checked for each rectangle. The anchor can match in several places
+// (for example, repeated lines of text), the largest moved area is selected.
+const int kMaxOffsetCandidates = 4;
+
+// Only the largest rectangles of the dirty region are checked.
+const int kMaxCheckedRects = 8;
+
+const int kMaxCopyRects = 8;
+
+FORCEINLINE uint32_t pixelAt(const Frame* frame, int x, int y)
+{
+    return *reinterpret_cast<const uint32_t*>(frame->frameDataAtPos(x, y));
+}
+
+bool isRowSpanEqual(const Frame* previous, const Frame* current,
+                    int x, int y, int width, const QPoint& offset)
+{
+    return memcmp(current->frameDataAtPos(x, y),
+                  previous->frameDataAtPos(x - offset.x(), y - offset.y()),
+                  width * kBytesPerPixel) == 0;
+}
+
+bool isUniform(const uint8_t* data, int width)
+{
+    const uint32_t* pixels = reinterpret_cast<const uint32_t*>(data);
+
+    for (int x = 1; x < width; ++x)
+    {
+        if (pixels[x] != pixels[0])
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+void MoveDetector::detect(const Frame* previous,
+                          const Frame* current,
+                          const DirtyRegion& dirty_region,
+                          QVector<CopyRect>* copy_rects)
+{
+    DCHECK(current);
+    DCHECK(copy_rects);
+
+    copy_rects->clear();
+
+    QVector<FailedRect> previous_failed_rects;
+    previous_failed_rects.swap(failed_rects_);
+
+    if (!previous || previous->size() != current->size())
+        return;
+
+    DCHECK_EQ(current->format().bytesPerPixel(), kBytesPerPixel);
+
+    QVector<QRect> rects;
+
+    for (const auto& rect : dirty_region)
+    {
+        if (rect.width() >= kAnchorWidth && rect.width() * rect.height() >= kMinMoveArea)
+            rects.push_back(rect);
+    }
+
+    if (rects.isEmpty())
+        return;
+
+    std::sort(rects.begin(), rects.end(), [](const QRect& a, const QRect& b)
+    {
+        return a.width() * a.height() > b.width() * b.height();
+    });
+
+    if (rects.size() > kMaxCheckedRects)
+        rects.resize(kMaxCheckedRects);
+
+    const QRect bounding_rect = dirty_region.boundingRect();
+
+    // Union of the destination rectangles already found.
+    QRegion dest_region;
+
+    for (const auto& rect : rects)
+    {
+        if (copy_rects->size() >= kMaxCopyRects)
+            break;
+
+        if (dest_region.contains(rect))
+            continue;
+
+        QPoint anchor;
+        if (!findAnchor(current, rect, &anchor))
+            continue;
+
+        // A moved window changes the dirty rectangle from frame to frame. If the rectangle lies
+        // inside the one for which nothing was found in the previous frame, the window search is
+        // skipped and only the vertical scrolling is checked.
+        FailedRect failed_rect = { rect, 0 };
+
+        for (const auto& previous_failed_rect : previous_failed_rects)
+        {
+            if (previous_failed_rect.rect.contains(rect))
+            {
+                failed_rect = previous_failed_rect;
+                ++failed_rect.skipped_searches;
+                break;
+            }
+        }
+
+        const bool search_moves = failed_rect.skipped_searches == 0 ||
+                                  failed_rect.skipped_searches > kMaxSkippedSearches;
+        if (search_moves)
+            failed_rect = { rect, 0 };
+
+        QPoint offsets[kMaxOffsetCandidates];
+        const int offset_count = findOffsets(
+            previous, current, anchor, search_moves, offsets, kMaxOffsetCandidates);
+
+        QRect best_rect;
+        QPoint best_offset;
+
+        for (int i = 0; i < offset_count; ++i)
+        {
+            QRect moved_rect =
+                movedRect(previous, current, anchor, offsets[i]).intersected(bounding_rect);
+
+            if (moved_rect.width() * moved_rect.height() >
+                best_rect.width() * best_rect.height())
+            {
+                best_rect = moved_rect;
+                best_offset = offsets[i];
+            }
+        }
+
+        if (best_rect.width() * best_rect.height() < kMinMoveArea)
+        {
+            failed_rects_.push_back(failed_rect);
+            continue;
+        }
+
+        const QRect source_rect = best_rect.translated(-best_offset);
+
+        // The copies are applied one after another. The source of this copy must not be
+        // overwritten by the previous copies.
+        if (dest_region.intersects(source_rect) || dest_region.intersects(best_rect))
+            continue;
+
+        copy_rects->push_back({ source_rect, best_rect.topLeft() });
+        dest_region += best_rect;
+    }
+}
+
+bool MoveDetector::findAnchor(const Frame* frame, const QRect& rect, QPoint* anchor) const
+{
+    const int x = rect.left() + (rect.width() - kAnchorWidth) / 2;
+    const int step = std::max(rect.height() / kMaxAnchorTries, 1);
+
+    // Start from the middle of the rectangle. Uniform segments (background) match everywhere and
+    // are skipped.
+    for (int i = 0; i < rect.height(); i += step)
+    {
+        const int y = rect.top() + (rect.height() / 2 + i) % rect.height();
+
+        if (!isUniform(frame->frameDataAtPos(x, y), kAnchorWidth))
+        {
+            *anchor = QPoint(x, y);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int MoveDetector::findOffsets(const Frame* previous, const Frame* current, const QPoint& anchor,
+                              bool search_moves, QPoint* offsets, int max_count) const
+{
+    const QSize& size = current->size();
+    const uint32_t first_pixel = pixelAt(current, anchor.x(), anchor.y());
+    int count = 0;
+
+    auto check_offset = [&](int dx, int dy)
+    {
+        const int x = anchor.x() - dx;
+        const int y = anchor.y() - dy;
+
+        if (x < 0 || y < 0 || x + kAnchorWidth > size.width() || y >= size.height())
+            return;
+
+        if (pixelAt(previous, x, y) != first_pixel)
+            return;
+
+        if (isRowSpanEqual(previous, current, anchor.x(), anchor.y(), kAnchorWidth,
+                           QPoint(dx, dy)))
+        {
+            offsets[count++] = QPoint(dx, dy);
+        }
+    };
+
+    // Vertical scrolling is the most frequent case. The nearest offsets are checked first.
+    for (int dy = 1; dy < size.height() && count < max_count; ++dy)
+    {
+        check_offset(0, dy);
+
+        if (count < max_count)
+            check_offset(0, -dy);
+    }
+
+    if (count || !search_moves)
+        return count;
+
+    // Moving a window.
+    for (int dy = -kMaxMoveOffset; dy <= kMaxMoveOffset && count < max_count; ++dy)
+    {
+        for (int dx = -kMaxMoveOffset; dx <= kMaxMoveOffset && count < max_count; ++dx)
+        {
+            if (dx != 0)
+                check_offset(dx, dy);
+        }
+    }
+
+    return count;
+}
+
+QRect MoveDetector::movedRect(const Frame* previous, const Frame* current,
+                              const QPoint& anchor, const QPoint& offset) const
+{
+    const QSize& size = current->size();
+
+    const int dx = offset.x();
+    const int dy = offset.y();
+
+    // Range of the coordinates for which the source pixel is inside the frame.
+    const int min_x = std::max(0, dx);
+    const int max_x = std::min(size.width(), size.width() + dx);
+    const int min_y = std::max(0, dy);
+    const int max_y = std::min(size.height(), size.height() + dy);
+
+    // Extend the anchor segment horizontally.
+    int left = anchor.x();
+    int right = anchor.x() + kAnchorWidth;
+
+    while (left > min_x && pixelAt(current, left - 1, anchor.y()) ==
+           pixelAt(previous, left - 1 - dx, anchor.y() - dy))
+    {
+        --left;
+    }
+
+    while (right < max_x && pixelAt(current, right, anchor.y()) ==
+           pixelAt(previous, right - dx, anchor.y() - dy))
+    {
+        ++right;
+    }
+
+    // Extend the segment vertically while the whole rows match.
+    const int width = right - left;
+
+    int top = anchor.y();
+    int bottom = anchor.y() + 1;
+
+    while (top > min_y && isRowSpanEqual(previous, current, left, top - 1, width, offset))
+        --top;
+
+    while (bottom < max_y && isRowSpanEqual(previous, current, left, bottom, width, offset))
+        ++bottom;
+
+    return QRect(left, top, width, bottom - top);
+}
+
+} // namespace desktop
@@ -0,0 +1,64 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__MOVE_DETECTOR_H
+#define DESKTOP__MOVE_DETECTOR_H
+
+#include "base/macros_magic.h"
+#include "desktop/desktop_frame.h"
+
+namespace desktop {
+
+// Searches for the areas of the previous frame that have moved in the current frame (scrolling,
+// moving windows). Such areas can be transferred as a copy command instead of the pixels.
+class MoveDetector
+{
+public:
+    MoveDetector() = default;
+    ~MoveDetector() = default;
+
+    // Finds the moved areas inside |dirty_region| (the region that differs between |previous| and
+    // |current|) and replaces the contents of |copy_rects| with them. The pixels of each found
+    // destination rectangle in |current| exactly match the source rectangle in |previous|.
+    void detect(const Frame* previous,
+                const Frame* current,
+                const DirtyRegion& dirty_region,
+                QVector<CopyRect>* copy_rects);
+
+private:
+    bool findAnchor(const Frame* frame, const QRect& rect, QPoint* anchor) const;
+    int findOffsets(const Frame* previous, const Frame* current, const QPoint& anchor,
+                    bool search_moves, QPoint* offsets, int max_count) const;
+    QRect movedRect(const Frame* previous, const Frame* current,
+                    const QPoint& anchor, const QPoint& offset) const;
+
+    // A rectangle for which nothing was found in the previous frame.
+    struct FailedRect
+    {
+        QRect rect;
+        int skipped_searches;
+    };
+
+    QVector<FailedRect> failed_rects_;
+
+    DISALLOW_COPY_AND_ASSIGN(MoveDetector);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__MOVE_DETECTOR_H
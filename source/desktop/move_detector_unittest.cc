@@ -0,0 +1,164 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include "desktop/differ.h"
+#include "desktop/frame_test_util.h"
+#include "desktop/move_detector.h"
+
+namespace desktop {
+
+namespace {
+
+const QSize kFrameSize(800, 600);
+
+std::unique_ptr<Frame> createFrame(uint32_t seed)
+{
+    std::unique_ptr<Frame> frame = createTestFrame(kFrameSize);
+    fillRandomPixels(frame.get(), QRect(QPoint(), kFrameSize), seed);
+    return frame;
+}
+
+QVector<CopyRect> detectMoves(const Frame* previous, const Frame* current)
+{
+    DirtyRegion dirty_region;
+
+    Differ differ(kFrameSize, 1);
+    differ.calcDirtyRegion(previous->frameData(), current->frameData(), &dirty_region);
+
+    QVector<CopyRect> copy_rects;
+
+    MoveDetector detector;
+    detector.detect(previous, current, dirty_region, &copy_rects);
+
+    return copy_rects;
+}
+
+// Checks that applying of |copy_rects| to |previous| gives the pixels of |current| in each
+// destination rectangle.
+void checkCopyRects(const Frame* previous, const Frame* current,
+                    const QVector<CopyRect>& copy_rects)
+{
+    std::unique_ptr<Frame> result = copyTestFrame(previous);
+
+    for (const auto& copy_rect : copy_rects)
+    {
+        result->copyRect(copy_rect.source_rect, copy_rect.dest_pos);
+
+        const QRect dest_rect(copy_rect.dest_pos, copy_rect.source_rect.size());
+
+        for (int y = dest_rect.top(); y <= dest_rect.bottom(); ++y)
+        {
+            EXPECT_EQ(0, memcmp(result->frameDataAtPos(dest_rect.left(), y),
+                                current->frameDataAtPos(dest_rect.left(), y),
+                                dest_rect.width() * 4));
+        }
+    }
+}
+
+} // namespace
+
+TEST(move_detector, vertical_scroll)
+{
+    std::unique_ptr<Frame> previous = createFrame(1);
+    std::unique_ptr<Frame> current = copyTestFrame(previous.get());
+
+    // Scroll the area (100, 50) - (700, 550) up by 40 pixels.
+    const QRect scroll_rect(100, 90, 600, 460);
+    current->copyRect(scroll_rect, QPoint(100, 50));
+
+    QVector<CopyRect> copy_rects = detectMoves(previous.get(), current.get());
+    ASSERT_EQ(1, copy_rects.size());
+
+    EXPECT_EQ(QPoint(100, 50), copy_rects[0].dest_pos);
+    EXPECT_EQ(scroll_rect, copy_rects[0].source_rect);
+
+    checkCopyRects(previous.get(), current.get(), copy_rects);
+}
+
+TEST(move_detector, window_move)
+{
+    std::unique_ptr<Frame> previous = createFrame(2);
+    std::unique_ptr<Frame> current = copyTestFrame(previous.get());
+
+    // Move the window to the right and down.
+    const QRect window_rect(200, 150, 300, 200);
+    current->copyRect(window_rect, QPoint(237, 181));
+
+    QVector<CopyRect> copy_rects = detectMoves(previous.get(), current.get());
+    ASSERT_EQ(1, copy_rects.size());
+
+    EXPECT_EQ(QPoint(237, 181), copy_rects[0].dest_pos);
+    EXPECT_EQ(window_rect, copy_rects[0].source_rect);
+
+    checkCopyRects(previous.get(), current.get(), copy_rects);
+}
+
+TEST(move_detector, no_moves)
+{
+    std::unique_ptr<Frame> previous = createFrame(3);
+    std::unique_ptr<Frame> current = createFrame(4);
+
+    EXPECT_TRUE(detectMoves(previous.get(), current.get()).isEmpty());
+}
+
+TEST(move_detector, window_move_beside_video)
+{
+    // The video area changes in place on every frame. The window search for it is skipped after
+    // the first frame, the window moved in another area is still found.
+    const QRect video_rect(0, 0, 256, 128);
+
+    std::unique_ptr<Frame> previous = createFrame(5);
+    MoveDetector detector;
+    QVector<CopyRect> copy_rects;
+
+    for (uint32_t seed = 6; seed < 10; ++seed)
+    {
+        std::unique_ptr<Frame> current = copyTestFrame(previous.get());
+        fillRandomPixels(current.get(), video_rect, seed);
+
+        const QRect window_rect(200, 250, 300, 200);
+        const QPoint window_pos(221, 283);
+
+        if (seed == 9)
+            current->copyRect(window_rect, window_pos);
+
+        DirtyRegion dirty_region;
+        Differ differ(kFrameSize, 1);
+        differ.calcDirtyRegion(previous->frameData(), current->frameData(), &dirty_region);
+
+        detector.detect(previous.get(), current.get(), dirty_region, &copy_rects);
+
+        if (seed == 9)
+        {
+            ASSERT_EQ(1, copy_rects.size());
+            EXPECT_EQ(window_pos, copy_rects[0].dest_pos);
+            EXPECT_EQ(window_rect, copy_rects[0].source_rect);
+            checkCopyRects(previous.get(), current.get(), copy_rects);
+        }
+        else
+        {
+            EXPECT_TRUE(copy_rects.isEmpty());
+        }
+
+        previous = std::move(current);
+    }
+}
+
+} // namespace desktop
@@ -21,6 +21,8 @@
 
 #include "desktop/desktop_frame.h"
 
+#include <chrono>
+
 namespace desktop {
 
 class ScreenCapturer
@@ -45,6 +47,10 @@ public:
     virtual bool screenList(ScreenList* screens) = 0;
     virtual bool selectScreen(ScreenId screen_id) = 0;
     virtual const Frame* captureFrame() = 0;
+
+    // Returns the time spent by the last call of captureFrame() on the search of the changed areas
+    // of the screen. Used for the latency statistics.
+    virtual std::chrono::microseconds diffTime() const { return std::chrono::microseconds(0); }
 };
 
 } // namespace desktop
@@ -22,11 +22,18 @@
 
 #include "base/logging.h"
 #include "desktop/win/screen_capture_utils.h"
+#include "desktop/desktop_frame_aligned.h"
 #include "desktop/desktop_frame_dib.h"
 #include "desktop/differ.h"
 
 namespace desktop {
 
+namespace {
+
+const size_t kAlignment = 32;
+
+} // namespace
+
 ScreenCapturerGDI::ScreenCapturerGDI() = default;
 ScreenCapturerGDI::~ScreenCapturerGDI() = default;
 
@@ -54,8 +61,6 @@ bool ScreenCapturerGDI::selectScreen(ScreenId screen_id)
 
 const Frame* ScreenCapturerGDI::captureFrame()
 {
-    queue_.moveToNextFrame();
-
     if (!prepareCaptureResources())
         return nullptr;
 
@@ -66,26 +71,24 @@ const Frame* ScreenCapturerGDI::captureFrame()
         return nullptr;
     }
 
-    if (!queue_.currentFrame() || queue_.currentFrame()->size() != screen_rect.size())
+    if (!scratch_frame_ || scratch_frame_->size() != screen_rect.size())
     {
         DCHECK(desktop_dc_);
         DCHECK(memory_dc_);
 
-        std::unique_ptr<Frame> frame = FrameDib::create(
-            screen_rect.size(), PixelFormat::ARGB(), memory_dc_);
-        if (!frame)
+        reference_frame_.reset();
+
+        scratch_frame_ = FrameDib::create(screen_rect.size(), PixelFormat::ARGB(), memory_dc_);
+        if (!scratch_frame_)
         {
             LOG(LS_WARNING) << "Failed to create frame buffer";
             return nullptr;
         }
-
-        queue_.replaceCurrentFrame(std::move(frame));
     }
 
-    FrameDib* current = static_cast<FrameDib*>(queue_.currentFrame());
-    FrameDib* previous = static_cast<FrameDib*>(queue_.previousFrame());
+    FrameDib* scratch = static_cast<FrameDib*>(scratch_frame_.get());
 
-    HGDIOBJ old_bitmap = SelectObject(memory_dc_, current->bitmap());
+    HGDIOBJ old_bitmap = SelectObject(memory_dc_, scratch->bitmap());
     if (old_bitmap)
     {
         BitBlt(memory_dc_,
@@ -100,21 +103,50 @@ const Frame* ScreenCapturerGDI::captureFrame()
         SelectObject(memory_dc_, old_bitmap);
     }
 
-    current->setTopLeft(screen_rect.topLeft());
-
-    if (!previous || previous->size() != current->size())
+    if (!reference_frame_)
     {
+        reference_frame_ =
+            FrameAligned::create(screen_rect.size(), PixelFormat::ARGB(), kAlignment);
+        if (!reference_frame_)
+        {
+            LOG(LS_WARNING) << "Failed to create reference frame";
+            return nullptr;
+        }
+
         differ_ = std::make_unique<Differ>(screen_rect.size());
-        *current->updatedRegion() += QRect(QPoint(), screen_rect.size());
+        differ_->setBlockSize(Differ::kAdaptiveBlockSize);
+
+        DirtyRegion* updated_region = reference_frame_->updatedRegion();
+        updated_region->clear();
+        updated_region->add(QRect(QPoint(), screen_rect.size()));
+
+        reference_frame_->copyPixelsFrom(*scratch, *updated_region);
+        reference_frame_->copyRects()->clear();
+
+        diff_time_ = std::chrono::microseconds(0);
     }
     else
     {
-        differ_->calcDirtyRegion(previous->frameData(),
-                                 current->frameData(),
-                                 current->updatedRegion());
+        const auto diff_start_time = std::chrono::steady_clock::now();
+
+        differ_->calcDirtyRegion(reference_frame_->frameData(),
+                                 scratch->frameData(),
+                                 reference_frame_->updatedRegion());
+
+        // Find scrolled and moved areas inside the changed region. The search needs the previous
+        // image, so the reference frame is updated after it. Only the changed areas are copied.
+        move_detector_.detect(reference_frame_.get(), scratch,
+                              reference_frame_->constUpdatedRegion(),
+                              reference_frame_->copyRects());
+
+        diff_time_ = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - diff_start_time);
+
+        reference_frame_->copyPixelsFrom(*scratch, reference_frame_->constUpdatedRegion());
     }
 
-    return current;
+    reference_frame_->setTopLeft(screen_rect.topLeft());
+    return reference_frame_.get();
 }
 
 bool ScreenCapturerGDI::prepareCaptureResources()
@@ -166,7 +198,8 @@ bool ScreenCapturerGDI::prepareCaptureResources()
         desktop_dc_rect_ = desktop_rect;
 
         // Make sure the frame buffers will be reallocated.
-        queue_.reset();
+        scratch_frame_.reset();
+        reference_frame_.reset();
     }
 
     return true;
@@ -21,8 +21,8 @@
 
 #include "base/win/scoped_hdc.h"
 #include "base/win/scoped_thread_desktop.h"
+#include "desktop/move_detector.h"
 #include "desktop/screen_capturer.h"
-#include "desktop/screen_capture_frame_queue.h"
 
 namespace desktop {
 
@@ -39,6 +39,7 @@ public:
     bool selectScreen(ScreenId screen_id) override;
 
     const Frame* captureFrame() override;
+    std::chrono::microseconds diffTime() const override { return diff_time_; }
 
 private:
     bool prepareCaptureResources();
@@ -50,10 +51,17 @@ private:
     QRect desktop_dc_rect_;
 
     std::unique_ptr<Differ> differ_;
+    MoveDetector move_detector_;
     std::unique_ptr<base::win::ScopedGetDC> desktop_dc_;
     base::win::ScopedCreateDC memory_dc_;
 
-    ScreenCaptureFrameQueue queue_;
+    // The screen is captured to |scratch_frame_|. |reference_frame_| keeps the previous screen
+    // image, only the changed areas are copied to it from |scratch_frame_|. The reference frame is
+    // returned to the caller.
+    std::unique_ptr<Frame> scratch_frame_;
+    std::unique_ptr<Frame> reference_frame_;
+
+    std::chrono::microseconds diff_time_ { 0 };
 
     DISALLOW_COPY_AND_ASSIGN(ScreenCapturerGDI);
 };
@@ -0,0 +1,348 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include "desktop/screen_capturer_replay.h"
+
+#include <QFileInfo>
+
+#include "base/logging.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/frame_recording.h"
+
+#include <cstring>
+
+namespace desktop {
+
+namespace {
+
+const int kBytesPerPixel = 4;
+const size_t kAlignment = 32;
+
+// Limits the size of the frame so that the sizes of the rectangles can not overflow.
+const int kMaxScreenSize = 16384;
+
+template <class T>
+T readStruct(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+QRect fromRecordedRect(const RecordedRect& rect)
+{
+    return QRect(rect.x, rect.y, rect.width, rect.height);
+}
+
+bool isValidRect(const QRect& rect, const QRect& frame_rect)
+{
+    return !rect.isEmpty() && frame_rect.contains(rect);
+}
+
+} // namespace
+
+ScreenCapturerReplay::ScreenCapturerReplay(std::unique_ptr<QFile> file,
+                                           const uint8_t* data,
+                                           int64_t size,
+                                           Mode mode)
+    : file_(std::move(file)),
+      data_(data),
+      size_(size),
+      mode_(mode)
+{
+    // Nothing
+}
+
+ScreenCapturerReplay::~ScreenCapturerReplay() = default;
+
+// static
+std::unique_ptr<ScreenCapturerReplay> ScreenCapturerReplay::open(
+    const QString& file_path, Mode mode)
+{
+    std::unique_ptr<QFile> file = std::make_unique<QFile>(file_path);
+    if (!file->open(QFile::ReadOnly))
+    {
+        LOG(LS_WARNING) << "Unable to open the recording file: " << file_path.toStdString();
+        return nullptr;
+    }
+
+    const int64_t size = file->size();
+    if (size < static_cast<int64_t>(sizeof(RecordingHeader)))
+    {
+        LOG(LS_WARNING) << "Invalid size of the recording file: " << size;
+        return nullptr;
+    }
+
+    const uint8_t* data = file->map(0, size);
+    if (!data)
+    {
+        LOG(LS_WARNING) << "Unable to map the recording file: "
+                        << file->errorString().toStdString();
+        return nullptr;
+    }
+
+    std::unique_ptr<ScreenCapturerReplay> capturer(
+        new ScreenCapturerReplay(std::move(file), data, size, mode));
+
+    if (!capturer->parseFrames())
+        return nullptr;
+
+    return capturer;
+}
+
+int ScreenCapturerReplay::screenCount()
+{
+    return 1;
+}
+
+bool ScreenCapturerReplay::screenList(ScreenList* screens)
+{
+    screens->push_back({ 0, QFileInfo(*file_).fileName() });
+    return true;
+}
+
+bool ScreenCapturerReplay::selectScreen(ScreenId screen_id)
+{
+    return screen_id == kFullDesktopScreenId || screen_id == 0;
+}
+
+const Frame* ScreenCapturerReplay::captureFrame()
+{
+    if (next_frame_ == frameCount())
+    {
+        if (!loop_)
+            return nullptr;
+
+        next_frame_ = 0;
+    }
+
+    if (mode_ == Mode::AS_FAST_AS_POSSIBLE)
+    {
+        if (!applyFrame(next_frame_++, false))
+            return nullptr;
+
+        return frame_.get();
+    }
+
+    const Clock::time_point now = Clock::now();
+
+    // The playback (re)starts. The first frame is due immediately.
+    if (next_frame_ == 0)
+        start_time_ = now - std::chrono::microseconds(frameTimestamp(0));
+
+    const int64_t elapsed =
+        std::chrono::duration_cast<std::chrono::microseconds>(now - start_time_).count();
+
+    if (frame_)
+    {
+        frame_->updatedRegion()->clear();
+        frame_->copyRects()->clear();
+    }
+
+    bool merge = false;
+
+    while (next_frame_ < frameCount() && frameTimestamp(next_frame_) <= elapsed)
+    {
+        if (!applyFrame(next_frame_++, merge))
+            return nullptr;
+
+        merge = true;
+    }
+
+    return frame_.get();
+}
+
+bool ScreenCapturerReplay::parseFrames()
+{
+    const RecordingHeader header = readStruct<RecordingHeader>(data_);
+    if (header.magic != kRecordingMagic || header.version != kRecordingVersion)
+    {
+        LOG(LS_WARNING) << "Unsupported recording format";
+        return false;
+    }
+
+    int64_t offset = sizeof(header);
+    QSize frame_size;
+
+    while (offset < size_)
+    {
+        if (size_ - offset < static_cast<int64_t>(sizeof(RecordedFrameHeader)))
+        {
+            LOG(LS_WARNING) << "Truncated frame header at offset " << offset;
+            return false;
+        }
+
+        const RecordedFrameHeader frame_header = readStruct<RecordedFrameHeader>(data_ + offset);
+
+        if (frame_header.width <= 0 || frame_header.width > kMaxScreenSize ||
+            frame_header.height <= 0 || frame_header.height > kMaxScreenSize)
+        {
+            LOG(LS_WARNING) << "Invalid frame size at offset " << offset;
+            return false;
+        }
+
+        const QRect frame_rect(0, 0, frame_header.width, frame_header.height);
+
+        int64_t pos = offset + sizeof(frame_header);
+
+        const int64_t rects_size =
+            static_cast<int64_t>(frame_header.copy_rect_count) * sizeof(RecordedCopyRect) +
+            static_cast<int64_t>(frame_header.dirty_rect_count) * sizeof(RecordedRect);
+
+        if (size_ - pos < rects_size)
+        {
+            LOG(LS_WARNING) << "Truncated frame rectangles at offset " << offset;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < frame_header.copy_rect_count; ++i)
+        {
+            const RecordedCopyRect copy_rect = readStruct<RecordedCopyRect>(data_ + pos);
+            const QRect source_rect = fromRecordedRect(copy_rect.source_rect);
+
+            if (!isValidRect(source_rect, frame_rect) ||
+                !isValidRect(QRect(QPoint(copy_rect.dest_x, copy_rect.dest_y),
+                                   source_rect.size()), frame_rect))
+            {
+                LOG(LS_WARNING) << "Invalid copy rectangle at offset " << pos;
+                return false;
+            }
+
+            pos += sizeof(copy_rect);
+        }
+
+        int64_t pixels_size = 0;
+
+        for (uint32_t i = 0; i < frame_header.dirty_rect_count; ++i)
+        {
+            const QRect rect = fromRecordedRect(readStruct<RecordedRect>(data_ + pos));
+            if (!isValidRect(rect, frame_rect))
+            {
+                LOG(LS_WARNING) << "Invalid dirty rectangle at offset " << pos;
+                return false;
+            }
+
+            // After a change of the screen size there is no previous image, the frame must
+            // contain the whole screen.
+            if (frame_size != frame_rect.size() &&
+                (frame_header.dirty_rect_count != 1 || rect != frame_rect))
+            {
+                LOG(LS_WARNING) << "Incomplete first frame at offset " << offset;
+                return false;
+            }
+
+            pixels_size += static_cast<int64_t>(rect.width()) * rect.height() * kBytesPerPixel;
+            pos += sizeof(RecordedRect);
+        }
+
+        if (frame_size != frame_rect.size() && frame_header.dirty_rect_count == 0)
+        {
+            LOG(LS_WARNING) << "Empty first frame at offset " << offset;
+            return false;
+        }
+
+        if (size_ - pos < pixels_size)
+        {
+            LOG(LS_WARNING) << "Truncated frame pixels at offset " << offset;
+            return false;
+        }
+
+        frame_offsets_.push_back(offset);
+        frame_size = frame_rect.size();
+        offset = pos + pixels_size;
+    }
+
+    if (frame_offsets_.empty())
+    {
+        LOG(LS_WARNING) << "Recording does not contain frames";
+        return false;
+    }
+
+    return true;
+}
+
+int64_t ScreenCapturerReplay::frameTimestamp(int index) const
+{
+    return readStruct<RecordedFrameHeader>(data_ + frame_offsets_[index]).timestamp;
+}
+
+bool ScreenCapturerReplay::applyFrame(int index, bool merge)
+{
+    const uint8_t* pos = data_ + frame_offsets_[index];
+
+    const RecordedFrameHeader header = readStruct<RecordedFrameHeader>(pos);
+    pos += sizeof(header);
+
+    const QSize size(header.width, header.height);
+
+    if (!frame_ || frame_->size() != size)
+    {
+        frame_ = FrameAligned::create(size, PixelFormat::ARGB(), kAlignment);
+        if (!frame_)
+        {
+            LOG(LS_WARNING) << "Unable to create the frame";
+            return false;
+        }
+
+        merge = false;
+    }
+
+    DirtyRegion* updated_region = frame_->updatedRegion();
+    QVector<CopyRect>* copy_rects = frame_->copyRects();
+
+    if (!merge)
+        updated_region->clear();
+
+    // The copy rectangles refer to the previous frame of the recording. When several frames are
+    // combined, the copied areas are sent as usual changes.
+    copy_rects->clear();
+
+    for (uint32_t i = 0; i < header.copy_rect_count; ++i)
+    {
+        const RecordedCopyRect copy_rect = readStruct<RecordedCopyRect>(pos);
+        pos += sizeof(copy_rect);
+
+        if (!merge)
+        {
+            copy_rects->push_back({ fromRecordedRect(copy_rect.source_rect),
+                                    QPoint(copy_rect.dest_x, copy_rect.dest_y) });
+        }
+    }
+
+    const uint8_t* pixels = pos + header.dirty_rect_count * sizeof(RecordedRect);
+
+    for (uint32_t i = 0; i < header.dirty_rect_count; ++i)
+    {
+        const QRect rect = fromRecordedRect(readStruct<RecordedRect>(pos));
+        pos += sizeof(RecordedRect);
+
+        const int row_size = rect.width() * kBytesPerPixel;
+
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            memcpy(frame_->frameDataAtPos(rect.left(), y), pixels, row_size);
+            pixels += row_size;
+        }
+
+        updated_region->add(rect);
+    }
+
+    return true;
+}
+
+} // namespace desktop
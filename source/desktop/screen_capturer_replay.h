@@ -0,0 +1,97 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#ifndef DESKTOP__SCREEN_CAPTURER_REPLAY_H
+#define DESKTOP__SCREEN_CAPTURER_REPLAY_H
+
+#include <QFile>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "desktop/screen_capturer.h"
+
+namespace desktop {
+
+// Plays the screen recording written by FrameRecorder instead of capturing the screen. The file
+// is memory-mapped, the frames are not copied before they are applied. It allows to run the
+// capture-to-encode pipeline without a screen with the same input each time.
+class ScreenCapturerReplay : public ScreenCapturer
+{
+public:
+    enum class Mode
+    {
+        // The frames are returned according to their timestamps. If several frames are due, they
+        // are combined into one. If no frame is due, the frame without changes is returned.
+        REAL_TIME,
+
+        // Each call of captureFrame returns the next frame of the recording.
+        AS_FAST_AS_POSSIBLE
+    };
+
+    ~ScreenCapturerReplay();
+
+    // Opens and validates the recording. Returns nullptr if the file can not be opened or is
+    // corrupted.
+    static std::unique_ptr<ScreenCapturerReplay> open(const QString& file_path, Mode mode);
+
+    int frameCount() const { return static_cast<int>(frame_offsets_.size()); }
+
+    // If |loop| is true, the playback restarts from the first frame after the last frame.
+    // Otherwise captureFrame returns nullptr at the end of the recording. By default, the
+    // playback is not looped.
+    void setLoop(bool loop) { loop_ = loop; }
+
+    // ScreenCapturer implementation.
+    int screenCount() override;
+    bool screenList(ScreenList* screens) override;
+    bool selectScreen(ScreenId screen_id) override;
+    const Frame* captureFrame() override;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    ScreenCapturerReplay(std::unique_ptr<QFile> file, const uint8_t* data, int64_t size,
+                         Mode mode);
+
+    bool parseFrames();
+    int64_t frameTimestamp(int index) const;
+
+    // Applies the frame |index| to |frame_|. If |merge| is true, the updated region of the frame
+    // is added to the current updated region.
+    bool applyFrame(int index, bool merge);
+
+    std::unique_ptr<QFile> file_;
+    const uint8_t* const data_;
+    const int64_t size_;
+    const Mode mode_;
+
+    std::vector<int64_t> frame_offsets_;
+    int next_frame_ = 0;
+    bool loop_ = false;
+
+    Clock::time_point start_time_;
+    std::unique_ptr<Frame> frame_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScreenCapturerReplay);
+};
+
+} // namespace desktop
+
+#endif // DESKTOP__SCREEN_CAPTURER_REPLAY_H
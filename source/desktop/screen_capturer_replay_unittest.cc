@@ -0,0 +1,185 @@
+//
+// Aspia Project
+// Copyright (C) 2018 Dmitry Chapyshev <dmitry@aspia.ru>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "desktop/frame_recorder.h"
+#include "desktop/frame_test_util.h"
+#include "desktop/screen_capturer_replay.h"
+
+#include <thread>
+
+namespace desktop {
+
+namespace {
+
+const QSize kFrameSize(320, 240);
+
+// Writes three frames: the whole screen, a changed rectangle and a moved area. Returns the
+// expected images of the frames.
+std::vector<std::unique_ptr<Frame>> writeRecording(const QString& file_path)
+{
+    std::vector<std::unique_ptr<Frame>> frames;
+
+    std::unique_ptr<FrameRecorder> recorder = FrameRecorder::create(file_path);
+    EXPECT_TRUE(recorder);
+    if (!recorder)
+        return frames;
+
+    std::unique_ptr<Frame> frame = createTestFrame(kFrameSize);
+
+    fillRandomPixels(frame.get(), QRect(QPoint(), kFrameSize), 1);
+    EXPECT_TRUE(recorder->writeFrame(*frame));
+    frames.push_back(copyTestFrame(frame.get()));
+
+    const QRect changed_rect(10, 20, 30, 40);
+    fillRandomPixels(frame.get(), changed_rect, 2);
+    frame->updatedRegion()->clear();
+    frame->updatedRegion()->add(changed_rect);
+    EXPECT_TRUE(recorder->writeFrame(*frame));
+    frames.push_back(copyTestFrame(frame.get()));
+
+    const QRect source_rect(100, 100, 64, 64);
+    const QPoint dest_pos(100, 80);
+    frame->copyRect(source_rect, dest_pos);
+    frame->updatedRegion()->clear();
+    frame->updatedRegion()->add(QRect(100, 80, 64, 84));
+    frame->copyRects()->clear();
+    frame->copyRects()->push_back({ source_rect, dest_pos });
+    EXPECT_TRUE(recorder->writeFrame(*frame));
+    frames.push_back(copyTestFrame(frame.get()));
+
+    return frames;
+}
+
+QString recordingPath(const QTemporaryDir& temp_dir)
+{
+    return QDir(temp_dir.path()).filePath("recording.aspr");
+}
+
+} // namespace
+
+TEST(screen_capturer_replay, fast_playback)
+{
+    QTemporaryDir temp_dir;
+    ASSERT_TRUE(temp_dir.isValid());
+
+    const QString file_path = recordingPath(temp_dir);
+    const std::vector<std::unique_ptr<Frame>> frames = writeRecording(file_path);
+    ASSERT_EQ(3U, frames.size());
+
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::open(
+        file_path, ScreenCapturerReplay::Mode::AS_FAST_AS_POSSIBLE);
+    ASSERT_TRUE(capturer);
+    ASSERT_EQ(3, capturer->frameCount());
+
+    const Frame* frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_TRUE(isEqualFrames(frames[0].get(), frame));
+    EXPECT_EQ(DirtyRegion(QRect(QPoint(), kFrameSize)), frame->constUpdatedRegion());
+
+    frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_TRUE(isEqualFrames(frames[1].get(), frame));
+    EXPECT_EQ(DirtyRegion(QRect(10, 20, 30, 40)), frame->constUpdatedRegion());
+    EXPECT_TRUE(frame->constCopyRects().isEmpty());
+
+    frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_TRUE(isEqualFrames(frames[2].get(), frame));
+    ASSERT_EQ(1, frame->constCopyRects().size());
+    EXPECT_EQ(QRect(100, 100, 64, 64), frame->constCopyRects()[0].source_rect);
+    EXPECT_EQ(QPoint(100, 80), frame->constCopyRects()[0].dest_pos);
+
+    // End of the recording.
+    EXPECT_FALSE(capturer->captureFrame());
+}
+
+TEST(screen_capturer_replay, loop)
+{
+    QTemporaryDir temp_dir;
+    ASSERT_TRUE(temp_dir.isValid());
+
+    const QString file_path = recordingPath(temp_dir);
+    const std::vector<std::unique_ptr<Frame>> frames = writeRecording(file_path);
+    ASSERT_EQ(3U, frames.size());
+
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::open(
+        file_path, ScreenCapturerReplay::Mode::AS_FAST_AS_POSSIBLE);
+    ASSERT_TRUE(capturer);
+
+    capturer->setLoop(true);
+
+    for (int i = 0; i < 7; ++i)
+    {
+        const Frame* frame = capturer->captureFrame();
+        ASSERT_TRUE(frame);
+        EXPECT_TRUE(isEqualFrames(frames[i % 3].get(), frame));
+    }
+}
+
+TEST(screen_capturer_replay, real_time_playback)
+{
+    QTemporaryDir temp_dir;
+    ASSERT_TRUE(temp_dir.isValid());
+
+    const QString file_path = recordingPath(temp_dir);
+    const std::vector<std::unique_ptr<Frame>> frames = writeRecording(file_path);
+    ASSERT_EQ(3U, frames.size());
+
+    std::unique_ptr<ScreenCapturerReplay> capturer = ScreenCapturerReplay::open(
+        file_path, ScreenCapturerReplay::Mode::REAL_TIME);
+    ASSERT_TRUE(capturer);
+
+    // The first frame is due immediately.
+    const Frame* frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_FALSE(frame->constUpdatedRegion().isEmpty());
+
+    // The frames were written without delays, so the rest of the frames are due after the pause
+    // and are combined into one frame.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    frame = capturer->captureFrame();
+    ASSERT_TRUE(frame);
+    EXPECT_TRUE(isEqualFrames(frames[2].get(), frame));
+    EXPECT_TRUE(frame->constUpdatedRegion().contains(QPoint(100, 80)));
+
+    EXPECT_FALSE(capturer->captureFrame());
+}
+
+TEST(screen_capturer_replay, corrupted_file)
+{
+    QTemporaryDir temp_dir;
+    ASSERT_TRUE(temp_dir.isValid());
+
+    const QString file_path = recordingPath(temp_dir);
+    const std::vector<std::unique_ptr<Frame>> frames = writeRecording(file_path);
+    ASSERT_EQ(3U, frames.size());
+
+    QFile file(file_path);
+    ASSERT_TRUE(file.resize(file.size() - 1));
+
+    EXPECT_FALSE(ScreenCapturerReplay::open(
+        file_path, ScreenCapturerReplay::Mode::AS_FAST_AS_POSSIBLE));
+}
+
+} // namespace desktop
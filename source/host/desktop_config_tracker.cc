@@ -59,15 +59,39 @@ uint32_t DesktopConfigTracker::changeFlags(const proto::desktop::Config& new_con
     if (old_config_.scale_factor() != new_config.scale_factor())
         result |= VIDEO_CHANGES;
 
+    if (old_config_.max_width() != new_config.max_width() ||
+        old_config_.max_height() != new_config.max_height())
+    {
+        result |= VIDEO_CHANGES;
+    }
+
     if (old_config_.compress_ratio() != new_config.compress_ratio())
         result |= VIDEO_CHANGES;
 
+    if (old_config_.tile_cache_size() != new_config.tile_cache_size())
+        result |= VIDEO_CHANGES;
+
+    if (old_config_.top_off_delay() != new_config.top_off_delay())
+        result |= VIDEO_CHANGES;
+
     if ((old_config_.flags() & proto::desktop::ENABLE_CURSOR_SHAPE) !=
         (new_config.flags() & proto::desktop::ENABLE_CURSOR_SHAPE))
     {
         result |= VIDEO_CHANGES;
     }
 
+    if ((old_config_.flags() & proto::desktop::ENABLE_INTER_FRAME_COMPRESSION) !=
+        (new_config.flags() & proto::desktop::ENABLE_INTER_FRAME_COMPRESSION))
+    {
+        result |= VIDEO_CHANGES;
+    }
+
+    if ((old_config_.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO) !=
+        (new_config.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO))
+    {
+        result |= VIDEO_CHANGES;
+    }
+
     if ((old_config_.flags() & proto::desktop::ENABLE_CLIPBOARD) !=
         (new_config.flags() & proto::desktop::ENABLE_CLIPBOARD))
     {
@@ -95,6 +95,8 @@ void SessionDesktop::messageReceived(const QByteArray& buffer)
         readExtension(incoming_message_.extension());
     else if (incoming_message_.has_config())
         readConfig(incoming_message_.config());
+    else if (incoming_message_.has_video_ack())
+        readVideoAck(incoming_message_.video_ack());
     else
     {
         DLOG(LS_WARNING) << "Unhandled message from client";
@@ -280,6 +282,12 @@ void SessionDesktop::readConfig(const proto::desktop::Config& config)
     }
 }
 
+void SessionDesktop::readVideoAck(const proto::desktop::VideoAck& video_ack)
+{
+    if (screen_updater_)
+        screen_updater_->frameAcknowledged(video_ack.frame_id());
+}
+
 void SessionDesktop::sendSystemInfo()
 {
     proto::system_info::SystemInfo system_info;
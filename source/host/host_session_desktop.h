@@ -64,6 +64,7 @@ private:
     void readClipboardEvent(const proto::desktop::ClipboardEvent& event);
     void readExtension(const proto::desktop::Extension& extension);
     void readConfig(const proto::desktop::Config& config);
+    void readVideoAck(const proto::desktop::VideoAck& video_ack);
 
     void sendSystemInfo();
 
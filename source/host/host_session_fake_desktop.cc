@@ -18,6 +18,8 @@
 
 #include "host/host_session_fake_desktop.h"
 
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
 #include "codec/video_encoder_vpx.h"
 #include "codec/video_encoder_zstd.h"
 #include "codec/video_util.h"
@@ -93,6 +95,16 @@ codec::VideoEncoder* SessionFakeDesktop::createEncoder(const proto::desktop::Con
                 codec::VideoUtil::fromVideoPixelFormat(
                     config.pixel_format()), config.compress_ratio());
 
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+            return codec::VideoEncoderHybrid::create(
+                codec::VideoUtil::fromVideoPixelFormat(
+                    config.pixel_format()), config.compress_ratio());
+
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+            return codec::VideoEncoderPalette::create(
+                codec::VideoUtil::fromVideoPixelFormat(
+                    config.pixel_format()), config.compress_ratio());
+
         default:
             LOG(LS_WARNING) << "Unsupported video encoding: " << config.video_encoding();
             return nullptr;
@@ -111,7 +123,7 @@ std::unique_ptr<desktop::Frame> SessionFakeDesktop::createFrame()
 
     memset(frame->frameData(), 0, frame->stride() * frame->size().height());
 
-    *frame->updatedRegion() += QRect(QPoint(), frame->size());
+    frame->updatedRegion()->add(QRect(QPoint(), frame->size()));
     return frame;
 }
 
@@ -22,11 +22,17 @@
 #include <QEvent>
 #include <QThread>
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <thread>
 
+#include "base/bandwidth_estimator.h"
+#include "base/spsc_queue.h"
 #include "codec/cursor_encoder.h"
 #include "codec/scale_reducer.h"
+#include "codec/video_encoder_hybrid.h"
+#include "codec/video_encoder_palette.h"
 #include "codec/video_encoder_vpx.h"
 #include "codec/video_encoder_zstd.h"
 #include "codec/video_util.h"
@@ -34,11 +40,48 @@
 #include "common/message_serialization.h"
 #include "desktop/capture_scheduler.h"
 #include "desktop/cursor_capturer_win.h"
+#include "desktop/desktop_frame_aligned.h"
+#include "desktop/frame_recorder.h"
 #include "desktop/screen_capturer_gdi.h"
+#include "desktop/screen_capturer_replay.h"
 #include "proto/desktop_session_extensions.pb.h"
 
 namespace host {
 
+namespace {
+
+#if defined(ENABLE_SCREEN_REPLAY)
+// Environment variables for reproducing the screen updates of real workloads. They are read only
+// if the host is built with ENABLE_SCREEN_REPLAY:
+//   ASPIA_REPLAY_FILE - the frames are read from the recording instead of the screen.
+//   ASPIA_REPLAY_FAST - if not empty, the recording is played as fast as possible.
+//   ASPIA_RECORD_FILE - the captured frames are written to the recording.
+const char kReplayFileVariable[] = "ASPIA_REPLAY_FILE";
+const char kReplayFastVariable[] = "ASPIA_REPLAY_FAST";
+const char kRecordFileVariable[] = "ASPIA_RECORD_FILE";
+#endif // defined(ENABLE_SCREEN_REPLAY)
+
+// Maximum number of items waiting in the queues between the stages. A larger queue smooths the
+// peaks of the stage times, but adds the latency.
+const size_t kQueueSize = 2;
+
+// One item for the stage that processes it plus the items waiting in the queue. When all frames
+// are in use, the capture waits until the encoder releases a frame.
+const int kFramePoolSize = kQueueSize + 1;
+const int kMessagePoolSize = kQueueSize + 1;
+
+const size_t kFrameAlignment = 32;
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t toMicroseconds(Clock::duration duration)
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+} // namespace
+
 class MessageEvent : public QEvent
 {
 public:
@@ -58,6 +101,13 @@ private:
     DISALLOW_COPY_AND_ASSIGN(MessageEvent);
 };
 
+// The screen updates are processed by three stages, each in its own thread:
+//   capture   - captures the screen and the cursor (the thread of QThread);
+//   encode    - scales and encodes the frame and the cursor;
+//   serialize - serializes the message and sends it to the session.
+// The stages are connected by the bounded queues. The frames and the messages are returned to
+// the previous stage after use and are reused, so the steady-state throughput is limited by the
+// slowest stage instead of the sum of the stages.
 class ScreenUpdaterImpl : public QThread
 {
 public:
@@ -66,6 +116,7 @@ public:
 
     bool startUpdater(const proto::desktop::Config& config);
     void selectScreen(desktop::ScreenCapturer::ScreenId screen_id);
+    void frameAcknowledged(uint32_t frame_id);
 
 protected:
     // QThread implementation.
@@ -74,12 +125,57 @@ protected:
 private:
     enum class Event { NO_EVENT, SELECT_SCREEN, TERMINATE };
 
+    // The frame passed from the capture stage to the encode stage.
+    struct CapturedFrame
+    {
+        // Index in |stale_regions_|.
+        int index = 0;
+
+        // Sequence number of the video packet.
+        uint32_t frame_id = 0;
+
+        // The video packet is encoded if the screen has changed or the encoder has an update.
+        bool has_video_update = false;
+
+        std::unique_ptr<desktop::Frame> frame;
+        std::unique_ptr<desktop::MouseCursor> mouse_cursor;
+
+        // Times of the capture stage for the latency statistics.
+        Clock::time_point capture_start_time;
+        Clock::time_point queued_time;
+        Clock::duration capture_time;
+        std::chrono::microseconds diff_time;
+    };
+
+    using CapturedFramePtr = std::unique_ptr<CapturedFrame>;
+    using MessagePtr = std::unique_ptr<proto::desktop::HostToClient>;
+
+    void createScreenCapturer();
+    void sendScreenList();
+    bool hasFrameCredit() const;
+
+    // Capture stage.
+    bool captureFrame();
+    bool copyCapturedFrame(const desktop::Frame* screen_frame, CapturedFrame* captured_frame);
+
+    // Encode and serialize stages.
+    static void setFrameTimings(const CapturedFrame& captured_frame,
+                                Clock::time_point encode_start_time,
+                                proto::desktop::FrameTimings* timings);
+    void encodeThread();
+    void serializeThread();
+    void stopStages();
+
     std::unique_ptr<desktop::CaptureScheduler> capture_scheduler_;
 
     std::unique_ptr<desktop::ScreenCapturer> screen_capturer_;
+    std::unique_ptr<desktop::FrameRecorder> frame_recorder_;
     std::unique_ptr<codec::ScaleReducer> scale_reducer_;
     std::unique_ptr<codec::VideoEncoder> video_encoder_;
 
+    // The screen position and size sent to the client. Used by the encode thread.
+    QRect source_rect_;
+
     std::unique_ptr<desktop::CursorCapturer> cursor_capturer_;
     std::unique_ptr<codec::CursorEncoder> cursor_encoder_;
 
@@ -91,7 +187,36 @@ private:
     std::condition_variable event_condition_;
     std::mutex event_lock_;
 
-    proto::desktop::HostToClient message_;
+    // Flow control. The capture is skipped while the client has not confirmed |frame_window_|
+    // video packets. The skipped changes are not lost: the next capture compares the screen with
+    // the last captured image, so its updated region contains them.
+    uint32_t frame_window_ = 0;
+
+    // The fields below are protected by |event_lock_|.
+    uint32_t last_frame_id_ = 0;
+    uint32_t acked_frame_id_ = 0;
+    bool waiting_for_ack_ = false;
+
+    // Estimated from the confirmations of the video packets and passed to the encoder.
+    base::BandwidthEstimator bandwidth_estimator_;
+
+    // Captured frames waiting for the encoder and the free frames returned by the encoder.
+    base::SpscQueue<CapturedFramePtr> encode_queue_ { kQueueSize };
+    base::SpscQueue<CapturedFramePtr> free_frames_ { kFramePoolSize };
+
+    // Encoded messages waiting for the serialization and the free messages.
+    base::SpscQueue<MessagePtr> serialize_queue_ { kQueueSize };
+    base::SpscQueue<MessagePtr> free_messages_ { kMessagePoolSize };
+
+    // The areas of each pool frame that have changed since the frame was filled last time. Used
+    // only by the capture stage.
+    std::vector<desktop::DirtyRegion> stale_regions_;
+
+    // The free frame which the capture stage has taken but has not used.
+    CapturedFramePtr spare_frame_;
+
+    std::thread encode_thread_;
+    std::thread serialize_thread_;
 
     DISALLOW_COPY_AND_ASSIGN(ScreenUpdaterImpl);
 };
@@ -122,25 +247,80 @@ ScreenUpdaterImpl::~ScreenUpdaterImpl()
 
 bool ScreenUpdaterImpl::startUpdater(const proto::desktop::Config& config)
 {
-    scale_reducer_.reset(codec::ScaleReducer::create(config.scale_factor()));
+    scale_reducer_.reset(codec::ScaleReducer::create(
+        config.scale_factor(),
+        QSize(static_cast<int>(config.max_width()), static_cast<int>(config.max_height()))));
     if (!scale_reducer_)
         return false;
 
     switch (config.video_encoding())
     {
         case proto::desktop::VIDEO_ENCODING_VP8:
-            video_encoder_.reset(codec::VideoEncoderVPX::createVP8());
-            break;
-
         case proto::desktop::VIDEO_ENCODING_VP9:
-            video_encoder_.reset(codec::VideoEncoderVPX::createVP9());
-            break;
+        {
+            std::unique_ptr<codec::VideoEncoderVPX> vpx_encoder(
+                config.video_encoding() == proto::desktop::VIDEO_ENCODING_VP8 ?
+                codec::VideoEncoderVPX::createVP8() : codec::VideoEncoderVPX::createVP9());
+
+            vpx_encoder->setTopOffDelay(std::chrono::milliseconds(config.top_off_delay()));
+            video_encoder_ = std::move(vpx_encoder);
+        }
+        break;
 
         case proto::desktop::VIDEO_ENCODING_ZSTD:
-            video_encoder_.reset(codec::VideoEncoderZstd::create(
-                codec::VideoUtil::fromVideoPixelFormat(
-                    config.pixel_format()), config.compress_ratio()));
-            break;
+        {
+            std::unique_ptr<codec::VideoEncoderZstd> zstd_encoder(codec::VideoEncoderZstd::create(
+                codec::VideoUtil::fromVideoPixelFormat(config.pixel_format()),
+                config.compress_ratio(),
+                config.tile_cache_size(),
+                config.flags() & proto::desktop::ENABLE_INTER_FRAME_COMPRESSION));
+
+            // The encoder must keep up with the capture.
+            if (zstd_encoder && (config.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO))
+            {
+                zstd_encoder->setAutoCompressRatio(
+                    std::chrono::milliseconds(config.update_interval()));
+            }
+
+            video_encoder_ = std::move(zstd_encoder);
+        }
+        break;
+
+        case proto::desktop::VIDEO_ENCODING_HYBRID:
+        {
+            std::unique_ptr<codec::VideoEncoderHybrid> hybrid_encoder(
+                codec::VideoEncoderHybrid::create(
+                    codec::VideoUtil::fromVideoPixelFormat(config.pixel_format()),
+                    config.compress_ratio(),
+                    config.tile_cache_size()));
+
+            if (hybrid_encoder && (config.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO))
+            {
+                hybrid_encoder->setAutoCompressRatio(
+                    std::chrono::milliseconds(config.update_interval()));
+            }
+
+            video_encoder_ = std::move(hybrid_encoder);
+        }
+        break;
+
+        case proto::desktop::VIDEO_ENCODING_PALETTE:
+        {
+            std::unique_ptr<codec::VideoEncoderPalette> palette_encoder(
+                codec::VideoEncoderPalette::create(
+                    codec::VideoUtil::fromVideoPixelFormat(config.pixel_format()),
+                    config.compress_ratio(),
+                    config.tile_cache_size()));
+
+            if (palette_encoder && (config.flags() & proto::desktop::ENABLE_AUTO_COMPRESS_RATIO))
+            {
+                palette_encoder->setAutoCompressRatio(
+                    std::chrono::milliseconds(config.update_interval()));
+            }
+
+            video_encoder_ = std::move(palette_encoder);
+        }
+        break;
 
         default:
         {
@@ -165,6 +345,21 @@ bool ScreenUpdaterImpl::startUpdater(const proto::desktop::Config& config)
     capture_scheduler_.reset(
         new desktop::CaptureScheduler(std::chrono::milliseconds(config.update_interval())));
 
+    frame_window_ = config.frame_window();
+
+    for (int i = 0; i < kFramePoolSize; ++i)
+    {
+        CapturedFramePtr captured_frame = std::make_unique<CapturedFrame>();
+        captured_frame->index = i;
+
+        free_frames_.tryPush(std::move(captured_frame));
+    }
+
+    stale_regions_.resize(kFramePoolSize);
+
+    for (int i = 0; i < kMessagePoolSize; ++i)
+        free_messages_.tryPush(std::make_unique<proto::desktop::HostToClient>());
+
     start(QThread::HighPriority);
     return true;
 }
@@ -180,9 +375,114 @@ void ScreenUpdaterImpl::selectScreen(desktop::ScreenCapturer::ScreenId screen_id
     event_condition_.notify_all();
 }
 
+void ScreenUpdaterImpl::frameAcknowledged(uint32_t frame_id)
+{
+    std::scoped_lock lock(event_lock_);
+
+    // The packets are confirmed in order. Old confirmations and the confirmations of the packets
+    // which were not sent by this updater are ignored.
+    if (static_cast<int32_t>(frame_id - acked_frame_id_) <= 0 ||
+        static_cast<int32_t>(frame_id - last_frame_id_) > 0)
+    {
+        return;
+    }
+
+    acked_frame_id_ = frame_id;
+    bandwidth_estimator_.packetAcknowledged(frame_id);
+
+    // The capture is waiting for the confirmation. Capture the next frame without waiting for the
+    // end of the update interval.
+    if (waiting_for_ack_)
+        event_condition_.notify_all();
+}
+
+bool ScreenUpdaterImpl::hasFrameCredit() const
+{
+    if (!frame_window_)
+        return true;
+
+    return last_frame_id_ - acked_frame_id_ < frame_window_;
+}
+
+void ScreenUpdaterImpl::createScreenCapturer()
+{
+#if defined(ENABLE_SCREEN_REPLAY)
+    const QString replay_file = qEnvironmentVariable(kReplayFileVariable);
+    if (!replay_file.isEmpty())
+    {
+        const bool fast = !qEnvironmentVariableIsEmpty(kReplayFastVariable);
+
+        std::unique_ptr<desktop::ScreenCapturerReplay> replay_capturer =
+            desktop::ScreenCapturerReplay::open(
+                replay_file,
+                fast ? desktop::ScreenCapturerReplay::Mode::AS_FAST_AS_POSSIBLE :
+                       desktop::ScreenCapturerReplay::Mode::REAL_TIME);
+        if (replay_capturer)
+        {
+            replay_capturer->setLoop(true);
+
+            // The frames are captured without delays between them.
+            if (fast)
+            {
+                capture_scheduler_.reset(
+                    new desktop::CaptureScheduler(std::chrono::milliseconds(0)));
+            }
+
+            screen_capturer_ = std::move(replay_capturer);
+
+            LOG(LS_WARNING) << "The screen is replayed from the recording: "
+                            << replay_file.toStdString();
+        }
+    }
+
+    const QString record_file = qEnvironmentVariable(kRecordFileVariable);
+    if (!record_file.isEmpty())
+    {
+        frame_recorder_ = desktop::FrameRecorder::create(record_file);
+        if (frame_recorder_)
+        {
+            LOG(LS_WARNING) << "The screen is recorded to the file: "
+                            << record_file.toStdString();
+        }
+    }
+#endif // defined(ENABLE_SCREEN_REPLAY)
+
+    if (!screen_capturer_)
+        screen_capturer_.reset(new desktop::ScreenCapturerGDI());
+}
+
+void ScreenUpdaterImpl::sendScreenList()
+{
+    desktop::ScreenCapturer::ScreenList screens;
+    if (!screen_capturer_->screenList(&screens))
+        return;
+
+    proto::desktop::ScreenList screen_list;
+
+    for (const auto& screen : screens)
+    {
+        proto::desktop::Screen* item = screen_list.add_screen();
+
+        item->set_id(screen.id);
+        item->set_title(screen.title.toStdString());
+    }
+
+    proto::desktop::HostToClient message;
+
+    proto::desktop::Extension* extension = message.mutable_extension();
+
+    extension->set_name(common::kSelectScreenExtension);
+    extension->set_data(screen_list.SerializeAsString());
+
+    QApplication::postEvent(parent(), new MessageEvent(common::serializeMessage(message)));
+}
+
 void ScreenUpdaterImpl::run()
 {
-    screen_capturer_.reset(new desktop::ScreenCapturerGDI());
+    createScreenCapturer();
+
+    encode_thread_ = std::thread(&ScreenUpdaterImpl::encodeThread, this);
+    serialize_thread_ = std::thread(&ScreenUpdaterImpl::serializeThread, this);
 
     while (true)
     {
@@ -197,69 +497,31 @@ void ScreenUpdaterImpl::run()
             // We display the full desktop and send a new list of screens.
             screen_id_ = desktop::ScreenCapturer::kFullDesktopScreenId;
 
-            desktop::ScreenCapturer::ScreenList screens;
-            if (screen_capturer_->screenList(&screens))
-            {
-                proto::desktop::ScreenList screen_list;
-
-                for (const auto& screen : screens)
-                {
-                    proto::desktop::Screen* item = screen_list.add_screen();
-
-                    item->set_id(screen.id);
-                    item->set_title(screen.title.toStdString());
-                }
-
-                message_.Clear();
-
-                proto::desktop::Extension* extension = message_.mutable_extension();
-
-                extension->set_name(common::kSelectScreenExtension);
-                extension->set_data(screen_list.SerializeAsString());
-
-                QApplication::postEvent(
-                    parent(), new MessageEvent(common::serializeMessage(message_)));
-            }
-
+            sendScreenList();
             screen_capturer_->selectScreen(screen_id_);
         }
 
         capture_scheduler_->beginCapture();
 
-        const desktop::Frame* screen_frame = screen_capturer_->captureFrame();
-        if (screen_frame)
+        bool has_frame_credit;
         {
-            message_.Clear();
-
-            if (!screen_frame->constUpdatedRegion().isEmpty())
-            {
-                video_encoder_->encode(scale_reducer_->scaleFrame(screen_frame),
-                                       message_.mutable_video_packet());
-            }
-
-            if (cursor_capturer_ && cursor_encoder_)
-            {
-                std::unique_ptr<desktop::MouseCursor> mouse_cursor(
-                    cursor_capturer_->captureCursor());
-                if (mouse_cursor)
-                {
-                    cursor_encoder_->encode(std::move(mouse_cursor),
-                                            message_.mutable_cursor_shape());
-                }
-            }
+            std::scoped_lock lock(event_lock_);
+            has_frame_credit = hasFrameCredit();
+        }
 
-            if (message_.has_video_packet() || message_.has_cursor_shape())
-            {
-                QApplication::postEvent(parent(),
-                    new MessageEvent(common::serializeMessage(message_)),
-                    Qt::HighEventPriority);
-            }
+        if (has_frame_credit && !captureFrame())
+        {
+            stopStages();
+            return;
         }
 
         capture_scheduler_->endCapture();
 
         std::unique_lock lock(event_lock_);
+
+        waiting_for_ack_ = !hasFrameCredit();
         event_condition_.wait_for(lock, capture_scheduler_->nextCaptureDelay());
+        waiting_for_ack_ = false;
 
         switch (event_)
         {
@@ -267,6 +529,7 @@ void ScreenUpdaterImpl::run()
                 break;
 
             case Event::TERMINATE:
+                stopStages();
                 return;
 
             case Event::SELECT_SCREEN:
@@ -278,6 +541,216 @@ void ScreenUpdaterImpl::run()
     }
 }
 
+void ScreenUpdaterImpl::stopStages()
+{
+    // The items remaining in the queues are discarded.
+    encode_queue_.close();
+    free_frames_.close();
+    serialize_queue_.close();
+    free_messages_.close();
+
+    encode_thread_.join();
+    serialize_thread_.join();
+}
+
+bool ScreenUpdaterImpl::captureFrame()
+{
+    const Clock::time_point capture_start_time = Clock::now();
+
+    const desktop::Frame* screen_frame = screen_capturer_->captureFrame();
+    if (!screen_frame)
+        return true;
+
+    const Clock::duration capture_time = Clock::now() - capture_start_time;
+
+    if (frame_recorder_)
+        frame_recorder_->writeFrame(*screen_frame);
+
+    std::unique_ptr<desktop::MouseCursor> mouse_cursor;
+
+    if (cursor_capturer_)
+        mouse_cursor.reset(cursor_capturer_->captureCursor());
+
+    const desktop::DirtyRegion& updated_region = screen_frame->constUpdatedRegion();
+
+    // The lossy encoders send the lossless top-off of the unchanged screen.
+    const bool has_video_update =
+        !updated_region.isEmpty() || video_encoder_->hasPendingUpdate();
+
+    if (!has_video_update && !mouse_cursor)
+        return true;
+
+    // The changed areas must be copied to all frames of the pool, including the frames that are
+    // in use by the other stages now.
+    for (auto& stale_region : stale_regions_)
+    {
+        for (const auto& rect : updated_region)
+            stale_region.add(rect);
+    }
+
+    // Waiting for a free frame. If the encoder is slower than the capture, the capture is blocked
+    // here until the encoder releases a frame.
+    CapturedFramePtr captured_frame = std::move(spare_frame_);
+    if (!captured_frame && !free_frames_.pop(&captured_frame))
+        return false;
+
+    if (!copyCapturedFrame(screen_frame, captured_frame.get()))
+    {
+        // Each queue has one producer, the frame can not be returned to |free_frames_| from this
+        // thread.
+        spare_frame_ = std::move(captured_frame);
+        return true;
+    }
+
+    captured_frame->mouse_cursor = std::move(mouse_cursor);
+    captured_frame->capture_start_time = capture_start_time;
+    captured_frame->capture_time = capture_time;
+    captured_frame->diff_time = screen_capturer_->diffTime();
+
+    captured_frame->has_video_update = has_video_update;
+
+    if (has_video_update)
+    {
+        std::scoped_lock lock(event_lock_);
+        captured_frame->frame_id = ++last_frame_id_;
+    }
+
+    captured_frame->queued_time = Clock::now();
+    return encode_queue_.push(std::move(captured_frame));
+}
+
+bool ScreenUpdaterImpl::copyCapturedFrame(const desktop::Frame* screen_frame,
+                                          CapturedFrame* captured_frame)
+{
+    std::unique_ptr<desktop::Frame>& frame = captured_frame->frame;
+    desktop::DirtyRegion& stale_region = stale_regions_[captured_frame->index];
+
+    if (!frame || frame->size() != screen_frame->size() ||
+        !(frame->format() == screen_frame->format()))
+    {
+        frame = desktop::FrameAligned::create(
+            screen_frame->size(), screen_frame->format(), kFrameAlignment);
+        if (!frame)
+        {
+            LOG(LS_WARNING) << "Unable to create a frame";
+            return false;
+        }
+
+        stale_region = desktop::DirtyRegion(QRect(QPoint(), screen_frame->size()));
+    }
+
+    // The screen frame contains the whole current image. Only the areas changed since the last use
+    // of this frame are copied.
+    frame->copyPixelsFrom(*screen_frame, stale_region);
+    stale_region.clear();
+
+    *frame->updatedRegion() = screen_frame->constUpdatedRegion();
+    *frame->copyRects() = screen_frame->constCopyRects();
+    frame->setTopLeft(screen_frame->topLeft());
+
+    return true;
+}
+
+// static
+void ScreenUpdaterImpl::setFrameTimings(const CapturedFrame& captured_frame,
+                                        Clock::time_point encode_start_time,
+                                        proto::desktop::FrameTimings* timings)
+{
+    const Clock::time_point now = Clock::now();
+
+    timings->set_capture_time(toMicroseconds(captured_frame.capture_time));
+    timings->set_diff_time(static_cast<uint32_t>(captured_frame.diff_time.count()));
+    timings->set_encode_wait_time(toMicroseconds(encode_start_time - captured_frame.queued_time));
+    timings->set_encode_time(toMicroseconds(now - encode_start_time));
+    timings->set_host_time(toMicroseconds(now - captured_frame.capture_start_time));
+    timings->set_send_timestamp(std::chrono::duration_cast<std::chrono::microseconds>(
+        now.time_since_epoch()).count());
+}
+
+void ScreenUpdaterImpl::encodeThread()
+{
+    CapturedFramePtr captured_frame;
+    MessagePtr message;
+
+    while (encode_queue_.pop(&captured_frame))
+    {
+        // If the previous message was not sent, it is reused. Otherwise waiting for a message
+        // released by the serialize stage.
+        if (!message && !free_messages_.pop(&message))
+            return;
+
+        message->Clear();
+
+        const desktop::Frame* frame = captured_frame->frame.get();
+
+        if (captured_frame->has_video_update)
+        {
+            proto::desktop::VideoPacket* video_packet = message->mutable_video_packet();
+
+            int64_t bandwidth;
+            {
+                std::scoped_lock lock(event_lock_);
+                bandwidth = bandwidth_estimator_.targetBytesPerSecond();
+            }
+
+            video_encoder_->setBandwidth(bandwidth);
+
+            const Clock::time_point encode_start_time = Clock::now();
+
+            video_encoder_->encode(scale_reducer_->scaleFrame(frame), video_packet);
+            video_packet->set_frame_id(captured_frame->frame_id);
+
+            // The client maps the pointer positions on the scaled image to the screen.
+            const QRect source_rect(frame->topLeft(), frame->size());
+            if (source_rect != source_rect_)
+            {
+                source_rect_ = source_rect;
+                codec::VideoUtil::toVideoRect(source_rect, video_packet->mutable_source_rect());
+            }
+
+            setFrameTimings(*captured_frame, encode_start_time, video_packet->mutable_timings());
+        }
+
+        if (captured_frame->mouse_cursor && cursor_encoder_)
+        {
+            cursor_encoder_->encode(std::move(captured_frame->mouse_cursor),
+                                    message->mutable_cursor_shape());
+        }
+
+        // The frame is no longer needed and can be reused by the capture stage.
+        if (!free_frames_.push(std::move(captured_frame)))
+            return;
+
+        if (message->has_video_packet() || message->has_cursor_shape())
+        {
+            if (!serialize_queue_.push(std::move(message)))
+                return;
+        }
+    }
+}
+
+void ScreenUpdaterImpl::serializeThread()
+{
+    MessagePtr message;
+
+    while (serialize_queue_.pop(&message))
+    {
+        QByteArray buffer = common::serializeMessage(*message);
+
+        if (message->has_video_packet() && message->video_packet().frame_id())
+        {
+            std::scoped_lock lock(event_lock_);
+            bandwidth_estimator_.packetSent(message->video_packet().frame_id(), buffer.size());
+        }
+
+        QApplication::postEvent(parent(), new MessageEvent(std::move(buffer)),
+                                Qt::HighEventPriority);
+
+        if (!free_messages_.push(std::move(message)))
+            return;
+    }
+}
+
 //================================================================================================
 // ScreenUpdater implementation.
 //================================================================================================
@@ -300,6 +773,11 @@ void ScreenUpdater::selectScreen(int64_t screen_id)
     impl_->selectScreen(screen_id);
 }
 
+void ScreenUpdater::frameAcknowledged(uint32_t frame_id)
+{
+    impl_->frameAcknowledged(frame_id);
+}
+
 void ScreenUpdater::customEvent(QEvent* event)
 {
     if (event->type() != MessageEvent::kType)
@@ -48,6 +48,9 @@ public slots:
     bool start(const proto::desktop::Config& config);
     void selectScreen(int64_t screen_id);
 
+    // Called when the client confirms the decoding of the video packet |frame_id|.
+    void frameAcknowledged(uint32_t frame_id);
+
 protected:
     // QObject implementation.
     void customEvent(QEvent* event) override;
@@ -85,6 +85,7 @@ void Channel::send(const QByteArray& buffer)
     bool schedule_write = write_queue_.isEmpty();
 
     write_queue_.push_back(buffer);
+    write_latency_.messageQueued();
 
     if (schedule_write)
         scheduleWrite();
@@ -115,6 +116,7 @@ void Channel::onBytesWritten(int64_t bytes)
     else
     {
         write_queue_.pop_front();
+        write_latency_.messageProcessed();
         written_ = 0;
 
         if (!write_queue_.empty())
@@ -25,6 +25,7 @@
 #include <QPointer>
 
 #include "base/macros_magic.h"
+#include "base/queue_latency_tracker.h"
 
 namespace ipc {
 
@@ -75,6 +76,9 @@ private:
     MessageSizeType write_size_ = 0;
     int64_t written_ = 0;
 
+    // Time from sending the message until it is written to the socket.
+    base::QueueLatencyTracker write_latency_ { "ipc::Channel" };
+
     bool read_size_received_ = false;
     QByteArray read_buffer_;
     MessageSizeType read_size_ = 0;
@@ -150,6 +150,7 @@ void Channel::send(const QByteArray& buffer)
 
     // Add the buffer to the queue for sending.
     write_.queue.push_back(buffer);
+    write_.latency.messageQueued();
 
     if (schedule_write)
         scheduleWrite();
@@ -312,6 +313,7 @@ void Channel::onMessageWritten()
 
         // Delete the sent message from the queue.
         write_.queue.pop_front();
+        write_.latency.messageProcessed();
 
         // If the queue is not empty, then we send the following message.
         if (!write_.queue.isEmpty())
@@ -25,6 +25,7 @@
 #include <QVersionNumber>
 
 #include "base/macros_magic.h"
+#include "base/queue_latency_tracker.h"
 
 namespace crypto {
 class Cryptor;
@@ -140,6 +141,9 @@ private:
 
         // Number of bytes transferred from the |buffer|.
         int64_t bytes_transferred = 0;
+
+        // Time from sending the message until it is encrypted and written to the socket.
+        base::QueueLatencyTracker latency { "net::Channel" };
     };
 
     struct ReadContext